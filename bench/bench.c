@@ -0,0 +1,1548 @@
+/*
+ * bench -- micro benchmarks for editor hot paths.
+ *
+ * Each benchmark is a command that runs its workload inside the running
+ * editor and reports timings with yed_cprint(). They are meant to be run
+ * before and after a change to the code being measured.
+ *
+ * This lives outside of plugins/ so that install.sh doesn't build and
+ * install it. Build it with build.sh here and load it from here:
+ *
+ *     plugins-add-dir /path/to/yed/bench
+ *     plugin-load bench
+ *
+ * Commands:
+ *     bench-blend [n_frames]
+ *         Draw a full-screen translucent popup for n_frames frames (default
+ *         600, i.e. ten seconds' worth at 60 Hz) and report the draw time
+ *         per frame against the 60 Hz frame budget.
+ *
+ *     bench-syntax-kwd [n_lines]
+ *         Build syntaxes with increasing numbers of keywords using the
+ *         declarative interface in syntax.h and report the time it takes to
+ *         highlight n_lines (default 20000) keyword-heavy lines with each.
+ *
+ *     bench-syntax-regex [n_lines]
+ *         Highlight n_lines (default 20000) token-heavy lines of C with a
+ *         syntax made mostly of regular expressions and report the time taken.
+ *
+ *     bench-syntax-request [n_requests]
+ *         Send n_requests (default 1000) highlight requests for strings of 10,
+ *         100 and 1000 lines, first with a different string each time and then
+ *         with the same one, and report the average time per request.
+ *
+ *     bench-syntax-build [n_syntaxes]
+ *         Build n_syntaxes (default 50) copies of the C syntax, as if that many
+ *         language plugins were loaded at startup, and report the time taken to
+ *         build them and then to highlight the first line with one of them.
+ *
+ *     bench-syntax-frame [n_rows]
+ *         Highlight n_rows (default 480, i.e. four 120-row splits) long lines
+ *         of C one at a time and then with the parallel pre-pass that runs
+ *         before a frame is drawn, and report the time taken by each.
+ *
+ *     bench-syntax-long-line [n_bytes]
+ *         Make a single line of n_bytes (default 1048576) of C, like a minified
+ *         file, and report the time taken to highlight all of it and then to
+ *         highlight 200-column windows of it the way a scrolled frame would.
+ *
+ *     bench-search [n_mb]
+ *         Search n_mb (default 64) megabytes of lines of C for a string that
+ *         isn't there, forward and backward, with each of the substring search
+ *         routines in the editor, then ignoring case and as a regex, and report
+ *         the throughput of each. Also checks that a search that doesn't
+ *         ignore case doesn't match text that differs only in case.
+ *
+ *     bench-find [n_mb]
+ *         Load n_mb (default 256) megabytes of lines of C into a buffer and
+ *         report the time that find-next and find-prev take to look through
+ *         all of it for a string that isn't there, next to the time taken to
+ *         search the lines one after another on this thread.
+ *
+ *     bench-replace [n_lines]
+ *         Fill a buffer with n_lines (default 200000) lines that each have two
+ *         matches, select all of them, and report the time taken to start
+ *         replace-current-search, to type each key of the replacement, to
+ *         replace them all with enter, and to undo and redo that. Then report
+ *         the time replace-regex takes to swap the words of each match back
+ *         around, using groups.
+ *
+ *     bench-complete [n_candidates]
+ *         Register a completion with n_candidates (default 100000) names like
+ *         "buffer-delete-42" and report the time yed_complete_fuzzy() takes
+ *         as a query is typed one key at a time, the first time with the
+ *         candidates collected, next to prefix completion with yed_complete().
+ *
+ *     bench-dir-cache [dir]
+ *         List dir (default the working directory) with the directory cache
+ *         and then list every file under it, each twice, and report the time
+ *         each took, next to reading the directory with readdir() and a stat()
+ *         per entry the way file completion used to. The first walk is
+ *         repeated until it has every directory.
+ *
+ *     bench-key-sequences [n_sequences]
+ *         Add n_sequences (default 500) key sequences like the ones terminals
+ *         send for keys with modifiers, and report the time taken to resolve
+ *         each of them a key at a time, the way keys are read, 1000 times
+ *         over, next to the linear scan of every sequence per key that was
+ *         used before.
+ *
+ *     bench-input [n_mb]
+ *         Pipe n_mb (default 10) megabytes of keystrokes into the editor's
+ *         standard input, lines of text typed into a new buffer with an arrow
+ *         key sequence in each, and report, once the last one has been taken,
+ *         the time taken, the number of times the screen was drawn and the
+ *         time spent drawing it. Standard input is put back afterwards.
+ */
+
+#include <yed/plugin.h>
+#include <yed/syntax.h>
+
+#define BENCH_60HZ_BUDGET_US (1000000ULL / 60)
+
+static void bench_report_frames(const char *what, int n_frames, unsigned long long total_us, unsigned long long max_us) {
+    unsigned long long avg_us;
+
+    avg_us = n_frames ? total_us / n_frames : 0;
+
+    yed_cprint("%s: %d frames, avg %lluus, max %lluus per frame (%.1f%% of the 60 Hz budget)",
+               what,
+               n_frames,
+               avg_us,
+               max_us,
+               100.0 * (double)avg_us / (double)BENCH_60HZ_BUDGET_US);
+}
+
+static void bench_blend(int n_args, char **args) {
+    int                  n_frames;
+    array_t              dds;
+    yed_direct_draw_t  **dit;
+    yed_direct_draw_t   *dd;
+    yed_attrs            attrs;
+    char                *line;
+    int                  row;
+    int                  col;
+    int                  i;
+    unsigned long long   start_us;
+    unsigned long long   frame_us;
+    unsigned long long   total_us;
+    unsigned long long   max_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_frames = 600;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_frames) || n_frames <= 0)) {
+        yed_cerr("expected a positive number of frames, but got '%s'", args[0]);
+        return;
+    }
+
+    if (ys->screen_update->opacity >= 1.0 || ys->screen_update->opacity <= 0.0) {
+        yed_cprint("note: 'screen-fake-opacity' is %.2f, so nothing will be blended\n",
+                   ys->screen_update->opacity);
+    }
+
+    /*
+     * Build a popup that covers every row except the command line. Mostly
+     * spaces (which blend both the foreground and background of whatever is
+     * underneath) with some text mixed in.
+     */
+    attrs       = ZERO_ATTR;
+    attrs.flags = ATTR_FG_KIND_BITS(ATTR_KIND_RGB) | ATTR_BG_KIND_BITS(ATTR_KIND_RGB);
+    attrs.fg    = RGB_32(0xee, 0xee, 0xee);
+    attrs.bg    = RGB_32(0x20, 0x30, 0x60);
+
+    dds  = array_make(yed_direct_draw_t*);
+    line = malloc(ys->term_cols + 1);
+
+    for (row = 1; row < ys->term_rows; row += 1) {
+        for (col = 0; col < ys->term_cols; col += 1) {
+            line[col] = (col % 16) < 10 ? ' ' : 'a' + ((row + col) % 26);
+        }
+        line[ys->term_cols] = 0;
+
+        dd = yed_direct_draw(row, 1, attrs, line);
+        array_push(dds, dd);
+    }
+
+    free(line);
+
+    total_us = max_us = 0;
+
+    for (i = 0; i < n_frames; i += 1) {
+        start_us = measure_time_now_us();
+        yed_draw_everything();
+        frame_us = measure_time_now_us() - start_us;
+
+        total_us += frame_us;
+        if (frame_us > max_us) { max_us = frame_us; }
+    }
+
+    array_traverse(dds, dit) {
+        yed_kill_direct_draw(*dit);
+    }
+    array_free(dds);
+
+    bench_report_frames("bench-blend", n_frames, total_us, max_us);
+}
+
+static const char *bench_c_kwds[] = {
+    "auto",     "break",    "case",     "char",     "const",    "continue",
+    "default",  "do",       "double",   "else",     "enum",     "extern",
+    "float",    "for",      "goto",     "if",       "inline",   "int",
+    "long",     "register", "restrict", "return",   "short",    "signed",
+    "sizeof",   "static",   "struct",   "switch",   "typedef",  "union",
+    "unsigned", "void",     "volatile", "while",
+};
+
+#define BENCH_N_C_KWDS (sizeof(bench_c_kwds) / sizeof(bench_c_kwds[0]))
+
+/* Highlight every line of buff with syn the way a highlight request would. */
+static unsigned long long bench_syntax_highlight(yed_syntax *syn, yed_buffer *buff) {
+    yed_event           event;
+    yed_attrs           za;
+    int                 i;
+    int                 row;
+    yed_line           *line;
+    array_t             line_attrs;
+    unsigned long long  start_us;
+    unsigned long long  total_us;
+    array_t            *ait;
+
+    memset(&event, 0, sizeof(event));
+    event.kind                  = EVENT_HIGHLIGHT_REQUEST;
+    event.highlight_lines_attrs = array_make(array_t);
+
+    za = ZERO_ATTR;
+    bucket_array_traverse(buff->lines, line) {
+        array_zero_term(line->chars);
+        line_attrs = array_make(yed_attrs);
+        for (i = 0; i < line->visual_width; i += 1) {
+            array_push(line_attrs, za);
+        }
+        array_push(event.highlight_lines_attrs, line_attrs);
+    }
+
+    start_us = measure_time_now_us();
+
+    row = 1;
+    bucket_array_traverse(buff->lines, line) {
+        event.row = row;
+        _yed_syntax_line(syn, line, &event, syn->global);
+        row += 1;
+    }
+
+    total_us = measure_time_now_us() - start_us;
+
+    array_traverse(event.highlight_lines_attrs, ait) {
+        array_free(*ait);
+    }
+    array_free(event.highlight_lines_attrs);
+
+    return total_us;
+}
+
+static void bench_syntax_kwd_one(int n_kwds, yed_buffer *buff) {
+    yed_syntax          syn;
+    char                kwd[64];
+    int                 i;
+    unsigned long long  total_us;
+
+    yed_syntax_start(&syn);
+        yed_syntax_attr_push(&syn, "&code-keyword");
+            for (i = 0; i < (int)BENCH_N_C_KWDS && i < n_kwds; i += 1) {
+                yed_syntax_kwd(&syn, bench_c_kwds[i]);
+            }
+            for (; i < n_kwds; i += 1) {
+                snprintf(kwd, sizeof(kwd), "kw_%d", i);
+                yed_syntax_kwd(&syn, kwd);
+            }
+        yed_syntax_attr_pop(&syn);
+    yed_syntax_end(&syn);
+
+    total_us = bench_syntax_highlight(&syn, buff);
+
+    yed_cprint("%6d keywords: %6lluus total, %.3fus per line\n",
+               n_kwds,
+               total_us,
+               (double)total_us / (double)yed_buff_n_lines(buff));
+
+    yed_syntax_free(&syn);
+}
+
+static void bench_syntax_kwd(int n_args, char **args) {
+    int        n_lines;
+    array_t    text;
+    char       word[64];
+    char       nl;
+    int        i;
+    int        j;
+    yed_buffer buff;
+    int        n_kwds;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_lines = 20000;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_lines) || n_lines <= 0)) {
+        yed_cerr("expected a positive number of lines, but got '%s'", args[0]);
+        return;
+    }
+
+    /*
+     * Lines of C keywords mixed with identifiers that are close to, but not,
+     * keywords so that the lookups can't bail out on the first character.
+     */
+    text = array_make(char);
+    for (i = 0; i < n_lines; i += 1) {
+        for (j = 0; j < 12; j += 1) {
+            if (j & 1) {
+                snprintf(word, sizeof(word), "%s_x%d ", bench_c_kwds[(i + j) % BENCH_N_C_KWDS], j);
+            } else {
+                snprintf(word, sizeof(word), "%s ", bench_c_kwds[(i * 7 + j) % BENCH_N_C_KWDS]);
+            }
+            array_push_n(text, word, strlen(word));
+        }
+        nl = '\n';
+        array_push(text, nl);
+    }
+
+    buff        = yed_new_buff();
+    buff.flags |= BUFF_NO_MOD_EVENTS;
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    array_free(text);
+
+    yed_cprint("highlighting %d lines\n", n_lines);
+
+    for (n_kwds = BENCH_N_C_KWDS; n_kwds <= 8192; n_kwds *= 4) {
+        bench_syntax_kwd_one(n_kwds, &buff);
+    }
+
+    yed_destroy_buffer(&buff);
+}
+
+/* A syntax in the style of the C highlighter, made mostly of regular expressions. */
+static void bench_c_syntax(yed_syntax *syn) {
+    int i;
+
+    yed_syntax_start(syn);
+        yed_syntax_attr_push(syn, "&code-comment");
+            yed_syntax_range_start(syn, "/\\*");
+            yed_syntax_range_end(syn,   "\\*/");
+            yed_syntax_range_start(syn, "//");
+                yed_syntax_range_one_line(syn);
+            yed_syntax_range_end(syn,   "$");
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-string");
+            yed_syntax_range_start(syn, "\"");
+                yed_syntax_range_one_line(syn);
+                yed_syntax_range_skip(syn, "\\\\\"");
+                yed_syntax_attr_push(syn, "&code-escape");
+                    yed_syntax_regex(syn, "\\\\.");
+                yed_syntax_attr_pop(syn);
+            yed_syntax_range_end(syn, "\"");
+            yed_syntax_regex(syn, "'(\\\\.|[^'\\\\])'");
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-preprocessor");
+            yed_syntax_regex(syn, "^[[:space:]]*#[[:space:]]*[[:alpha:]]+");
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-fn-call");
+            yed_syntax_regex_sub(syn, "([[:alpha:]_][[:alnum:]_]*)[[:space:]]*\\(", 1);
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-field");
+            yed_syntax_regex_sub(syn, "(\\.|->)[[:space:]]*([[:alpha:]_][[:alnum:]_]*)", 2);
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-constant");
+            yed_syntax_regex(syn, "[A-Z_][A-Z0-9_]+[^[:alnum:]_(]");
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-number");
+            yed_syntax_regex_sub(syn, "(^|[^[:alnum:]_])(-?[[:digit:]]+\\.[[:digit:]]+)", 2);
+            yed_syntax_regex_sub(syn, "(^|[^[:alnum:]_])(0[xX][[:xdigit:]]+)", 2);
+            yed_syntax_regex_sub(syn, "(^|[^[:alnum:]_])(-?[[:digit:]]+)", 2);
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-operator");
+            yed_syntax_regex(syn, "<<|>>|<=|>=|==|!=|&&|\\|\\|");
+            yed_syntax_regex(syn, "[-+*/%=<>!&|^~?:]");
+        yed_syntax_attr_pop(syn);
+
+        yed_syntax_attr_push(syn, "&code-keyword");
+            for (i = 0; i < (int)BENCH_N_C_KWDS; i += 1) {
+                yed_syntax_kwd(syn, bench_c_kwds[i]);
+            }
+        yed_syntax_attr_pop(syn);
+    yed_syntax_end(syn);
+}
+
+/* Token-heavy lines in the style of the C highlighter, with a block comment every so often. */
+static void bench_c_text(array_t *text, int n_lines) {
+    int         i;
+    const char *line;
+
+    for (i = 0; i < n_lines; i += 1) {
+        switch (i % 8) {
+            case 0: line = "    total = compute(a, 123) + table[0x1f] * 3.5 - (b << 2); /* scale */\n";  break;
+            case 1: line = "    printf(\"%d items\\n\", count(list, 42), ptr->next->val, 'x');\n";   break;
+            case 2: line = "    if (x >= 0 && y != -17) { return fn(x, y) ? 1 : 0; } // done\n";         break;
+            case 3: line = "#define MAX_SIZE(a, b) ((a) > (b) ? (a) : (b))\n";                           break;
+            case 4: line = "/* Block comments span lines, so the state at the\n";                         break;
+            case 5: line = "   start of each line matters: if (x) return 1; */\n";                        break;
+            case 6: line = "    ptr->next = (node_t*)malloc(sizeof(node_t) * 16);\n";                    break;
+            case 7: line = "    while (i < n) { sum += vals[i] * 0.5; i += 1; }\n";                      break;
+        }
+        array_push_n(*text, (char*)line, strlen(line));
+    }
+}
+
+static void bench_syntax_regex(int n_args, char **args) {
+    int                 n_lines;
+    array_t             text;
+    yed_buffer          buff;
+    yed_syntax          syn;
+    unsigned long long  total_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_lines = 20000;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_lines) || n_lines <= 0)) {
+        yed_cerr("expected a positive number of lines, but got '%s'", args[0]);
+        return;
+    }
+
+    text = array_make(char);
+    bench_c_text(&text, n_lines);
+
+    buff        = yed_new_buff();
+    buff.flags |= BUFF_NO_MOD_EVENTS;
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    array_free(text);
+
+    bench_c_syntax(&syn);
+
+    if (yed_syntax_compile(&syn) != 0) {
+        yed_cerr("bad regex in the benchmark syntax: %s", yed_syntax_get_regex_err(&syn));
+    } else {
+        total_us = bench_syntax_highlight(&syn, &buff);
+
+        yed_cprint("%d regexes, %d lines: %lluus total, %.3fus per line\n",
+                   (int)array_len(syn.global->items.regs),
+                   n_lines,
+                   total_us,
+                   (double)total_us / (double)n_lines);
+    }
+
+    yed_syntax_free(&syn);
+    yed_destroy_buffer(&buff);
+}
+
+static unsigned long long bench_syntax_request(yed_syntax *syn, const char *string) {
+    yed_event           event;
+    unsigned long long  start_us;
+    unsigned long long  total_us;
+    array_t            *ait;
+
+    memset(&event, 0, sizeof(event));
+    event.kind                  = EVENT_HIGHLIGHT_REQUEST;
+    event.highlight_string      = string;
+    event.highlight_lines_attrs = array_make(array_t);
+
+    start_us = measure_time_now_us();
+    yed_syntax_highlight_request_event(syn, &event);
+    total_us = measure_time_now_us() - start_us;
+
+    array_traverse(event.highlight_lines_attrs, ait) {
+        array_free(*ait);
+    }
+    array_free(event.highlight_lines_attrs);
+
+    return total_us;
+}
+
+static void bench_syntax_requests(int n_args, char **args) {
+    int                 n_requests;
+    yed_syntax          syn;
+    array_t             text;
+    int                 n_lines;
+    int                 i;
+    char                tag[64];
+    int                 tag_len;
+    unsigned long long  total_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_requests = 1000;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_requests) || n_requests <= 0)) {
+        yed_cerr("expected a positive number of requests, but got '%s'", args[0]);
+        return;
+    }
+
+    bench_c_syntax(&syn);
+
+    for (n_lines = 10; n_lines <= 1000; n_lines *= 10) {
+        text = array_make(char);
+        bench_c_text(&text, n_lines);
+
+        /* A different string every time, so every request has to do the work. */
+        total_us = 0;
+        for (i = 0; i < n_requests; i += 1) {
+            tag_len = snprintf(tag, sizeof(tag), "// request %d", i);
+            array_push_n(text, tag, tag_len);
+            array_zero_term(text);
+
+            total_us += bench_syntax_request(&syn, array_data(text));
+
+            array_delete(text, array_len(text) - 1);
+            text.used -= tag_len;
+        }
+
+        yed_cprint("%5d lines, distinct strings: %8.1fus per request\n",
+                   n_lines,
+                   (double)total_us / (double)n_requests);
+
+        /* The same string every time, as a completion popup would. */
+        array_zero_term(text);
+        total_us = 0;
+        for (i = 0; i < n_requests; i += 1) {
+            total_us += bench_syntax_request(&syn, array_data(text));
+        }
+
+        yed_cprint("%5d lines, repeated string:  %8.1fus per request\n",
+                   n_lines,
+                   (double)total_us / (double)n_requests);
+
+        array_free(text);
+    }
+
+    yed_syntax_free(&syn);
+}
+
+static void bench_syntax_build(int n_args, char **args) {
+    int                 n_syntaxes;
+    yed_syntax         *syns;
+    int                 i;
+    array_t             text;
+    yed_buffer          buff;
+    unsigned long long  start_us;
+    unsigned long long  build_us;
+    unsigned long long  first_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_syntaxes = 50;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_syntaxes) || n_syntaxes <= 0)) {
+        yed_cerr("expected a positive number of syntaxes, but got '%s'", args[0]);
+        return;
+    }
+
+    syns = malloc(sizeof(*syns) * n_syntaxes);
+
+    start_us = measure_time_now_us();
+    for (i = 0; i < n_syntaxes; i += 1) {
+        bench_c_syntax(syns + i);
+    }
+    build_us = measure_time_now_us() - start_us;
+
+    text = array_make(char);
+    bench_c_text(&text, 1);
+
+    buff        = yed_new_buff();
+    buff.flags |= BUFF_NO_MOD_EVENTS;
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    array_free(text);
+
+    first_us = bench_syntax_highlight(syns, &buff);
+
+    yed_cprint("%d syntaxes: %lluus to build (%.1fus each), %lluus to highlight the first line",
+               n_syntaxes,
+               build_us,
+               (double)build_us / (double)n_syntaxes,
+               first_us);
+
+    for (i = 0; i < n_syntaxes; i += 1) {
+        yed_syntax_free(syns + i);
+    }
+    free(syns);
+    yed_destroy_buffer(&buff);
+}
+
+static void bench_syntax_frame(int n_args, char **args) {
+    int                 n_rows;
+    array_t             text;
+    char               *c;
+    int                 n_newlines;
+    yed_buffer          buff;
+    yed_syntax          syn;
+    yed_frame           frame;
+    yed_event           event;
+    _yed_syntax_cache  *cache;
+    _yed_syntax_row    *rit;
+    unsigned long long  start_us;
+    unsigned long long  serial_us;
+    unsigned long long  parallel_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_rows = 480;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_rows) || n_rows <= 0)) {
+        yed_cerr("expected a positive number of rows, but got '%s'", args[0]);
+        return;
+    }
+
+    /* Join every four lines into one, so that each row has plenty of work. */
+    text = array_make(char);
+    bench_c_text(&text, 4 * n_rows);
+
+    n_newlines = 0;
+    array_traverse(text, c) {
+        if (*c == '\n') {
+            n_newlines += 1;
+            if (n_newlines % 4 != 0) { *c = ' '; }
+        }
+    }
+
+    buff        = yed_new_buff();
+    buff.flags |= BUFF_NO_MOD_EVENTS;
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    array_free(text);
+
+    bench_c_syntax(&syn);
+    yed_syntax_compile(&syn);
+
+    serial_us = bench_syntax_highlight(&syn, &buff);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.buffer = &buff;
+    frame.height = n_rows;
+
+    memset(&event, 0, sizeof(event));
+    event.kind  = EVENT_FRAME_PRE_BUFF_DRAW;
+    event.frame = &frame;
+
+    /* Work out the start state of every row up front, like the scan between frames would. */
+    cache = _yed_syntax_get_cache(&syn, &buff);
+    while (_yed_syntax_scan(&syn, &buff, cache, ~(u64)0)) {}
+
+    /* Once to create the per-thread copies of the syntax. */
+    yed_syntax_frame_event(&syn, &event);
+
+    array_traverse(syn.rows, rit) {
+        rit->buffer = NULL;
+    }
+
+    start_us = measure_time_now_us();
+    yed_syntax_frame_event(&syn, &event);
+    parallel_us = measure_time_now_us() - start_us;
+
+    if (yed_n_workers() <= 1) {
+        yed_cprint("%d rows of %d columns: %lluus one at a time (set 'worker-threads' to more than 1 to compare)",
+                   n_rows,
+                   yed_buff_get_line(&buff, 1)->visual_width,
+                   serial_us);
+    } else {
+        yed_cprint("%d rows of %d columns: %lluus one at a time, %lluus in parallel with %d threads",
+                   n_rows,
+                   yed_buff_get_line(&buff, 1)->visual_width,
+                   serial_us,
+                   parallel_us,
+                   yed_n_workers());
+    }
+
+    yed_syntax_free(&syn);
+    yed_destroy_buffer(&buff);
+}
+
+static void bench_syntax_long_line(int n_args, char **args) {
+    int                 n_bytes;
+    array_t             text;
+    char               *c;
+    yed_buffer          buff;
+    yed_line           *line;
+    yed_syntax          syn;
+    yed_frame           frame;
+    yed_event           event;
+    yed_attrs           za;
+    int                 i;
+    int                 n_windows;
+    unsigned long long  start_us;
+    unsigned long long  full_us;
+    unsigned long long  first_us;
+    unsigned long long  window_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_bytes = 1048576;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_bytes) || n_bytes <= 0)) {
+        yed_cerr("expected a positive number of bytes, but got '%s'", args[0]);
+        return;
+    }
+
+    text = array_make(char);
+    while (array_len(text) < n_bytes) {
+        bench_c_text(&text, 8);
+    }
+
+    /* Minified code doesn't have line comments, since they would comment out the rest of the file. */
+    array_traverse(text, c) {
+        if (*c == '\n') {
+            *c = ' ';
+        } else if (*c == '/' && c[1] == '/') {
+            c[1] = '*';
+            memcpy(c + 2, "dn*/", 4);
+        }
+    }
+
+    buff        = yed_new_buff();
+    buff.flags |= BUFF_NO_MOD_EVENTS;
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    array_free(text);
+
+    line = yed_buff_get_line(&buff, 1);
+    array_zero_term(line->chars);
+
+    bench_c_syntax(&syn);
+    yed_syntax_compile(&syn);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.buffer = &buff;
+    frame.width  = 200;
+    frame.height = 1;
+
+    memset(&event, 0, sizeof(event));
+    event.kind        = EVENT_LINE_PRE_DRAW;
+    event.frame       = &frame;
+    event.row         = 1;
+    event.eline_attrs = array_make(yed_attrs);
+
+    za = ZERO_ATTR;
+    for (i = 0; i < frame.width; i += 1) {
+        array_push(event.eline_attrs, za);
+    }
+
+    start_us = measure_time_now_us();
+    _yed_syntax_line_span(&syn, line, &event, syn.global, 0, array_len(line->chars));
+    full_us = measure_time_now_us() - start_us;
+
+    /* The first window also works out the checkpoints for the line. */
+    frame.buffer_x_offset = line->visual_width / 2;
+    start_us = measure_time_now_us();
+    _yed_syntax_line_window(&syn, line, &event, syn.global);
+    first_us = measure_time_now_us() - start_us;
+
+    /* Then scroll through the line. */
+    n_windows = 0;
+    start_us  = measure_time_now_us();
+    for (frame.buffer_x_offset = 0; frame.buffer_x_offset < line->visual_width; frame.buffer_x_offset += frame.width) {
+        _yed_syntax_line_window(&syn, line, &event, syn.global);
+        n_windows += 1;
+    }
+    window_us = measure_time_now_us() - start_us;
+
+    yed_cprint("%d-byte line: %lluus to highlight all of it, %lluus for the first window, %.1fus per window after that (%d windows)",
+               array_len(line->chars),
+               full_us,
+               first_us,
+               (double)window_us / (double)n_windows,
+               n_windows);
+
+    array_free(event.eline_attrs);
+    yed_syntax_free(&syn);
+    yed_destroy_buffer(&buff);
+}
+
+/* The search routines that find.c used to use. The editor exports them but doesn't declare them for plugins. */
+char *strnstr(const char *haystack, const char *needle, size_t len);
+int   yed_boyer_moore(char *text, int text_len, char *pattern, int pattern_len);
+
+typedef struct {
+    int start;
+    int len;
+} bench_search_line;
+
+/* Total matches found, so that the compiler can't drop the searches. */
+static int bench_search_found;
+
+static void bench_search_report(const char *what, unsigned long long us, long long n_bytes) {
+    yed_cprint("%-26s %8lluus  %8.1f MB/s\n",
+               what,
+               us,
+               ((double)n_bytes / (1024.0 * 1024.0)) / ((double)us / 1000000.0));
+}
+
+static void bench_search_pattern(const char *what, const char *str, int flags, array_t *lines, char *data, long long n_bytes) {
+    yed_search_pattern  pattern;
+    bench_search_line  *it;
+    unsigned long long  start_us;
+
+    yed_search_pattern_make(&pattern, str, flags);
+
+    start_us = measure_time_now_us();
+    array_traverse(*lines, it) {
+        bench_search_found += yed_search_pattern_find(&pattern, data + it->start, it->len, 0, it->len, NULL) >= 0;
+    }
+    bench_search_report(what, measure_time_now_us() - start_us, n_bytes);
+
+    yed_search_pattern_free(&pattern);
+}
+
+/*
+ * Matches that differ only in case, far enough into a line that the
+ * searches look at them a block at a time.
+ */
+static void bench_search_check_case(void) {
+    const char         *text = "xxAbcxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxabcxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxabCxx";
+    yed_search_pattern  pattern;
+    int                 len;
+    int                 first;
+    int                 last;
+    int                 got;
+
+    len   = strlen(text);
+    first = strstr(text, "abc") - text;
+    last  = first;
+
+    yed_search_pattern_make(&pattern, "abc", 0);
+    if ((got = yed_search_pattern_find(&pattern, text, len, 0, len, NULL)) != first) {
+        yed_cerr("case-sensitive find: expected %d, got %d", first, got);
+    }
+    if ((got = yed_search_pattern_rfind(&pattern, text, len, len, NULL)) != last) {
+        yed_cerr("case-sensitive rfind: expected %d, got %d", last, got);
+    }
+    yed_search_pattern_free(&pattern);
+
+    yed_search_pattern_make(&pattern, "abc", SEARCH_PATTERN_ICASE);
+    if ((got = yed_search_pattern_find(&pattern, text, len, 0, len, NULL)) != 2) {
+        yed_cerr("find ignoring case: expected 2, got %d", got);
+    }
+    if ((got = yed_search_pattern_rfind(&pattern, text, len, len, NULL)) != len - 5) {
+        yed_cerr("rfind ignoring case: expected %d, got %d", len - 5, got);
+    }
+    yed_search_pattern_free(&pattern);
+}
+
+static void bench_search(int n_args, char **args) {
+    int                 n_mb;
+    array_t             text;
+    array_t             lines;
+    bench_search_line   l, *it;
+    char               *data;
+    char               *p;
+    char                needle[] = "sizeof(node_q)";
+    int                 needle_len;
+    yed_search_pattern  pattern;
+    unsigned long long  start_us;
+    long long           n_bytes;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n_mb = 64;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_mb) || n_mb <= 0)) {
+        yed_cerr("expected a positive number of megabytes, but got '%s'", args[0]);
+        return;
+    }
+
+    text = array_make(char);
+    while (array_len(text) < n_mb * 1024 * 1024) {
+        bench_c_text(&text, 8);
+    }
+
+    /* Split it up like a buffer's lines. */
+    lines   = array_make(bench_search_line);
+    data    = array_data(text);
+    l.start = 0;
+    for (p = data; p < data + array_len(text); p += 1) {
+        if (*p == '\n') {
+            l.len = (p - data) - l.start;
+            array_push(lines, l);
+            l.start = (p - data) + 1;
+        }
+    }
+
+    n_bytes    = array_len(text);
+    needle_len = strlen(needle);
+
+    yed_search_pattern_make(&pattern, needle, 0);
+    bench_search_found = 0;
+
+    yed_cprint("%d lines, %lld bytes, looking for '%s'\n", array_len(lines), n_bytes, needle);
+
+    start_us = measure_time_now_us();
+    array_traverse(lines, it) {
+        bench_search_found += strnstr(data + it->start, needle, it->len) != NULL;
+    }
+    bench_search_report("strnstr", measure_time_now_us() - start_us, n_bytes);
+
+    start_us = measure_time_now_us();
+    array_traverse(lines, it) {
+        bench_search_found += yed_boyer_moore(data + it->start, it->len, needle, needle_len) >= 0;
+    }
+    bench_search_report("yed_boyer_moore", measure_time_now_us() - start_us, n_bytes);
+
+    start_us = measure_time_now_us();
+    array_traverse(lines, it) {
+        bench_search_found += yed_search_pattern_find(&pattern, data + it->start, it->len, 0, it->len, NULL) >= 0;
+    }
+    bench_search_report("yed_search_pattern_find", measure_time_now_us() - start_us, n_bytes);
+
+    start_us = measure_time_now_us();
+    array_traverse(lines, it) {
+        bench_search_found += last_strnstr(data + it->start, needle, it->len) != NULL;
+    }
+    bench_search_report("last_strnstr", measure_time_now_us() - start_us, n_bytes);
+
+    start_us = measure_time_now_us();
+    array_traverse(lines, it) {
+        bench_search_found += yed_search_pattern_rfind(&pattern, data + it->start, it->len, it->len, NULL) >= 0;
+    }
+    bench_search_report("yed_search_pattern_rfind", measure_time_now_us() - start_us, n_bytes);
+
+    bench_search_pattern("ignoring case",            "SizeOf(Node_Q)",             SEARCH_PATTERN_ICASE, &lines, data, n_bytes);
+    bench_search_pattern("regex, literal prefix",    "sizeof\\(node_q\\)",         SEARCH_PATTERN_REGEX, &lines, data, n_bytes);
+    bench_search_pattern("regex, no literal prefix", "[a-z]+\\(node_q\\)",         SEARCH_PATTERN_REGEX, &lines, data, n_bytes);
+
+    if (bench_search_found) {
+        yed_cerr("found %d matches that shouldn't be there", bench_search_found);
+    }
+
+    bench_search_check_case();
+
+    yed_search_pattern_free(&pattern);
+    array_free(lines);
+    array_free(text);
+}
+
+static void bench_find(int n_args, char **args) {
+    int                 n_mb;
+    array_t             text;
+    yed_buffer          buff;
+    yed_buffer         *save_buff;
+    char               *save_search;
+    yed_line           *line;
+    yed_search_pattern  pattern;
+    int                 r, c;
+    unsigned long long  start_us;
+    long long           n_bytes;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    if (!ys->active_frame) {
+        yed_cerr("no active frame");
+        return;
+    }
+
+    n_mb = 256;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_mb) || n_mb <= 0)) {
+        yed_cerr("expected a positive number of megabytes, but got '%s'", args[0]);
+        return;
+    }
+
+    text = array_make(char);
+    while (array_len(text) < n_mb * 1024 * 1024) {
+        bench_c_text(&text, 8);
+    }
+
+    /* No modification events, so there's no search index to help. */
+    buff        = yed_new_buff();
+    buff.flags |= BUFF_NO_MOD_EVENTS;
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    n_bytes = array_len(text);
+    array_free(text);
+
+    save_buff                = ys->active_frame->buffer;
+    save_search              = ys->current_search;
+    ys->active_frame->buffer = &buff;
+    ys->current_search       = "sizeof(node_q)";
+
+    yed_cprint("%d lines, %lld bytes, looking for '%s' with %d threads\n",
+               yed_buff_n_lines(&buff), n_bytes, ys->current_search, yed_n_workers());
+
+    yed_search_pattern_make(&pattern, ys->current_search, 0);
+    bench_search_found = 0;
+
+    start_us = measure_time_now_us();
+    bucket_array_traverse(buff.lines, line) {
+        bench_search_found += yed_search_pattern_find(&pattern, array_data(line->chars), array_len(line->chars), 0, array_len(line->chars), NULL) >= 0;
+    }
+    bench_search_report("one line at a time", measure_time_now_us() - start_us, n_bytes);
+
+    start_us = measure_time_now_us();
+    bench_search_found += yed_find_next(1, 1, &r, &c);
+    bench_search_report("yed_find_next", measure_time_now_us() - start_us, n_bytes);
+
+    start_us = measure_time_now_us();
+    bench_search_found += yed_find_prev(1, 1, &r, &c);
+    bench_search_report("yed_find_prev", measure_time_now_us() - start_us, n_bytes);
+
+    if (ys->search_cancelled) {
+        yed_cerr("a key was pressed, so the search was cancelled");
+    } else if (bench_search_found) {
+        yed_cerr("found %d matches that shouldn't be there", bench_search_found);
+    }
+
+    ys->active_frame->buffer = save_buff;
+    ys->current_search       = save_search;
+
+    yed_search_pattern_free(&pattern);
+    yed_destroy_buffer(&buff);
+}
+
+static void bench_replace(int n_args, char **args) {
+    int                 n_lines, i;
+    array_t             text;
+    char                line[128];
+    yed_buffer          buff;
+    yed_buffer         *save_buff;
+    char               *save_search,
+                       *save_current_search;
+    int                 save_row, save_col;
+    const char         *keys;
+    char                key[16];
+    unsigned long long  start_us;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    if (!ys->active_frame) {
+        yed_cerr("no active frame");
+        return;
+    }
+
+    if (ys->interactive_command) {
+        yed_cerr("can't run while another command is taking keys");
+        return;
+    }
+
+    n_lines = 200000;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_lines) || n_lines <= 0)) {
+        yed_cerr("expected a positive number of lines, but got '%s'", args[0]);
+        return;
+    }
+
+    text = array_make(char);
+    for (i = 0; i < n_lines; i += 1) {
+        snprintf(line, sizeof(line), "    total += node_weight(nodes[%d]) * node_weight(root);\n", i);
+        array_push_n(text, line, strlen(line));
+    }
+
+    buff = yed_new_buff();
+    yed_fill_buff_from_string(&buff, array_data(text), array_len(text));
+    array_free(text);
+
+    save_buff                = ys->active_frame->buffer;
+    save_search              = ys->save_search;
+    save_current_search      = ys->current_search;
+    save_row                 = ys->active_frame->cursor_line;
+    save_col                 = ys->active_frame->cursor_col;
+    ys->active_frame->buffer = &buff;
+    ys->save_search          = "node_weight";
+    yed_set_cursor_within_frame(ys->active_frame, 1, 1);
+
+    buff.has_selection        = 1;
+    buff.selection.kind       = RANGE_LINE;
+    buff.selection.locked     = 1;
+    buff.selection.anchor_row = 1;
+    buff.selection.anchor_col = 1;
+    buff.selection.cursor_row = yed_buff_n_lines(&buff);
+    buff.selection.cursor_col = 1;
+
+    yed_cprint("%d lines, replacing '%s'\n", yed_buff_n_lines(&buff), ys->save_search);
+
+    start_us = measure_time_now_us();
+    YEXE("replace-current-search");
+    yed_cprint("    %-24s %8.2f ms\n", "start", (measure_time_now_us() - start_us) / 1000.0);
+
+    start_us = measure_time_now_us();
+    for (keys = "node_cost"; *keys; keys += 1) {
+        snprintf(key, sizeof(key), "%d", *keys);
+        YEXE("replace-current-search", key);
+    }
+    yed_cprint("    %-24s %8.2f ms per key\n", "typing", (measure_time_now_us() - start_us) / 1000.0 / strlen("node_cost"));
+
+    start_us = measure_time_now_us();
+    snprintf(key, sizeof(key), "%d", ENTER);
+    YEXE("replace-current-search", key);
+    yed_cprint("    %-24s %8.2f ms\n", "enter", (measure_time_now_us() - start_us) / 1000.0);
+
+    start_us = measure_time_now_us();
+    yed_undo(ys->active_frame, &buff);
+    yed_cprint("    %-24s %8.2f ms\n", "undo", (measure_time_now_us() - start_us) / 1000.0);
+
+    start_us = measure_time_now_us();
+    yed_redo(ys->active_frame, &buff);
+    yed_cprint("    %-24s %8.2f ms\n", "redo", (measure_time_now_us() - start_us) / 1000.0);
+
+    if (strncmp(array_data(yed_buff_get_line(&buff, n_lines)->chars), "    total += node_cost(nodes[", 29) != 0) {
+        yed_cerr("the last line wasn't replaced");
+    }
+
+    start_us = measure_time_now_us();
+    YEXE("replace-regex", "node_([a-z]+)\\(([a-z]+)", "\\2_\\1(");
+    yed_cprint("    %-24s %8.2f ms with %d threads\n", "replace-regex", (measure_time_now_us() - start_us) / 1000.0, yed_n_workers());
+
+    if (strncmp(array_data(yed_buff_get_line(&buff, n_lines)->chars), "    total += nodes_cost([", 25) != 0) {
+        yed_cerr("replace-regex didn't replace the last line");
+    }
+
+    yed_clear_cmd_buff();
+
+    ys->active_frame->buffer = save_buff;
+    ys->save_search          = save_search;
+    ys->current_search       = save_current_search;
+    yed_set_cursor_within_frame(ys->active_frame, save_row, save_col);
+
+    yed_destroy_buffer(&buff);
+}
+
+static array_t bench_compl_names;
+
+static int bench_compl(char *string, yed_completion_results *results) {
+    char **it;
+    int    len;
+    char  *cpy;
+
+    len = strlen(string);
+
+    array_clear(results->strings);
+    array_traverse(bench_compl_names, it) {
+        if (strncmp(*it, string, len) == 0) {
+            cpy = strdup(*it);
+            array_push(results->strings, cpy);
+        }
+    }
+
+    return array_len(results->strings) ? COMPL_ERR_NO_ERR : COMPL_ERR_NO_MATCH;
+}
+
+static void bench_complete_report(const char *what, const char *string, int fuzzy) {
+    yed_completion_results  results;
+    unsigned long long      start_us;
+    int                     status;
+
+    start_us = measure_time_now_us();
+    if (fuzzy) { status = yed_complete_fuzzy("bench-compl", (char*)string, &results); }
+    else       { status = yed_complete("bench-compl", (char*)string, &results);       }
+    yed_cprint("    %-10s %-12s %8.2f ms, %6d results, first '%s'\n",
+               what,
+               string,
+               (measure_time_now_us() - start_us) / 1000.0,
+               status == COMPL_ERR_NO_ERR ? array_len(results.strings) : 0,
+               status == COMPL_ERR_NO_ERR && array_len(results.strings) ? *(char**)array_item(results.strings, 0) : "");
+
+    if (status != COMPL_ERR_NO_COMPL) {
+        free_string_array(results.strings);
+    }
+}
+
+static void bench_complete(int n_args, char **args) {
+    const char *verbs[] = { "buffer", "frame", "cursor", "select", "find", "replace", "plugin", "style" };
+    const char *nouns[] = { "delete", "new", "next", "prev", "close", "move", "split", "open",
+                            "line", "word", "begin", "end", "reload", "toggle", "hidden", "all" };
+    const char *query;
+    char        name[128];
+    char       *cpy;
+    char        prefix[64];
+    int         n, i;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n = 100000;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n) || n <= 0)) {
+        yed_cerr("expected a positive number of candidates, but got '%s'", args[0]);
+        return;
+    }
+
+    bench_compl_names = array_make(char*);
+    for (i = 0; i < n; i += 1) {
+        snprintf(name, sizeof(name), "%s-%s-%d", verbs[i % 8], nouns[(i / 8) % 16], i / 128);
+        cpy = strdup(name);
+        array_push(bench_compl_names, cpy);
+    }
+
+    yed_set_completion("bench-compl", bench_compl);
+
+    yed_cprint("%d candidates\n", n);
+
+    query = "bfdel42";
+    for (i = 0; query[i]; i += 1) {
+        memcpy(prefix, query, i + 1);
+        prefix[i + 1] = 0;
+        bench_complete_report("fuzzy", prefix, 1);
+    }
+    bench_complete_report("fuzzy", "frmsplt", 1);
+    bench_complete_report("prefix", "buffer-delete", 0);
+
+    yed_unset_completion("bench-compl");
+    free_string_array(bench_compl_names);
+}
+
+static void bench_dir_cache(int n_args, char **args) {
+    const char         *dirn;
+    array_t             names;
+    unsigned long long  start_us;
+    DIR                *dir;
+    struct dirent      *dent;
+    char                path[4096];
+    struct stat         st;
+    int                 n;
+    int                 i;
+    int                 complete;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    dirn = n_args == 1 ? args[0] : ".";
+
+    start_us = measure_time_now_us();
+    n        = 0;
+    if ((dir = opendir(dirn)) != NULL) {
+        while ((dent = readdir(dir)) != NULL) {
+            snprintf(path, sizeof(path), "%s/%s", dirn, dent->d_name);
+            n += stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        closedir(dir);
+    }
+    yed_cprint("%s\n    %-24s %8.2f ms, %d directories\n", dirn, "readdir() and stat()", (measure_time_now_us() - start_us) / 1000.0, n);
+
+    for (i = 0; i < 2; i += 1) {
+        names    = array_make(char*);
+        start_us = measure_time_now_us();
+        complete = yed_dir_cache_list(dirn, &names, 1);
+        yed_cprint("    %-24s %8.2f ms, %d directories%s\n", "yed_dir_cache_list()", (measure_time_now_us() - start_us) / 1000.0, array_len(names), complete ? "" : " (not read yet)");
+        free_string_array(names);
+    }
+
+    for (i = 0; i < 2; i += 1) {
+        start_us = measure_time_now_us();
+        n        = 0;
+        do {
+            names    = array_make(char*);
+            complete = yed_dir_cache_walk(dirn, &names);
+            n       += 1;
+            if (!complete) { free_string_array(names); }
+        } while (!complete);
+        yed_cprint("    %-24s %8.2f ms, %d files in %d walks\n", "yed_dir_cache_walk()", (measure_time_now_us() - start_us) / 1000.0, array_len(names), n);
+        free_string_array(names);
+    }
+}
+
+/* The way a sequence used to be resolved: a scan of all of them for each key read, and one at the end. */
+static int bench_key_seq_linear(int len, int *keys) {
+    yed_key_sequence *seq_it;
+    int               n;
+    int               i;
+    int               partial;
+
+    for (n = 1; n < len; n += 1) {
+        partial = 0;
+        array_traverse(ys->key_sequences, seq_it) {
+            if (seq_it->len > n) {
+                for (i = 0; i < n && seq_it->keys[i] == keys[i]; i += 1);
+                if (i == n) { partial = 1; break; }
+            }
+        }
+        if (!partial) { return KEY_NULL; }
+    }
+
+    array_traverse(ys->key_sequences, seq_it) {
+        if (seq_it->len == len) {
+            for (i = 0; i < len && seq_it->keys[i] == keys[i]; i += 1);
+            if (i == len) { return seq_it->seq_key; }
+        }
+    }
+
+    return KEY_NULL;
+}
+
+static int bench_key_seq_trie(int len, int *keys) {
+    int node;
+    int i;
+
+    node = KEY_SEQ_ROOT;
+    for (i = 0; i < len; i += 1) {
+        if ((node = yed_key_sequence_step(node, keys[i])) == -1) { return KEY_NULL; }
+    }
+
+    return ((yed_key_seq_node*)array_item(ys->key_seq_trie.nodes, node))->seq_key;
+}
+
+static void bench_key_sequences(int n_args, char **args) {
+    const char         *mods = "2345678";
+    const char         *finals = "ABCDFHPQRS~";
+    array_t             seqs;
+    array_t             seq_keys;
+    yed_key_sequence   *seq;
+    int                 keys[MAX_SEQ_LEN];
+    int                 len;
+    int                 n;
+    int                 i;
+    int                 r;
+    int                 key;
+    int                 found;
+    int                 pass;
+    unsigned long long  start_us;
+    unsigned long long  us[2];
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    n = 500;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n) || n <= 0)) {
+        yed_cerr("expected a positive number of sequences, but got '%s'", args[0]);
+        return;
+    }
+
+    seqs     = array_make(yed_key_sequence);
+    seq_keys = array_make(int);
+
+    /* ESC [ <n> ; <mod> <final>, with n counting up from 1, so they're all different. */
+    for (i = 0; i < n; i += 1) {
+        len         = 0;
+        keys[len++] = ESC;
+        keys[len++] = '[';
+        if (i / (7 * 11) + 1 >= 10) { keys[len++] = '0' + (i / (7 * 11) + 1) / 10 % 10; }
+        keys[len++] = '0' + (i / (7 * 11) + 1) % 10;
+        keys[len++] = ';';
+        keys[len++] = mods[i % 7];
+        keys[len++] = finals[(i / 7) % 11];
+
+        key = yed_add_key_sequence(len, keys);
+        if (key == KEY_NULL) { continue; }
+
+        array_push(seq_keys, key);
+        array_push(seqs, *(yed_key_sequence*)array_last(ys->key_sequences));
+    }
+
+    for (pass = 0; pass < 2; pass += 1) {
+        found    = 0;
+        start_us = measure_time_now_us();
+        for (r = 0; r < 1000; r += 1) {
+            for (i = 0; i < array_len(seqs); i += 1) {
+                seq = array_item(seqs, i);
+                key = pass == 0
+                        ? bench_key_seq_linear(seq->len, seq->keys)
+                        : bench_key_seq_trie(seq->len, seq->keys);
+                found += key == seq->seq_key;
+            }
+        }
+        us[pass] = measure_time_now_us() - start_us;
+
+        yed_cprint("%-12s %8.2f ms for %d lookups, %.3f us each, %d found\n",
+                   pass == 0 ? "linear scan" : "trie",
+                   us[pass] / 1000.0,
+                   1000 * array_len(seqs),
+                   array_len(seqs) ? (double)us[pass] / (1000 * array_len(seqs)) : 0.0,
+                   found);
+    }
+
+    yed_cprint("%d sequences in all, %d trie nodes", array_len(ys->key_sequences), array_len(ys->key_seq_trie.nodes));
+
+    while (array_len(seq_keys)) {
+        yed_delete_key_sequence(*(int*)array_last(seq_keys));
+        array_pop(seq_keys);
+    }
+
+    array_free(seq_keys);
+    array_free(seqs);
+}
+
+static struct {
+    int                 running;
+    int                 saved_stdin;
+    int                 write_fd;
+    pthread_t           writer;
+    char               *data;
+    int                 len;
+    int                 n_lines;
+    yed_buffer         *buff;
+    unsigned long long  start_us;
+    unsigned long long  start_pumps;
+    unsigned long long  start_draw_us;
+} bench_input;
+
+static void *bench_input_writer(void *arg) {
+    int n;
+    int w;
+
+    (void)arg;
+
+    for (n = 0; n < bench_input.len; n += w) {
+        w = write(bench_input.write_fd, bench_input.data + n, bench_input.len - n);
+        if (w <= 0) { break; }
+    }
+
+    close(bench_input.write_fd);
+
+    return NULL;
+}
+
+static void bench_input_post_pump(yed_event *event) {
+    unsigned long long us;
+    unsigned long long n_pumps;
+    unsigned long long draw_us;
+
+    (void)event;
+
+    if (!bench_input.running || yed_buff_n_lines(bench_input.buff) <= bench_input.n_lines) { return; }
+
+    us      = measure_time_now_us() - bench_input.start_us;
+    n_pumps = ys->n_pumps - bench_input.start_pumps;
+    draw_us = ys->draw_accum_us - bench_input.start_draw_us;
+
+    dup2(bench_input.saved_stdin, 0);
+    close(bench_input.saved_stdin);
+    pthread_join(bench_input.writer, NULL);
+    free(bench_input.data);
+
+    bench_input.running = 0;
+
+    yed_cprint("%.1f MB, %d lines in %.2f s (%.1f MB/s), %llu draws taking %.2f s",
+               bench_input.len / (1024.0 * 1024.0),
+               bench_input.n_lines,
+               us / 1000000.0,
+               (bench_input.len / (1024.0 * 1024.0)) / (us / 1000000.0),
+               n_pumps,
+               draw_us / 1000000.0);
+}
+
+static void bench_input_cmd(int n_args, char **args) {
+    const char *line = "the quick brown fox jumps over the lazy dog and types some more\033[D\033[C\r";
+    int         n_mb;
+    int         line_len;
+    int         fds[2];
+    int         i;
+    sigset_t    block;
+    sigset_t    sigs;
+
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    if (!ys->active_frame) {
+        yed_cerr("no active frame");
+        return;
+    }
+
+    if (bench_input.running || ys->interactive_command) {
+        yed_cerr("can't run while something else is taking keys");
+        return;
+    }
+
+    n_mb = 10;
+    if (n_args == 1 && (!sscanf(args[0], "%d", &n_mb) || n_mb <= 0)) {
+        yed_cerr("expected a positive number of megabytes, but got '%s'", args[0]);
+        return;
+    }
+
+    if (yed_get_buffer("*bench-input") != NULL) {
+        YEXE("buffer-delete", "*bench-input");
+    }
+
+    bench_input.buff = yed_create_buffer("*bench-input");
+    if (bench_input.buff == NULL) {
+        yed_cerr("couldn't make a buffer");
+        return;
+    }
+    yed_frame_set_buff(ys->active_frame, bench_input.buff);
+
+    line_len             = strlen(line);
+    bench_input.n_lines  = (n_mb * 1024 * 1024) / line_len;
+    bench_input.len      = bench_input.n_lines * line_len;
+    bench_input.data     = malloc(bench_input.len);
+    for (i = 0; i < bench_input.n_lines; i += 1) {
+        memcpy(bench_input.data + i * line_len, line, line_len);
+    }
+
+    if (pipe(fds) != 0) {
+        yed_cerr("pipe() failed: %s", strerror(errno));
+        free(bench_input.data);
+        return;
+    }
+
+    bench_input.saved_stdin = dup(0);
+    dup2(fds[0], 0);
+    close(fds[0]);
+    bench_input.write_fd = fds[1];
+
+    /* Leave the asynchronous signals to the main thread, and SIGPIPE to write(). */
+    sigfillset(&block);
+    sigdelset(&block, SIGSEGV);
+    sigdelset(&block, SIGBUS);
+    sigdelset(&block, SIGFPE);
+    sigdelset(&block, SIGILL);
+    sigdelset(&block, SIGABRT);
+    pthread_sigmask(SIG_BLOCK, &block, &sigs);
+    pthread_create(&bench_input.writer, NULL, bench_input_writer, NULL);
+    pthread_sigmask(SIG_SETMASK, &sigs, NULL);
+
+    bench_input.start_us      = measure_time_now_us();
+    bench_input.start_pumps   = ys->n_pumps;
+    bench_input.start_draw_us = ys->draw_accum_us;
+    bench_input.running       = 1;
+}
+
+int yed_plugin_boot(yed_plugin *self) {
+    yed_event_handler h;
+
+    YED_PLUG_VERSION_CHECK();
+
+    yed_plugin_set_command(self, "bench-blend",        bench_blend);
+    yed_plugin_set_command(self, "bench-syntax-kwd",   bench_syntax_kwd);
+    yed_plugin_set_command(self, "bench-syntax-regex", bench_syntax_regex);
+    yed_plugin_set_command(self, "bench-syntax-request", bench_syntax_requests);
+    yed_plugin_set_command(self, "bench-syntax-build",   bench_syntax_build);
+    yed_plugin_set_command(self, "bench-syntax-frame",   bench_syntax_frame);
+    yed_plugin_set_command(self, "bench-syntax-long-line", bench_syntax_long_line);
+    yed_plugin_set_command(self, "bench-search",           bench_search);
+    yed_plugin_set_command(self, "bench-find",             bench_find);
+    yed_plugin_set_command(self, "bench-replace",          bench_replace);
+    yed_plugin_set_command(self, "bench-complete",         bench_complete);
+    yed_plugin_set_command(self, "bench-dir-cache",        bench_dir_cache);
+    yed_plugin_set_command(self, "bench-key-sequences",    bench_key_sequences);
+    yed_plugin_set_command(self, "bench-input",            bench_input_cmd);
+
+    h.kind = EVENT_POST_PUMP;
+    h.fn   = bench_input_post_pump;
+    yed_plugin_add_event_handler(self, h);
+
+    return 0;
+}
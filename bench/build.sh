@@ -0,0 +1,2 @@
+#!/usr/bin/env bash
+gcc -o bench.so -O2 bench.c $(yed --print-cflags) $(yed --print-ldflags)
@@ -1690,6 +1690,7 @@ static void pre_mod_handler(yed_event *event) {
     ||  event->buff_mod_event == BUFF_MOD_DELETE_LINE
     ||  event->buff_mod_event == BUFF_MOD_CLEAR_LINE
     ||  event->buff_mod_event == BUFF_MOD_SET_LINE
+    ||  event->buff_mod_event == BUFF_MOD_SET_LINES
     ||  event->buff_mod_event == BUFF_MOD_CLEAR) {
         event->cancel = 1;
     }
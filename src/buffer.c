@@ -17,6 +17,7 @@ yed_line yed_new_line(void) {
     memset(&line, 0, sizeof(line));
 
     line.chars = array_make(char);
+    yed_line_bump_version(&line);
 
     return line;
 }
@@ -27,6 +28,7 @@ yed_line yed_new_line_with_cap(int len) {
     memset(&line, 0, sizeof(line));
 
     line.chars = array_make_with_cap(char, len);
+    yed_line_bump_version(&line);
 
     return line;
 }
@@ -48,6 +50,11 @@ yed_line * yed_copy_line(yed_line *line) {
     return new_line;
 }
 
+void yed_line_bump_version(yed_line *line) {
+    ys->line_version_counter += 1;
+    line->version             = ys->line_version_counter;
+}
+
 void yed_line_add_glyph(yed_line *line, yed_glyph g, int idx) {
     int len, i;
 
@@ -57,6 +64,8 @@ void yed_line_add_glyph(yed_line *line, yed_glyph g, int idx) {
     }
     line->visual_width += yed_get_glyph_width(g);
     line->n_glyphs     += 1;
+
+    yed_line_bump_version(line);
 }
 
 void yed_line_append_glyph(yed_line *line, yed_glyph g) {
@@ -69,6 +78,8 @@ void yed_line_append_glyph(yed_line *line, yed_glyph g) {
     }
     line->visual_width += width;
     line->n_glyphs     += 1;
+
+    yed_line_bump_version(line);
 }
 
 void yed_line_delete_glyph(yed_line *line, int idx) {
@@ -85,6 +96,8 @@ void yed_line_delete_glyph(yed_line *line, int idx) {
 
     line->visual_width -= width;
     line->n_glyphs     -= 1;
+
+    yed_line_bump_version(line);
 }
 
 void yed_line_pop_glyph(yed_line *line) {
@@ -102,12 +115,16 @@ void yed_line_pop_glyph(yed_line *line) {
 
     line->visual_width -= width;
     line->n_glyphs     -= 1;
+
+    yed_line_bump_version(line);
 }
 
 void yed_clear_line(yed_line *line) {
     array_clear(line->chars);
     line->visual_width = 0;
     line->n_glyphs     = 0;
+
+    yed_line_bump_version(line);
 }
 
 static int yed_buffer_add_line_no_undo_no_events(yed_buffer *buff) {
@@ -231,6 +248,9 @@ void yed_destroy_buffer(yed_buffer *buffer) {
     bucket_array_free(buffer->lines);
 
     yed_free_undo_history(&buffer->undo_history);
+
+    yed_free_search_index(buffer);
+    yed_free_word_index(buffer);
 }
 
 void yed_free_buffer(yed_buffer *buffer) {
@@ -378,6 +398,7 @@ void yed_buffer_set_ft(yed_buffer *buffer, int ft) {
     event.buffer = buffer;
     yed_trigger_event(&event);
     buffer->ft = ft;
+    yed_invalidate_row_caches();
     event.kind = EVENT_BUFFER_POST_SET_FT;
     yed_trigger_event(&event);
 }
@@ -496,6 +517,8 @@ void yed_line_clear_no_undo(yed_buffer *buff, int row) {
     line = yed_buff_get_line(buff, row);
     array_clear(line->chars);
     line->visual_width = 0;
+    line->n_glyphs     = 0;
+    yed_line_bump_version(line);
 
     DO_POST_MOD_EVT(buff, BUFF_MOD_CLEAR, row, 0);
 out:;
@@ -535,11 +558,66 @@ void yed_buff_set_line_no_undo(yed_buffer *buff, int row, yed_line *line) {
 
     yed_free_line(old_line);
     old_line->visual_width = line->visual_width;
+    old_line->n_glyphs     = line->n_glyphs;
     old_line->chars        = array_make(char);
     array_copy(old_line->chars, line->chars);
+    yed_line_bump_version(old_line);
+
+    DO_POST_MOD_EVT(buff, BUFF_MOD_SET_LINE, row, 0);
+out:;
+}
+
+int yed_buff_swap_line_chars_no_undo(yed_buffer *buff, int row, array_t *chars) {
+    int       swapped;
+    yed_line *line;
+    array_t   tmp;
+
+    swapped = 0;
+
+    DO_RD_ONLY_CHECK(buff);
+
+    DO_PRE_MOD_EVT(buff, BUFF_MOD_SET_LINE, row, 0);
+
+    line = yed_buff_get_line(buff, row);
+
+    tmp         = line->chars;
+    line->chars = *chars;
+    *chars      = tmp;
+
+    yed_get_string_info(array_data(line->chars), array_len(line->chars),
+                        &line->n_glyphs, &line->visual_width);
+    yed_line_bump_version(line);
+
+    swapped = 1;
 
     DO_POST_MOD_EVT(buff, BUFF_MOD_SET_LINE, row, 0);
 out:;
+    return swapped;
+}
+
+int yed_buff_replace_span_no_undo(yed_buffer *buff, int row, int idx, int len, const char *text, int text_len) {
+    yed_line *line;
+    int       line_len;
+    array_t   chars;
+    int       replaced;
+
+    if (buff->flags & BUFF_RD_ONLY) { return 0; }
+
+    line     = yed_buff_get_line(buff, row);
+    line_len = array_len(line->chars);
+
+    if (idx < 0 || len < 0 || idx + len > line_len) { return 0; }
+
+    chars = array_make_with_cap(char, line_len - len + text_len + 1);
+    array_push_n(chars, (char*)array_data(line->chars), idx);
+    array_push_n(chars, (char*)text, text_len);
+    array_push_n(chars, (char*)array_data(line->chars) + idx + len, line_len - idx - len);
+
+    replaced = yed_buff_swap_line_chars_no_undo(buff, row, &chars);
+
+    array_free(chars);
+
+    return replaced;
 }
 
 yed_line * yed_buff_insert_line_no_undo(yed_buffer *buff, int row) {
@@ -783,27 +861,71 @@ int yed_buffer_add_line(yed_buffer *buff) {
 }
 
 void yed_buff_set_line(yed_buffer *buff, int row, yed_line *line) {
-    yed_line        *old_line;
-    yed_undo_action  uact;
-    yed_glyph       *git;
+    yed_line *old_line;
 
     old_line = yed_buff_get_line(buff, row);
 
-    uact.kind = UNDO_GLYPH_POP;
-    uact.row  = row;
-    yed_line_glyph_rtraverse(*old_line, git) {
-        uact.g = *git;
-        yed_push_undo_action(buff, &uact);
+    yed_buff_replace_span(buff, row, 0, array_len(old_line->chars),
+                          array_data(line->chars), array_len(line->chars));
+}
+
+int yed_buff_replace_span(yed_buffer *buff, int row, int idx, int len, const char *text, int text_len) {
+    yed_line        *line;
+    yed_undo_action  uact;
+
+    line = yed_buff_get_line(buff, row);
+
+    if (idx < 0 || len < 0 || idx + len > array_len(line->chars)) { return 0; }
+
+    uact.kind          = UNDO_LINE_SPAN;
+    uact.row           = row;
+    uact.col           = idx;
+    uact.span.old_len  = len;
+    uact.span.new_len  = text_len;
+    uact.span.text     = malloc(len + text_len + 1);
+    memcpy(uact.span.text, (char*)array_data(line->chars) + idx, len);
+    memcpy(uact.span.text + len, text, text_len);
+
+    if (!yed_buff_replace_span_no_undo(buff, row, idx, len, text, text_len)) {
+        free(uact.span.text);
+        return 0;
     }
 
-    uact.kind = UNDO_GLYPH_PUSH;
-    uact.row  = row;
-    yed_line_glyph_traverse(*line, git) {
-        uact.g = *git;
-        yed_push_undo_action(buff, &uact);
+    if (!yed_push_undo_action(buff, &uact)) {
+        free(uact.span.text);
+    }
+
+    return 1;
+}
+
+void yed_buff_replace_spans(yed_buffer *buff, yed_span_edit *edits, int n_edits) {
+    int first,
+        last,
+        no_mod_events,
+        i;
+
+    if (n_edits <= 0) { return; }
+
+    first = edits[0].row;
+    last  = edits[n_edits - 1].row;
+
+    DO_RD_ONLY_CHECK(buff);
+
+    DO_PRE_MOD_EVT(buff, BUFF_MOD_SET_LINES, first, last);
+
+    no_mod_events  = buff->flags & BUFF_NO_MOD_EVENTS;
+    buff->flags   |= BUFF_NO_MOD_EVENTS;
+
+    for (i = 0; i < n_edits; i += 1) {
+        yed_buff_replace_span(buff, edits[i].row, edits[i].idx, edits[i].len, edits[i].text, edits[i].text_len);
     }
 
-    yed_buff_set_line_no_undo(buff, row, line);
+    if (!no_mod_events) {
+        buff->flags &= ~BUFF_NO_MOD_EVENTS;
+    }
+
+    DO_POST_MOD_EVT(buff, BUFF_MOD_SET_LINES, first, last);
+out:;
 }
 
 yed_line * yed_buff_insert_line(yed_buffer *buff, int row) {
@@ -1212,6 +1334,8 @@ int yed_fill_buff_from_file_stream(yed_buffer *buff, FILE *f) {
         line.visual_width     = 0;
         line.n_glyphs         = 0;
 
+        yed_line_bump_version(&line);
+
         while (array_len(line.chars)
         &&    ((c = *(char*)array_last(line.chars)) == '\n' || c == '\r')) {
             array_pop(line.chars);
@@ -1472,6 +1596,8 @@ void yed_update_line_visual_widths(void) {
             }
         }
     }
+
+    yed_invalidate_row_caches();
 }
 
 char *yed_get_selection_text(yed_buffer *buffer) {
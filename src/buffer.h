@@ -6,6 +6,7 @@ typedef struct yed_line_t {
     array_t chars;
     int     visual_width;
     int     n_glyphs;
+    u64     version;
 } yed_line;
 
 #define RANGE_NORMAL  (0x1)
@@ -17,6 +18,15 @@ typedef struct {
     int anchor_row, anchor_col, cursor_row, cursor_col;
 } yed_range;
 
+/* Replace the len bytes at idx in row with text. */
+typedef struct {
+    int         row;
+    int         idx;
+    int         len;
+    const char *text;
+    int         text_len;
+} yed_span_edit;
+
 #define BUFF_KIND_UNKNOWN         (0x0)
 #define BUFF_KIND_FILE            (0x1)
 #define BUFF_KIND_YANK            (0x2)
@@ -56,6 +66,10 @@ typedef struct yed_buffer_t {
     int               last_cursor_row,
                       last_cursor_col;
     char             *underlying_buff;
+    struct yed_search_index_t
+                     *search_index;
+    struct yed_word_index_t
+                     *word_index;
 } yed_buffer;
 
 void yed_init_buffers(void);
@@ -70,6 +84,11 @@ void yed_line_append_glyph(yed_line *line, yed_glyph g);
 void yed_line_delete_glyph(yed_line *line, int idx);
 void yed_line_pop_glyph(yed_line *line);
 void yed_clear_line(yed_line *line);
+/*
+ * Every change to a line's contents gives it a new, unique version.
+ * Call this if you modify line->chars directly.
+ */
+void yed_line_bump_version(yed_line *line);
 
 yed_buffer yed_new_buff(void);
 yed_buffer * yed_create_buffer(char *name);
@@ -102,6 +121,14 @@ void yed_pop_from_line_no_undo(yed_buffer *buff, int row);
 void yed_line_clear_no_undo(yed_buffer *buff, int row);
 int yed_buffer_add_line_no_undo(yed_buffer *buff);
 void yed_buff_set_line_no_undo(yed_buffer *buff, int row, yed_line *line);
+/*
+ * Makes *chars the text of the line and gives the line's old text back in
+ * *chars, so that the caller can reuse its memory. Returns 0 if the buffer
+ * is read-only or the change was cancelled.
+ */
+int yed_buff_swap_line_chars_no_undo(yed_buffer *buff, int row, array_t *chars);
+/* Replaces the len bytes at idx in the line with text. */
+int yed_buff_replace_span_no_undo(yed_buffer *buff, int row, int idx, int len, const char *text, int text_len);
 yed_line * yed_buff_insert_line_no_undo(yed_buffer *buff, int row);
 void yed_buff_delete_line_no_undo(yed_buffer *buff, int row);
 void yed_insert_into_line_no_undo(yed_buffer *buff, int row, int col, yed_glyph g);
@@ -118,6 +145,12 @@ void yed_pop_from_line(yed_buffer *buff, int row);
 void yed_line_clear(yed_buffer *buff, int row);
 int yed_buffer_add_line(yed_buffer *buff);
 void yed_buff_set_line(yed_buffer *buff, int row, yed_line *line);
+int yed_buff_replace_span(yed_buffer *buff, int row, int idx, int len, const char *text, int text_len);
+/*
+ * Many span replacements, sorted by row and at most one per row, with one
+ * BUFF_MOD_SET_LINES event for all of them rather than one per row.
+ */
+void yed_buff_replace_spans(yed_buffer *buff, yed_span_edit *edits, int n_edits);
 yed_line * yed_buff_insert_line(yed_buffer *buff, int row);
 void yed_buff_delete_line(yed_buffer *buff, int row);
 void yed_insert_into_line(yed_buffer *buff, int row, int col, yed_glyph g);
@@ -167,6 +167,7 @@ static void yed_builtin_cmd_prompt_cancel(void) {
     ys->interactive_command = NULL;
     yed_clear_cmd_buff();
     yed_builtin_cmd_prompt_compl_cleanup();
+    yed_clear_completion_cache();
 }
 
 static void yed_builtin_cmd_prompt_run_cmd(void) {
@@ -196,6 +197,7 @@ static void yed_builtin_cmd_prompt_run_cmd(void) {
 
     free_string_array(split);
     yed_builtin_cmd_prompt_compl_cleanup();
+    yed_clear_completion_cache();
 }
 
 static char compl_name_buff[4096];
@@ -255,11 +257,53 @@ out:;
     return compl_string_buff;
 }
 
+/*
+ * Complete what's at the end of the prompt. Returns 0 if there's nothing
+ * to complete it with. Fuzzy matches don't start with what was typed, so
+ * they replace it rather than being added on.
+ */
+static int yed_builtin_cmd_prompt_compl_start(void) {
+    char *compl_name;
+    char *compl_string;
+    int   compl_status;
+    int   len;
+    int   fuzzy;
+
+    yed_builtin_cmd_prompt_compl_cleanup();
+
+    compl_name   = yed_builtin_cmd_prompt_get_compl_name_from_context();
+    compl_string = yed_builtin_cmd_prompt_get_compl_string_from_context();
+    len          = strlen(compl_string);
+
+    /* Not if the string was quoted or escaped: we don't know what to replace. */
+    fuzzy =    yed_var_is_truthy("compl-fuzzy")
+            && array_len(ys->cmd_buff) >= len
+            && memcmp((char*)array_data(ys->cmd_buff) + array_len(ys->cmd_buff) - len, compl_string, len) == 0;
+
+    if (fuzzy) {
+        compl_status = yed_complete_fuzzy(compl_name, compl_string, &(ys->cmd_prompt_compl_results));
+    } else {
+        compl_status = yed_complete(compl_name, compl_string, &(ys->cmd_prompt_compl_results));
+    }
+
+    if (compl_status != COMPL_ERR_NO_ERR
+    ||  array_len(ys->cmd_prompt_compl_results.strings) == 0) {
+
+        if (compl_status != COMPL_ERR_NO_COMPL) {
+            free_string_array(ys->cmd_prompt_compl_results.strings);
+        }
+        return 0;
+    }
+
+    ys->cmd_prompt_has_compl_results = 1;
+    ys->cmd_prompt_compl_start_idx   = array_len(ys->cmd_buff) - (fuzzy ? len : 0);
+    ys->cmd_prompt_compl_string_len  = fuzzy ? 0 : len;
+
+    return 1;
+}
+
 static void yed_builtin_cmd_prompt_do_compl_fwd(void) {
     array_t *strings;
-    char    *compl_string;
-    char    *compl_name;
-    int      compl_status;
 
     if (ys->cmd_cursor_x != strlen(ys->cmd_prompt) + array_len(ys->cmd_buff) + 1) {
         return;
@@ -268,21 +312,9 @@ static void yed_builtin_cmd_prompt_do_compl_fwd(void) {
     strings = &(ys->cmd_prompt_compl_results.strings);
 
     if (ys->cmd_prompt_compl_item == 0) {
-        yed_builtin_cmd_prompt_compl_cleanup();
+        if (!yed_builtin_cmd_prompt_compl_start()) { return; }
 
-        compl_name   = yed_builtin_cmd_prompt_get_compl_name_from_context();
-        compl_string = yed_builtin_cmd_prompt_get_compl_string_from_context();
-        compl_status = yed_complete(compl_name, compl_string, &(ys->cmd_prompt_compl_results));
-
-        if (compl_status != COMPL_ERR_NO_ERR
-        ||  array_len(*strings) == 0) {
-            return;
-        }
-
-        ys->cmd_prompt_has_compl_results = 1;
-        ys->cmd_prompt_compl_item        = 1;
-        ys->cmd_prompt_compl_start_idx   = array_len(ys->cmd_buff);
-        ys->cmd_prompt_compl_string_len  = strlen(compl_string);
+        ys->cmd_prompt_compl_item = 1;
     } else {
         ys->cmd_prompt_compl_item += 1;
         if (ys->cmd_prompt_compl_item > array_len(*strings)) {
@@ -307,9 +339,6 @@ static void yed_builtin_cmd_prompt_do_compl_fwd(void) {
 
 static void yed_builtin_cmd_prompt_do_compl_bwd(void) {
     array_t *strings;
-    char    *compl_name;
-    char    *compl_string;
-    int      compl_status;
 
     if (ys->cmd_cursor_x != strlen(ys->cmd_prompt) + array_len(ys->cmd_buff) + 1) {
         return;
@@ -318,21 +347,9 @@ static void yed_builtin_cmd_prompt_do_compl_bwd(void) {
     strings = &(ys->cmd_prompt_compl_results.strings);
 
     if (ys->cmd_prompt_compl_item == 0) {
-        yed_builtin_cmd_prompt_compl_cleanup();
-
-        compl_name   = yed_builtin_cmd_prompt_get_compl_name_from_context();
-        compl_string = yed_builtin_cmd_prompt_get_compl_string_from_context();
-        compl_status = yed_complete(compl_name, compl_string, &(ys->cmd_prompt_compl_results));
-
-        if (compl_status != COMPL_ERR_NO_ERR
-        ||  array_len(*strings) == 0) {
-            return;
-        }
+        if (!yed_builtin_cmd_prompt_compl_start()) { return; }
 
-        ys->cmd_prompt_has_compl_results = 1;
-        ys->cmd_prompt_compl_item        = array_len(*strings);
-        ys->cmd_prompt_compl_start_idx   = array_len(ys->cmd_buff);
-        ys->cmd_prompt_compl_string_len  = strlen(compl_string);
+        ys->cmd_prompt_compl_item = array_len(*strings);
     } else {
         ys->cmd_prompt_compl_item -= 1;
         if (ys->cmd_prompt_compl_item == 0) {
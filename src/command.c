@@ -163,6 +163,11 @@ do {                                                              \
     SET_DEFAULT_COMMAND("find-next-in-buffer",                find_next_in_buffer);
     SET_DEFAULT_COMMAND("find-prev-in-buffer",                find_prev_in_buffer);
     SET_DEFAULT_COMMAND("replace-current-search",             replace_current_search);
+    SET_DEFAULT_COMMAND("replace-regex",                      replace_regex);
+    SET_DEFAULT_COMMAND("find-in-buffers",                    find_in_buffers);
+    SET_DEFAULT_COMMAND("grep-files",                         grep_files);
+    SET_DEFAULT_COMMAND("search-results",                     search_results);
+    SET_DEFAULT_COMMAND("find-file",                          find_file);
     SET_DEFAULT_COMMAND("style",                              style);
     SET_DEFAULT_COMMAND("style-off",                          style_off);
     SET_DEFAULT_COMMAND("styles-list",                        styles_list);
@@ -183,6 +188,7 @@ do {                                                              \
     SET_DEFAULT_COMMAND("nop",                                nop);
     SET_DEFAULT_COMMAND("cursor-style",                       cursor_style);
     SET_DEFAULT_COMMAND("feed-keys",                          feed_keys);
+    SET_DEFAULT_COMMAND("feed-keys-as-typed",                 feed_keys_as_typed);
     SET_DEFAULT_COMMAND("alias",                              alias);
     SET_DEFAULT_COMMAND("unalias",                            unalias);
     SET_DEFAULT_COMMAND("repeat",                             repeat);
@@ -567,6 +573,7 @@ void yed_default_command_sh(int n_args, char **args) {
     strcat(buff, "); printf \"\\r\\n[ Hit any key to return to yed. ]\"'");
 
 
+    yed_render_lock();
     printf(TERM_CLEAR_SCREEN);
     printf(TERM_CURSOR_HOME);
     fflush(stdout);
@@ -575,6 +582,7 @@ void yed_default_command_sh(int n_args, char **args) {
 
     while (yed_read_keys(junk) == 0);
     yed_clear_screen();
+    yed_render_unlock();
 }
 
 void yed_default_command_sh_silent(int n_args, char **args) {
@@ -641,11 +649,13 @@ void yed_default_command_less(int n_args, char **args) {
 
     strcat(buff, ") 2>&1 | less -cR'");
 
+    yed_render_lock();
     printf(TERM_STD_SCREEN);
     fflush(stdout);
     err = system(buff);
     printf(TERM_ALT_SCREEN);
     yed_clear_screen();
+    yed_render_unlock();
 
     if (err == 0) {
         yed_cprint("%s", cmd_buff);
@@ -3493,7 +3503,7 @@ void yed_find_in_buffer_take_key(int key) {
             if (!found) {
                 yed_append_text_to_cmd_buff("(find-in-buffer) [!] '");
                 yed_append_text_to_cmd_buff(ys->save_search);
-                yed_append_text_to_cmd_buff("' not found");
+                yed_append_text_to_cmd_buff(ys->search_cancelled ? "' search cancelled" : "' not found");
             }
 
             mru_search = array_last(ys->search_hist);
@@ -3569,7 +3579,7 @@ void yed_default_command_find_in_buffer(int n_args, char **args) {
             if (!found) {
                 yed_append_text_to_cmd_buff("[!] '");
                 yed_append_text_to_cmd_buff(ys->current_search);
-                yed_append_text_to_cmd_buff("' not found");
+                yed_append_text_to_cmd_buff(ys->search_cancelled ? "' search cancelled" : "' not found");
 
                 ys->current_search = NULL;
             }
@@ -3616,7 +3626,7 @@ void yed_default_command_find_next_in_buffer(int n_args, char **args) {
     if (!yed_inc_find_in_buffer()) {
         yed_append_text_to_cmd_buff("[!] '");
         yed_append_text_to_cmd_buff(ys->save_search);
-        yed_append_text_to_cmd_buff("' not found");
+        yed_append_text_to_cmd_buff(ys->search_cancelled ? "' search cancelled" : "' not found");
     } else {
         yed_append_text_to_cmd_buff(ys->current_search);
     }
@@ -3665,97 +3675,193 @@ void yed_default_command_find_prev_in_buffer(int n_args, char **args) {
     if (!yed_inc_find_prev_in_buffer()) {
         yed_append_text_to_cmd_buff("[!] '");
         yed_append_text_to_cmd_buff(ys->current_search);
-        yed_append_text_to_cmd_buff("' not found");
+        yed_append_text_to_cmd_buff(ys->search_cancelled ? "' search cancelled" : "' not found");
     } else {
         yed_append_text_to_cmd_buff(ys->current_search);
     }
 }
 
-void yed_replace_current_search_update_line(int idx, int row) {
-    char       *replacement;
-    int         i, len, it,
-               *mark;
-    yed_buffer *buff;
-    yed_line   *line,
-               *working_line;
-    array_t    *markers;
-    yed_glyph   g;
+/*
+ * Replace works on the rows of the selection (or the cursor's row) that have
+ * a match, found once when it starts. While the replacement is being typed,
+ * only the rows that are on screen show it, and only they are changed
+ * (without undo). Enter puts them back and then replaces every row with a
+ * single span change each, all in one undo record.
+ */
 
-    buff = ys->active_frame->buffer;
+/* The rest of a row's text, from its first match, with each match replaced. */
+static void replace_build(array_t *out, const char *text, int *mark, int n_marks, const char *replacement, int rep_len) {
+    int i, idx;
 
-    working_line = *(yed_line**)array_item(ys->replace_working_lines, idx);
-    line         = yed_copy_line(working_line);
-    yed_buff_set_line(buff, row, line);
-    line = NULL;
+    idx = mark[0];
 
-    replacement = array_data(ys->cmd_buff);
-    len         = strlen(replacement);
-    markers     = array_item(ys->replace_markers, idx);
-
-    it = 0;
-    array_traverse(*markers, mark) {
-        for (i = len - 1; i >= 0; i -= 1) {
-            g = G(replacement[i]);
-            yed_insert_into_line(buff, row, *mark + (it * len), g);
+    for (i = 0; i < n_marks; i += 1) {
+        array_push_n(*out, (char*)text + idx, mark[2 * i] - idx);
+        array_push_n(*out, (char*)replacement, rep_len);
+        idx = mark[2 * i] + mark[2 * i + 1];
+    }
+}
+
+static int replace_row_marks(int i, int **mark) {
+    int first, last;
+
+    first = *(int*)array_item(ys->replace_first_marker, i);
+    last  = *(int*)array_item(ys->replace_first_marker, i + 1);
+
+    *mark = array_item(ys->replace_markers, 2 * first);
+
+    return last - first;
+}
+
+static void replace_span(int i, int **mark, int *n_marks, int *start, int *end) {
+    *n_marks = replace_row_marks(i, mark);
+    *start   = (*mark)[0];
+    *end     = (*mark)[2 * (*n_marks - 1)] + (*mark)[2 * (*n_marks - 1) + 1];
+}
+
+/*
+ * Put back the rows that show the replacement. Their saved text is swapped
+ * back in, so the arrays in replace_save_lines are left holding the preview
+ * text and can be reused for the next one.
+ */
+static void replace_unpreview(void) {
+    int     *i;
+    array_t *save;
+    int      row;
+
+    save = array_data(ys->replace_save_lines);
+    array_traverse(ys->replace_preview, i) {
+        row = *(int*)array_item(ys->replace_rows, *i);
+        yed_buff_swap_line_chars_no_undo(ys->active_frame->buffer, row, save);
+        save += 1;
+    }
+
+    array_clear(ys->replace_preview);
+}
+
+/* Index of the first row in replace_rows that is at or after row. */
+static int replace_lower_bound(int row) {
+    int lo, hi, mid;
+
+    lo = 0;
+    hi = array_len(ys->replace_rows);
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (*(int*)array_item(ys->replace_rows, mid) < row) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-        it += 1;
     }
+
+    return lo;
 }
 
 void yed_replace_current_search_update(void) {
-    int row, r1, c1, r2, c2, i;
+    yed_frame  *frame;
+    yed_buffer *buff;
+    const char *replacement;
+    int         rep_len, i, last, row, n_marks, start, end, *mark;
+    yed_line   *line;
+    array_t    *save,
+                new_save;
 
     array_zero_term(ys->cmd_buff);
 
-    if (ys->active_frame->buffer->has_selection) {
-        yed_range_sorted_points(&ys->active_frame->buffer->selection,
-                                &r1, &c1, &r2, &c2);
-    } else {
-        r1 = r2 = ys->active_frame->cursor_line;
-    }
+    frame       = ys->active_frame;
+    buff        = frame->buffer;
+    replacement = array_data(ys->cmd_buff);
+    rep_len     = array_len(ys->cmd_buff);
 
-    i = 0;
-    for (row = r1; row <= r2; row += 1) {
-        yed_replace_current_search_update_line(i, row);
-        i += 1;
+    replace_unpreview();
+
+    last = replace_lower_bound(frame->buffer_y_offset + frame->height + 1);
+
+    for (i = replace_lower_bound(frame->buffer_y_offset + 1); i < last; i += 1) {
+        row  = *(int*)array_item(ys->replace_rows, i);
+        line = yed_buff_get_line(buff, row);
+
+        replace_span(i, &mark, &n_marks, &start, &end);
+
+        array_clear(ys->replace_scratch);
+        array_push_n(ys->replace_scratch, (char*)array_data(line->chars), start);
+        replace_build(&ys->replace_scratch, array_data(line->chars), mark, n_marks, replacement, rep_len);
+        array_push_n(ys->replace_scratch, (char*)array_data(line->chars) + end, array_len(line->chars) - end);
+
+        if (array_len(ys->replace_preview) == array_len(ys->replace_save_lines)) {
+            new_save = array_make(char);
+            array_push(ys->replace_save_lines, new_save);
+        }
+        save = array_item(ys->replace_save_lines, array_len(ys->replace_preview));
+        array_clear(*save);
+        array_push_n(*save, (char*)array_data(line->chars), array_len(line->chars));
+
+        if (yed_buff_swap_line_chars_no_undo(buff, row, &ys->replace_scratch)) {
+            array_push(ys->replace_preview, i);
+        }
     }
 }
 
-void replace_abort(void) {
-    int       row, r1, c1, r2, c2, i;
-    yed_line *save_line;
+void yed_replace_current_search_apply(void) {
+    yed_buffer    *buff;
+    const char    *replacement;
+    int            rep_len, i, n_marks, end, off, *mark;
+    yed_line      *line;
+    array_t        edits;
+    yed_span_edit  edit,
+                  *edit_it;
 
-    if (ys->active_frame->buffer->has_selection) {
-        yed_range_sorted_points(&ys->active_frame->buffer->selection,
-                                &r1, &c1, &r2, &c2);
-    } else {
-        r1 = r2 = ys->active_frame->cursor_line;
+    array_zero_term(ys->cmd_buff);
+
+    buff        = ys->active_frame->buffer;
+    replacement = array_data(ys->cmd_buff);
+    rep_len     = array_len(ys->cmd_buff);
+    edits       = array_make_with_cap(yed_span_edit, array_len(ys->replace_rows));
+
+    replace_unpreview();
+
+    array_clear(ys->replace_scratch);
+
+    for (i = 0; i < array_len(ys->replace_rows); i += 1) {
+        edit.row = *(int*)array_item(ys->replace_rows, i);
+        line     = yed_buff_get_line(buff, edit.row);
+
+        replace_span(i, &mark, &n_marks, &edit.idx, &end);
+
+        edit.len      = end - edit.idx;
+        edit.text_len = array_len(ys->replace_scratch);
+        replace_build(&ys->replace_scratch, array_data(line->chars), mark, n_marks, replacement, rep_len);
+        edit.text_len = array_len(ys->replace_scratch) - edit.text_len;
+
+        array_push(edits, edit);
     }
 
-    i = 0;
-    for (row = r1; row <= r2; row += 1) {
-        save_line = *(yed_line**)array_item(ys->replace_save_lines, i);
-        yed_buff_set_line(ys->active_frame->buffer, row, save_line);
-        i += 1;
+    /* The scratch text is all there now, so it won't move. */
+    off = 0;
+    array_traverse(edits, edit_it) {
+        edit_it->text  = (char*)array_data(ys->replace_scratch) + off;
+        off           += edit_it->text_len;
     }
+
+    yed_start_undo_record(ys->active_frame, buff);
+    yed_buff_replace_spans(buff, array_data(edits), array_len(edits));
+    yed_end_undo_record(ys->active_frame, buff);
+
+    array_free(edits);
 }
 
-void replace_free(void) {
-    yed_line **line_it;
-    array_t   *markers_it;
+static void replace_free(void) {
+    array_t *save;
 
-    array_traverse(ys->replace_save_lines, line_it) {
-        yed_free_line(*line_it);
+    array_traverse(ys->replace_save_lines, save) {
+        array_free(*save);
     }
     array_clear(ys->replace_save_lines);
-    array_traverse(ys->replace_working_lines, line_it) {
-        yed_free_line(*line_it);
-    }
-    array_clear(ys->replace_working_lines);
-    array_traverse(ys->replace_markers, markers_it) {
-        array_free(*markers_it);
-    }
+    array_clear(ys->replace_rows);
+    array_clear(ys->replace_first_marker);
     array_clear(ys->replace_markers);
+    array_clear(ys->replace_scratch);
 }
 
 void yed_replace_current_search_take_key(int key) {
@@ -3766,15 +3872,12 @@ void yed_replace_current_search_take_key(int key) {
         case CTRL_C:
             ys->interactive_command = NULL;
             yed_clear_cmd_buff();
-            replace_abort();
+            replace_unpreview();
             replace_free();
-            yed_cancel_undo_record(ys->active_frame, ys->active_frame->buffer);
             break;
         case ENTER:
-            yed_replace_current_search_update();
-
+            yed_replace_current_search_apply();
             replace_free();
-            yed_end_undo_record(ys->active_frame, ys->active_frame->buffer);
 
             ys->interactive_command = NULL;
             cpy = strdup(array_data(ys->cmd_buff));
@@ -3801,51 +3904,48 @@ void yed_replace_current_search_take_key(int key) {
     }
 }
 
-void replace_add_line(yed_buffer *buff, int row, int len) {
-    yed_line  *line,
-              *save_line,
-              *working_line;
-    int        idx, col, j;
-    array_t    markers;
-    yed_glyph *git;
-
-    line      = yed_buff_get_line(buff, row);
-    markers   = array_make(int);
-    save_line = yed_copy_line(line);
+static void replace_add_line(yed_search_pattern *pattern, yed_line *line, int row) {
+    const char *text;
+    int         len, idx, start, end, mlen, n_marks;
 
-    array_push(ys->replace_save_lines, save_line);
+    text    = array_data(line->chars);
+    len     = array_len(line->chars);
+    start   = 0;
+    end     = -1;
+    n_marks = 0;
 
-    while (1) {
-        yed_line_glyph_traverse(*line, git) {
-            if (((void*)git) + len - 1 > array_last(line->chars)) { break; }
-            if (strncmp(&git->c, ys->current_search, len) == 0) {
-                idx = ((void*)git - line->chars.data);
-                col = yed_line_idx_to_col(line, idx);
-                array_push(markers, col);
-                ys->replace_count += 1;
+    while (start <= len
+    &&     (idx = yed_search_pattern_find(pattern, text, len, start, len, &mlen)) >= 0) {
+        start = idx + mlen;
 
+        if (mlen == 0) {
+            /* Don't match the empty string right after another match, and don't find this one again. */
+            if (idx == len) { start = len + 1; }
+            else            { start += yed_get_glyph_len(*(yed_glyph*)(text + idx)); }
 
-                for (j = 0; j < len; j += 1) {
-                    yed_delete_from_line(buff, row, col);
-                }
-
-                goto cont;
-            }
+            if (idx == end) { continue; }
         }
-        break;
-    cont:
-        continue;
+
+        array_push(ys->replace_markers, idx);
+        array_push(ys->replace_markers, mlen);
+        end      = idx + mlen;
+        n_marks += 1;
     }
 
-    array_push(ys->replace_markers, markers);
-    working_line = yed_copy_line(line);
-    array_push(ys->replace_working_lines, working_line);
+    if (n_marks) {
+        array_push(ys->replace_rows, row);
+        idx = array_len(ys->replace_markers) / 2;
+        array_push(ys->replace_first_marker, idx);
+        ys->replace_count += n_marks;
+    }
 }
 
 void yed_start_replace_current_search(void) {
-    yed_buffer *buff;
-    int         len;
-    int         row, r1, c1, r2, c2;
+    yed_buffer         *buff;
+    yed_search_pattern *pattern;
+    yed_line           *line;
+    int                 row, r1, c1, r2, c2;
+    int                 zero;
 
     ys->interactive_command  = "replace-current-search";
     ys->cmd_prompt           = "(replace-current-search) ";
@@ -3854,10 +3954,8 @@ void yed_start_replace_current_search(void) {
     ys->current_search       = ys->save_search;
     ys->replace_count        = 0;
 
-    buff = ys->active_frame->buffer;
-    len  = strlen(ys->current_search);
-
-    yed_start_undo_record(ys->active_frame, buff);
+    buff    = ys->active_frame->buffer;
+    pattern = yed_get_current_search_pattern();
 
     yed_set_cursor_within_frame(ys->active_frame, ys->active_frame->cursor_line, 1);
 
@@ -3868,8 +3966,19 @@ void yed_start_replace_current_search(void) {
         r1 = r2 = ys->active_frame->cursor_line;
     }
 
-    for (row = r1; row <= r2; row += 1) {
-        replace_add_line(buff, row, len);
+    replace_free();
+
+    /* Row i's matches are from replace_first_marker[i] up to replace_first_marker[i + 1]. */
+    zero = 0;
+    array_push(ys->replace_first_marker, zero);
+
+    if (pattern != NULL) {
+        row = r1;
+        bucket_array_traverse_from(buff->lines, line, r1 - 1) {
+            if (row > r2) { break; }
+            replace_add_line(pattern, line, row);
+            row += 1;
+        }
     }
 
     yed_clear_cmd_buff();
@@ -3906,6 +4015,185 @@ void yed_default_command_replace_current_search(int n_args, char **args) {
     }
 }
 
+void yed_default_command_replace_regex(int n_args, char **args) {
+    yed_frame            *frame;
+    yed_buffer           *buff;
+    yed_search_pattern    pattern;
+    yed_replace_template  tmpl;
+    int                   r1, c1, r2, c2;
+    int                   n;
+
+    if (n_args != 2) {
+        yed_cerr("expected 2 arguments, but got %d", n_args);
+        return;
+    }
+
+    if (!ys->active_frame) {
+        yed_cerr("no active frame");
+        return;
+    }
+
+    frame = ys->active_frame;
+
+    if (!frame->buffer) {
+        yed_cerr("active frame has no buffer");
+        return;
+    }
+
+    buff = frame->buffer;
+
+    if (buff->flags & BUFF_RD_ONLY) {
+        yed_cerr("buffer is read-only");
+        return;
+    }
+
+    if (!strlen(args[0])) {
+        yed_cerr("empty regex");
+        return;
+    }
+
+    yed_search_pattern_make(&pattern, args[0], yed_search_pattern_flags(args[0]) | SEARCH_PATTERN_REGEX);
+
+    if (pattern.reg == NULL) {
+        yed_cerr("invalid regex '%s'", args[0]);
+        yed_search_pattern_free(&pattern);
+        return;
+    }
+
+    yed_replace_template_make(&tmpl, args[1]);
+
+    if (tmpl.max_group > yed_search_pattern_n_groups(&pattern)) {
+        yed_cerr("the replacement uses group %d, but the regex only has %d",
+                 tmpl.max_group, yed_search_pattern_n_groups(&pattern));
+        goto out;
+    }
+
+    if (buff->has_selection) {
+        yed_range_sorted_points(&buff->selection, &r1, &c1, &r2, &c2);
+    } else {
+        r1 = 1;
+        r2 = yed_buff_n_lines(buff);
+    }
+
+    yed_start_undo_record(frame, buff);
+
+    n = yed_replace_regex(buff, &pattern, &tmpl, r1, r2);
+
+    if (n > 0) {
+        yed_end_undo_record(frame, buff);
+    } else {
+        yed_cancel_undo_record(frame, buff);
+    }
+
+    if (buff->has_selection) {
+        YEXE("select-off");
+    }
+
+    yed_set_cursor_within_frame(frame, frame->cursor_line, frame->cursor_col);
+
+    yed_cprint("replaced %d match%s", n, n == 1 ? "" : "es");
+
+out:;
+    yed_replace_template_free(&tmpl);
+    yed_search_pattern_free(&pattern);
+}
+
+/* Make this the search that find-next-in-buffer uses and that's highlighted. */
+static void set_search(const char *str) {
+    char *cpy;
+
+    cpy = strdup(str);
+
+    if (ys->save_search) {
+        free(ys->save_search);
+    }
+
+    ys->save_search    = cpy;
+    ys->current_search = cpy;
+}
+
+static void focus_search_results(void) {
+    YEXE("special-buffer-prepare-focus", "*search-results");
+    YEXE("buffer",                       "*search-results");
+    yed_set_cursor_far_within_frame(ys->active_frame, 1, 1);
+}
+
+void yed_default_command_find_in_buffers(int n_args, char **args) {
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    if (n_args == 0 && (!ys->save_search || !strlen(ys->save_search))) {
+        yed_cerr("no previous search");
+        return;
+    }
+
+    if (n_args == 1) {
+        if (!strlen(args[0])) {
+            yed_cerr("empty search");
+            return;
+        }
+
+        set_search(args[0]);
+    }
+
+    ys->current_search = ys->save_search;
+
+    focus_search_results();
+    yed_find_in_buffers(ys->save_search);
+}
+
+void yed_default_command_grep_files(int n_args, char **args) {
+    int status;
+
+    if (n_args < 1 || n_args > 2) {
+        yed_cerr("expected 1 or 2 arguments, but got %d", n_args);
+        return;
+    }
+
+    if (!strlen(args[0])) {
+        yed_cerr("empty search");
+        return;
+    }
+
+    set_search(args[0]);
+
+    status = yed_grep_files(ys->save_search, n_args == 2 ? args[1] : ".");
+    if (status != 0) {
+        yed_cerr("can't search '%s' -- %s", n_args == 2 ? args[1] : ".", strerror(status));
+        return;
+    }
+
+    focus_search_results();
+    yed_cprint("searching...");
+}
+
+void yed_default_command_search_results(int n_args, char **args) {
+    if (n_args != 0) {
+        yed_cerr("expected 0 arguments, but got %d", n_args);
+        return;
+    }
+
+    YEXE("special-buffer-prepare-focus", "*search-results");
+    YEXE("buffer",                       "*search-results");
+}
+
+void yed_default_command_find_file(int n_args, char **args) {
+    if (n_args > 1) {
+        yed_cerr("expected 0 or 1 arguments, but got %d", n_args);
+        return;
+    }
+
+    /* Ask for it, with the files under the working directory to complete from. */
+    if (n_args == 0) {
+        YEXE("command-prompt", "find-file", "");
+        return;
+    }
+
+    YEXE("buffer", args[0]);
+}
+
 void yed_default_command_style(int n_args, char **args) {
     if (n_args == 0) {
         if (ys->active_style) {
@@ -4267,6 +4555,19 @@ void yed_default_command_feed_keys(int n_args, char **args) {
     }
 }
 
+void yed_default_command_feed_keys_as_typed(int n_args, char **args) {
+    int i;
+    int n;
+    int keys[MAX_SEQ_LEN];
+
+    for (i = 0; i < n_args; i += 1) {
+        n = yed_string_to_keys(args[i], keys);
+        if (n <= 0) { continue; }
+
+        yed_feed_keys_as_typed(n, keys);
+    }
+}
+
 void yed_default_command_alias(int n_args, char **args) {
     yed_command cmd;
 
@@ -117,6 +117,11 @@ DEF_DEFAULT_COMMAND(find_in_buffer);
 DEF_DEFAULT_COMMAND(find_next_in_buffer);
 DEF_DEFAULT_COMMAND(find_prev_in_buffer);
 DEF_DEFAULT_COMMAND(replace_current_search);
+DEF_DEFAULT_COMMAND(replace_regex);
+DEF_DEFAULT_COMMAND(find_in_buffers);
+DEF_DEFAULT_COMMAND(grep_files);
+DEF_DEFAULT_COMMAND(search_results);
+DEF_DEFAULT_COMMAND(find_file);
 DEF_DEFAULT_COMMAND(style);
 DEF_DEFAULT_COMMAND(style_off);
 DEF_DEFAULT_COMMAND(styles_list);
@@ -137,6 +142,7 @@ DEF_DEFAULT_COMMAND(log);
 DEF_DEFAULT_COMMAND(nop);
 DEF_DEFAULT_COMMAND(cursor_style);
 DEF_DEFAULT_COMMAND(feed_keys);
+DEF_DEFAULT_COMMAND(feed_keys_as_typed);
 DEF_DEFAULT_COMMAND(alias);
 DEF_DEFAULT_COMMAND(unalias);
 DEF_DEFAULT_COMMAND(repeat);
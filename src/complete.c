@@ -2,11 +2,14 @@ void yed_init_completions(void) {
     ys->completions         = tree_make(yed_completion_name_t, yed_completion);
     ys->default_completions = tree_make(yed_completion_name_t, yed_completion);
     yed_set_default_completions();
+    yed_init_word_index();
 }
 
 void yed_set_completion(char *name, yed_completion comp) {
     tree_it(yed_completion_name_t, yed_completion) it;
 
+    yed_clear_completion_cache();
+
     it = tree_lookup(ys->completions, name);
 
     if (tree_it_good(it)) {
@@ -20,6 +23,8 @@ void yed_unset_completion(char *name) {
     tree_it(yed_completion_name_t, yed_completion)  it;
     char                                           *old_key;
 
+    yed_clear_completion_cache();
+
     it = tree_lookup(ys->completions, name);
 
     if (tree_it_good(it)) {
@@ -136,21 +141,18 @@ static int yed_default_completion_plugins(char *string, yed_completion_results *
 }
 
 static int _yed_default_completion_files(char *string, yed_completion_results *results, int dironly) {
-    char                    *orig;
-    int                      expanded;
-    char                     expanded_path[4096];
-    char                    *cpy;
-    char                    *dirn;
-    tree(str_t, empty_t)     t;
-    char                     dir_path_buff[4096];
-    DIR                     *dir;
-    struct dirent           *dent;
-    char                     full_path[4096];
-    struct stat              st;
-    char                     homeified_path[4096];
-    tree_it(str_t, empty_t)  it;
-    char                    *key;
-    int                      status;
+    char      *orig;
+    int        expanded;
+    char       expanded_path[4096];
+    char      *cpy;
+    char      *dirn;
+    char       dir_path_buff[4096];
+    array_t    names;
+    char     **it;
+    char       full_path[4096];
+    char       homeified_path[4096];
+    char      *path;
+    int        len;
 
     if (strcmp(string, "~") == 0) {
         array_clear(results->strings);
@@ -167,7 +169,7 @@ static int _yed_default_completion_files(char *string, yed_completion_results *r
     }
     cpy    = strdup(string);
     dirn   = dirname(cpy);
-    t      = tree_make(str_t, empty_t);
+    names  = array_make(char*);
 
     if (strlen(string) > 0) {
         if (string[strlen(string) - 1] == '/') {
@@ -179,53 +181,39 @@ static int _yed_default_completion_files(char *string, yed_completion_results *r
         }
     }
 
-    if ((dir = opendir(dirn)) == NULL) { goto out; }
+    array_clear(results->strings);
 
-    while ((dent = readdir(dir)) != NULL) {
-        if (strcmp(dent->d_name, ".")  == 0
-        ||  strcmp(dent->d_name, "..") == 0) {
-            continue;
-        }
+    /* The names are sorted, so the paths made from them are too. */
+    if (yed_dir_cache_list(dirn, &names, dironly)) {
+        len = strlen(orig);
 
-        full_path[0] = 0;
-        if (strcmp(string, "./") == 0 || strcmp(dirn, ".") != 0) {
-            strcat(full_path, dirn);
-            if (strcmp(dirn, "/") != 0) {
-                strcat(full_path, "/");
+        array_traverse(names, it) {
+            full_path[0] = 0;
+            if (strcmp(string, "./") == 0 || strcmp(dirn, ".") != 0) {
+                strcat(full_path, dirn);
+                if (strcmp(dirn, "/") != 0) {
+                    strcat(full_path, "/");
+                }
             }
-        }
-        strcat(full_path, dent->d_name);
+            strcat(full_path, *it);
 
-        if (dironly) {
-            if (stat(full_path, &st) != 0) { continue; }
-            if (!(S_ISDIR(st.st_mode)))    { continue; }
-        }
+            path = full_path;
+            if (expanded) {
+                if (homeify_path(full_path, homeified_path) == NULL) { continue; }
+                path = homeified_path;
+            }
 
-        if (expanded) {
-            if (homeify_path(full_path, homeified_path) != NULL) {
-                tree_insert(t, strdup(homeified_path), (empty_t){});
+            if (strncmp(path, orig, len) == 0) {
+                path = strdup(path);
+                array_push(results->strings, path);
             }
-        } else {
-            tree_insert(t, strdup(full_path), (empty_t){});
         }
     }
 
-    closedir(dir);
-
-    string = orig;
-    FN_BODY_FOR_COMPLETE_FROM_TREE(string, t, it, results, status);
-
-out:;
-    while (tree_len(t)) {
-        it  = tree_begin(t);
-        key = tree_it_key(it);
-        tree_delete(t, key);
-        free(key);
-    }
-    tree_free(t);
+    free_string_array(names);
     free(cpy);
 
-    return status;
+    return array_len(results->strings) ? COMPL_ERR_NO_ERR : COMPL_ERR_NO_MATCH;
 }
 
 static int yed_default_completion_files(char *string, yed_completion_results *results) {
@@ -236,6 +224,30 @@ static int yed_default_completion_directories(char *string, yed_completion_resul
     return _yed_default_completion_files(string, results, 1);
 }
 
+/* Every file under the working directory, for find-file. */
+static int yed_default_completion_project_files(char *string, yed_completion_results *results) {
+    array_t   paths;
+    char    **it;
+    int       len;
+
+    paths = array_make(char*);
+    len   = strlen(string);
+
+    yed_dir_cache_walk(".", &paths);
+
+    array_clear(results->strings);
+    array_traverse(paths, it) {
+        if (strncmp(*it, string, len) == 0) {
+            array_push(results->strings, *it);
+        } else {
+            free(*it);
+        }
+    }
+    array_free(paths);
+
+    return array_len(results->strings) ? COMPL_ERR_NO_ERR : COMPL_ERR_NO_MATCH;
+}
+
 static int complete_files_and_buffers(char *string, yed_completion_results *results) {
     const char *compls[] = { "file", "buffer" };
     return yed_complete_multiple(sizeof(compls)/sizeof(compls[0]), (char**)compls, string, results);
@@ -303,100 +315,27 @@ static int complete_loadable_plugins(char *string, yed_completion_results *resul
     return status;
 }
 
-static void get_all_line_words(char *string, tree(str_t, empty_t) words, yed_line *line) {
-    int  len, col, start_col;
-    char c, *word_start, *word;
-
-    len = strlen(string);
-    col = 1;
-
-    while (col < line->visual_width) {
-        start_col = col;
-
-        c = ((yed_glyph*)yed_line_col_to_glyph(line, col))->c;
-
-        if (is_alnum(c) || c == '_') {
-            while (col <= line->visual_width) {
-                col += 1;
-                c    = ((yed_glyph*)yed_line_col_to_glyph(line, col))->c;
-
-                if (!is_alnum(c) && c != '_') {
-                    break;
-                }
-            }
-
-            word_start = array_data(line->chars)
-                         + yed_line_col_to_idx(line, start_col);
-
-            if (strncmp(string, word_start, len) == 0) {
-                word = strndup(word_start, col - start_col);
-                tree_insert(words, word, (empty_t){});
-            }
-        } else if (!is_space(c)) {
-            while (col <= line->visual_width) {
-                col += 1;
-                c    = ((yed_glyph*)yed_line_col_to_glyph(line, col))->c;
-
-                if (is_alnum(c) || c == '_' || is_space(c)) {
-                    break;
-                }
-            }
-        }
-
-        if (is_space(c)) {
-            while (col <= line->visual_width) {
-                col += 1;
-                c    = ((yed_glyph*)yed_line_col_to_glyph(line, col))->c;
-
-                if (!is_space(c)) {
-                    break;
-                }
-            }
-        }
-    }
-}
+static int yed_default_completion_words(char *string, yed_completion_results *results) {
+    yed_word **words;
+    int        n;
+    int        include_special;
+    int        i;
+    char      *cpy;
 
-static void get_all_buff_words(char *string, tree(str_t, empty_t) words) {
-    int                                           include_special;
-    int                                           max_lines;
-    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)  it;
-    yed_line                                     *line;
+    if (string == NULL) { return COMPL_ERR_NO_MATCH; }
 
     include_special = yed_var_is_truthy("compl-words-include-special");
-    if (!yed_get_var_as_int("compl-words-buffer-max-lines", &max_lines)) {
-        max_lines = DEFAULT_COMPL_WORDS_BUFFER_MAX_LINES;
-    }
-
-    tree_traverse(ys->buffers, it) {
-        if (!include_special && tree_it_val(it)->flags & BUFF_SPECIAL) { continue; }
-        if (yed_buff_n_lines(tree_it_val(it)) > max_lines)             { continue; }
+    n               = yed_word_index_lookup(string, include_special, &words);
 
-        bucket_array_traverse(tree_it_val(it)->lines, line) {
-            get_all_line_words(string, words, line);
-        }
-    }
-}
-
-static int yed_default_completion_words(char *string, yed_completion_results *results) {
-    tree(str_t, empty_t)     t;
-    tree_it(str_t, empty_t)  it;
-    int                      status;
-    char                    *key;
-
-    t = tree_make(str_t, empty_t);
-    get_all_buff_words(string, t);
-
-    FN_BODY_FOR_COMPLETE_FROM_TREE(string, t, it, results, status);
+    array_clear(results->strings);
+    array_grow_if_needed_to(results->strings, n);
 
-    while (tree_len(t)) {
-        it  = tree_begin(t);
-        key = tree_it_key(it);
-        tree_delete(t, key);
-        free(key);
+    for (i = 0; i < n; i += 1) {
+        cpy = strdup(words[i]->str);
+        array_push(results->strings, cpy);
     }
-    tree_free(t);
 
-    return status;
+    return n ? COMPL_ERR_NO_ERR : COMPL_ERR_NO_MATCH;
 }
 
 
@@ -415,6 +354,7 @@ void yed_set_default_completions(void) {
     SET_DEFAULT_COMPL("plugin",                          yed_default_completion_plugins);
     SET_DEFAULT_COMPL("file",                            yed_default_completion_files);
     SET_DEFAULT_COMPL("directory",                       yed_default_completion_directories);
+    SET_DEFAULT_COMPL("project-file",                    yed_default_completion_project_files);
     SET_DEFAULT_COMPL("word",                            yed_default_completion_words);
 
     SET_DEFAULT_COMPL("bind-compl-arg-1",                yed_default_completion_commands);
@@ -437,6 +377,7 @@ void yed_set_default_completions(void) {
     SET_DEFAULT_COMPL("unalias-compl-arg-0",             yed_default_completion_commands);
     SET_DEFAULT_COMPL("repeat-compl-arg-1",              yed_default_completion_commands);
     SET_DEFAULT_COMPL("forward-cursor-word-compl-arg-0", yed_default_completion_commands);
+    SET_DEFAULT_COMPL("find-file-compl-arg-0",           yed_default_completion_project_files);
 }
 
 int compute_common_prefix_len(char *in, int n_items, char **items) {
@@ -516,59 +457,6 @@ none:
     return n_items;
 }
 
-int get_buff_word_completion(char *in, char ***out) {
-    tree(str_t, empty_t)      words;
-    tree_it(str_t, empty_t)   it;
-    int                       in_len,
-                              i,
-                              n_items;
-    char                    **items,
-                             *key;
-
-    words   = tree_make(str_t, empty_t);
-    in_len  = strlen(in);
-    n_items = 0;
-
-    get_all_buff_words(in, words);
-
-    it  = tree_gtr(words, in);
-
-    if (!tree_it_good(it))    { goto none; }
-
-    i   = 0;
-    key = tree_it_key(it);
-    while (strncmp(key, in, in_len) == 0) {
-        i += 1;
-        tree_it_next(it);
-        if (!tree_it_good(it)) {
-            break;
-        }
-        key = tree_it_key(it);
-    }
-
-    n_items = i;
-
-    if (n_items) {
-        items = malloc(i * sizeof(char*));
-
-        it = tree_gtr(words, in);
-        i  = 0;
-        while (i < n_items) {
-            items[i] = tree_it_key(it);
-            tree_it_next(it);
-            i += 1;
-        }
-    } else {
-none:
-        items = NULL;
-    }
-
-    tree_free(words);
-
-    *out = items;
-    return n_items;
-}
-
 int yed_complete(char *compl_name, char *string, yed_completion_results *results) {
     tree_it(yed_completion_name_t, yed_completion) it;
     yed_completion                                 comp;
@@ -640,3 +528,159 @@ out:;
 
     return status;
 }
+
+static void compl_cache_entry_free(yed_completion_cache_entry *entry) {
+    if (entry->name == NULL) { return; }
+
+    free(entry->name);
+    free(entry->anchor);
+    free(entry->query);
+    yed_fuzzy_set_free(&entry->set);
+    array_free(entry->matches);
+    array_free(entry->scratch);
+
+    entry->name = NULL;
+}
+
+void yed_clear_completion_cache(void) {
+    int i;
+
+    for (i = 0; i < COMPL_CACHE_SIZE; i += 1) {
+        compl_cache_entry_free(ys->compl_cache + i);
+    }
+}
+
+/* The entry for this completion and anchor, running the completion if there isn't one. */
+static yed_completion_cache_entry *compl_cache_get(char *compl_name, yed_completion comp, char *anchor) {
+    yed_completion_cache_entry *entry;
+    int                         i;
+    yed_completion_results      results;
+    int                         anchor_len;
+    char                      **it;
+    array_t                     strings;
+    u64                         dir_generation;
+
+    entry          = NULL;
+    dir_generation = yed_dir_cache_generation();
+
+    for (i = 0; i < COMPL_CACHE_SIZE; i += 1) {
+        if (ys->compl_cache[i].name != NULL
+        &&  strcmp(ys->compl_cache[i].name,   compl_name) == 0
+        &&  strcmp(ys->compl_cache[i].anchor, anchor)     == 0) {
+
+            entry = ys->compl_cache + i;
+
+            if (entry->dir_generation == dir_generation) { goto out; }
+
+            /* Files were listed from directories that have changed (or were still being read). */
+            break;
+        }
+
+        if (entry == NULL
+        ||  (entry->name != NULL && (ys->compl_cache[i].name == NULL || ys->compl_cache[i].last_use < entry->last_use))) {
+            entry = ys->compl_cache + i;
+        }
+    }
+
+    compl_cache_entry_free(entry);
+
+    results.strings = array_make(char*);
+    if (comp(anchor, &results) != COMPL_ERR_NO_ERR) {
+        free_string_array(results.strings);
+        results.strings = array_make(char*);
+    }
+
+    /* Completions are supposed to start with the string, but don't count on it. */
+    anchor_len = strlen(anchor);
+    strings    = array_make_with_cap(char*, array_len(results.strings));
+    array_traverse(results.strings, it) {
+        if (strncmp(*it, anchor, anchor_len) == 0) {
+            array_push(strings, *it);
+        }
+    }
+
+    entry->name           = strdup(compl_name);
+    entry->anchor         = strdup(anchor);
+    entry->dir_generation = yed_dir_cache_generation();
+    entry->query          = NULL;
+    entry->matches        = array_make(yed_fuzzy_match);
+    entry->scratch        = array_make(yed_fuzzy_match);
+    yed_fuzzy_set_make(&entry->set, array_len(strings), array_data(strings), anchor_len);
+
+    array_free(strings);
+    free_string_array(results.strings);
+
+out:;
+    ys->compl_cache_clock += 1;
+    entry->last_use        = ys->compl_cache_clock;
+
+    return entry;
+}
+
+int yed_complete_fuzzy(char *compl_name, char *string, yed_completion_results *results) {
+    tree_it(yed_completion_name_t, yed_completion)  it;
+    char                                           *slash;
+    char                                            anchor[4096];
+    int                                             anchor_len;
+    yed_fuzzy_query                                 query;
+    yed_completion_cache_entry                     *entry;
+    array_t                                        *in;
+    array_t                                         tmp;
+    yed_fuzzy_match                                *match;
+    char                                           *cpy;
+
+    it = tree_lookup(ys->completions, compl_name);
+
+    if (!tree_it_good(it)) {
+        return COMPL_ERR_NO_COMPL;
+    }
+
+    if (string == NULL) { string = ""; }
+
+    slash      = strrchr(string, '/');
+    anchor_len = slash == NULL ? 0 : slash - string + 1;
+
+    if (anchor_len >= sizeof(anchor)
+    ||  !yed_fuzzy_query_make(&query, string + anchor_len)) {
+        return yed_complete(compl_name, string, results);
+    }
+
+    memcpy(anchor, string, anchor_len);
+    anchor[anchor_len] = 0;
+
+    entry = compl_cache_get(compl_name, tree_it_val(it), anchor);
+
+    /* Every match of a longer query is a match of the shorter one. */
+    in = NULL;
+    if (entry->query != NULL
+    &&  strncmp(query.str, entry->query, strlen(entry->query)) == 0) {
+        in = &entry->matches;
+    }
+
+    yed_fuzzy_filter(&entry->set, &query, in, &entry->scratch);
+
+    tmp            = entry->matches;
+    entry->matches = entry->scratch;
+    entry->scratch = tmp;
+
+    free(entry->query);
+    entry->query = strdup(query.str);
+
+    if (array_len(entry->matches) == 0) {
+        return yed_complete(compl_name, string, results);
+    }
+
+    results->strings = array_make_with_cap(char*, array_len(entry->matches));
+
+    array_traverse(entry->matches, match) {
+        cpy = strdup(yed_fuzzy_set_string(&entry->set, match->idx));
+        array_push(results->strings, cpy);
+    }
+
+    results->common_prefix_len =
+        compute_common_prefix_len(anchor,
+                                  array_len(results->strings),
+                                  array_data(results->strings));
+
+    return COMPL_ERR_NO_ERR;
+}
@@ -11,11 +11,42 @@ typedef struct yed_completion_results_t {
     int     common_prefix_len;
 } yed_completion_results;
 
+#define COMPL_CACHE_SIZE (8)
+
+/*
+ * Fuzzy completion (see fuzzy.h) runs a completion once with everything
+ * up to the last '/' of the string (the anchor) and matches the rest of
+ * the string against the rest of each candidate. The candidates are kept
+ * for the next time the same completion is run with the same anchor, along
+ * with the matches, so that a longer query only has to look at those.
+ * They're collected again if any directory listing has changed since,
+ * since there's no telling which completions list files.
+ */
+typedef struct {
+    char          *name; /* NULL if unused. */
+    char          *anchor;
+    yed_fuzzy_set  set;
+    char          *query;
+    array_t        matches; /* yed_fuzzy_match, for query. */
+    array_t        scratch;
+    u64            last_use;
+    u64            dir_generation; /* Directory listings change, see dir_cache.h. */
+} yed_completion_cache_entry;
+
 void yed_init_completions(void);
 void yed_set_default_completions(void);
 int yed_complete(char *compl_name, char *string, yed_completion_results *results);
 int yed_complete_multiple(int n, char **compl_names, char *string, yed_completion_results *results);
 
+/*
+ * Like yed_complete(), but the results are fuzzy matches, best first. If
+ * there aren't any, the results are yed_complete()'s.
+ */
+int yed_complete_fuzzy(char *compl_name, char *string, yed_completion_results *results);
+
+/* Forget the candidates kept for fuzzy completion, e.g. when they might have changed. */
+void yed_clear_completion_cache(void);
+
 void yed_set_completion(char *name, yed_completion comp);
 void yed_unset_completion(char *name);
 yed_completion yed_get_completion(char *name);
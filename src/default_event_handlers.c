@@ -15,6 +15,8 @@ static void yed_var_change_handler(yed_event *event) {
     char *val;
     float f;
 
+    yed_invalidate_status_line(strncmp(event->var_name, "status-line-", strlen("status-line-")) == 0);
+
     if (strcmp(event->var_name, "tab-width") == 0) {
         old_tabw = ys->tabw;
         yed_get_var_as_int("tab-width", &ys->tabw);
@@ -34,9 +36,26 @@ static void yed_var_change_handler(yed_event *event) {
                     f = 1.0;
                 }
             }
-            ys->screen_update->opacity = f;
+            yed_set_screen_opacity(f);
             yed_clear_screen();
         }
+    } else if (strcmp(event->var_name, "screen-render-thread") == 0) {
+        if (ys->screen_update != NULL) {
+            if (yed_var_is_truthy("screen-render-thread")) {
+                yed_start_render_thread();
+            } else {
+                yed_stop_render_thread();
+            }
+        }
+    } else if (strcmp(event->var_name, "search-regex") == 0
+           ||  strcmp(event->var_name, "search-smart-case") == 0) {
+        /* The same search now matches different things. */
+        ys->search_decoration_version += 1;
+    } else if (strcmp(event->var_name, "worker-threads") == 0) {
+        if (ys->workers_started) {
+            yed_stop_workers();
+            yed_start_workers();
+        }
     }
 
     if (yed_buff_is_visible(yed_get_vars_buffer())) {
@@ -50,18 +69,49 @@ static void yed_var_buffer_focus_handler(yed_event *event) {
     }
 }
 
+u64 yed_search_decoration_version(void) {
+    const char *search;
+
+    search = ys->current_search;
+
+    if (search == NULL) {
+        if (ys->search_decoration_str != NULL) {
+            free(ys->search_decoration_str);
+            ys->search_decoration_str      = NULL;
+            ys->search_decoration_version += 1;
+        }
+    } else if (ys->search_decoration_str == NULL
+           ||  strcmp(ys->search_decoration_str, search) != 0) {
+
+        if (ys->search_decoration_str != NULL) {
+            free(ys->search_decoration_str);
+        }
+        ys->search_decoration_str      = strdup(search);
+        ys->search_decoration_version += 1;
+    }
+
+    return ys->search_decoration_version;
+}
+
+static void yed_style_change_handler(yed_event *event) {
+    (void)event;
+    yed_invalidate_row_caches();
+    yed_invalidate_status_line(0);
+}
+
 void yed_search_line_handler(yed_event *event) {
-    yed_frame  *frame;
-    yed_buffer *buff;
-    yed_line   *line;
-    yed_attrs  *attr, search, search_cursor, *set;
-    char       *line_data,
-               *line_data_end,
-               *scan;
-    int         i, idx, col,
-                search_len,
-                search_width,
-                data_len;
+    yed_frame          *frame;
+    yed_buffer         *buff;
+    yed_line           *line;
+    yed_attrs          *attr, search, search_cursor, *set;
+    yed_search_pattern *pattern;
+    yed_search_index   *index;
+    char               *line_data;
+    int                 i, idx, col,
+                        start,
+                        len,
+                        width,
+                        data_len;
 
     if (!ys->current_search) {
         return;
@@ -81,34 +131,41 @@ void yed_search_line_handler(yed_event *event) {
         return;
     }
 
-    buff         = frame->buffer;
-    line         = yed_buff_get_line(buff, event->row);
-    data_len     = array_len(line->chars);
-    search_len   = strlen(ys->current_search);
-    search_width = yed_get_string_width(ys->current_search);
+    buff     = frame->buffer;
+    line     = yed_buff_get_line(buff, event->row);
+    data_len = array_len(line->chars);
+    pattern  = yed_get_current_search_pattern();
 
-    if (!line->visual_width || !search_len)    { return; }
+    if (!line->visual_width || !pattern->len)    { return; }
 
-    line_data     = scan = array_data(line->chars);
-    line_data_end = line_data + data_len;
+    /* Most rows don't have any matches, and the index already knows which. */
+    index = yed_buff_get_search_index(buff);
+    if (index != NULL && yed_search_index_row_matches(buff, index, event->row) == 0) { return; }
+
+    line_data = array_data(line->chars);
+    start     = 0;
 
     search        = yed_active_style_get_search();
     search_cursor = yed_active_style_get_search_cursor();
 
-    while (scan < line_data_end && line_data_end - scan >= search_len) {
-        if (!(scan = strnstr(scan, ys->current_search, line_data_end - scan))) {
+    while (data_len - start >= pattern->lit_len) {
+        if ((idx = yed_search_pattern_find(pattern, line_data, data_len, start, data_len, &len)) < 0) {
             break;
         }
 
-        idx = scan - line_data;
         col = yed_line_idx_to_col(line, idx);
 
+        /* Regex matches vary in length, so they have to be measured. */
+        width = (pattern->flags & SEARCH_PATTERN_REGEX)
+                    ? yed_line_idx_to_col(line, idx + len) - col
+                    : pattern->width;
+
         set = (event->row == frame->cursor_line
                 &&    col == frame->cursor_col)
                     ? &search_cursor
                     : &search;
 
-        for (i = 0; i < search_width; i += 1) {
+        for (i = 0; i < width; i += 1) {
             if (ys->active_style) {
                 yed_eline_combine_col_attrs(event, col + i, set);
             } else {
@@ -119,7 +176,7 @@ void yed_search_line_handler(yed_event *event) {
             }
         }
 
-        scan += 1;
+        start = idx + 1;
     }
 }
 
@@ -0,0 +1,505 @@
+#include "dir_cache.h"
+
+static void dir_cache_abs_path(const char *path, char *buff) {
+    int len;
+
+    abs_path(path, buff);
+
+    len = strlen(buff);
+    if (len > 1 && buff[len - 1] == '/') { buff[len - 1] = 0; }
+}
+
+static int dir_entry_cmp(const void *a, const void *b) {
+    return strcmp(((yed_dir_entry*)a)->name, ((yed_dir_entry*)b)->name);
+}
+
+static void dir_entries_free(array_t *entries) {
+    yed_dir_entry *it;
+
+    array_traverse(*entries, it) {
+        free(it->name);
+    }
+    array_free(*entries);
+}
+
+/* Returns 0 if the directory couldn't be opened. */
+static int dir_cache_read(const char *path, array_t *entries) {
+    DIR           *dir;
+    struct dirent *dent;
+    yed_dir_entry  entry;
+    char           full_path[4096];
+    struct stat    st;
+
+    if ((dir = opendir(path)) == NULL) { return 0; }
+
+    while ((dent = readdir(dir)) != NULL) {
+        if (strcmp(dent->d_name, ".")  == 0
+        ||  strcmp(dent->d_name, "..") == 0) {
+            continue;
+        }
+
+        entry.is_dir  = dent->d_type == DT_DIR;
+        entry.is_link = dent->d_type == DT_LNK;
+
+        /* Only these need a stat() to find out if they're directories. */
+        if (dent->d_type == DT_LNK || dent->d_type == DT_UNKNOWN) {
+            snprintf(full_path, sizeof(full_path), "%s/%s", strcmp(path, "/") == 0 ? "" : path, dent->d_name);
+
+            if (dent->d_type == DT_UNKNOWN && lstat(full_path, &st) == 0) {
+                entry.is_link = S_ISLNK(st.st_mode);
+            }
+
+            entry.is_dir = stat(full_path, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+
+        entry.name = strdup(dent->d_name);
+        array_push(*entries, entry);
+    }
+
+    closedir(dir);
+
+    qsort(array_data(*entries), array_len(*entries), sizeof(yed_dir_entry), dir_entry_cmp);
+
+    return 1;
+}
+
+static int dir_cache_is_ignored(yed_dir_cache *cache, const char *name) {
+    char **it;
+
+    if (name[0] == '.') { return 1; }
+
+    array_traverse(cache->ignore, it) {
+        if (fnmatch(*it, name, 0) == 0) { return 1; }
+    }
+
+    return 0;
+}
+
+/* The rest of these are called with the mutex held. */
+
+static yed_dir_listing *dir_cache_listing(yed_dir_cache *cache, const char *path) {
+    tree_it(str_t, yed_dir_listing_ptr_t)  it;
+    yed_dir_listing                       *listing;
+
+    it = tree_lookup(cache->listings, (char*)path);
+
+    if (tree_it_good(it)) { return tree_it_val(it); }
+
+    listing          = calloc(1, sizeof(*listing));
+    listing->path    = strdup(path);
+    listing->state   = DIR_LISTING_NEW;
+    listing->used_us = measure_time_now_us();
+    listing->entries = array_make(yed_dir_entry);
+
+    tree_insert(cache->listings, listing->path, listing);
+
+    return listing;
+}
+
+static void dir_cache_queue(yed_dir_cache *cache, yed_dir_listing *listing) {
+    if (listing->queued) { return; }
+
+    listing->queued = 1;
+    array_push(cache->todo, listing);
+
+    pthread_cond_broadcast(&cache->cond);
+}
+
+/* Queue the listing if it hasn't been read, or hasn't been checked in a while. */
+static void dir_cache_refresh(yed_dir_cache *cache, yed_dir_listing *listing) {
+    listing->used_us = measure_time_now_us();
+
+    if (listing->state == DIR_LISTING_NEW
+    ||  measure_time_now_us() - listing->checked_us > 1000ULL * DIR_CACHE_CHECK_MS) {
+        dir_cache_queue(cache, listing);
+    }
+}
+
+static void dir_cache_queue_subdirs(yed_dir_cache *cache, yed_dir_listing *listing) {
+    yed_dir_entry   *it;
+    char             path[4096];
+    yed_dir_listing *child;
+
+    array_traverse(listing->entries, it) {
+        if (!it->is_dir || it->is_link || dir_cache_is_ignored(cache, it->name)) { continue; }
+
+        snprintf(path, sizeof(path), "%s/%s", strcmp(listing->path, "/") == 0 ? "" : listing->path, it->name);
+
+        child = dir_cache_listing(cache, path);
+
+        if (!child->recursive) {
+            child->recursive = 1;
+            dir_cache_queue(cache, child);
+        } else if (child->state == DIR_LISTING_NEW) {
+            dir_cache_queue(cache, child);
+        }
+    }
+}
+
+/* Take the next listing off of the queue and read it, unlocking the mutex while doing so. */
+static void dir_cache_do_one(yed_dir_cache *cache) {
+    yed_dir_listing *listing;
+    int              state;
+    struct timespec  mtime;
+    struct stat      st;
+    array_t          entries;
+    int              changed;
+
+    listing = *(yed_dir_listing**)array_last(cache->todo);
+    array_pop(cache->todo);
+
+    state         = listing->state;
+    mtime         = listing->mtime;
+    cache->n_busy += 1;
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    entries = array_make(yed_dir_entry);
+    changed = 1;
+
+    if (stat(listing->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        changed = state != DIR_LISTING_FAILED;
+        state   = DIR_LISTING_FAILED;
+    } else if (state == DIR_LISTING_READY
+           &&  st.st_mtim.tv_sec  == mtime.tv_sec
+           &&  st.st_mtim.tv_nsec == mtime.tv_nsec) {
+        changed = 0;
+    } else {
+        state = dir_cache_read(listing->path, &entries) ? DIR_LISTING_READY : DIR_LISTING_FAILED;
+        mtime = st.st_mtim;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    if (changed) {
+        dir_entries_free(&listing->entries);
+        listing->entries  = entries;
+        listing->state    = state;
+        listing->mtime    = mtime;
+        cache->generation += 1;
+    } else {
+        array_free(entries);
+    }
+
+    listing->checked_us = measure_time_now_us();
+    listing->queued     = 0;
+
+    /* Don't go any deeper than the last walk can use. */
+    if (listing->recursive && listing->state == DIR_LISTING_READY && cache->budget > 0) {
+        cache->budget -= array_len(listing->entries);
+        dir_cache_queue_subdirs(cache, listing);
+    }
+
+    cache->n_busy -= 1;
+
+    pthread_cond_broadcast(&cache->cond);
+}
+
+static void * dir_cache_thread(void *arg) {
+    yed_dir_cache *cache;
+
+    cache = arg;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    for (;;) {
+        while (!cache->stop && array_len(cache->todo) == 0) {
+            pthread_cond_wait(&cache->cond, &cache->mutex);
+        }
+
+        if (cache->stop) { break; }
+
+        dir_cache_do_one(cache);
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return NULL;
+}
+
+/* Returns 0 at the deadline. */
+static int dir_cache_wait(yed_dir_cache *cache, struct timespec *deadline) {
+    /* Nobody to wait for: do it here. */
+    if (cache->n_threads == 0) {
+        if (array_len(cache->todo) > 0) { dir_cache_do_one(cache); }
+        return 1;
+    }
+
+    return pthread_cond_timedwait(&cache->cond, &cache->mutex, deadline) != ETIMEDOUT;
+}
+
+static void dir_cache_deadline(struct timespec *deadline, int ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+
+    deadline->tv_sec  += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000L;
+
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec  += 1;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Let go of the listings that haven't been looked up in a while. */
+static void dir_cache_sweep(yed_dir_cache *cache) {
+    tree_it(str_t, yed_dir_listing_ptr_t)   it;
+    yed_dir_listing                        *listing;
+    yed_dir_listing                       **lit;
+    array_t                                 old;
+    u64                                     now_us;
+
+    now_us = measure_time_now_us();
+
+    if (now_us - cache->swept_us < 1000ULL * DIR_CACHE_CHECK_MS) { return; }
+
+    cache->swept_us = now_us;
+
+    old = array_make(yed_dir_listing*);
+
+    tree_traverse(cache->listings, it) {
+        listing = tree_it_val(it);
+
+        /* A thread may be reading a queued one right now. */
+        if (!listing->queued && now_us - listing->used_us > 1000ULL * DIR_CACHE_EVICT_MS) {
+            array_push(old, listing);
+        }
+    }
+
+    array_traverse(old, lit) {
+        tree_delete(cache->listings, (*lit)->path);
+        dir_entries_free(&(*lit)->entries);
+        free((*lit)->path);
+        free(*lit);
+    }
+
+    array_free(old);
+}
+
+/* Lock the mutex, starting the threads first if they aren't running. */
+static yed_dir_cache *dir_cache_lock(void) {
+    yed_dir_cache *cache;
+    int            n_threads;
+    sigset_t       block;
+    sigset_t       sigs;
+
+    if ((cache = ys->dir_cache) == NULL) {
+        cache           = calloc(1, sizeof(*cache));
+        cache->listings = tree_make(str_t, yed_dir_listing_ptr_t);
+        cache->todo     = array_make(yed_dir_listing*);
+        cache->ignore   = array_make(char*);
+
+        pthread_mutex_init(&cache->mutex, NULL);
+        pthread_cond_init(&cache->cond, NULL);
+
+        ys->dir_cache = cache;
+    }
+
+    if (cache->n_threads == 0) {
+        /* Same as the worker threads: leave the asynchronous signals to the main thread. */
+        sigfillset(&block);
+        sigdelset(&block, SIGSEGV);
+        sigdelset(&block, SIGBUS);
+        sigdelset(&block, SIGFPE);
+        sigdelset(&block, SIGILL);
+        sigdelset(&block, SIGABRT);
+
+        pthread_sigmask(SIG_BLOCK, &block, &sigs);
+
+        /* They mostly wait on the file system, so have a couple even with one CPU. */
+        n_threads = MIN(MAX(yed_n_workers(), 2), MAX_WORKERS);
+
+        while (cache->n_threads < n_threads) {
+            if (pthread_create(cache->threads + cache->n_threads, NULL, dir_cache_thread, cache) != 0) {
+                break;
+            }
+            cache->n_threads += 1;
+        }
+
+        pthread_sigmask(SIG_SETMASK, &sigs, NULL);
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    dir_cache_sweep(cache);
+
+    return cache;
+}
+
+int yed_dir_cache_list(const char *path, array_t *names, int dirs_only) {
+    char             a_path[4096];
+    yed_dir_cache   *cache;
+    yed_dir_listing *listing;
+    struct timespec  deadline;
+    yed_dir_entry   *it;
+    char            *cpy;
+    int              ok;
+
+    dir_cache_abs_path(path, a_path);
+
+    cache   = dir_cache_lock();
+    listing = dir_cache_listing(cache, a_path);
+
+    dir_cache_refresh(cache, listing);
+
+    dir_cache_deadline(&deadline, DIR_CACHE_WAIT_MS);
+    while (listing->state == DIR_LISTING_NEW && dir_cache_wait(cache, &deadline));
+
+    ok = listing->state == DIR_LISTING_READY;
+
+    if (ok) {
+        array_traverse(listing->entries, it) {
+            if (!dirs_only || it->is_dir) {
+                cpy = strdup(it->name);
+                array_push(*names, cpy);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return ok;
+}
+
+/*
+ * path is only somewhere to put the subdirectories' paths, so that the stack doesn't need one per level.
+ * budget is how many more entries the walk may look at.
+ */
+static int dir_cache_walk_listing(yed_dir_cache *cache, yed_dir_listing *listing, char *rel, int rel_len, char *path, int *budget, array_t *paths) {
+    int              complete;
+    yed_dir_entry   *it;
+    int              len;
+    yed_dir_listing *child;
+    char            *cpy;
+
+    if (listing->state == DIR_LISTING_NEW) {
+        dir_cache_queue(cache, listing);
+        return 0;
+    }
+
+    dir_cache_refresh(cache, listing);
+
+    complete = 1;
+
+    array_traverse(listing->entries, it) {
+        if (*budget <= 0) { break; }
+        *budget -= 1;
+
+        if (dir_cache_is_ignored(cache, it->name)) { continue; }
+
+        len = strlen(it->name);
+        if (rel_len + len + 2 > 4096) { continue; }
+
+        memcpy(rel + rel_len, it->name, len);
+        rel[rel_len + len] = 0;
+
+        if (it->is_dir) {
+            if (it->is_link) { continue; }
+
+            snprintf(path, 4096, "%s/%s", strcmp(listing->path, "/") == 0 ? "" : listing->path, it->name);
+
+            child            = dir_cache_listing(cache, path);
+            child->recursive = 1;
+
+            rel[rel_len + len]     = '/';
+            rel[rel_len + len + 1] = 0;
+
+            if (!dir_cache_walk_listing(cache, child, rel, rel_len + len + 1, path, budget, paths)) {
+                complete = 0;
+            }
+        } else {
+            cpy = strdup(rel);
+            array_push(*paths, cpy);
+        }
+    }
+
+    return complete;
+}
+
+int yed_dir_cache_walk(const char *path, array_t *paths) {
+    char             a_path[4096];
+    array_t          ignore;
+    char            *ignore_var;
+    char            *word;
+    char            *save;
+    yed_dir_cache   *cache;
+    yed_dir_listing *root;
+    struct timespec  deadline;
+    char             rel[4096];
+    char             scratch[4096];
+    int              budget;
+    int              complete;
+
+    dir_cache_abs_path(path, a_path);
+
+    ignore = array_make(char*);
+    if ((ignore_var = yed_get_var("grep-ignore")) != NULL) {
+        ignore_var = strdup(ignore_var);
+        for (word = strtok_r(ignore_var, " ", &save); word != NULL; word = strtok_r(NULL, " ", &save)) {
+            word = strdup(word);
+            array_push(ignore, word);
+        }
+        free(ignore_var);
+    }
+
+    cache = dir_cache_lock();
+
+    free_string_array(cache->ignore);
+    cache->ignore = ignore;
+
+    root = dir_cache_listing(cache, a_path);
+
+    cache->budget = DIR_CACHE_MAX_FILES;
+
+    if (!root->recursive) {
+        root->recursive = 1;
+        dir_cache_queue(cache, root);
+    } else {
+        dir_cache_refresh(cache, root);
+    }
+
+    /* Let the threads read as much of the tree as they can first. */
+    dir_cache_deadline(&deadline, DIR_CACHE_WALK_WAIT_MS);
+    while ((array_len(cache->todo) > 0 || cache->n_busy > 0) && dir_cache_wait(cache, &deadline));
+
+    rel[0]   = 0;
+    budget   = DIR_CACHE_MAX_FILES;
+    complete = dir_cache_walk_listing(cache, root, rel, 0, scratch, &budget, paths);
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return complete;
+}
+
+u64 yed_dir_cache_generation(void) {
+    yed_dir_cache *cache;
+    u64            generation;
+
+    if ((cache = ys->dir_cache) == NULL) { return 0; }
+
+    pthread_mutex_lock(&cache->mutex);
+    generation = cache->generation;
+    pthread_mutex_unlock(&cache->mutex);
+
+    return generation;
+}
+
+void yed_stop_dir_cache(void) {
+    yed_dir_cache *cache;
+    void          *junk;
+    int            i;
+
+    if ((cache = ys->dir_cache) == NULL || cache->n_threads == 0) { return; }
+
+    pthread_mutex_lock(&cache->mutex);
+    cache->stop = 1;
+    pthread_cond_broadcast(&cache->cond);
+    pthread_mutex_unlock(&cache->mutex);
+
+    for (i = 0; i < cache->n_threads; i += 1) {
+        pthread_join(cache->threads[i], &junk);
+    }
+
+    /* What's still queued is picked up when they're started again. */
+    cache->n_threads = 0;
+    cache->stop      = 0;
+}
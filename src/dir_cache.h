@@ -0,0 +1,95 @@
+#ifndef __DIR_CACHE_H__
+#define __DIR_CACHE_H__
+
+/*
+ * Directory listings for file completion, kept by absolute path so that
+ * Tab doesn't have to read a directory again.
+ *
+ * Directories are read by a few threads of the cache's own, so a slow file
+ * system or a huge directory can't freeze the editor: a lookup waits at
+ * most DIR_CACHE_WAIT_MS for a listing that isn't there yet, and comes
+ * back without one if it takes longer. It will be there the next time.
+ * Whether an entry is a directory comes from d_type, with a stat() only for
+ * symbolic links and file systems that don't fill d_type in.
+ *
+ * A listing is read again when the directory's mtime changes. The threads
+ * check that at most once every DIR_CACHE_CHECK_MS per directory, when
+ * it's looked up, and the old listing is used until they're done. Listings
+ * that haven't been looked up in DIR_CACHE_EVICT_MS are let go of.
+ *
+ * yed_dir_cache_walk() lists every file under a directory from the same
+ * listings. The threads read the subdirectories as they find them, and the
+ * walk waits up to DIR_CACHE_WALK_WAIT_MS for them to finish. The threads
+ * stop going deeper once they have seen DIR_CACHE_MAX_FILES entries for a
+ * walk, and the walk stops after looking at that many, so a walk from the
+ * top of a huge tree costs no more than that. Like grep-files, it skips
+ * hidden files and directories, symbolic links to directories, and names
+ * that match the 'grep-ignore' variable.
+ */
+
+#define DIR_CACHE_WAIT_MS      (20)
+#define DIR_CACHE_WALK_WAIT_MS (100)
+#define DIR_CACHE_CHECK_MS     (1000)
+#define DIR_CACHE_EVICT_MS     (60000)
+#define DIR_CACHE_MAX_FILES    (200000) /* Most entries yed_dir_cache_walk() looks at. */
+
+#define DIR_LISTING_NEW    (0)
+#define DIR_LISTING_READY  (1)
+#define DIR_LISTING_FAILED (2)
+
+typedef struct {
+    char *name;
+    int   is_dir;  /* Including symbolic links to directories. */
+    int   is_link;
+} yed_dir_entry;
+
+typedef struct yed_dir_listing_t {
+    char            *path;
+    int              state;
+    int              queued;
+    int              recursive;  /* Read subdirectories too, for a walk. */
+    struct timespec  mtime;
+    u64              checked_us;
+    u64              used_us;
+    array_t          entries;    /* yed_dir_entry, sorted by name. */
+} yed_dir_listing;
+
+typedef yed_dir_listing *yed_dir_listing_ptr_t;
+
+use_tree_c(str_t, yed_dir_listing_ptr_t, strcmp);
+
+typedef struct yed_dir_cache_t {
+    pthread_mutex_t                      mutex;
+    pthread_cond_t                       cond;       /* Something was queued, or a listing was read. */
+    tree(str_t, yed_dir_listing_ptr_t)   listings;
+    array_t                              todo;       /* yed_dir_listing* */
+    int                                  n_busy;
+    array_t                              ignore;     /* char*, fnmatch() patterns, for walks. */
+    int                                  budget;     /* Entries the threads may still read for the last walk. */
+    u64                                  swept_us;
+    u64                                  generation;
+    int                                  stop;
+    pthread_t                            threads[MAX_WORKERS];
+    int                                  n_threads;
+} yed_dir_cache;
+
+/*
+ * Put the names of the entries in path (a directory) into names (char*,
+ * sorted), only those that are directories if dirs_only is set. Returns 0
+ * if it couldn't be read, or wasn't read in time.
+ */
+int yed_dir_cache_list(const char *path, array_t *names, int dirs_only);
+
+/*
+ * Put the paths of the files under path, relative to it, into paths
+ * (char*). Returns 0 if some directories weren't read in time, in which
+ * case paths has what was found so far.
+ */
+int yed_dir_cache_walk(const char *path, array_t *paths);
+
+/* Goes up whenever a listing is read for the first time or changes. */
+u64  yed_dir_cache_generation(void);
+
+void yed_stop_dir_cache(void);
+
+#endif
@@ -4,18 +4,34 @@ void yed_init_direct_draw(void) {
     ys->direct_draws = array_make(yed_direct_draw_t*);
 }
 
+static void _yed_insert_direct_draw(yed_direct_draw_t *dd) {
+    int                 idx;
+    yed_direct_draw_t **dit;
+
+    /* Keep the list sorted by z, placing dd after everything with the same z. */
+    idx = array_len(ys->direct_draws);
+    array_rtraverse(ys->direct_draws, dit) {
+        if ((*dit)->z <= dd->z) { break; }
+        idx -= 1;
+    }
+
+    array_insert(ys->direct_draws, idx, dd);
+}
+
 static yed_direct_draw_t * _yed_make_direct_draw(int row, int col, const char *string) {
     yed_direct_draw_t *dd;
     int                n_glyphs;
     int                width;
 
     dd                        = malloc(sizeof(*dd));
+    memset(dd, 0, sizeof(*dd));
     dd->row                   = MIN(row, ys->term_rows);
     dd->col                   = MIN(col, ys->term_cols);
     dd->len                   = strlen(string);
     dd->additional_attr_flags = 0;
     dd->string                = strdup(string);
     dd->live                  = 1;
+    dd->dirty                 = 1;
 
     yed_get_string_info(string, dd->len, &n_glyphs, &width);
 
@@ -23,7 +39,7 @@ static yed_direct_draw_t * _yed_make_direct_draw(int row, int col, const char *s
         dd->string[(ys->term_cols - dd->col) + 1] = 0;
     }
 
-    array_push(ys->direct_draws, dd);
+    _yed_insert_direct_draw(dd);
 
     return dd;
 }
@@ -47,41 +63,109 @@ yed_direct_draw_t * yed_direct_draw_style(int row, int col, int scomp, const cha
     return dd;
 }
 
+static void _yed_free_direct_draw(yed_direct_draw_t *dd) {
+    free(dd->string);
+    if (dd->cache_string != NULL) { free(dd->cache_string); }
+    if (dd->cache_under  != NULL) { free(dd->cache_under);  }
+    if (dd->cache_over   != NULL) { free(dd->cache_over);   }
+    free(dd);
+}
+
+static void _yed_composite_direct_draw(yed_direct_draw_t *dd, yed_attrs attrs) {
+    int              n_glyphs;
+    int              width;
+    int              n;
+    yed_screen_cell *cells;
+
+    if (dd->row < 1 || dd->row > ys->term_rows
+    ||  dd->col < 1 || dd->col > ys->term_cols) {
+        yed_set_cursor(dd->row, dd->col);
+        yed_set_attr(attrs);
+        yed_screen_print_over(dd->string);
+        return;
+    }
+
+    cells = ys->screen_update->cells + ((dd->row - 1) * ys->term_cols) + (dd->col - 1);
+
+    if (!dd->dirty
+    &&  dd->cache_row     == dd->row
+    &&  dd->cache_col     == dd->col
+    &&  dd->cache_string  != NULL
+    &&  strcmp(dd->cache_string, dd->string) == 0
+    &&  dd->cache_opacity == ys->screen_update->opacity
+    &&  ATTRS_EQ(dd->cache_attrs, attrs)
+    &&  dd->cache_n       <= ys->term_cols - dd->col + 1
+    &&  memcmp(dd->cache_under, cells, dd->cache_n * sizeof(*cells)) == 0) {
+
+        memcpy(cells, dd->cache_over, dd->cache_n * sizeof(*cells));
+        return;
+    }
+
+    yed_get_string_info(dd->string, strlen(dd->string), &n_glyphs, &width);
+    n = MIN(width, ys->term_cols - dd->col + 1);
+
+    dd->cache_under = realloc(dd->cache_under, MAX(n, 1) * sizeof(*cells));
+    dd->cache_over  = realloc(dd->cache_over,  MAX(n, 1) * sizeof(*cells));
+
+    memcpy(dd->cache_under, cells, n * sizeof(*cells));
+
+    yed_set_cursor(dd->row, dd->col);
+    yed_set_attr(attrs);
+    yed_screen_print_over(dd->string);
+
+    memcpy(dd->cache_over, cells, n * sizeof(*cells));
+
+    dd->cache_row     = dd->row;
+    dd->cache_col     = dd->col;
+    dd->cache_n       = n;
+    if (dd->cache_string != NULL) { free(dd->cache_string); }
+    dd->cache_string  = strdup(dd->string);
+    dd->cache_opacity = ys->screen_update->opacity;
+    dd->cache_attrs   = attrs;
+    dd->dirty         = 0;
+}
+
 void yed_do_direct_draws(void) {
     yed_event            event;
-    array_t              new;
     yed_direct_draw_t  **dit;
     yed_direct_draw_t   *dd;
     yed_attrs            attrs;
+    int                  i;
+    int                  j;
 
     memset(&event, 0, sizeof(event));
     event.kind = EVENT_PRE_DIRECT_DRAWS;
     yed_trigger_event(&event);
 
-    new = array_make(yed_direct_draw_t*);
+    /* Release killed draws, compacting the list in place. */
+    j = 0;
+    for (i = 0; i < array_len(ys->direct_draws); i += 1) {
+        dit = array_item(ys->direct_draws, i);
+        dd  = *dit;
+
+        if (dd->live) {
+            *(yed_direct_draw_t**)array_item(ys->direct_draws, j) = dd;
+            j += 1;
+        } else {
+            _yed_free_direct_draw(dd);
+        }
+    }
+    while (array_len(ys->direct_draws) > j) {
+        array_pop(ys->direct_draws);
+    }
 
     array_traverse(ys->direct_draws, dit) {
         dd = *dit;
 
-        if (dd->live) {
-            yed_set_cursor(dd->row, dd->col);
-            if (dd->scomp != -1) {
-                attrs = yed_get_active_style_scomp(dd->scomp);
-            } else {
-                attrs = dd->attrs;
-            }
-            attrs.flags |= dd->additional_attr_flags;
-            yed_set_attr(attrs);
-            yed_screen_print_over(dd->string);
-            array_push(new, dd);
+        if (dd->scomp != -1) {
+            attrs = yed_get_active_style_scomp(dd->scomp);
         } else {
-            free(dd->string);
-            free(dd);
+            attrs = dd->attrs;
         }
-    }
+        attrs.flags |= dd->additional_attr_flags;
 
-    array_free(ys->direct_draws);
-    ys->direct_draws = new;
+        _yed_composite_direct_draw(dd, attrs);
+    }
 
     memset(&event, 0, sizeof(event));
     event.kind = EVENT_POST_DIRECT_DRAWS;
@@ -90,3 +174,24 @@ void yed_do_direct_draws(void) {
 }
 
 void yed_kill_direct_draw(yed_direct_draw_t *dd) { dd->live = 0; }
+
+void yed_direct_draw_set_z(yed_direct_draw_t *dd, int z) {
+    int                 idx;
+    yed_direct_draw_t **dit;
+
+    if (dd->z == z) { return; }
+
+    idx = 0;
+    array_traverse(ys->direct_draws, dit) {
+        if (*dit == dd) {
+            array_delete(ys->direct_draws, idx);
+            break;
+        }
+        idx += 1;
+    }
+
+    dd->z = z;
+    _yed_insert_direct_draw(dd);
+}
+
+void yed_direct_draw_mark_dirty(yed_direct_draw_t *dd) { dd->dirty = 1; }
@@ -10,6 +10,25 @@ typedef struct {
     int        additional_attr_flags;
     char      *string;
     int        live;
+    int        z;
+    int        dirty;
+
+    /*
+     * Retained composite: the cells that were underneath the draw and the
+     * cells that resulted from drawing over them the last time that it was
+     * composited. If the same cells are underneath this time and nothing
+     * about the draw has changed, the result is copied instead of redrawn.
+     * cache_string is a copy of what was drawn, so that changes made to
+     * string in place are noticed.
+     */
+    int              cache_row;
+    int              cache_col;
+    int              cache_n;
+    yed_attrs        cache_attrs;
+    float            cache_opacity;
+    char            *cache_string;
+    yed_screen_cell *cache_under;
+    yed_screen_cell *cache_over;
 } yed_direct_draw_t;
 
 void yed_init_direct_draw(void);
@@ -17,5 +36,15 @@ yed_direct_draw_t * yed_direct_draw(int row, int col, yed_attrs attrs, const cha
 yed_direct_draw_t * yed_direct_draw_style(int row, int col, int scomp, const char *string);
 void yed_do_direct_draws(void);
 void yed_kill_direct_draw(yed_direct_draw_t *dd);
+/*
+ * Direct draws are composited in increasing z order (0 by default).
+ * Draws with the same z are composited in the order they were created.
+ */
+void yed_direct_draw_set_z(yed_direct_draw_t *dd, int z);
+/*
+ * Composite the draw again next time rather than reusing the last result.
+ * Changes to dd->string are noticed without this.
+ */
+void yed_direct_draw_mark_dirty(yed_direct_draw_t *dd);
 
 #endif
@@ -5,6 +5,8 @@ void yed_init_events(void) {
         ys->event_handlers[i] = array_make(yed_event_handler);
     }
 
+    ys->row_decorators = array_make(yed_row_decorator);
+
     yed_reload_default_event_handlers();
 }
 
@@ -15,15 +17,49 @@ void yed_reload_default_event_handlers(void) {
     for (i = 0; i < N_EVENTS; i += 1) {
         array_clear(ys->event_handlers[i]);
     }
+    array_clear(ys->row_decorators);
 
     h.kind = EVENT_LINE_PRE_DRAW;
     h.fn   = yed_search_line_handler;
     yed_add_event_handler(h);
+    yed_declare_row_decorator(yed_search_line_handler, yed_search_decoration_version);
+
+    h.kind = EVENT_STYLE_CHANGE;
+    h.fn   = yed_style_change_handler;
+    yed_add_event_handler(h);
 
     h.kind = EVENT_BUFFER_POST_MOD;
     h.fn   = yed_log_buff_mod_handler;
     yed_add_event_handler(h);
 
+    h.kind = EVENT_BUFFER_POST_MOD;
+    h.fn   = yed_search_index_buff_mod_handler;
+    yed_add_event_handler(h);
+
+    h.kind = EVENT_PRE_PUMP;
+    h.fn   = yed_search_index_pump_handler;
+    yed_add_event_handler(h);
+
+    h.kind = EVENT_BUFFER_PRE_MOD;
+    h.fn   = yed_word_index_pre_mod_handler;
+    yed_add_event_handler(h);
+
+    h.kind = EVENT_BUFFER_POST_MOD;
+    h.fn   = yed_word_index_post_mod_handler;
+    yed_add_event_handler(h);
+
+    h.kind = EVENT_PRE_PUMP;
+    h.fn   = yed_word_index_pump_handler;
+    yed_add_event_handler(h);
+
+    h.kind = EVENT_PRE_PUMP;
+    h.fn   = yed_search_files_pump_handler;
+    yed_add_event_handler(h);
+
+    h.kind = EVENT_KEY_PRESSED;
+    h.fn   = yed_search_results_key_handler;
+    yed_add_event_handler(h);
+
     h.kind = EVENT_KEY_POST_BIND;
     h.fn = yed_key_bind_handler;
     yed_add_event_handler(h);
@@ -57,6 +93,8 @@ void yed_add_event_handler(yed_event_handler handler) {
     array_push(ys->event_handlers[handler.kind], handler);
 }
 
+static void yed_undeclare_row_decorator(yed_event_handler_fn_t fn);
+
 void yed_delete_event_handler(yed_event_handler handler) {
     yed_event_handler *handler_it;
     int                i;
@@ -69,6 +107,77 @@ void yed_delete_event_handler(yed_event_handler handler) {
         }
         i += 1;
     }
+
+    if (handler.kind == EVENT_ROW_PRE_CLEAR
+    ||  handler.kind == EVENT_LINE_PRE_DRAW) {
+        yed_undeclare_row_decorator(handler.fn);
+    }
+}
+
+static yed_row_decorator * yed_find_row_decorator(yed_event_handler_fn_t fn) {
+    yed_row_decorator *it;
+
+    array_traverse(ys->row_decorators, it) {
+        if (it->fn == fn) { return it; }
+    }
+
+    return NULL;
+}
+
+void yed_declare_row_decorator(yed_event_handler_fn_t fn, yed_row_decoration_version_fn_t version_fn) {
+    yed_row_decorator *it;
+    yed_row_decorator  dec;
+
+    if ((it = yed_find_row_decorator(fn)) != NULL) {
+        it->version_fn = version_fn;
+        return;
+    }
+
+    dec.fn         = fn;
+    dec.version_fn = version_fn;
+    array_push(ys->row_decorators, dec);
+
+    yed_invalidate_row_caches();
+}
+
+static void yed_undeclare_row_decorator(yed_event_handler_fn_t fn) {
+    yed_row_decorator *it;
+    int                i;
+
+    i = 0;
+    array_traverse(ys->row_decorators, it) {
+        if (it->fn == fn) {
+            array_delete(ys->row_decorators, i);
+            yed_invalidate_row_caches();
+            break;
+        }
+        i += 1;
+    }
+}
+
+int yed_get_row_decoration_version(u64 *version_out) {
+    u64                 version;
+    int                 kinds[2] = { EVENT_ROW_PRE_CLEAR, EVENT_LINE_PRE_DRAW };
+    int                 i;
+    yed_event_handler  *handler_it;
+    yed_row_decorator  *dec;
+
+    version = ys->row_cache_generation;
+
+    for (i = 0; i < 2; i += 1) {
+        array_traverse(ys->event_handlers[kinds[i]], handler_it) {
+            if ((dec = yed_find_row_decorator(handler_it->fn)) == NULL) {
+                return 0;
+            }
+            if (dec->version_fn != NULL) {
+                version += dec->version_fn();
+            }
+        }
+    }
+
+    *version_out = version;
+
+    return 1;
 }
 
 void yed_trigger_event(yed_event *event) {
@@ -90,6 +90,7 @@ typedef enum {
     BUFF_MOD_INSERT_INTO_LINE,
     BUFF_MOD_DELETE_FROM_LINE,
     BUFF_MOD_CLEAR,
+    BUFF_MOD_SET_LINES, /* Rows row through last_row were each set, all at once. */
 
     N_BUFF_MOD_EVENTS,
 } yed_buff_mod_event;
@@ -102,7 +103,8 @@ typedef struct yed_event_t {
     union { int                 row;
             int                 new_row; };
     union { int                 col;
-            int                 new_col; };
+            int                 new_col;
+            int                 last_row; };
     yed_attrs                   row_base_attr;
     union { array_t             eline_attrs;
             array_t             highlight_lines_attrs; };
@@ -147,4 +149,22 @@ void yed_delete_event_handler(yed_event_handler handler);
 
 void yed_trigger_event(yed_event *event);
 
+/*
+ * Row decorators are EVENT_ROW_PRE_CLEAR/EVENT_LINE_PRE_DRAW handlers
+ * whose output depends only on the line's contents, its row, and
+ * whatever state is summarized by the version that version_fn returns.
+ * The version must increase whenever the decorations might change.
+ * Frames only reuse previously drawn rows when every row handler
+ * has been declared as a decorator.
+ */
+typedef u64 (*yed_row_decoration_version_fn_t)(void);
+
+typedef struct {
+    yed_event_handler_fn_t          fn;
+    yed_row_decoration_version_fn_t version_fn;
+} yed_row_decorator;
+
+void yed_declare_row_decorator(yed_event_handler_fn_t fn, yed_row_decoration_version_fn_t version_fn);
+int  yed_get_row_decoration_version(u64 *version_out);
+
 #endif
@@ -1,26 +1,385 @@
 void yed_init_search(void) {
-    ys->replace_markers       = array_make(array_t);
-    ys->replace_save_lines    = array_make(yed_line*);
-    ys->replace_working_lines = array_make(yed_line*);
+    ys->replace_rows          = array_make(int);
+    ys->replace_first_marker  = array_make(int);
+    ys->replace_markers       = array_make(int);
+    ys->replace_preview       = array_make(int);
+    ys->replace_save_lines    = array_make(array_t);
+    ys->replace_scratch       = array_make(char);
 }
 
 int search_can_move_cursor(void) {
     return yed_var_is_truthy("enable-search-cursor-move");
 }
 
+/*
+ * First match in line r that starts at a byte in [start, end) and ends
+ * before end, skipping one that sits right at (row, col).
+ */
+static int find_next_in_line(yed_search_pattern *pattern, yed_line *line, int r, int start, int end, int row, int col, int *col_out) {
+    char *line_data;
+    int   idx,
+          c;
+
+    line_data = array_data(line->chars);
+
+    while (end - start >= pattern->lit_len) {
+        idx = yed_search_pattern_find(pattern, line_data, array_len(line->chars), start, end, NULL);
+        if (idx < 0) { break; }
+
+        c = yed_line_idx_to_col(line, idx);
+
+        if (r != row || c != col) {
+            *col_out = c;
+            return 1;
+        }
+
+        start = idx + 1;
+    }
+
+    return 0;
+}
+
+/* Same as above, but the last match. */
+static int find_prev_in_line(yed_search_pattern *pattern, yed_line *line, int r, int end, int row, int col, int *col_out) {
+    char *line_data;
+    int   idx,
+          len,
+          c;
+
+    line_data = array_data(line->chars);
+
+    while (end >= pattern->lit_len) {
+        idx = yed_search_pattern_rfind(pattern, line_data, array_len(line->chars), end, &len);
+        if (idx < 0) { break; }
+
+        c = yed_line_idx_to_col(line, idx);
+
+        if (r != row || c != col) {
+            *col_out = c;
+            return 1;
+        }
+
+        /* Matches may overlap. */
+        end = idx + len - 1;
+    }
+
+    return 0;
+}
+
+/*
+ * With a finished index, only the rows that have matches need to be looked at.
+ * Rows are visited in the same order as the plain search below: the rest of
+ * the cursor's row, the rows after it, then around to the start of its row.
+ */
+static int find_next_indexed(yed_buffer *buff, yed_search_index *index, yed_search_pattern *pattern, int row, int col, int *row_out, int *col_out) {
+    yed_line *line;
+    int       r,
+              next,
+              wrapped,
+              c,
+              end;
+
+    line = yed_buff_get_line(buff, row);
+
+    if (yed_search_index_row_matches(buff, index, row) > 0
+    &&  find_next_in_line(pattern, line, row, yed_line_col_to_idx(line, col + 1), array_len(line->chars), row, col, &c)) {
+        *row_out = row;
+        *col_out = c;
+        return 1;
+    }
+
+    r       = row;
+    wrapped = 0;
+
+    while ((next = yed_search_index_next_row(index, r)) != 0) {
+        if (next <= r) {
+            if (wrapped) { break; }
+            wrapped = 1;
+        }
+        if (wrapped && next > row) { break; }
+
+        r    = next;
+        line = yed_buff_get_line(buff, r);
+        end  = r == row
+                ? yed_line_col_to_idx(line, col)
+                : (int)array_len(line->chars);
+
+        if (yed_search_index_row_matches(buff, index, r) > 0
+        &&  find_next_in_line(pattern, line, r, 0, end, row, col, &c)) {
+            *row_out = r;
+            *col_out = c;
+            return 1;
+        }
+
+        if (wrapped && r == row) { break; }
+    }
+
+    return 0;
+}
+
+static int find_prev_indexed(yed_buffer *buff, yed_search_index *index, yed_search_pattern *pattern, int row, int col, int *row_out, int *col_out) {
+    yed_line *line;
+    int       r,
+              prev,
+              wrapped,
+              c;
+
+    line = yed_buff_get_line(buff, row);
+
+    if (col > pattern->lit_len
+    &&  yed_search_index_row_matches(buff, index, row) > 0
+    &&  find_prev_in_line(pattern, line, row, yed_line_col_to_idx(line, col - 1), row, col, &c)) {
+        *row_out = row;
+        *col_out = c;
+        return 1;
+    }
+
+    r       = row;
+    wrapped = 0;
+
+    while ((prev = yed_search_index_prev_row(index, r)) != 0) {
+        if (prev >= r) {
+            if (wrapped) { break; }
+            wrapped = 1;
+        }
+        if (wrapped && prev < row) { break; }
+
+        r    = prev;
+        line = yed_buff_get_line(buff, r);
+
+        if (yed_search_index_row_matches(buff, index, r) > 0
+        &&  find_prev_in_line(pattern, line, r, array_len(line->chars), row, col, &c)) {
+            *row_out = r;
+            *col_out = c;
+            return 1;
+        }
+
+        if (wrapped && r == row) { break; }
+    }
+
+    return 0;
+}
+
+typedef struct {
+    yed_buffer         *buff;
+    yed_search_pattern *pattern;
+    int                 n_lines;
+    int                 first;     /* The row at offset 0. */
+    int                 n_rows;    /* How many rows, going forward or backward from first. */
+    int                 dir;
+    int                 base;      /* Offset of the first row of item 0 in this round. */
+    int                 hit_item;  /* The first item that found a match. */
+    int                 hit_rows[SEARCH_PARALLEL_MAX_ROUND];
+    int                 hit_cols[SEARCH_PARALLEL_MAX_ROUND];
+} find_parallel_args;
+
+/* Returns non-zero when the item is done: it found a match, or an earlier one did. */
+static int find_parallel_line(find_parallel_args *args, int item, yed_line *line, int r, int i) {
+    int c,
+        found,
+        hit;
+
+    /* An earlier chunk has a match, so this one doesn't matter. */
+    if ((i & 63) == 0 && __atomic_load_n(&args->hit_item, __ATOMIC_RELAXED) < item) { return 1; }
+
+    if (!line->visual_width) { return 0; }
+
+    found = args->dir > 0
+            ? find_next_in_line(args->pattern, line, r, 0, array_len(line->chars), 0, 0, &c)
+            : find_prev_in_line(args->pattern, line, r, array_len(line->chars), 0, 0, &c);
+
+    if (!found) { return 0; }
+
+    args->hit_rows[item] = r;
+    args->hit_cols[item] = c;
+
+    hit = __atomic_load_n(&args->hit_item, __ATOMIC_RELAXED);
+    while (item < hit
+    &&     !__atomic_compare_exchange_n(&args->hit_item, &hit, item, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    return 1;
+}
+
+/* n rows starting at r, without wrapping. */
+static int find_parallel_rows(find_parallel_args *args, int item, int r, int n) {
+    yed_line *line;
+    int       i;
+
+    i = 0;
+
+    if (args->dir > 0) {
+        bucket_array_traverse_from(args->buff->lines, line, r - 1) {
+            if (i == n) { break; }
+            if (find_parallel_line(args, item, line, r + i, i)) { return 1; }
+            i += 1;
+        }
+    } else {
+        bucket_array_rtraverse_from(args->buff->lines, line, r - 1) {
+            if (i == n) { break; }
+            if (find_parallel_line(args, item, line, r - i, i)) { return 1; }
+            i += 1;
+        }
+    }
+
+    return 0;
+}
+
+static void find_parallel_item(int item, int worker, void *_args) {
+    find_parallel_args *args;
+    int                 k,
+                        n,
+                        r,
+                        before_wrap;
+
+    args = _args;
+    k    = args->base + item * SEARCH_PARALLEL_CHUNK_ROWS;
+    n    = MIN(SEARCH_PARALLEL_CHUNK_ROWS, args->n_rows - k);
+
+    r = args->first + k * args->dir;
+    if      (r > args->n_lines) { r -= args->n_lines; }
+    else if (r < 1)             { r += args->n_lines; }
+
+    before_wrap = args->dir > 0 ? args->n_lines - r + 1 : r;
+
+    if (n <= before_wrap) {
+        find_parallel_rows(args, item, r, n);
+    } else if (!find_parallel_rows(args, item, r, before_wrap)) {
+        find_parallel_rows(args, item, args->dir > 0 ? 1 : args->n_lines, n - before_wrap);
+    }
+}
+
+/*
+ * The first match in n_rows rows, starting at first and going in direction dir
+ * (wrapping around the buffer). The buffer can't change while we look, since
+ * the main thread is either in yed_work_run() or right here between rounds.
+ */
+static int find_parallel(yed_buffer *buff, yed_search_pattern *pattern, int first, int n_rows, int dir, int *row_out, int *col_out) {
+    find_parallel_args args;
+    int                round;
+    int                n_items;
+
+    args.buff    = buff;
+    args.pattern = pattern;
+    args.n_lines = yed_buff_n_lines(buff);
+    args.first   = first;
+    args.n_rows  = n_rows;
+    args.dir     = dir;
+    args.base    = 0;
+
+    round = MIN(yed_n_workers(), SEARCH_PARALLEL_MAX_ROUND);
+
+    while (args.base < n_rows) {
+        n_items       = MIN(round, (n_rows - args.base + SEARCH_PARALLEL_CHUNK_ROWS - 1) / SEARCH_PARALLEL_CHUNK_ROWS);
+        args.hit_item = n_items;
+
+        yed_work_run(n_items, find_parallel_item, &args);
+
+        if (args.hit_item < n_items) {
+            *row_out = args.hit_rows[args.hit_item];
+            *col_out = args.hit_cols[args.hit_item];
+            return 1;
+        }
+
+        args.base += n_items * SEARCH_PARALLEL_CHUNK_ROWS;
+
+        /*
+         * Keys that had already been read when the search started were typed
+         * before it, so they don't cancel it. Only what comes in now does.
+         */
+        if (args.base < n_rows && yed_input_arrived()) {
+            ys->search_cancelled = 1;
+            return 0;
+        }
+
+        round = MIN(round * 2, SEARCH_PARALLEL_MAX_ROUND);
+    }
+
+    return 0;
+}
+
+/* Same order as the plain search in yed_find_next(). */
+static int find_next_parallel(yed_buffer *buff, yed_search_pattern *pattern, int row, int col, int *row_out, int *col_out) {
+    yed_line *line;
+    int       n_lines,
+              c;
+
+    n_lines = yed_buff_n_lines(buff);
+
+    if (row > n_lines) {
+        return find_parallel(buff, pattern, 1, n_lines, 1, row_out, col_out);
+    }
+
+    line = yed_buff_get_line(buff, row);
+
+    if (line->visual_width
+    &&  find_next_in_line(pattern, line, row, yed_line_col_to_idx(line, col + 1), array_len(line->chars), row, col, &c)) {
+        *row_out = row;
+        *col_out = c;
+        return 1;
+    }
+
+    if (find_parallel(buff, pattern, row % n_lines + 1, n_lines - 1, 1, row_out, col_out)) {
+        return 1;
+    }
+
+    if (ys->search_cancelled) { return 0; }
+
+    if (line->visual_width
+    &&  find_next_in_line(pattern, line, row, 0, yed_line_col_to_idx(line, col), row, col, &c)) {
+        *row_out = row;
+        *col_out = c;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Same order as the plain search in yed_find_prev(). */
+static int find_prev_parallel(yed_buffer *buff, yed_search_pattern *pattern, int row, int col, int *row_out, int *col_out) {
+    yed_line *line;
+    int       n_lines,
+              c;
+
+    n_lines = yed_buff_n_lines(buff);
+    line    = yed_buff_get_line(buff, row);
+
+    if (line->visual_width
+    &&  col > pattern->lit_len
+    &&  find_prev_in_line(pattern, line, row, yed_line_col_to_idx(line, col - 1), row, col, &c)) {
+        *row_out = row;
+        *col_out = c;
+        return 1;
+    }
+
+    if (find_parallel(buff, pattern, row > 1 ? row - 1 : n_lines, n_lines - 1, -1, row_out, col_out)) {
+        return 1;
+    }
+
+    if (ys->search_cancelled) { return 0; }
+
+    if (line->visual_width
+    &&  find_prev_in_line(pattern, line, row, array_len(line->chars), row, col, &c)) {
+        *row_out = row;
+        *col_out = c;
+        return 1;
+    }
+
+    return 0;
+}
+
 int yed_find_next(int row, int col, int *row_out, int *col_out) {
-    yed_frame  *frame;
-    yed_buffer *buff;
-    yed_line   *line;
-    char       *line_data,
-               *line_data_end,
-               *scan;
-    int         idx,
-                r,
-                c,
-                search_len,
-                data_len,
-                junk_row, junk_col;
+    yed_frame          *frame;
+    yed_buffer         *buff;
+    yed_line           *line;
+    yed_search_pattern *pattern;
+    yed_search_index   *index;
+    int                 r,
+                        c,
+                        start,
+                        end,
+                        junk_row, junk_col;
+
+    ys->search_cancelled = 0;
 
     if (!ys->current_search)    { return 0; }
     if (!ys->active_frame)      { return 0; }
@@ -38,9 +397,9 @@ int yed_find_next(int row, int col, int *row_out, int *col_out) {
         col_out  = &junk_col;
     }
 
-    search_len = strlen(ys->current_search);
+    pattern = yed_get_current_search_pattern();
 
-    if (!search_len)    { return 0; }
+    if (!pattern->len)    { return 0; }
 
     line = yed_buff_get_line(buff, row);
     if (col > line->visual_width) {
@@ -48,55 +407,35 @@ int yed_find_next(int row, int col, int *row_out, int *col_out) {
         col = 1;
     }
 
+    index = yed_buff_get_search_index(buff);
+    if (index != NULL
+    &&  row <= yed_buff_n_lines(buff)
+    &&  yed_search_index_is_complete(buff, index)) {
+        return find_next_indexed(buff, index, pattern, row, col, row_out, col_out);
+    }
+
+    if (yed_buff_n_lines(buff) >= SEARCH_PARALLEL_MIN_ROWS) {
+        return find_next_parallel(buff, pattern, row, col, row_out, col_out);
+    }
+
     r = row;
     bucket_array_traverse_from(buff->lines, line, r - 1) {
-        data_len = array_len(line->chars);
-
         if (!line->visual_width) {
             r += 1;
             continue;
         }
 
-        line_data     = scan = array_data(line->chars);
-        line_data_end = line_data + data_len;
+        start = 0;
+        end   = array_len(line->chars);
 
         if (r == row) {
-            scan += yed_line_col_to_idx(line, col + 1);
+            start = yed_line_col_to_idx(line, col + 1);
         }
 
-        if (yed_var_is_truthy("use-boyer-moore")) {
-            while (scan < line_data_end) {
-                idx = yed_boyer_moore(scan, line_data_end - scan,
-                                ys->current_search, search_len);
-                if (idx >= 0) {
-                    c = yed_line_idx_to_col(line, scan - line_data + idx);
-                    if (r != row || c != col) {
-                        *row_out = r;
-                        *col_out = c;
-                        return 1;
-                    }
-                    scan += idx + 1;
-                } else {
-                    break;
-                }
-            }
-        } else {
-            while (scan < line_data_end && line_data_end - scan >= search_len) {
-                if ((scan = strnstr(scan, ys->current_search, line_data_end - scan))) {
-                    idx = scan - line_data;
-                    c   = yed_line_idx_to_col(line, idx);
-
-                    if (r != row || c != col) {
-                        *row_out = r;
-                        *col_out = c;
-                        return 1;
-                    }
-
-                    scan += 1;
-                } else {
-                    break;
-                }
-            }
+        if (find_next_in_line(pattern, line, r, start, end, row, col, &c)) {
+            *row_out = r;
+            *col_out = c;
+            return 1;
         }
 
         r += 1;
@@ -104,53 +443,22 @@ int yed_find_next(int row, int col, int *row_out, int *col_out) {
 
     r = 1;
     bucket_array_traverse(buff->lines, line) {
-        data_len = array_len(line->chars);
-
         if (!line->visual_width) {
             r += 1;
             continue;
         }
 
-        line_data     = scan = array_data(line->chars);
-        line_data_end = line_data + array_len(line->chars);
+        start = 0;
+        end   = array_len(line->chars);
 
         if (r == row) {
-            line_data_end = line_data + yed_line_col_to_idx(line, col);
+            end = yed_line_col_to_idx(line, col);
         }
 
-        if (yed_var_is_truthy("use-boyer-moore")) {
-            while (scan < line_data_end) {
-                idx = yed_boyer_moore(scan, line_data_end - scan,
-                                ys->current_search, search_len);
-                if (idx >= 0) {
-                    c = yed_line_idx_to_col(line, scan - line_data + idx);
-                    if (r != row || c != col) {
-                        *row_out = r;
-                        *col_out = c;
-                        return 1;
-                    }
-                    scan += idx + 1;
-                } else {
-                    break;
-                }
-            }
-        } else {
-            while (scan < line_data_end && line_data_end - scan >= search_len) {
-                if ((scan = strnstr(scan, ys->current_search, line_data_end - scan))) {
-                    idx = scan - line_data;
-                    c   = yed_line_idx_to_col(line, idx);
-
-                    if (r != row || c != col) {
-                        *row_out = r;
-                        *col_out = c;
-                        return 1;
-                    }
-
-                    scan += 1;
-                } else {
-                    break;
-                }
-            }
+        if (find_next_in_line(pattern, line, r, start, end, row, col, &c)) {
+            *row_out = r;
+            *col_out = c;
+            return 1;
         }
 
         r += 1;
@@ -160,18 +468,17 @@ int yed_find_next(int row, int col, int *row_out, int *col_out) {
 }
 
 int yed_find_prev(int row, int col, int *row_out, int *col_out) {
-    yed_frame  *frame;
-    yed_buffer *buff;
-    yed_line   *line;
-    char       *line_data,
-               *line_data_end,
-               *scan;
-    int         idx,
-                r,
-                c,
-                search_len,
-                data_len,
-                junk_row, junk_col;
+    yed_frame          *frame;
+    yed_buffer         *buff;
+    yed_line           *line;
+    yed_search_pattern *pattern;
+    yed_search_index   *index;
+    int                 r,
+                        c,
+                        end,
+                        junk_row, junk_col;
+
+    ys->search_cancelled = 0;
 
     if (!ys->current_search)    { return 0; }
     if (!ys->active_frame)      { return 0; }
@@ -189,45 +496,40 @@ int yed_find_prev(int row, int col, int *row_out, int *col_out) {
         col_out  = &junk_col;
     }
 
-    search_len = strlen(ys->current_search);
+    pattern = yed_get_current_search_pattern();
+
+    if (!pattern->len)    { return 0; }
+
+    index = yed_buff_get_search_index(buff);
+    if (index != NULL && yed_search_index_is_complete(buff, index)) {
+        return find_prev_indexed(buff, index, pattern, row, col, row_out, col_out);
+    }
 
-    if (!search_len)    { return 0; }
+    if (yed_buff_n_lines(buff) >= SEARCH_PARALLEL_MIN_ROWS) {
+        return find_prev_parallel(buff, pattern, row, col, row_out, col_out);
+    }
 
     r = row;
     bucket_array_rtraverse_from(buff->lines, line, r - 1) {
-        data_len = array_len(line->chars);
-
         if (!line->visual_width) {
             r -= 1;
             continue;
         }
 
-        line_data     = array_data(line->chars);
-        line_data_end = line_data + data_len;
+        end = array_len(line->chars);
 
         if (r == row) {
-            if (col <= search_len) {
+            if (col <= pattern->lit_len) {
                 r -= 1;
                 continue;
             }
-            line_data_end = line_data + yed_line_col_to_idx(line, col - 1);
+            end = yed_line_col_to_idx(line, col - 1);
         }
 
-        while (line_data < line_data_end && line_data_end - line_data >= search_len) {
-            if ((scan = last_strnstr(line_data, ys->current_search, line_data_end - line_data))) {
-                idx = scan - line_data;
-                c   = yed_line_idx_to_col(line, idx);
-
-                if (r != row || c != col) {
-                    *row_out = r;
-                    *col_out = c;
-                    return 1;
-                }
-
-                line_data_end = scan;
-            } else {
-                break;
-            }
+        if (find_prev_in_line(pattern, line, r, end, row, col, &c)) {
+            *row_out = r;
+            *col_out = c;
+            return 1;
         }
 
         r -= 1;
@@ -235,31 +537,17 @@ int yed_find_prev(int row, int col, int *row_out, int *col_out) {
 
     r = bucket_array_len(buff->lines);
     bucket_array_rtraverse_from(buff->lines, line, r - 1) {
-        data_len = array_len(line->chars);
-
         if (!line->visual_width) {
             r -= 1;
             continue;
         }
 
-        line_data     = array_data(line->chars);
-        line_data_end = line_data + data_len;
-
-        while (line_data < line_data_end && line_data_end - line_data >= search_len) {
-            if ((scan = last_strnstr(line_data, ys->current_search, line_data_end - line_data))) {
-                idx = scan - line_data;
-                c   = yed_line_idx_to_col(line, idx);
+        end = array_len(line->chars);
 
-                if (r != row || c != col) {
-                    *row_out = r;
-                    *col_out = c;
-                    return 1;
-                }
-
-                line_data_end = scan;
-            } else {
-                break;
-            }
+        if (find_prev_in_line(pattern, line, r, end, row, col, &c)) {
+            *row_out = r;
+            *col_out = c;
+            return 1;
         }
 
         r -= 1;
@@ -1,8 +1,21 @@
 #ifndef __FIND_H__
 #define __FIND_H__
 
+/*
+ * Buffers with at least SEARCH_PARALLEL_MIN_ROWS rows that don't have a
+ * finished search index are searched by the worker threads, in chunks of
+ * SEARCH_PARALLEL_CHUNK_ROWS rows. Chunks are handed out in rounds that
+ * start small and get bigger, so that a match near the cursor is found
+ * without searching the whole buffer. If the terminal sends more input
+ * between rounds, the search gives up and ys->search_cancelled is set.
+ */
+#define SEARCH_PARALLEL_MIN_ROWS   (65536)
+#define SEARCH_PARALLEL_CHUNK_ROWS (4096)
+#define SEARCH_PARALLEL_MAX_ROUND  (MAX_WORKERS * 16)
+
 void yed_init_search(void);
 void yed_search_line_handler(yed_event *event);
+u64 yed_search_decoration_version(void);
 int  yed_find_next(int row, int col, int *row_out, int *col_out);
 int  yed_find_prev(int row, int col, int *row_out, int *col_out);
 
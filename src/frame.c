@@ -100,12 +100,15 @@ yed_frame * yed_new_frame(float top_f, float left_f, float height_f, float width
     frame->line_attrs      = array_make(yed_attrs);
     frame->gutter_glyphs   = array_make(char);
     frame->gutter_attrs    = array_make(yed_attrs);
+    frame->row_cache       = array_make(yed_frame_row_cache_entry);
 
     frame->tree = yed_frame_tree_add_root(frame);
 
     return frame;
 }
 
+static void frame_row_cache_free(yed_frame *frame);
+
 void yed_delete_frame(yed_frame *frame) {
     int             i;
     yed_frame      *new_active_frame, **frame_it;
@@ -172,6 +175,7 @@ void yed_delete_frame(yed_frame *frame) {
     array_free(frame->gutter_attrs);
     array_free(frame->gutter_glyphs);
     array_free(frame->line_attrs);
+    frame_row_cache_free(frame);
 
     if (frame->name != NULL) { free(frame->name); }
 
@@ -627,6 +631,20 @@ static int _yed_draw_line_combine_col_attrs(yed_frame *frame, array_t line_attrs
     return 1;
 }
 
+static yed_attrs frame_row_base_attr(yed_frame *frame, int row) {
+    if (frame == ys->active_frame
+    &&  frame->cursor_line == row
+    &&  !frame->buffer->has_selection
+    &&  yed_var_is_truthy("cursor-line")) {
+
+        return yed_active_style_get_cursor_line();
+    } else if (frame == ys->active_frame) {
+        return yed_active_style_get_active();
+    }
+
+    return yed_active_style_get_inactive();
+}
+
 void yed_frame_draw_line(yed_frame *frame, yed_line *line, int row, int y_offset, int x_offset) {
     yed_attrs  cur_attr, base_attr, sel_attr;
     int        col, n_col, first_idx, first_col, width_skip, col_off, width, n_bytes, i, nprint_glyph_pos;
@@ -639,17 +657,7 @@ void yed_frame_draw_line(yed_frame *frame, yed_line *line, int row, int y_offset
      * Determine what the baseline attributes of text should
      * look like.
      */
-    if (frame == ys->active_frame
-    &&  frame->cursor_line == row
-    &&  !frame->buffer->has_selection
-    &&  yed_var_is_truthy("cursor-line")) {
-
-        base_attr = yed_active_style_get_cursor_line();
-    } else if (frame == ys->active_frame) {
-        base_attr = yed_active_style_get_active();
-    } else {
-        base_attr = yed_active_style_get_inactive();
-    }
+    base_attr = frame_row_base_attr(frame, row);
 
 
     memset(&event, 0, sizeof(event));
@@ -909,18 +917,146 @@ void yed_frame_draw_fill(yed_frame *frame, int y_offset) {
     }
 }
 
+void yed_invalidate_row_caches(void) {
+    ys->row_cache_generation += 1;
+}
+
+static void frame_row_cache_free(yed_frame *frame) {
+    yed_frame_row_cache_entry *it;
+
+    array_traverse(frame->row_cache, it) {
+        array_free(it->cells);
+    }
+    array_free(frame->row_cache);
+}
+
+/*
+ * Rows are cached in a direct-mapped table indexed by buffer row,
+ * with twice as many slots as the frame is tall, so that scrolling
+ * doesn't evict the rows that are still on screen.
+ */
+static int frame_row_cache_prepare(yed_frame *frame, u64 *decoration_version) {
+    int                        n_slots;
+    yed_frame_row_cache_entry *it;
+    yed_frame_row_cache_entry  empty;
+
+    if (!yed_var_is_truthy("frame-row-cache"))                 { return 0; }
+    if (frame->top < 1 || frame->left < 1)                     { return 0; }
+    if (frame->top + frame->height - 1 > ys->term_rows)        { return 0; }
+    if (frame->left + frame->width - 1 > ys->term_cols)        { return 0; }
+    if (!yed_get_row_decoration_version(decoration_version))   { return 0; }
+
+    n_slots = 2 * frame->height;
+
+    if (array_len(frame->row_cache) != n_slots) {
+        array_traverse(frame->row_cache, it) {
+            array_free(it->cells);
+        }
+        array_clear(frame->row_cache);
+
+        memset(&empty, 0, sizeof(empty));
+        while (array_len(frame->row_cache) < n_slots) {
+            empty.cells = array_make(yed_screen_cell);
+            array_push(frame->row_cache, empty);
+        }
+    }
+
+    return 1;
+}
+
+static int frame_row_is_cacheable(yed_frame *frame, int row) {
+    int r1, c1, r2, c2;
+
+    if (frame != ys->active_frame) { return 1; }
+
+    /* Cursor-dependent decorations (like the search cursor) live here. */
+    if (row == frame->cursor_line) { return 0; }
+
+    if (frame->buffer->has_selection) {
+        yed_range_sorted_points(&frame->buffer->selection, &r1, &c1, &r2, &c2);
+        if (row >= r1 && row <= r2) { return 0; }
+    }
+
+    return 1;
+}
+
+static yed_frame_row_cache_entry * frame_row_cache_slot(yed_frame *frame, int row) {
+    return array_item(frame->row_cache, (row - 1) % array_len(frame->row_cache));
+}
+
+static yed_screen_cell * frame_row_screen_cells(yed_frame *frame, int y_offset) {
+    return ys->screen_update->cells
+           + ((frame->top + y_offset - 1) * ys->term_cols)
+           + (frame->left - 1);
+}
+
+static int frame_row_cache_blit(yed_frame *frame, yed_line *line, int row, int y_offset, int x_offset, u64 decoration_version) {
+    yed_frame_row_cache_entry *entry;
+    yed_attrs                  base_attr;
+
+    entry     = frame_row_cache_slot(frame, row);
+    base_attr = frame_row_base_attr(frame, row);
+
+    if (entry->buffer             != frame->buffer
+    ||  entry->row                != row
+    ||  entry->line_version       != line->version
+    ||  entry->decoration_version != decoration_version
+    ||  entry->is_active          != (frame == ys->active_frame)
+    ||  entry->x_offset           != x_offset
+    ||  entry->width              != frame->width
+    ||  entry->gutter_width       != frame->gutter_width
+    ||  array_len(entry->cells)   != frame->width
+    ||  !ATTRS_EQ(entry->base_attr, base_attr)) {
+
+        return 0;
+    }
+
+    memcpy(frame_row_screen_cells(frame, y_offset),
+           array_data(entry->cells),
+           frame->width * sizeof(yed_screen_cell));
+
+    return 1;
+}
+
+static void frame_row_cache_store(yed_frame *frame, yed_line *line, int row, int y_offset, int x_offset, u64 decoration_version) {
+    yed_frame_row_cache_entry *entry;
+
+    entry = frame_row_cache_slot(frame, row);
+
+    entry->buffer             = frame->buffer;
+    entry->row                = row;
+    entry->line_version       = line->version;
+    entry->decoration_version = decoration_version;
+    entry->base_attr          = frame_row_base_attr(frame, row);
+    entry->is_active          = frame == ys->active_frame;
+    entry->x_offset           = x_offset;
+    entry->width              = frame->width;
+    entry->gutter_width       = frame->gutter_width;
+
+    array_clear(entry->cells);
+    array_push_n(entry->cells, frame_row_screen_cells(frame, y_offset), frame->width);
+}
+
 void yed_frame_draw_buff(yed_frame *frame, yed_buffer *buff, int y_offset, int x_offset) {
     yed_line *line;
     int lines_drawn;
     int row;
+    int use_cache;
+    u64 decoration_version;
 
     yed_reset_attr();
 
     lines_drawn = 0;
+    use_cache   = frame_row_cache_prepare(frame, &decoration_version);
 
     row = y_offset + 1;
     bucket_array_traverse_from(buff->lines, line, y_offset) {
-        yed_frame_draw_line(frame, line, row, lines_drawn, x_offset);
+        if (!use_cache || !frame_row_is_cacheable(frame, row)) {
+            yed_frame_draw_line(frame, line, row, lines_drawn, x_offset);
+        } else if (!frame_row_cache_blit(frame, line, row, lines_drawn, x_offset, decoration_version)) {
+            yed_frame_draw_line(frame, line, row, lines_drawn, x_offset);
+            frame_row_cache_store(frame, line, row, lines_drawn, x_offset, decoration_version);
+        }
         yed_reset_attr();
 
         lines_drawn += 1;
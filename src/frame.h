@@ -5,6 +5,19 @@
 
 struct yed_event_t;
 
+typedef struct {
+    yed_buffer         *buffer;
+    int                 row;
+    u64                 line_version;
+    u64                 decoration_version;
+    yed_attrs           base_attr;
+    int                 is_active;
+    int                 x_offset;
+    int                 width;
+    int                 gutter_width;
+    array_t             cells;
+} yed_frame_row_cache_entry;
+
 typedef struct yed_frame_t {
     yed_frame_tree     *tree;
     yed_buffer         *buffer;
@@ -31,6 +44,7 @@ typedef struct yed_frame_t {
     array_t             gutter_glyphs;
     array_t             gutter_attrs;
     char               *name;
+    array_t             row_cache;
 } yed_frame;
 
 void yed_init_frames(void);
@@ -91,6 +105,13 @@ int yed_frame_line_to_y(yed_frame *frame, int row);
 
 int yed_frame_is_tree_root(yed_frame *frame);
 
+/*
+ * Forget every row that frames have cached from previous draws.
+ * Needed when something that row decorators can't know about changes
+ * how lines are drawn.
+ */
+void yed_invalidate_row_caches(void);
+
 yed_attrs * yed_eline_get_col_attrs(struct yed_event_t *event, int col);
 int yed_eline_set_col_attrs(struct yed_event_t *event, int col, yed_attrs *attrs);
 int yed_eline_combine_col_attrs(struct yed_event_t *event, int col, yed_attrs *attrs);
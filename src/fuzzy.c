@@ -0,0 +1,247 @@
+#include "fuzzy.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FUZZY_BLOCK (32)
+typedef __m256i fuzzy_vec;
+#define FUZZY_SPLAT(c)  _mm256_set1_epi8(c)
+#define FUZZY_LOAD(p)   _mm256_loadu_si256((const __m256i*)(p))
+#define FUZZY_EQ(a, b)  _mm256_cmpeq_epi8((a), (b))
+#define FUZZY_OR(a, b)  _mm256_or_si256((a), (b))
+#define FUZZY_MASK(a)   ((u32)_mm256_movemask_epi8(a))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FUZZY_BLOCK (16)
+typedef __m128i fuzzy_vec;
+#define FUZZY_SPLAT(c)  _mm_set1_epi8(c)
+#define FUZZY_LOAD(p)   _mm_loadu_si128((const __m128i*)(p))
+#define FUZZY_EQ(a, b)  _mm_cmpeq_epi8((a), (b))
+#define FUZZY_OR(a, b)  _mm_or_si128((a), (b))
+#define FUZZY_MASK(a)   ((u32)_mm_movemask_epi8(a))
+#endif
+
+/* Zero bytes after the last candidate, so that a block can be loaded from anywhere in one. */
+#define FUZZY_PAD (32)
+
+#define FUZZY_SCORE_MATCH       (16)
+#define FUZZY_SCORE_FIRST       (12) /* Extra for matching the first character. */
+#define FUZZY_SCORE_BOUNDARY    (8)
+#define FUZZY_SCORE_CONSECUTIVE (8)
+#define FUZZY_SCORE_GAP         (1)
+
+static inline int fuzzy_bit(unsigned char c) {
+    if (c >= 'a' && c <= 'z') { return c - 'a';       }
+    if (c >= 'A' && c <= 'Z') { return c - 'A';       }
+    if (c >= '0' && c <= '9') { return 26 + c - '0';  }
+    return 36 + c % 28;
+}
+
+static u64 fuzzy_mask(const char *s, int len) {
+    u64 mask;
+    int i;
+
+    mask = 0;
+    for (i = 0; i < len; i += 1) {
+        mask |= 1ull << fuzzy_bit(s[i]);
+    }
+
+    return mask;
+}
+
+void yed_fuzzy_set_make(yed_fuzzy_set *set, int n, char **strings, int skip) {
+    yed_fuzzy_candidate  cand;
+    int                  i;
+    int                  len;
+    char                *p;
+
+    set->candidates = array_make_with_cap(yed_fuzzy_candidate, n);
+    set->skip       = skip;
+    set->text_len   = 0;
+
+    for (i = 0; i < n; i += 1) {
+        set->text_len += strlen(strings[i]) + 1;
+    }
+
+    set->text = malloc(set->text_len + FUZZY_PAD);
+    memset(set->text + set->text_len, 0, FUZZY_PAD);
+
+    p = set->text;
+    for (i = 0; i < n; i += 1) {
+        len = strlen(strings[i]);
+        memcpy(p, strings[i], len + 1);
+
+        if (len >= skip) {
+            cand.off  = p - set->text;
+            cand.len  = len;
+            cand.mask = fuzzy_mask(p + skip, len - skip);
+            array_push(set->candidates, cand);
+        }
+
+        p += len + 1;
+    }
+}
+
+void yed_fuzzy_set_free(yed_fuzzy_set *set) {
+    free(set->text);
+    array_free(set->candidates);
+}
+
+int yed_fuzzy_query_make(yed_fuzzy_query *query, const char *str) {
+    int i;
+    int c;
+
+    query->len = strlen(str);
+
+    if (query->len >= FUZZY_MAX_QUERY) { return 0; }
+
+    query->icase = 1;
+    for (i = 0; i < query->len; i += 1) {
+        if (str[i] >= 'A' && str[i] <= 'Z') {
+            query->icase = 0;
+            break;
+        }
+    }
+
+    for (i = 0; i < query->len; i += 1) {
+        c              = (unsigned char)str[i];
+        query->str[i]  = c;
+        query->alt[i]  = (query->icase && c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+    }
+    query->str[query->len] = 0;
+
+    query->mask = fuzzy_mask(str, query->len);
+
+    return 1;
+}
+
+/* First i at or after start where text[i] is a or b, or -1. */
+static inline int fuzzy_find(const char *text, int len, int start, char a, char b) {
+    int        i;
+#ifdef FUZZY_BLOCK
+    fuzzy_vec  va, vb, v;
+    u32        mask;
+
+    va = FUZZY_SPLAT(a);
+    vb = FUZZY_SPLAT(b);
+
+    /* Blocks can run past len, into the next candidate or the padding. */
+    for (i = start; i < len; i += FUZZY_BLOCK) {
+        v    = FUZZY_LOAD(text + i);
+        mask = FUZZY_MASK(FUZZY_OR(FUZZY_EQ(v, va), FUZZY_EQ(v, vb)));
+
+        if (mask) {
+            i += __builtin_ctz(mask);
+            return i < len ? i : -1;
+        }
+    }
+#else
+    for (i = start; i < len; i += 1) {
+        if (text[i] == a || text[i] == b) { return i; }
+    }
+#endif
+
+    return -1;
+}
+
+static inline int fuzzy_is_boundary(const char *text, int i) {
+    char prev;
+
+    if (i == 0) { return 1; }
+
+    prev = text[i - 1];
+
+    return prev == '/' || prev == '-' || prev == '_' || prev == '.' || prev == ' '
+        || (prev >= 'a' && prev <= 'z' && text[i] >= 'A' && text[i] <= 'Z');
+}
+
+/* Returns 0 if text doesn't match. */
+static int fuzzy_score(yed_fuzzy_query *query, const char *text, int len, int *score) {
+    int pos[FUZZY_MAX_QUERY];
+    int i;
+    int j;
+    int last;
+
+    if (query->len == 0) {
+        *score = 0;
+        return 1;
+    }
+
+    /* The earliest the whole query can end... */
+    j = 0;
+    for (i = 0; i < query->len; i += 1) {
+        j = fuzzy_find(text, len, j, query->str[i], query->alt[i]);
+        if (j < 0) { return 0; }
+        j += 1;
+    }
+
+    /* ...and the latest it can start and still end there. */
+    last = query->len - 1;
+    j    = j - 1;
+    for (i = last; i >= 0; i -= 1) {
+        while (text[j] != query->str[i] && text[j] != query->alt[i]) { j -= 1; }
+        pos[i]  = j;
+        j      -= 1;
+    }
+
+    *score = -FUZZY_SCORE_GAP * (pos[last] - pos[0] + 1 - query->len);
+
+    for (i = 0; i < query->len; i += 1) {
+        *score += FUZZY_SCORE_MATCH;
+
+        if (fuzzy_is_boundary(text, pos[i])) {
+            *score += pos[i] == 0 ? FUZZY_SCORE_FIRST : FUZZY_SCORE_BOUNDARY;
+        }
+        if (i > 0 && pos[i - 1] == pos[i] - 1) {
+            *score += FUZZY_SCORE_CONSECUTIVE;
+        }
+    }
+
+    return 1;
+}
+
+static int fuzzy_match_cmp(const void *a, const void *b) {
+    const yed_fuzzy_match *ma;
+    const yed_fuzzy_match *mb;
+
+    ma = a;
+    mb = b;
+
+    if (ma->score != mb->score) { return mb->score - ma->score; }
+
+    return ma->idx - mb->idx;
+}
+
+static inline void fuzzy_try(yed_fuzzy_set *set, yed_fuzzy_query *query, int idx, array_t *out) {
+    yed_fuzzy_candidate *cand;
+    yed_fuzzy_match      match;
+
+    cand = array_item(set->candidates, idx);
+
+    if (query->mask & ~cand->mask) { return; }
+
+    if (fuzzy_score(query, set->text + cand->off + set->skip, cand->len - set->skip, &match.score)) {
+        match.idx = idx;
+        array_push(*out, match);
+    }
+}
+
+void yed_fuzzy_filter(yed_fuzzy_set *set, yed_fuzzy_query *query, array_t *in, array_t *out) {
+    yed_fuzzy_match *it;
+    int              i;
+
+    array_clear(*out);
+
+    if (in != NULL) {
+        array_traverse(*in, it) {
+            fuzzy_try(set, query, it->idx, out);
+        }
+    } else {
+        for (i = 0; i < array_len(set->candidates); i += 1) {
+            fuzzy_try(set, query, i, out);
+        }
+    }
+
+    if (query->len > 0) {
+        qsort(array_data(*out), array_len(*out), sizeof(yed_fuzzy_match), fuzzy_match_cmp);
+    }
+}
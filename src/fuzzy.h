@@ -0,0 +1,71 @@
+#ifndef __FUZZY_H__
+#define __FUZZY_H__
+
+/*
+ * Fuzzy matching for completions. A candidate matches a query if the
+ * query's characters appear in it in order, not necessarily next to each
+ * other: "bfdl" matches "buffer-delete". A query without capital letters
+ * ignores case.
+ *
+ * Matches are scored so that the best come first: every matched character
+ * counts, and more so when it starts a word (the start of the candidate,
+ * after one of "/-_. ", or a capital after a lowercase letter) or follows
+ * the previous match, and characters skipped between the first and last
+ * matched ones count against it. Ties keep the order the candidates were
+ * given in.
+ *
+ * The candidates are copied into one block of memory, each with a mask of
+ * the characters in it, so that most non-matches are thrown out with one
+ * AND, and the rest are scanned a SIMD block at a time (AVX2 or SSE2,
+ * whichever the library was built for) for each query character.
+ */
+
+#define FUZZY_MAX_QUERY (256)
+
+typedef struct {
+    int off;  /* Into yed_fuzzy_set.text. */
+    int len;
+    u64 mask;
+} yed_fuzzy_candidate;
+
+typedef struct {
+    char    *text;        /* The candidates, each followed by a NUL, and some padding after the last one. */
+    int      text_len;
+    int      skip;
+    array_t  candidates;  /* yed_fuzzy_candidate */
+} yed_fuzzy_set;
+
+typedef struct {
+    int idx;  /* Into yed_fuzzy_set.candidates. */
+    int score;
+} yed_fuzzy_match;
+
+typedef struct {
+    char str[FUZZY_MAX_QUERY];
+    char alt[FUZZY_MAX_QUERY]; /* The other case of each letter, if case is ignored. */
+    int  len;
+    int  icase;
+    u64  mask;
+} yed_fuzzy_query;
+
+/* Candidates are compared from byte skip on, so a common prefix can be left out. */
+void yed_fuzzy_set_make(yed_fuzzy_set *set, int n, char **strings, int skip);
+void yed_fuzzy_set_free(yed_fuzzy_set *set);
+
+/* Returns 0 if str is too long to be a query. */
+int  yed_fuzzy_query_make(yed_fuzzy_query *query, const char *str);
+
+/*
+ * Put the candidates that match query into out (yed_fuzzy_match), best
+ * first. If in isn't NULL, only the candidates in it (yed_fuzzy_match, as
+ * left in out by a previous call) are looked at, which is all that's
+ * needed when the query only got longer.
+ */
+void yed_fuzzy_filter(yed_fuzzy_set *set, yed_fuzzy_query *query, array_t *in, array_t *out);
+
+/* The whole candidate, including the skipped prefix. */
+static inline const char *yed_fuzzy_set_string(yed_fuzzy_set *set, int idx) {
+    return set->text + ((yed_fuzzy_candidate*)array_item(set->candidates, idx))->off;
+}
+
+#endif
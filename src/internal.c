@@ -297,11 +297,18 @@ const char *u8_to_s(u8 u) { return _u8_to_s[u]; }
 #include "event.c"
 #include "plugin.c"
 #include "boyer_moore.c"
+#include "search_pattern.c"
+#include "search_index.c"
+#include "word_index.c"
 #include "find.c"
+#include "search_files.c"
+#include "dir_cache.c"
+#include "replace.c"
 #include "var.c"
 #include "util.c"
 #include "style.c"
 #include "subproc.c"
+#include "fuzzy.c"
 #include "complete.c"
 #include "direct_draw.c"
 #include "frame_tree.c"
@@ -309,3 +316,4 @@ const char *u8_to_s(u8 u) { return _u8_to_s[u]; }
 #include "print_backtrace.c"
 #include "cmd_line.c"
 #include "status_line.c"
+#include "work.c"
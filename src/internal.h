@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <math.h>
 #include <pthread.h>
+#include <fnmatch.h>
 
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -161,6 +162,7 @@ int mk_wcwidth(wchar_t ucs);
 #include "buffer.h"
 #include "frame.h"
 #include "log.h"
+#include "fuzzy.h"
 #include "complete.h"
 #include "cmd_line.h"
 #include "command.h"
@@ -169,6 +171,9 @@ int mk_wcwidth(wchar_t ucs);
 #include "event.h"
 #include "plugin.h"
 #include "find.h"
+#include "search_pattern.h"
+#include "search_index.h"
+#include "word_index.h"
 #include "var.h"
 #include "util.h"
 #include "style.h"
@@ -177,6 +182,10 @@ int mk_wcwidth(wchar_t ucs);
 #include "version.h"
 #include "print_backtrace.h"
 #include "status_line.h"
+#include "work.h"
+#include "search_files.h"
+#include "dir_cache.h"
+#include "replace.h"
 
 typedef struct {
     array_t  files;
@@ -210,9 +219,12 @@ typedef struct yed_state_t {
                                  search_save_col;
     array_t                      search_hist;
     yed_cmd_line_readline_ptr_t  search_readline;
-    array_t                      replace_save_lines;
-    array_t                      replace_working_lines;
-    array_t                      replace_markers;
+    array_t                      replace_rows;         /* int: rows with a match. */
+    array_t                      replace_first_marker; /* int: where each row's matches start in replace_markers. */
+    array_t                      replace_markers;      /* int pairs: byte index and length of each match. */
+    array_t                      replace_preview;      /* int: rows (indices into replace_rows) showing the replacement. */
+    array_t                      replace_save_lines;   /* array_t of char: their text before that. */
+    array_t                      replace_scratch;
     int                          replace_count;
     yed_cmd_line_readline_ptr_t  replace_readline;
     array_t                      cmd_buff;
@@ -224,6 +236,8 @@ typedef struct yed_state_t {
     int                          cmd_prompt_compl_item;
     int                          cmd_prompt_compl_start_idx;
     int                          cmd_prompt_compl_string_len;
+    yed_completion_cache_entry   compl_cache[COMPL_CACHE_SIZE];
+    u64                          compl_cache_clock;
     int                          status;
     int                          tabw;
     tree(yed_command_name_t,
@@ -235,6 +249,8 @@ typedef struct yed_state_t {
     array_t                      plugin_dirs;
     yed_key_map_list            *keymap_list;
     array_t                      key_sequences;
+    yed_key_seq_trie             key_seq_trie;
+    yed_input_buff               input;
     int                          virt_key_counter;
     array_t                      released_virt_keys;
     yed_glyph                    mbyte;
@@ -273,6 +289,43 @@ typedef struct yed_state_t {
     yed_screen                  *screen_update;
     yed_screen                  *screen_render;
     int                          signal_pipe_fds[2];
+    u64                          line_version_counter;
+    u64                          row_cache_generation;
+    array_t                      row_decorators;
+    char                        *search_decoration_str;
+    u64                          search_decoration_version;
+    yed_search_pattern           search_pattern;
+    int                          search_cancelled;
+    struct yed_file_search_t    *file_search;
+    char                        *search_results_dir;
+    struct yed_word_table_t     *word_table;
+    struct yed_dir_cache_t      *dir_cache;
+    yed_screen_frame             screen_frames[N_SCREEN_FRAMES];
+    int                          screen_frame_back;
+    int                          screen_frame_front;
+    int                          screen_frame_middle;
+    u64                          screen_clear_count;
+    pthread_t                    render_thread_id;
+    pthread_mutex_t              render_mutex;
+    int                          render_thread_running;
+    int                          render_thread_stop;
+    int                          render_wake_fds[2];
+    yed_status_line_part         status_line_parts[N_STATUS_LINE_PARTS];
+    u64                          status_line_generation;
+    int                          workers_started;
+    int                          n_workers;
+    pthread_t                    worker_ids[MAX_WORKERS];
+    pthread_mutex_t              work_mutex;
+    pthread_cond_t               work_cond;
+    pthread_cond_t               work_done_cond;
+    u64                          work_generation;
+    int                          work_stop;
+    int                          work_busy;
+    yed_work_fn_t                work_fn;
+    void                        *work_arg;
+    int                          work_n_items;
+    int                          work_next_item;
+    int                          work_n_finished;
 } yed_state;
 
 extern yed_state *ys;
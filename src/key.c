@@ -1,21 +1,181 @@
 static int ctrl_h_is_bs;
 
+static void key_seq_trie_build(void);
+
 void yed_init_keys(void) {
     yed_add_key_map("global");
     ys->key_sequences        = array_make(yed_key_sequence);
+    ys->key_seq_trie.nodes   = array_make(yed_key_seq_node);
     ys->released_virt_keys   = array_make(int);
     ys->bracketed_paste_buff = array_make(char);
 
+    key_seq_trie_build();
+
     yed_set_default_key_bindings();
 }
 
+static inline u32 key_seq_hash(int node, int key) {
+    return ((u32)node * 2654435761u) ^ ((u32)key * 2246822519u);
+}
+
+int yed_key_sequence_step(int node, int key) {
+    yed_key_seq_trie *trie;
+    int               i;
+    int               idx;
+    yed_key_seq_node *n;
+
+    trie = &ys->key_seq_trie;
+
+    for (i = key_seq_hash(node, key) & (trie->cap - 1); (idx = trie->slots[i]) != -1; i = (i + 1) & (trie->cap - 1)) {
+        n = array_item(trie->nodes, idx);
+        if (n->parent == node && n->key == key) { return idx; }
+    }
+
+    return -1;
+}
+
+static void key_seq_trie_put(yed_key_seq_trie *trie, int idx) {
+    yed_key_seq_node *n;
+    int               i;
+
+    n = array_item(trie->nodes, idx);
+
+    for (i = key_seq_hash(n->parent, n->key) & (trie->cap - 1); trie->slots[i] != -1; i = (i + 1) & (trie->cap - 1));
+
+    trie->slots[i] = idx;
+}
+
+static void key_seq_trie_grow(yed_key_seq_trie *trie) {
+    int i;
+
+    free(trie->slots);
+
+    trie->cap   *= 2;
+    trie->slots  = malloc(trie->cap * sizeof(int));
+    memset(trie->slots, -1, trie->cap * sizeof(int));
+
+    /* Not the root: nothing leads to it. */
+    for (i = 1; i < array_len(trie->nodes); i += 1) {
+        key_seq_trie_put(trie, i);
+    }
+}
+
+static void key_seq_trie_add(yed_key_sequence *seq) {
+    yed_key_seq_trie *trie;
+    int               node;
+    int               next;
+    int               i;
+    yed_key_seq_node  new_node;
+    yed_key_seq_node *n;
+
+    trie = &ys->key_seq_trie;
+    node = KEY_SEQ_ROOT;
+
+    for (i = 0; i < seq->len; i += 1) {
+        next = yed_key_sequence_step(node, seq->keys[i]);
+
+        if (next == -1) {
+            new_node.parent     = node;
+            new_node.key        = seq->keys[i];
+            new_node.seq_key    = KEY_NULL;
+            new_node.n_children = 0;
+
+            array_push(trie->nodes, new_node);
+            next = array_len(trie->nodes) - 1;
+
+            ((yed_key_seq_node*)array_item(trie->nodes, node))->n_children += 1;
+
+            if (2 * array_len(trie->nodes) > trie->cap) {
+                key_seq_trie_grow(trie);
+            } else {
+                key_seq_trie_put(trie, next);
+            }
+        }
+
+        node = next;
+    }
+
+    /* If the same keys were added twice, the first one wins, like it always has. */
+    n = array_item(trie->nodes, node);
+    if (n->seq_key == KEY_NULL) {
+        n->seq_key = seq->seq_key;
+    }
+}
+
+static void key_seq_trie_build(void) {
+    yed_key_seq_trie *trie;
+    yed_key_seq_node  root;
+    yed_key_sequence *seq_it;
+
+    trie = &ys->key_seq_trie;
+
+    free(trie->slots);
+    array_clear(trie->nodes);
+
+    root.parent     = -1;
+    root.key        = KEY_NULL;
+    root.seq_key    = KEY_NULL;
+    root.n_children = 0;
+    array_push(trie->nodes, root);
+
+    trie->cap   = 64;
+    trie->slots = malloc(trie->cap * sizeof(int));
+    memset(trie->slots, -1, trie->cap * sizeof(int));
+
+    array_traverse(ys->key_sequences, seq_it) {
+        key_seq_trie_add(seq_it);
+    }
+}
+
+/*
+ * Like read(0, c, 1), but from ys->input, which is filled with as much as
+ * one read() will give when it's empty. That read() still waits for the
+ * terminal's timeout if nothing's there, which is what lets a lone ESC be
+ * told from the start of a sequence.
+ */
+static int input_read(char *c) {
+    yed_input_buff *in;
+    int             n;
+
+    in = &ys->input;
+
+    if (in->len == 0) {
+        in->start = 0;
+
+        n = read(0, in->data, INPUT_BUFF_SIZE);
+        if (n <= 0) { return 0; }
+
+        in->len = n;
+    }
+
+    *c         = in->data[in->start];
+    in->start += 1;
+    in->len   -= 1;
+
+    return 1;
+}
+
+int yed_input_arrived(void) {
+    struct pollfd pfd;
+
+    pfd.fd      = 0;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+int yed_input_pending(void) {
+    return ys->input.len > 0 || yed_input_arrived();
+}
+
 static int esc_timeout(int *input) {
     int  seq_key;
     char c;
 
     /* input[0] is ESC */
 
-    if (read(0, &c, 1) == 0) {
+    if (input_read(&c) == 0) {
         return 1;
     }
     input[1] = c;
@@ -33,7 +193,7 @@ static int esc_timeout(int *input) {
         return 2;
     }
 
-    if (read(0, &c, 1) == 0) {
+    if (input_read(&c) == 0) {
         return 2;
     }
     input[2] = c;
@@ -63,7 +223,7 @@ static int esc_sequence(int *input) {
     if (input[1] == '[') { /* ESC [ sequences. */
         if (input[2] >= '0' && input[2] <= '9') {
             /* Extended escape, read additional byte. */
-            if (read(0, &c, 1) == 0) {
+            if (input_read(&c) == 0) {
                 return 3;
             } else if (input[2] == '1') {
                 input[3] = c;
@@ -71,10 +231,10 @@ static int esc_sequence(int *input) {
                     input[0] = HOME_KEY;
                     return 1;
                 } else if (c == ';') {
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '3') {
-                        if (read(0, &c, 1) == 0) { return 5; }
+                        if (input_read(&c) == 0) { return 5; }
                         input[5] = c;
                         switch (c) {
                             case 'A':
@@ -92,7 +252,7 @@ static int esc_sequence(int *input) {
                         }
                         return 6;
                     } else if (c == '5') {
-                        if (read(0, &c, 1) == 0) { return 5; }
+                        if (input_read(&c) == 0) { return 5; }
                         input[5] = c;
                         switch (c) {
                             case 'A':
@@ -112,7 +272,7 @@ static int esc_sequence(int *input) {
                     }
                     return 5;
                 } else if (c == '5') {
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN5;
@@ -120,7 +280,7 @@ static int esc_sequence(int *input) {
                     }
                     return 5;
                 } else if (c == '7') {
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN6;
@@ -128,7 +288,7 @@ static int esc_sequence(int *input) {
                     }
                     return 5;
                 } else if (c == '8') {
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN7;
@@ -136,7 +296,7 @@ static int esc_sequence(int *input) {
                     }
                     return 5;
                 } else if (c == '9') {
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN8;
@@ -149,19 +309,19 @@ static int esc_sequence(int *input) {
                 if (c == '0') {
                     input[3] = c;
 
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
 
                     if (c == '~') {
                         input[0] = FN9;
                         return 1;
                     } else if (c == '0') {
-                        if (read(0, &c, 1) == 0) { return 5; }
+                        if (input_read(&c) == 0) { return 5; }
                         input[5] = c;
                         if (c == '~') { input[0] = _BRACKETED_PASTE_BEGIN; return 1; }
                         return 6;
                     } else if (c == '1') {
-                        if (read(0, &c, 1) == 0) { return 5; }
+                        if (input_read(&c) == 0) { return 5; }
                         input[5] = c;
                         if (c == '~') { input[0] = _BRACKETED_PASTE_END; return 1; }
                         return 6;
@@ -169,7 +329,7 @@ static int esc_sequence(int *input) {
                     return 5;
                 } else if (c == '1') {
                     input[3] = c;
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN10;
@@ -178,7 +338,7 @@ static int esc_sequence(int *input) {
                     return 5;
                 } else if (c == '3') {
                     input[3] = c;
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN11;
@@ -187,7 +347,7 @@ static int esc_sequence(int *input) {
                     return 5;
                 } else if (c == '4') {
                     input[3] = c;
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '~') {
                         input[0] = FN12;
@@ -209,16 +369,16 @@ static int esc_sequence(int *input) {
                 if (c == '7') {
                     input[3] = c;
 
-                    if (read(0, &c, 1) == 0) { return 4; }
+                    if (input_read(&c) == 0) { return 4; }
                     input[4] = c;
                     if (c == '3') {
-                        if (read(0, &c, 1) == 0) { return 5; }
+                        if (input_read(&c) == 0) { return 5; }
                         input[5] = c;
                         if (c == '6') {
-                            if (read(0, &c, 1) == 0) { return 6; }
+                            if (input_read(&c) == 0) { return 6; }
                             input[6] = c;
                             if (c == '3') {
-                                if (read(0, &c, 1) == 0) { return 7; }
+                                if (input_read(&c) == 0) { return 7; }
                                 input[7] = c;
                                 if (c == 'u') {
                                     input[0] = MENU_KEY;
@@ -249,7 +409,7 @@ static int esc_sequence(int *input) {
                     k = 0;
 
                     memset(buff, 0, sizeof(buff));
-                    for (i = 0; read(0, &c, 1) && c != ';'; i += 1) { buff[i] = c; }
+                    for (i = 0; input_read(&c) && c != ';'; i += 1) { buff[i] = c; }
                     buff[i] = 0;
                     b = s_to_i(buff);
 
@@ -261,12 +421,12 @@ static int esc_sequence(int *input) {
                     }
 
                     memset(buff, 0, sizeof(buff));
-                    for (i = 0; read(0, &c, 1) && c != ';'; i += 1) { buff[i] = c; }
+                    for (i = 0; input_read(&c) && c != ';'; i += 1) { buff[i] = c; }
                     buff[i] = 0;
                     x = s_to_i(buff);
 
                     memset(buff, 0, sizeof(buff));
-                    for (i = 0; read(0, &c, 1) && toupper(c) != 'M'; i += 1) { buff[i] = c; }
+                    for (i = 0; input_read(&c) && toupper(c) != 'M'; i += 1) { buff[i] = c; }
                     buff[i] = 0;
                     y = s_to_i(buff);
 
@@ -296,7 +456,7 @@ static int esc_sequence(int *input) {
     }
 
     if (input[1] == ESC) {
-        if (read(0, &c, 1)) {
+        if (input_read(&c)) {
             input[3] = c;
             if (input[2] == ESC && input[3] == ESC) { return 4; }
             return 1 + esc_sequence(input + 1);
@@ -309,11 +469,10 @@ static int esc_sequence(int *input) {
 int yed_read_key_sequences(int len, int *input) {
     int  seq_key,
          i,
-         found_a_partial_match,
          keep_reading;
     char c;
     int  new_key;
-    yed_key_sequence *seq_it;
+    int  node;
 
     if (len == 0) { return 0; }
 
@@ -323,6 +482,11 @@ int yed_read_key_sequences(int len, int *input) {
 
     len -= 1;
 
+    node = KEY_SEQ_ROOT;
+    for (i = 0; i < len && node != -1; i += 1) {
+        node = yed_key_sequence_step(node, input[i]);
+    }
+
     do {
         /* We have consumed a keystroke. */
         if (new_key == CTRL_H && ctrl_h_is_bs) {new_key = BACKSPACE; }
@@ -337,30 +501,17 @@ int yed_read_key_sequences(int len, int *input) {
         keep_reading  = 0;
 
         /*
-         * Should we consume another? See if there's
-         * a key sequence defined that matches the keys
-         * we have so far.
+         * Should we consume another? Only if there's a
+         * key sequence that starts with the keys we have
+         * so far and has more to it.
          */
-        array_traverse(ys->key_sequences, seq_it) {
-            /* Only if there's more in the sequence to read.. */
-            if (seq_it->len > len) {
-                found_a_partial_match = 1;
-                for (i = 0; i < len; i += 1) {
-                    if (seq_it->keys[i] != input[i]) {
-                        found_a_partial_match = 0;
-                        break;
-                    }
-                }
-
-                if (found_a_partial_match) {
-                    keep_reading = 1;
-                    break;
-                }
-            }
+        if (node != -1) {
+            node         = yed_key_sequence_step(node, new_key);
+            keep_reading = node != -1 && ((yed_key_seq_node*)array_item(ys->key_seq_trie.nodes, node))->n_children > 0;
         }
-    } while (keep_reading && read(0, &c, 1) && ((new_key = c), len < MAX_SEQ_LEN));
+    } while (keep_reading && input_read(&c) && ((new_key = c), len < MAX_SEQ_LEN));
 
-    seq_key = yed_get_key_sequence(len, input);
+    seq_key = node == -1 ? KEY_NULL : ((yed_key_seq_node*)array_item(ys->key_seq_trie.nodes, node))->seq_key;
 
     if (seq_key != KEY_NULL) {
         input[0] = seq_key;
@@ -385,7 +536,7 @@ int yed_read_mbyte_keys(char first_byte, int n_bytes) {
          * the caller that we could not get all of the bytes
          * that we needed.
          */
-        if (read(0, &c, 1) == 0) { return 0; }
+        if (input_read(&c) == 0) { return 0; }
 
         ys->mbyte.bytes[i] = c;
     }
@@ -414,18 +565,21 @@ static int _yed_read_keys(int *input) {
     pfds[1].events  = POLLIN;
     pfds[1].revents = 0;
 
-    status = poll(pfds, 2, 100 * TERM_DEFAULT_READ_TIMEOUT);
-    if (status <= 0) { return 0; }
+    /* Only wait when there's nothing left from the last read(). */
+    if (ys->input.len == 0) {
+        status = poll(pfds, 2, 100 * TERM_DEFAULT_READ_TIMEOUT);
+        if (status <= 0) { return 0; }
 
-    if (pfds[1].revents & POLLIN) {
-        while (read(ys->signal_pipe_fds[0], &sig, 1) > 0) {
-            yed_handle_signal(sig);
+        if (pfds[1].revents & POLLIN) {
+            while (read(ys->signal_pipe_fds[0], &sig, 1) > 0) {
+                yed_handle_signal(sig);
+            }
         }
-    }
 
-    if (!(pfds[0].revents & POLLIN)) { return 0; }
+        if (!(pfds[0].revents & POLLIN)) { return 0; }
+    }
 
-    nread = read(0, &c, 1);
+    nread = input_read(&c);
     if (nread <= 0) { return 0; }
 
 #if 0
@@ -603,6 +757,42 @@ void yed_feed_keys(int n, int *keys) {
     }
 }
 
+void yed_feed_keys_as_typed(int n, int *keys) {
+    int               i;
+    int               j;
+    int               node;
+    yed_key_seq_node *n_it;
+
+    i = 0;
+    while (i < n) {
+        /* Like typed keys, keys that make a sequence are taken as one, unless they're going to a command. */
+        if (ys->interactive_command || ys->doing_bracketed_paste) {
+            yed_take_key(keys[i]);
+            i += 1;
+            continue;
+        }
+
+        node = KEY_SEQ_ROOT;
+        n_it = NULL;
+        j    = i;
+        do {
+            node  = yed_key_sequence_step(node, keys[j]);
+            n_it  = node == -1 ? NULL : array_item(ys->key_seq_trie.nodes, node);
+            j    += 1;
+        } while (n_it != NULL && n_it->n_children > 0 && j < n);
+
+        if (n_it != NULL && n_it->seq_key != KEY_NULL) {
+            yed_take_key(n_it->seq_key);
+        } else {
+            for (; i < j; i += 1) {
+                yed_take_key(keys[i]);
+            }
+        }
+
+        i = j;
+    }
+}
+
 static yed_key_map *yed_get_key_map(const char *mapname) {
     yed_key_map_list *list;
 
@@ -984,38 +1174,21 @@ int yed_add_key_sequence(int len, int *keys) {
     seq.seq_key = yed_acquire_virt_key();
 
     array_push(ys->key_sequences, seq);
+    key_seq_trie_add(&seq);
 
     return seq.seq_key;
 }
 
 int yed_get_key_sequence(int len, int *keys) {
-    yed_key_sequence *seq_it;
-    int               i,
-                      found,
-                      good;
-
-    found = 0;
-    array_traverse(ys->key_sequences, seq_it) {
-        if (seq_it->len == len) {
-            good = 1;
-
-            for (i = 0; i < len; i += 1) {
-                if (seq_it->keys[i] != keys[i]) {
-                    good = 0;
-                    break;
-                }
-            }
+    int node;
+    int i;
 
-            if (good) {
-                found = 1;
-                break;
-            }
-        }
+    node = KEY_SEQ_ROOT;
+    for (i = 0; i < len; i += 1) {
+        if ((node = yed_key_sequence_step(node, keys[i])) == -1) { return KEY_NULL; }
     }
 
-    if (!found)    { return KEY_NULL; }
-
-    return seq_it->seq_key;
+    return ((yed_key_seq_node*)array_item(ys->key_seq_trie.nodes, node))->seq_key;
 }
 
 int yed_delete_key_sequence(int seq_key) {
@@ -1036,6 +1209,7 @@ int yed_delete_key_sequence(int seq_key) {
     if (!found)    { return 1; }
 
     array_delete(ys->key_sequences, i);
+    key_seq_trie_build();
     yed_release_virt_key(seq_key);
 
     return 0;
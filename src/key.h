@@ -117,12 +117,38 @@ enum {
     | 0x80000000)
 
 
+/*
+ * Bytes read from the terminal and not yet made into keys. Input is read
+ * as much as is there at a time, so a paste or a burst of keys costs one
+ * read() per INPUT_BUFF_SIZE bytes instead of one per byte, and keys are
+ * decoded from here.
+ */
+#define INPUT_BUFF_SIZE (65536)
+
+typedef struct {
+    char data[INPUT_BUFF_SIZE];
+    int  start;
+    int  len;
+} yed_input_buff;
+
+/*
+ * The pump takes all of the keys that are already there before it draws,
+ * but draws at least this often while they keep coming.
+ */
+#define INPUT_MAX_DRAIN_US (16000ULL)
+
 void yed_init_keys(void);
 
 int yed_read_keys(int *input);
+/* Whether there is input that can be read without waiting. */
+int yed_input_pending(void);
+/* Same, but only counting what the terminal has sent that isn't in ys->input yet. */
+int yed_input_arrived(void);
 void yed_take_key(int key);
 
 void yed_feed_keys(int n, int *keys);
+/* Like yed_feed_keys(), but keys that make up a key sequence are taken as that sequence's key, as if typed. */
+void yed_feed_keys_as_typed(int n, int *keys);
 
 typedef struct yed_key_binding_t {
     int    key;
@@ -162,12 +188,35 @@ typedef struct {
     int seq_key;
 } yed_key_sequence;
 
+/*
+ * The key sequences, as a trie, so that matching input against all of
+ * them takes one step per key: a node's children are found by hashing the
+ * node's index with the next key. Adding a sequence adds its nodes;
+ * deleting one builds the trie again from ys->key_sequences.
+ */
+typedef struct {
+    int parent;
+    int key;
+    int seq_key;    /* KEY_NULL if no sequence ends here. */
+    int n_children;
+} yed_key_seq_node;
+
+typedef struct {
+    array_t  nodes;  /* yed_key_seq_node, the root first. */
+    int     *slots;  /* Indices into nodes, -1 if empty. */
+    int      cap;
+} yed_key_seq_trie;
+
+#define KEY_SEQ_ROOT (0)
+
 int yed_is_key(int key);
 int yed_acquire_virt_key(void);
 void yed_release_virt_key(int key);
 
 int yed_add_key_sequence(int len, int *keys);
 int yed_get_key_sequence(int len, int *keys);
+/* The node reached from node with key, or -1 if no sequence goes that way. */
+int yed_key_sequence_step(int node, int key);
 int yed_delete_key_sequence(int seq_key);
 int yed_vadd_key_sequence(int len, ...);
 int yed_vget_key_sequence(int len, ...);
@@ -0,0 +1,221 @@
+#include "replace.h"
+
+void yed_replace_template_make(yed_replace_template *tmpl, const char *str) {
+    yed_replace_piece piece;
+    char              c;
+
+    tmpl->text      = array_make(char);
+    tmpl->pieces    = array_make(yed_replace_piece);
+    tmpl->max_group = 0;
+
+    piece.group = -1;
+    piece.off   = 0;
+    piece.len   = 0;
+
+    for (; *str; str += 1) {
+        c = *str;
+
+        if (c == '\\' && str[1] >= '0' && str[1] <= '9') {
+            if (piece.len) { array_push(tmpl->pieces, piece); }
+
+            piece.group = str[1] - '0';
+            piece.off   = 0;
+            piece.len   = 0;
+            array_push(tmpl->pieces, piece);
+
+            tmpl->max_group = MAX(tmpl->max_group, piece.group);
+
+            piece.group = -1;
+            piece.off   = array_len(tmpl->text);
+            str        += 1;
+            continue;
+        }
+
+        if (c == '\\' && str[1]) {
+            str += 1;
+            c    = *str == 't' ? '\t' : *str;
+        }
+
+        array_push(tmpl->text, c);
+        piece.len += 1;
+    }
+
+    if (piece.len) { array_push(tmpl->pieces, piece); }
+}
+
+void yed_replace_template_free(yed_replace_template *tmpl) {
+    array_free(tmpl->text);
+    array_free(tmpl->pieces);
+}
+
+void yed_replace_template_expand(yed_replace_template *tmpl, array_t *out, const char *text, int *groups) {
+    yed_replace_piece *piece;
+    int               *g;
+
+    array_traverse(tmpl->pieces, piece) {
+        if (piece->group < 0) {
+            array_push_n(*out, (char*)array_data(tmpl->text) + piece->off, piece->len);
+        } else {
+            g = groups + 2 * piece->group;
+            if (g[0] >= 0) {
+                array_push_n(*out, (char*)text + g[0], g[1] - g[0]);
+            }
+        }
+    }
+}
+
+typedef struct {
+    array_t text;   /* char: the new text of every edit, one after another. */
+    array_t edits;  /* yed_span_edit */
+    int     n_matches;
+} replace_chunk;
+
+typedef struct {
+    yed_buffer           *buff;
+    yed_search_pattern   *patterns;  /* One for each worker. */
+    yed_replace_template *tmpl;
+    int                   n_groups;
+    int                   r1;
+    int                   r2;
+    replace_chunk        *chunks;
+} replace_args;
+
+/* The part of the line from its first match to the end of its last one, replaced, goes on the end of chunk->text. */
+static void replace_line(replace_args *args, yed_search_pattern *pattern, replace_chunk *chunk, yed_line *line, int row) {
+    const char    *text;
+    int            len,
+                   start,
+                   idx,
+                   end,
+                   text_start,
+                   groups[2 * SEARCH_PATTERN_MAX_GROUPS];
+    yed_span_edit  edit;
+
+    len        = array_len(line->chars);
+    text       = len ? array_data(line->chars) : "";
+    start      = 0;
+    end        = -1;
+    text_start = array_len(chunk->text);
+
+    edit.row = row;
+    edit.idx = -1;
+
+    while (start <= len
+    &&     (idx = yed_search_pattern_find_groups(pattern, text, len, start, groups, args->n_groups)) >= 0) {
+        start = groups[1];
+
+        if (groups[1] == idx) {
+            /* Don't match the empty string right after another match, and don't find this one again. */
+            if (idx == len) { start = len + 1; }
+            else            { start += yed_get_glyph_len(*(yed_glyph*)(text + idx)); }
+
+            if (idx == end) { continue; }
+        }
+
+        if (edit.idx < 0) {
+            edit.idx = idx;
+        } else {
+            array_push_n(chunk->text, (char*)text + end, idx - end);
+        }
+
+        yed_replace_template_expand(args->tmpl, &chunk->text, text, groups);
+
+        end               = groups[1];
+        chunk->n_matches += 1;
+    }
+
+    if (edit.idx < 0) { return; }
+
+    edit.len      = end - edit.idx;
+    edit.text     = NULL;
+    edit.text_len = array_len(chunk->text) - text_start;
+
+    array_push(chunk->edits, edit);
+}
+
+static void replace_item(int item, int worker, void *_args) {
+    replace_args  *args;
+    replace_chunk *chunk;
+    yed_line      *line;
+    yed_span_edit *edit;
+    int            row,
+                   last,
+                   off;
+
+    args  = _args;
+    chunk = args->chunks + item;
+    row   = args->r1 + item * REPLACE_CHUNK_ROWS;
+    last  = MIN(row + REPLACE_CHUNK_ROWS - 1, args->r2);
+
+    bucket_array_traverse_from(args->buff->lines, line, row - 1) {
+        if (row > last) { break; }
+        replace_line(args, args->patterns + worker, chunk, line, row);
+        row += 1;
+    }
+
+    /* chunk->text won't move anymore. */
+    off = 0;
+    array_traverse(chunk->edits, edit) {
+        edit->text  = (char*)array_data(chunk->text) + off;
+        off        += edit->text_len;
+    }
+}
+
+int yed_replace_regex(yed_buffer *buff, yed_search_pattern *pattern, yed_replace_template *tmpl, int r1, int r2) {
+    replace_args   args;
+    int            n_items,
+                   n_workers,
+                   n_matches,
+                   i;
+    array_t        edits;
+    replace_chunk *chunk;
+
+    if (r1 > r2) { return 0; }
+
+    n_items   = (r2 - r1 + REPLACE_CHUNK_ROWS) / REPLACE_CHUNK_ROWS;
+    n_workers = n_items > 1 ? MAX(yed_n_workers(), 1) : 1;
+
+    args.buff     = buff;
+    args.tmpl     = tmpl;
+    args.n_groups = MIN(MAX(tmpl->max_group, yed_search_pattern_n_groups(pattern)) + 1, SEARCH_PATTERN_MAX_GROUPS);
+    args.r1       = r1;
+    args.r2       = r2;
+    args.patterns = malloc(n_workers * sizeof(yed_search_pattern));
+    args.chunks   = malloc(n_items * sizeof(replace_chunk));
+
+    args.patterns[0] = *pattern;
+    for (i = 1; i < n_workers; i += 1) {
+        yed_search_pattern_make(args.patterns + i, pattern->str, pattern->flags);
+    }
+
+    for (i = 0; i < n_items; i += 1) {
+        args.chunks[i].text      = array_make(char);
+        args.chunks[i].edits     = array_make(yed_span_edit);
+        args.chunks[i].n_matches = 0;
+    }
+
+    yed_work_run(n_items, replace_item, &args);
+
+    edits     = array_make(yed_span_edit);
+    n_matches = 0;
+    for (i = 0; i < n_items; i += 1) {
+        chunk = args.chunks + i;
+        array_push_n(edits, (yed_span_edit*)array_data(chunk->edits), array_len(chunk->edits));
+        n_matches += chunk->n_matches;
+    }
+
+    yed_buff_replace_spans(buff, array_data(edits), array_len(edits));
+
+    array_free(edits);
+    for (i = 0; i < n_items; i += 1) {
+        array_free(args.chunks[i].text);
+        array_free(args.chunks[i].edits);
+    }
+    for (i = 1; i < n_workers; i += 1) {
+        yed_search_pattern_free(args.patterns + i);
+    }
+    free(args.chunks);
+    free(args.patterns);
+
+    return n_matches;
+}
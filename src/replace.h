@@ -0,0 +1,39 @@
+#ifndef __REPLACE_H__
+#define __REPLACE_H__
+
+/*
+ * replace-regex: every match of a regex in a range of rows is replaced with
+ * a template, in which \0 is the whole match, \1 through \9 are its groups,
+ * \t is a tab and \\ is a backslash.
+ *
+ * The rows are split into chunks of REPLACE_CHUNK_ROWS that the worker
+ * threads work on, each with its own copy of the compiled regex (regexec()
+ * may lock a shared one), building the new text of every changed row into
+ * the chunk's own array. Only then is the buffer touched, with
+ * yed_buff_replace_spans(): one span undo action per row and one mod event
+ * for all of them.
+ */
+
+#define REPLACE_CHUNK_ROWS (4096)
+
+typedef struct {
+    int group;  /* -1 for literal text. */
+    int off;
+    int len;
+} yed_replace_piece;
+
+typedef struct {
+    array_t text;       /* char: the template's literal text, without the escapes. */
+    array_t pieces;     /* yed_replace_piece */
+    int     max_group;  /* The highest group used, or 0. */
+} yed_replace_template;
+
+void yed_replace_template_make(yed_replace_template *tmpl, const char *str);
+void yed_replace_template_free(yed_replace_template *tmpl);
+/* Append the template to out, with groups (start/end pairs) filled in from text. */
+void yed_replace_template_expand(yed_replace_template *tmpl, array_t *out, const char *text, int *groups);
+
+/* Returns the number of matches replaced in rows [r1, r2]. */
+int yed_replace_regex(yed_buffer *buff, yed_search_pattern *pattern, yed_replace_template *tmpl, int r1, int r2);
+
+#endif
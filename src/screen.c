@@ -1,43 +1,85 @@
 #include "screen.h"
 
 void yed_init_screen(void) {
+    pthread_mutexattr_t attr;
+
     ys->output_buffer = array_make_with_cap(char, 4 * ys->term_cols * ys->term_rows);
 
     ys->screen_update = &ys->screen1;
     ys->screen_render = &ys->screen2;
 
-    ys->screen_update->opacity = DEFAULT_FAKE_OPACITY;
+    yed_set_screen_opacity(DEFAULT_FAKE_OPACITY);
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ys->render_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
 
     yed_resize_screen();
+
+    if (yed_var_is_truthy("screen-render-thread")) {
+        yed_start_render_thread();
+    }
 }
 
-void yed_resize_screen(void) {
-    int              n_cells;
+static void reset_screen_cells(yed_screen *screen, int n_cells, int dirty) {
     int              n_bytes;
     yed_screen_cell *cell;
     int              i;
 
-    n_cells = ys->term_rows * ys->term_cols;
     n_bytes = n_cells * sizeof(yed_screen_cell);
 
-    ys->screen_update->cells = realloc(ys->screen_update->cells, n_bytes);
-    ys->screen_render->cells = realloc(ys->screen_render->cells, n_bytes);
+    screen->cells = realloc(screen->cells, n_bytes);
+    memset(screen->cells, 0, n_bytes);
+
+    if (dirty) {
+        cell = screen->cells;
+        for (i = 0; i < n_cells; i += 1) {
+            cell->dirty  = 1;
+            cell        += 1;
+        }
+    }
+}
+
+void yed_resize_screen(void) {
+    int n_cells;
 
-    memset(ys->screen_update->cells, 0, n_bytes);
-    memset(ys->screen_render->cells, 0, n_bytes);
+    n_cells = ys->term_rows * ys->term_cols;
 
-    cell = ys->screen_render->cells;
-    for (i = 0; i < n_cells; i += 1) {
-        cell->dirty  = 1;
-        cell        += 1;
+    reset_screen_cells(ys->screen_update, n_cells, 0);
+
+    /*
+     * While the render thread is running, it owns the render screen and
+     * will resize it itself when it sees a frame with new dimensions.
+     */
+    if (!ys->render_thread_running) {
+        reset_screen_cells(ys->screen_render, n_cells, 1);
     }
 }
 
 void yed_clear_screen(void) {
-    printf(TERM_RESET TERM_CURSOR_HOME TERM_CLEAR_SCREEN);
+    if (ys->render_thread_running) {
+        ys->screen_clear_count += 1;
+    } else {
+        printf(TERM_RESET TERM_CURSOR_HOME TERM_CLEAR_SCREEN);
+    }
     yed_resize_screen();
 }
 
+void yed_set_screen_opacity(float opacity) {
+    float alpha;
+    int   v;
+
+    ys->screen_update->opacity = opacity;
+
+    alpha = sqrt(sqrt(opacity));
+
+    for (v = 0; v < 256; v += 1) {
+        ys->screen_update->blend_over[v]  = (int)(alpha * v);
+        ys->screen_update->blend_under[v] = (int)((1.0 - alpha) * v);
+    }
+}
+
 __attribute__((always_inline))
 static inline void set_cellp(yed_screen_cell *cell, yed_glyph g) {
     cell->attrs = ys->screen_update->cur_attrs;
@@ -178,16 +220,9 @@ void yed_draw_background(void) {
     write_welcome();
 }
 
-void yed_diff_and_swap_screens(void) {
-    int              n_cells;
-    yed_screen_cell *ucell;
-    yed_screen_cell *rcell;
-    int              i;
-    int              dirty;
-
-    n_cells = ys->term_rows * ys->term_cols;
-    ucell   = ys->screen_update->cells;
-    rcell   = ys->screen_render->cells;
+static void diff_cells(yed_screen_cell *ucell, yed_screen_cell *rcell, int n_cells) {
+    int i;
+    int dirty;
 
     for (i = 0; i < n_cells; i += 1) {
         dirty =    (rcell->glyph.data != ucell->glyph.data)
@@ -201,14 +236,16 @@ void yed_diff_and_swap_screens(void) {
     }
 }
 
-void yed_render_screen(void) {
+void yed_diff_and_swap_screens(void) {
+    diff_cells(ys->screen_update->cells, ys->screen_render->cells, ys->term_rows * ys->term_cols);
+}
+
+static void render_cells(int rows, int cols, int cursor_y, int cursor_x, int show_cursor, int sync, int clear) {
     int              screen_dirty;
     yed_screen_cell *cell;
     int              row;
     int              col;
     char             buff[512];
-    int              cursor_x;
-    int              cursor_y;
     int              width;
     int              total_written;
     int              n;
@@ -217,21 +254,21 @@ void yed_render_screen(void) {
 
     array_clear(ys->output_buffer);
 
-    if (yed_var_is_truthy("screen-update-sync")) {
+    if (sync) {
         WR("\e[?2026h", strlen("\e[?2026h"));
     }
 
     screen_dirty = 0;
 
+    if (clear) {
+        WR(TERM_RESET TERM_CURSOR_HOME TERM_CLEAR_SCREEN, strlen(TERM_RESET TERM_CURSOR_HOME TERM_CLEAR_SCREEN));
+        screen_dirty = 1;
+    }
+
     /* Screen is "dirty" if the cursor has moved. */
-    if (ys->interactive_command != NULL) {
-        if (ys->screen_render->cur_x != ys->cmd_cursor_x
-        ||  ys->screen_render->cur_y != ys->term_rows) {
-            screen_dirty = 1;
-        }
-    } else if (ys->active_frame != NULL) {
-        if (ys->screen_render->cur_x != ys->active_frame->cur_x
-        ||  ys->screen_render->cur_y != ys->active_frame->cur_y) {
+    if (show_cursor) {
+        if (ys->screen_render->cur_x != cursor_x
+        ||  ys->screen_render->cur_y != cursor_y) {
             screen_dirty = 1;
         }
     }
@@ -246,8 +283,8 @@ void yed_render_screen(void) {
 
     cell = ys->screen_render->cells;
 
-    for (row = 1; row <= ys->term_rows; row += 1) {
-        for (col = 1; col <= ys->term_cols; col += 1) {
+    for (row = 1; row <= rows; row += 1) {
+        for (col = 1; col <= cols; col += 1) {
             if (cell->dirty && cell->glyph.data) {
                 screen_dirty = 1;
 
@@ -284,13 +321,7 @@ void yed_render_screen(void) {
         }
     }
 
-    if (ys->interactive_command != NULL) {
-        cursor_y = ys->term_rows;
-        cursor_x = ys->cmd_cursor_x;
-        WR(TERM_CURSOR_SHOW, strlen(TERM_CURSOR_SHOW));
-    } else if (ys->active_frame != NULL) {
-        cursor_y = ys->active_frame->cur_y;
-        cursor_x = ys->active_frame->cur_x;
+    if (show_cursor) {
         WR(TERM_CURSOR_SHOW, strlen(TERM_CURSOR_SHOW));
     } else {
         cursor_y = cursor_x = 1;
@@ -303,13 +334,14 @@ void yed_render_screen(void) {
         snprintf(buff, sizeof(buff), "\e[%d;%dH", cursor_y, cursor_x);
         WR(buff, strlen(buff));
 
-        if (yed_var_is_truthy("screen-update-sync")) {
+        if (sync) {
             WR("\e[?2026l", strlen("\e[?2026l"));
         }
 
         total_written = 0;
         while (total_written < array_len(ys->output_buffer)) {
             n = write(1, array_data(ys->output_buffer) + total_written, array_len(ys->output_buffer) - total_written);
+            if (n < 0 && errno == EINTR) { continue; }
             ASSERT(n > 0, "failed to write output");
             total_written += n;
         }
@@ -318,6 +350,223 @@ void yed_render_screen(void) {
 #undef WR
 }
 
+static int get_screen_cursor(int *cursor_y, int *cursor_x) {
+    if (ys->interactive_command != NULL) {
+        *cursor_y = ys->term_rows;
+        *cursor_x = ys->cmd_cursor_x;
+        return 1;
+    } else if (ys->active_frame != NULL) {
+        *cursor_y = ys->active_frame->cur_y;
+        *cursor_x = ys->active_frame->cur_x;
+        return 1;
+    }
+
+    *cursor_y = *cursor_x = 1;
+
+    return 0;
+}
+
+void yed_render_screen(void) {
+    int cursor_y;
+    int cursor_x;
+    int show_cursor;
+
+    show_cursor = get_screen_cursor(&cursor_y, &cursor_x);
+
+    render_cells(ys->term_rows, ys->term_cols,
+                 cursor_y, cursor_x, show_cursor,
+                 yed_var_is_truthy("screen-update-sync"), 0);
+}
+
+static void wake_render_thread(void) {
+    char c;
+    int  ret;
+
+    c   = 0;
+    ret = write(ys->render_wake_fds[1], &c, 1);
+    (void)ret;
+}
+
+static void publish_screen_frame(void) {
+    yed_screen_frame *frame;
+    int               n_cells;
+    int               old;
+
+    frame   = ys->screen_frames + ys->screen_frame_back;
+    n_cells = ys->term_rows * ys->term_cols;
+
+    if (frame->cap < n_cells) {
+        frame->cells = realloc(frame->cells, n_cells * sizeof(yed_screen_cell));
+        frame->cap   = n_cells;
+    }
+
+    memcpy(frame->cells, ys->screen_update->cells, n_cells * sizeof(yed_screen_cell));
+
+    frame->rows        = ys->term_rows;
+    frame->cols        = ys->term_cols;
+    frame->show_cursor = get_screen_cursor(&frame->cursor_y, &frame->cursor_x);
+    frame->sync        = yed_var_is_truthy("screen-update-sync");
+    frame->clear_count = ys->screen_clear_count;
+
+    /*
+     * Hand the frame off. Whatever was sitting in the middle slot (either a
+     * frame that the render thread already picked up and released or one
+     * that it never got to) becomes our next back frame.
+     */
+    old = __atomic_exchange_n(&ys->screen_frame_middle,
+                              ys->screen_frame_back | SCREEN_FRAME_FRESH,
+                              __ATOMIC_ACQ_REL);
+
+    ys->screen_frame_back = old & ~SCREEN_FRAME_FRESH;
+
+    wake_render_thread();
+}
+
+void yed_present_screen(void) {
+    if (ys->render_thread_running) {
+        publish_screen_frame();
+    } else {
+        yed_diff_and_swap_screens();
+        yed_render_screen();
+    }
+}
+
+static void render_screen_frame(yed_screen_frame *frame, int *rows, int *cols, u64 *clear_count) {
+    int clear;
+
+    clear = frame->clear_count != *clear_count;
+
+    if (clear || frame->rows != *rows || frame->cols != *cols) {
+        reset_screen_cells(ys->screen_render, frame->rows * frame->cols, 1);
+        *rows        = frame->rows;
+        *cols        = frame->cols;
+        *clear_count = frame->clear_count;
+    }
+
+    diff_cells(frame->cells, ys->screen_render->cells, frame->rows * frame->cols);
+
+    render_cells(frame->rows, frame->cols,
+                 frame->cursor_y, frame->cursor_x, frame->show_cursor,
+                 frame->sync, clear);
+}
+
+static void * render_thread(void *arg) {
+    int  rows;
+    int  cols;
+    u64  clear_count;
+    char junk[64];
+    int  n;
+    int  stop;
+    int  old;
+
+    (void)arg;
+
+    rows        = 0;
+    cols        = 0;
+    clear_count = ys->screen_clear_count;
+
+    for (;;) {
+        n    = read(ys->render_wake_fds[0], junk, sizeof(junk));
+        stop = __atomic_load_n(&ys->render_thread_stop, __ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ys->screen_frame_middle, __ATOMIC_ACQUIRE) & SCREEN_FRAME_FRESH) {
+            old = __atomic_exchange_n(&ys->screen_frame_middle,
+                                      ys->screen_frame_front,
+                                      __ATOMIC_ACQ_REL);
+
+            ys->screen_frame_front = old & ~SCREEN_FRAME_FRESH;
+
+            pthread_mutex_lock(&ys->render_mutex);
+            if (!ys->stopped) {
+                render_screen_frame(ys->screen_frames + ys->screen_frame_front,
+                                    &rows, &cols, &clear_count);
+            }
+            pthread_mutex_unlock(&ys->render_mutex);
+        }
+
+        if (stop || (n <= 0 && errno != EINTR)) { break; }
+    }
+
+    return NULL;
+}
+
+void yed_start_render_thread(void) {
+    int      pipe_ret;
+    int      fd_flags;
+    sigset_t block;
+    sigset_t save;
+
+    if (ys->render_thread_running) { return; }
+
+    pipe_ret = pipe(ys->render_wake_fds);
+    if (pipe_ret != 0) { return; }
+
+    fd_flags = fcntl(ys->render_wake_fds[1], F_GETFL);
+    fcntl(ys->render_wake_fds[1], F_SETFL, fd_flags | O_NONBLOCK);
+
+    ys->screen_frame_back   = 0;
+    ys->screen_frame_middle = 1;
+    ys->screen_frame_front  = 2;
+    ys->render_thread_stop  = 0;
+
+    /*
+     * Signal handlers (resize, suspend, etc.) expect to run on the main
+     * thread, so the render thread only takes the synchronous ones.
+     */
+    sigfillset(&block);
+    sigdelset(&block, SIGSEGV);
+    sigdelset(&block, SIGBUS);
+    sigdelset(&block, SIGFPE);
+    sigdelset(&block, SIGILL);
+    sigdelset(&block, SIGABRT);
+
+    pthread_sigmask(SIG_BLOCK, &block, &save);
+
+    if (pthread_create(&ys->render_thread_id, NULL, render_thread, NULL) == 0) {
+        ys->render_thread_running = 1;
+    } else {
+        close(ys->render_wake_fds[0]);
+        close(ys->render_wake_fds[1]);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &save, NULL);
+}
+
+void yed_stop_render_thread(void) {
+    void *junk;
+
+    if (!ys->render_thread_running) { return; }
+
+    __atomic_store_n(&ys->render_thread_stop, 1, __ATOMIC_RELEASE);
+    wake_render_thread();
+    pthread_join(ys->render_thread_id, &junk);
+
+    close(ys->render_wake_fds[0]);
+    close(ys->render_wake_fds[1]);
+
+    ys->render_thread_running = 0;
+
+    /*
+     * The render screen may not match the current dimensions anymore.
+     * Reset it so that the next synchronous render repaints everything.
+     */
+    yed_resize_screen();
+}
+
+int yed_render_thread_is_running(void) { return ys->render_thread_running; }
+
+void yed_render_lock(void) {
+    if (ys->render_thread_running) {
+        pthread_mutex_lock(&ys->render_mutex);
+    }
+}
+
+void yed_render_unlock(void) {
+    if (ys->render_thread_running) {
+        pthread_mutex_unlock(&ys->render_mutex);
+    }
+}
+
 __attribute__((always_inline))
 static inline void screen_print_n(const char *s, int n, int combine) {
     const char      *end;
@@ -330,15 +579,27 @@ static inline void screen_print_n(const char *s, int n, int combine) {
     float            opacity;
     int              transparent;
     int              i;
+    u8              *over;
+    u8              *under;
     int              br;
     int              bg;
     int              bb;
-    int              fr;
-    int              fg;
-    int              fb;
 
     end = s + n;
 
+    /*
+     * The attributes don't change over the course of the string, so the
+     * text's side of the blend only needs to be computed once.
+     */
+    opacity     = ys->screen_update->opacity;
+    transparent = opacity < 1.0 && opacity > 0 && combine && ATTR_BG_KIND(ys->screen_update->cur_attrs.flags) == ATTR_KIND_RGB;
+    save_attrs  = ys->screen_update->cur_attrs;
+    over        = ys->screen_update->blend_over;
+    under       = ys->screen_update->blend_under;
+    br          = over[RGB_32_r(save_attrs.bg) & 0xFF];
+    bg          = over[RGB_32_g(save_attrs.bg)];
+    bb          = over[RGB_32_b(save_attrs.bg)];
+
     while (s < end) {
         if (unlikely(   ys->screen_update->cur_y > ys->term_rows
                      || ys->screen_update->cur_x > ys->term_cols)) {
@@ -352,30 +613,19 @@ static inline void screen_print_n(const char *s, int n, int combine) {
         new_g = G(0);
         for (i = 0; i < len; i += 1) { new_g.bytes[i] = g->bytes[i]; }
 
-        opacity     = ys->screen_update->opacity;
-        transparent = opacity < 1.0 && opacity > 0 && combine && ATTR_BG_KIND(ys->screen_update->cur_attrs.flags) == ATTR_KIND_RGB;
-
         if (transparent) {
-            opacity                      = sqrt(sqrt(opacity));
-            cellp                        = get_cell(ys->screen_update->cur_y, ys->screen_update->cur_x);
-            save_attrs                   = ys->screen_update->cur_attrs;
-            ys->screen_update->cur_attrs = save_attrs;
-            br                           = (int)(opacity * RGB_32_r(save_attrs.bg));
-            bg                           = (int)(opacity * RGB_32_g(save_attrs.bg));
-            bb                           = (int)(opacity * RGB_32_b(save_attrs.bg));
+            cellp = get_cell(ys->screen_update->cur_y, ys->screen_update->cur_x);
 
             if (new_g.c == ' ') {
                 new_g = cellp->glyph;
-                fr                              = (int)((1.0 - opacity) * RGB_32_r(cellp->attrs.fg));
-                fg                              = (int)((1.0 - opacity) * RGB_32_g(cellp->attrs.fg));
-                fb                              = (int)((1.0 - opacity) * RGB_32_b(cellp->attrs.fg));
-                ys->screen_update->cur_attrs.fg = RGB_32(br + fr, bg + fg, bb + fb);
+                ys->screen_update->cur_attrs.fg = RGB_32(br + under[RGB_32_r(cellp->attrs.fg) & 0xFF],
+                                                         bg + under[RGB_32_g(cellp->attrs.fg)],
+                                                         bb + under[RGB_32_b(cellp->attrs.fg)]);
             }
 
-            fr                              = (int)((1.0 - opacity) * RGB_32_r(cellp->attrs.bg));
-            fg                              = (int)((1.0 - opacity) * RGB_32_g(cellp->attrs.bg));
-            fb                              = (int)((1.0 - opacity) * RGB_32_b(cellp->attrs.bg));
-            ys->screen_update->cur_attrs.bg = RGB_32(br + fr, bg + fg, bb + fb);
+            ys->screen_update->cur_attrs.bg = RGB_32(br + under[RGB_32_r(cellp->attrs.bg) & 0xFF],
+                                                     bg + under[RGB_32_g(cellp->attrs.bg)],
+                                                     bb + under[RGB_32_b(cellp->attrs.bg)]);
         }
 
         for (i = 0; i < width; i += 1) {
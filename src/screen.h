@@ -13,14 +13,58 @@ typedef struct {
     int              cur_x;
     yed_screen_cell *cells;
     float            opacity;
+    /*
+     * Fixed-point blend tables for the current opacity.
+     * blend_over[v] is the contribution of channel value v from text
+     * printed over the screen and blend_under[v] is the contribution of
+     * channel value v from the cell that it is printed over.
+     */
+    u8               blend_over[256];
+    u8               blend_under[256];
 } yed_screen;
 
+/*
+ * A snapshot of the update screen that the main thread hands off to the
+ * render thread. Three of these are rotated through so that neither side
+ * ever waits on the other: the main thread fills the back frame, swaps it
+ * into the middle slot, and the render thread swaps the newest middle frame
+ * out to draw it. Frames that the render thread doesn't get to in time are
+ * simply replaced by newer ones.
+ */
+typedef struct {
+    yed_screen_cell *cells;
+    int              cap;
+    int              rows;
+    int              cols;
+    int              cursor_y;
+    int              cursor_x;
+    int              show_cursor;
+    int              sync;
+    u64              clear_count;
+} yed_screen_frame;
+
+#define N_SCREEN_FRAMES    (3)
+#define SCREEN_FRAME_FRESH (0x4)
+
 void yed_init_screen(void);
 void yed_resize_screen(void);
 void yed_clear_screen(void);
+void yed_set_screen_opacity(float opacity);
 void yed_draw_background(void);
 void yed_diff_and_swap_screens(void);
 void yed_render_screen(void);
+void yed_present_screen(void);
+void yed_start_render_thread(void);
+void yed_stop_render_thread(void);
+int  yed_render_thread_is_running(void);
+/*
+ * Anything that writes to the terminal outside of the screen (escape
+ * sequences, subprocesses that take over the terminal, etc.) must do so
+ * between these calls so that it doesn't interleave with a frame that the
+ * render thread is writing. Calls may be nested.
+ */
+void yed_render_lock(void);
+void yed_render_unlock(void);
 void yed_screen_print(const char *s);
 void yed_screen_print_n(const char *s, int n);
 void yed_screen_print_over(const char *s);
@@ -0,0 +1,634 @@
+#include "search_files.h"
+
+typedef struct {
+    char *path;
+    int   is_dir;
+} search_files_item;
+
+yed_buffer *yed_get_search_results_buffer(void) {
+    yed_buffer *b;
+    b = yed_get_or_create_special_rdonly_buffer("*search-results");
+    b->flags |= BUFF_NO_MOD_EVENTS;
+    return b;
+}
+
+/* Relative paths in *search-results are relative to this, if it's set. */
+static void search_results_set_dir(const char *dir) {
+    if (ys->search_results_dir != NULL) { free(ys->search_results_dir); }
+    ys->search_results_dir = dir == NULL ? NULL : strdup(dir);
+}
+
+static void search_results_clear(void) {
+    yed_buffer *buff;
+
+    buff = yed_get_search_results_buffer();
+
+    buff->flags &= ~BUFF_RD_ONLY;
+    yed_buff_clear_no_undo(buff);
+    buff->flags |= BUFF_RD_ONLY;
+}
+
+/* Takes the lines in results (char*) and adds them to the end of *search-results. */
+static void search_results_add(array_t *results) {
+    yed_buffer  *buff;
+    char       **it;
+    int          row;
+
+    if (array_len(*results) == 0) { return; }
+
+    buff = yed_get_search_results_buffer();
+
+    buff->flags &= ~BUFF_RD_ONLY;
+
+    row = yed_buff_n_lines(buff);
+    if (yed_buff_get_line(buff, row)->visual_width > 0) { row += 1; }
+
+    array_traverse(*results, it) {
+        yed_buff_insert_string_no_undo(buff, *it, row, 1);
+        row += 1;
+        free(*it);
+    }
+
+    buff->flags |= BUFF_RD_ONLY;
+
+    array_clear(*results);
+}
+
+/*
+ * "path:row:col: text", with at most SEARCH_FILES_MAX_TEXT bytes of the
+ * line. Tabs become spaces, and a character that is cut off (or isn't
+ * valid UTF-8 to begin with) becomes '?', so that the line can go straight
+ * into a buffer.
+ */
+static char *search_result_line(const char *path, int row, int col, const char *text, int len) {
+    array_t    line;
+    char       head[64];
+    yed_glyph *g;
+    int        i;
+    int        n;
+    char       c;
+
+    line = array_make(char);
+
+    array_push_n(line, (char*)path, strlen(path));
+    snprintf(head, sizeof(head), ":%d:%d: ", row, col);
+    array_push_n(line, head, strlen(head));
+
+    if (len > SEARCH_FILES_MAX_TEXT) { len = SEARCH_FILES_MAX_TEXT; }
+
+    for (i = 0; i < len; i += n) {
+        g = (yed_glyph*)(void*)(text + i);
+        n = yed_get_glyph_len(*g);
+
+        if (n > 1 && i + n <= len) {
+            array_push_n(line, (char*)text + i, n);
+        } else {
+            c = text[i];
+            if      (c == '\t')            { c = ' '; }
+            else if (n > 1 || (c & 0x80)) { c = '?'; }
+            array_push(line, c);
+            n = 1;
+        }
+    }
+
+    array_zero_term(line);
+
+    return array_data(line);
+}
+
+/* Adds a line to results for every line of buff that has a match. */
+static int search_buffer_lines(yed_search_pattern *pattern, yed_buffer *buff, const char *name, array_t *results) {
+    yed_line *line;
+    int       row;
+    int       idx;
+    int       n;
+    char     *result;
+
+    row = 1;
+    n   = 0;
+
+    bucket_array_traverse(buff->lines, line) {
+        idx = yed_search_pattern_find(pattern, array_data(line->chars), array_len(line->chars), 0, array_len(line->chars), NULL);
+        if (idx >= 0) {
+            result = search_result_line(name, row, idx + 1, array_data(line->chars), array_len(line->chars));
+            array_push(*results, result);
+            n += 1;
+        }
+        row += 1;
+    }
+
+    return n;
+}
+
+void yed_find_in_buffers(const char *str) {
+    yed_search_pattern                            pattern;
+    array_t                                       results;
+    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)  it;
+    yed_buffer                                   *buff;
+    int                                           n_matches;
+    int                                           n_buffers;
+
+    yed_search_pattern_make(&pattern, str, yed_search_pattern_flags(str));
+
+    search_results_clear();
+    search_results_set_dir(NULL);
+
+    results   = array_make(char*);
+    n_matches = 0;
+    n_buffers = 0;
+
+    tree_traverse(ys->buffers, it) {
+        buff = tree_it_val(it);
+        if (buff->flags & BUFF_SPECIAL) { continue; }
+
+        n_matches += search_buffer_lines(&pattern, buff, buff->name, &results);
+        n_buffers += 1;
+    }
+
+    search_results_add(&results);
+    array_free(results);
+
+    yed_search_pattern_free(&pattern);
+
+    yed_cprint("%d matching lines in %d buffers", n_matches, n_buffers);
+}
+
+static const char *search_files_display_path(yed_file_search *fs, const char *path) {
+    int n;
+
+    n = strlen(fs->cwd);
+
+    if (strncmp(path, fs->cwd, n) == 0 && path[n] == '/') {
+        return path + n + 1;
+    }
+
+    return path;
+}
+
+static int search_files_is_ignored(yed_file_search *fs, const char *name) {
+    char **it;
+
+    if (name[0] == '.') { return 1; }
+
+    array_traverse(fs->ignore, it) {
+        if (fnmatch(*it, name, 0) == 0) { return 1; }
+    }
+
+    return 0;
+}
+
+static int search_files_strcmp(const void *a, const void *b) {
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+static void search_files_visit_dir(yed_file_search *fs, const char *path, array_t *children) {
+    DIR               *dir;
+    struct dirent     *ent;
+    struct stat        st;
+    search_files_item  child;
+    int                is_dir;
+    int                n;
+
+    if ((dir = opendir(path)) == NULL) { return; }
+
+    n = strlen(path);
+    if (n > 0 && path[n - 1] == '/') { n -= 1; }
+
+    while ((ent = readdir(dir)) != NULL) {
+        if (search_files_is_ignored(fs, ent->d_name)) { continue; }
+
+        child.path = malloc(n + 1 + strlen(ent->d_name) + 1);
+        memcpy(child.path, path, n);
+        child.path[n] = '/';
+        strcpy(child.path + n + 1, ent->d_name);
+
+        /* Most file systems tell us what it is, so it doesn't need a stat(). */
+        if (ent->d_type == DT_UNKNOWN) {
+            if (lstat(child.path, &st) != 0) { goto skip; }
+
+            if      (S_ISDIR(st.st_mode)) { is_dir = 1; }
+            else if (S_ISREG(st.st_mode)) { is_dir = 0; }
+            else                          { goto skip;  }
+        } else if (ent->d_type == DT_DIR) {
+            is_dir = 1;
+        } else if (ent->d_type == DT_REG) {
+            is_dir = 0;
+        } else {
+            goto skip;
+        }
+
+        child.is_dir = is_dir;
+        array_push(*children, child);
+        continue;
+
+skip:;
+        free(child.path);
+    }
+
+    closedir(dir);
+}
+
+/*
+ * Read the whole file into data. The file may be changing as we read it,
+ * so the length is what we got rather than what stat() said.
+ */
+static int search_files_read(int fd, int size, array_t *data) {
+    int len;
+    int n;
+
+    array_clear(*data);
+    array_grow_if_needed_to(*data, size);
+
+    len = 0;
+    while (len < size) {
+        n = read(fd, (char*)array_data(*data) + len, size - len);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0)                  { break;    }
+        len += n;
+    }
+
+    return len;
+}
+
+static void search_files_visit_file(yed_file_search *fs, const char *path, array_t *buff, array_t *results) {
+    int          fd;
+    struct stat  st;
+    const char  *data;
+    int          len;
+    int          start;
+    int          idx;
+    int          row;
+    const char  *nl;
+    int          line_end;
+    char        *result;
+
+    /* It's open, so it was searched from the buffer. */
+    if (bsearch(&path, array_data(fs->skip), array_len(fs->skip), sizeof(char*), search_files_strcmp) != NULL) {
+        return;
+    }
+
+    if ((fd = open(path, O_RDONLY)) == -1) { return; }
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > INT32_MAX) {
+        close(fd);
+        return;
+    }
+
+    len  = search_files_read(fd, st.st_size, buff);
+    data = array_data(*buff);
+    close(fd);
+
+    if (len == 0) { return; }
+
+    if (memchr(data, 0, MIN(len, SEARCH_FILES_BINARY_CHECK)) != NULL) { return; }
+
+    __atomic_fetch_add(&fs->n_files, 1, __ATOMIC_RELAXED);
+
+    start = 0;
+    row   = 1;
+
+    while (start < len
+    &&     !__atomic_load_n(&fs->stop, __ATOMIC_RELAXED)
+    &&     (idx = yed_search_pattern_find_in_lines(&fs->pattern, data, len, start, NULL)) >= 0) {
+
+        /* Count the lines on the way to the match. */
+        while ((nl = memchr(data + start, '\n', idx - start)) != NULL) {
+            start  = nl - data + 1;
+            row   += 1;
+        }
+
+        nl       = memchr(data + idx, '\n', len - idx);
+        line_end = nl == NULL ? len : nl - data;
+
+        result = search_result_line(search_files_display_path(fs, path), row, idx - start + 1, data + start, line_end - start);
+        array_push(*results, result);
+
+        start  = line_end + 1;
+        row   += 1;
+    }
+}
+
+static void * search_files_thread(void *arg) {
+    yed_file_search   *fs;
+    search_files_item  item;
+    search_files_item *it;
+    array_t            children;
+    array_t            results;
+    array_t            buff;
+    int                was_empty;
+
+    fs       = arg;
+    children = array_make(search_files_item);
+    results  = array_make(char*);
+    buff     = array_make(char);
+
+    pthread_mutex_lock(&fs->mutex);
+
+    for (;;) {
+        while (!fs->stop && array_len(fs->todo) == 0 && fs->n_busy > 0) {
+            pthread_cond_wait(&fs->cond, &fs->mutex);
+        }
+
+        /* Nothing left for anyone to do. */
+        if (fs->stop || array_len(fs->todo) == 0) { break; }
+
+        item = *(search_files_item*)array_last(fs->todo);
+        array_pop(fs->todo);
+        fs->n_busy += 1;
+
+        pthread_mutex_unlock(&fs->mutex);
+
+        if (item.is_dir) {
+            search_files_visit_dir(fs, item.path, &children);
+        } else {
+            search_files_visit_file(fs, item.path, &buff, &results);
+        }
+        free(item.path);
+
+        pthread_mutex_lock(&fs->mutex);
+
+        array_traverse(children, it) {
+            array_push(fs->todo, *it);
+        }
+        array_clear(children);
+
+        was_empty = array_len(fs->results) == 0;
+        array_push_n(fs->results, array_data(results), array_len(results));
+        fs->n_matches += array_len(results);
+
+        /* Wake up the main thread to add them to the buffer. */
+        if (was_empty && array_len(results) > 0) { yed_force_update(); }
+        array_clear(results);
+
+        fs->n_busy -= 1;
+        pthread_cond_broadcast(&fs->cond);
+    }
+
+    fs->n_running -= 1;
+    if (fs->n_running == 0) { yed_force_update(); }
+
+    pthread_cond_broadcast(&fs->cond);
+    pthread_mutex_unlock(&fs->mutex);
+
+    array_free(children);
+    array_free(results);
+    array_free(buff);
+
+    return NULL;
+}
+
+static void search_files_free(yed_file_search *fs) {
+    char              **it;
+    search_files_item  *item;
+
+    array_traverse(fs->skip, it)    { free(*it); }
+    array_traverse(fs->ignore, it)  { free(*it); }
+    array_traverse(fs->results, it) { free(*it); }
+    array_traverse(fs->todo, item)  { free(item->path); }
+
+    array_free(fs->skip);
+    array_free(fs->ignore);
+    array_free(fs->results);
+    array_free(fs->todo);
+
+    pthread_cond_destroy(&fs->cond);
+    pthread_mutex_destroy(&fs->mutex);
+
+    yed_search_pattern_free(&fs->pattern);
+    free(fs->cwd);
+    free(fs);
+}
+
+static void search_files_join(yed_file_search *fs) {
+    void *junk;
+    int   i;
+
+    for (i = 0; i < fs->n_threads; i += 1) {
+        pthread_join(fs->threads[i], &junk);
+    }
+}
+
+void yed_stop_grep_files(void) {
+    yed_file_search *fs;
+
+    if ((fs = ys->file_search) == NULL) { return; }
+
+    pthread_mutex_lock(&fs->mutex);
+    fs->stop = 1;
+    pthread_cond_broadcast(&fs->cond);
+    pthread_mutex_unlock(&fs->mutex);
+
+    search_files_join(fs);
+    search_files_free(fs);
+
+    ys->file_search = NULL;
+}
+
+int yed_grep_files(const char *str, const char *dir) {
+    char                                          a_path[4096];
+    struct stat                                   st;
+    yed_file_search                              *fs;
+    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)  it;
+    yed_buffer                                   *buff;
+    array_t                                       results;
+    int                                           n;
+    char                                         *ignore;
+    char                                         *word;
+    char                                         *save;
+    search_files_item                             item;
+    int                                           n_threads;
+    sigset_t                                      block;
+    sigset_t                                      sigs;
+
+    yed_stop_grep_files();
+
+    abs_path(dir, a_path);
+
+    if (stat(a_path, &st) != 0) { return errno; }
+
+    search_results_clear();
+    search_results_set_dir(ys->working_dir);
+
+    fs = calloc(1, sizeof(*fs));
+
+    yed_search_pattern_make(&fs->pattern, str, yed_search_pattern_flags(str));
+
+    fs->cwd      = strdup(ys->working_dir);
+    fs->skip     = array_make(char*);
+    fs->ignore   = array_make(char*);
+    fs->todo     = array_make(search_files_item);
+    fs->results  = array_make(char*);
+    fs->start_us = measure_time_now_us();
+
+    /* Open files are searched here and now, from their buffers. */
+    results = array_make(char*);
+    n       = strlen(a_path);
+
+    tree_traverse(ys->buffers, it) {
+        buff = tree_it_val(it);
+        if (buff->kind != BUFF_KIND_FILE || buff->path == NULL) { continue; }
+
+        if (strncmp(buff->path, a_path, n) == 0
+        &&  (buff->path[n] == '/' || buff->path[n] == 0 || n == 1)) {
+            fs->n_files   += 1;
+            fs->n_matches += search_buffer_lines(&fs->pattern, buff, search_files_display_path(fs, buff->path), &results);
+            word = strdup(buff->path);
+            array_push(fs->skip, word);
+        }
+    }
+
+    search_results_add(&results);
+    array_free(results);
+
+    qsort(array_data(fs->skip), array_len(fs->skip), sizeof(char*), search_files_strcmp);
+
+    if ((ignore = yed_get_var("grep-ignore")) != NULL) {
+        ignore = strdup(ignore);
+        for (word = strtok_r(ignore, " ", &save); word != NULL; word = strtok_r(NULL, " ", &save)) {
+            word = strdup(word);
+            array_push(fs->ignore, word);
+        }
+        free(ignore);
+    }
+
+    item.path   = strdup(a_path);
+    item.is_dir = S_ISDIR(st.st_mode);
+    array_push(fs->todo, item);
+
+    pthread_mutex_init(&fs->mutex, NULL);
+    pthread_cond_init(&fs->cond, NULL);
+
+    /* Same as the worker threads: leave the asynchronous signals to the main thread. */
+    sigfillset(&block);
+    sigdelset(&block, SIGSEGV);
+    sigdelset(&block, SIGBUS);
+    sigdelset(&block, SIGFPE);
+    sigdelset(&block, SIGILL);
+    sigdelset(&block, SIGABRT);
+
+    pthread_sigmask(SIG_BLOCK, &block, &sigs);
+
+    n_threads = MIN(yed_n_workers(), MAX_WORKERS);
+
+    pthread_mutex_lock(&fs->mutex);
+    while (fs->n_threads < n_threads) {
+        if (pthread_create(fs->threads + fs->n_threads, NULL, search_files_thread, fs) != 0) {
+            break;
+        }
+        fs->n_threads += 1;
+        fs->n_running += 1;
+    }
+    pthread_mutex_unlock(&fs->mutex);
+
+    pthread_sigmask(SIG_SETMASK, &sigs, NULL);
+
+    ys->file_search = fs;
+
+    if (fs->n_threads == 0) {
+        yed_stop_grep_files();
+        return EAGAIN;
+    }
+
+    return 0;
+}
+
+void yed_search_files_pump_handler(yed_event *event) {
+    yed_file_search *fs;
+    array_t          results;
+    int              running;
+
+    if ((fs = ys->file_search) == NULL) { return; }
+
+    pthread_mutex_lock(&fs->mutex);
+    results     = fs->results;
+    fs->results = array_make(char*);
+    running     = fs->n_running;
+    pthread_mutex_unlock(&fs->mutex);
+
+    search_results_add(&results);
+    array_free(results);
+
+    if (running) { return; }
+
+    LOG_CMD_ENTER("grep-files");
+    if (ys->interactive_command) {
+        yed_log("%d matching lines in %d files (%llums)", fs->n_matches, fs->n_files, (measure_time_now_us() - fs->start_us) / 1000);
+    } else {
+        yed_cprint("%d matching lines in %d files (%llums)", fs->n_matches, fs->n_files, (measure_time_now_us() - fs->start_us) / 1000);
+    }
+    LOG_EXIT();
+
+    search_files_join(fs);
+    search_files_free(fs);
+
+    ys->file_search = NULL;
+}
+
+int yed_search_results_jump(int row) {
+    yed_buffer *buff;
+    yed_line   *line;
+    char       *text;
+    char       *p;
+    char       *path;
+    char        full_path[4096];
+    int         r;
+    int         c;
+    int         n;
+
+    buff = yed_get_search_results_buffer();
+
+    if (row < 1 || row > yed_buff_n_lines(buff)) { return 0; }
+
+    line = yed_buff_get_line(buff, row);
+    text = strndup(array_data(line->chars), array_len(line->chars));
+
+    /* Paths can have colons in them, so look for the first ":row:col: " that follows one. */
+    for (p = strchr(text, ':'); p != NULL; p = strchr(p + 1, ':')) {
+        n = 0;
+        if (sscanf(p, ":%d:%d: %n", &r, &c, &n) == 2 && n > 0) { break; }
+    }
+
+    if (p == NULL || p == text) {
+        free(text);
+        return 0;
+    }
+
+    *p   = 0;
+    path = text;
+
+    /* The working directory may have changed since the search. */
+    if (path[0] != '/' && ys->search_results_dir != NULL) {
+        snprintf(full_path, sizeof(full_path), "%s/%s", ys->search_results_dir, path);
+        path = full_path;
+    }
+
+    YEXE("special-buffer-prepare-jump-focus", "*search-results");
+    YEXE("buffer", path);
+
+    free(text);
+
+    if (ys->active_frame == NULL || ys->active_frame->buffer == NULL) { return 0; }
+
+    buff = ys->active_frame->buffer;
+    if (r > yed_buff_n_lines(buff)) { r = yed_buff_n_lines(buff); }
+
+    line = yed_buff_get_line(buff, r);
+    if (c > array_len(line->chars) + 1) { c = array_len(line->chars) + 1; }
+
+    yed_set_cursor_within_frame(ys->active_frame, r, yed_line_idx_to_col(line, c - 1));
+
+    return 1;
+}
+
+void yed_search_results_key_handler(yed_event *event) {
+    if (event->key != ENTER
+    ||  ys->interactive_command
+    ||  ys->active_frame == NULL
+    ||  ys->active_frame->buffer != yed_get_search_results_buffer()) {
+        return;
+    }
+
+    yed_search_results_jump(ys->active_frame->cursor_line);
+
+    event->cancel = 1;
+}
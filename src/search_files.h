@@ -0,0 +1,58 @@
+#ifndef __SEARCH_FILES_H__
+#define __SEARCH_FILES_H__
+
+/*
+ * Searches that go beyond one buffer: find-in-buffers looks through every
+ * open buffer and grep-files looks through every file under a directory.
+ *
+ * Matches go into the *search-results buffer as "path:row:col: text" lines
+ * (one per matching line, col in bytes), and pressing enter on one of them
+ * jumps to it. grep-files shows paths relative to the working directory that
+ * it was run from, and jumps from there even if it has changed since.
+ *
+ * Buffers are searched right away, from memory. Files are searched by a few
+ * threads of grep-files' own, each of which read()s one file at a time into
+ * a buffer of its own, and their matches are added to *search-results
+ * before each pump as they come in, so the editor stays usable while a big
+ * tree is searched. Files that are open in a buffer are
+ * searched from the buffer instead, so that unsaved changes are seen.
+ * Hidden files and directories, symbolic links, files that have a NUL byte
+ * in their first SEARCH_FILES_BINARY_CHECK bytes, and names that match one
+ * of the patterns in the 'grep-ignore' variable are skipped.
+ */
+
+#define SEARCH_FILES_BINARY_CHECK (8192)
+#define SEARCH_FILES_MAX_TEXT     (256) /* Bytes of each matching line to show. */
+
+typedef struct yed_file_search_t {
+    yed_search_pattern  pattern;
+    char               *cwd;        /* Paths under this are shown relative to it. */
+    array_t             skip;       /* char*, sorted: files that are open in a buffer. */
+    array_t             ignore;     /* char*, fnmatch() patterns from 'grep-ignore'. */
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    array_t             todo;       /* char*, directories and files that haven't been looked at. */
+    int                 n_busy;     /* Threads looking at something from todo. */
+    int                 n_running;
+    int                 stop;
+    array_t             results;    /* char*, lines that haven't made it into the buffer yet. */
+    int                 n_files;
+    int                 n_matches;
+    u64                 start_us;
+    pthread_t           threads[MAX_WORKERS];
+    int                 n_threads;
+} yed_file_search;
+
+yed_buffer *yed_get_search_results_buffer(void);
+
+void yed_find_in_buffers(const char *str);
+int  yed_grep_files(const char *str, const char *dir);
+void yed_stop_grep_files(void);
+
+/* Jump to the match on this row of *search-results. */
+int  yed_search_results_jump(int row);
+
+void yed_search_files_pump_handler(yed_event *event);
+void yed_search_results_key_handler(yed_event *event);
+
+#endif
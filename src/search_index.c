@@ -0,0 +1,538 @@
+#include "search_index.h"
+
+static int search_index_count_line(yed_search_pattern *pattern, yed_line *line) {
+    char *data;
+    int   len;
+    int   start;
+    int   idx;
+    int   n;
+
+    if (!line->visual_width) { return 0; }
+
+    data  = array_data(line->chars);
+    len   = array_len(line->chars);
+    start = 0;
+    n     = 0;
+
+    /* Count the same (possibly overlapping) matches that get highlighted. */
+    while (len - start >= pattern->lit_len) {
+        if ((idx = yed_search_pattern_find(pattern, data, len, start, len, NULL)) < 0) { break; }
+        n     += 1;
+        start  = idx + 1;
+    }
+
+    return n;
+}
+
+static void search_index_reset(yed_search_index *index) {
+    yed_search_index_chunk *chunk;
+
+    array_traverse(index->chunks, chunk) {
+        array_free(chunk->rows);
+    }
+    array_clear(index->chunks);
+
+    index->n_rows     = 0;
+    index->n_matches  = 0;
+    index->hint_chunk = 0;
+    index->hint_first = 0;
+}
+
+/*
+ * The chunk that row_idx is in, and where in it. row_idx may be one past the
+ * last row, in which case it's in the last chunk. Lookups tend to be close
+ * together, so they start from the chunk of the last one when they can.
+ */
+static yed_search_index_chunk *search_index_locate(yed_search_index *index, int row_idx, int *k_out, int *i_out) {
+    yed_search_index_chunk *chunk;
+    int                     k;
+    int                     first;
+
+    if (array_len(index->chunks) == 0) { return NULL; }
+
+    k     = 0;
+    first = 0;
+    if (row_idx >= index->hint_first && index->hint_chunk < array_len(index->chunks)) {
+        k     = index->hint_chunk;
+        first = index->hint_first;
+    }
+
+    chunk = array_item(index->chunks, k);
+
+    while (row_idx >= first + array_len(chunk->rows) && k < array_len(index->chunks) - 1) {
+        first += array_len(chunk->rows);
+        k     += 1;
+        chunk  = array_item(index->chunks, k);
+    }
+
+    index->hint_chunk = k;
+    index->hint_first = first;
+
+    *k_out = k;
+    *i_out = row_idx - first;
+
+    return chunk;
+}
+
+static yed_search_index_row *search_index_row(yed_search_index *index, int row_idx) {
+    yed_search_index_chunk *chunk;
+    int                     k;
+    int                     i;
+
+    chunk = search_index_locate(index, row_idx, &k, &i);
+
+    return array_item(chunk->rows, i);
+}
+
+static yed_search_index_chunk *search_index_new_chunk(yed_search_index *index, int k) {
+    yed_search_index_chunk chunk;
+
+    chunk.rows      = array_make_with_cap(yed_search_index_row, SEARCH_INDEX_CHUNK_ROWS);
+    chunk.n_matches = 0;
+
+    array_insert(index->chunks, k, chunk);
+
+    return array_item(index->chunks, k);
+}
+
+/* Move the second half of a full chunk into a new one after it. */
+static void search_index_split_chunk(yed_search_index *index, int k) {
+    yed_search_index_chunk *chunk;
+    yed_search_index_chunk *next;
+    yed_search_index_row   *r;
+    int                     half;
+    int                     i;
+
+    next  = search_index_new_chunk(index, k + 1);
+    chunk = array_item(index->chunks, k);
+    half  = array_len(chunk->rows) / 2;
+
+    for (i = half; i < array_len(chunk->rows); i += 1) {
+        r                 = array_item(chunk->rows, i);
+        next->n_matches  += r->n_matches;
+        chunk->n_matches -= r->n_matches;
+        array_push(next->rows, *r);
+    }
+
+    while (array_len(chunk->rows) > half) {
+        array_pop(chunk->rows);
+    }
+
+    index->hint_chunk = 0;
+    index->hint_first = 0;
+}
+
+static void search_index_update_row(yed_buffer *buff, yed_search_index *index, int row) {
+    yed_search_pattern     *pattern;
+    yed_search_index_chunk *chunk;
+    yed_search_index_row   *r;
+    yed_line               *line;
+    int                     k;
+    int                     i;
+    int                     n;
+
+    if (row < 1 || row > index->n_rows) { return; }
+
+    pattern = yed_get_current_search_pattern();
+    line    = yed_buff_get_line(buff, row);
+
+    if (line == NULL) { return; }
+
+    chunk = search_index_locate(index, row - 1, &k, &i);
+    r     = array_item(chunk->rows, i);
+    n     = search_index_count_line(pattern, line);
+
+    chunk->n_matches += n - r->n_matches;
+    index->n_matches += n - r->n_matches;
+
+    r->version   = line->version;
+    r->n_matches = n;
+}
+
+static void search_index_insert_row(yed_buffer *buff, yed_search_index *index, int row) {
+    yed_search_index_chunk *chunk;
+    yed_search_index_row    r;
+    yed_line               *line;
+    int                     k;
+    int                     i;
+
+    if (row < 1 || row > index->n_rows + 1) { return; }
+
+    line = yed_buff_get_line(buff, row);
+    if (line == NULL) { return; }
+
+    r.version   = line->version;
+    r.n_matches = search_index_count_line(yed_get_current_search_pattern(), line);
+
+    if (array_len(index->chunks) == 0) {
+        search_index_new_chunk(index, 0);
+    }
+
+    chunk = search_index_locate(index, row - 1, &k, &i);
+
+    if (array_len(chunk->rows) >= SEARCH_INDEX_CHUNK_ROWS) {
+        search_index_split_chunk(index, k);
+        chunk = search_index_locate(index, row - 1, &k, &i);
+    }
+
+    array_insert(chunk->rows, i, r);
+
+    chunk->n_matches += r.n_matches;
+    index->n_matches += r.n_matches;
+    index->n_rows    += 1;
+}
+
+static void search_index_delete_row(yed_search_index *index, int row) {
+    yed_search_index_chunk *chunk;
+    yed_search_index_row   *r;
+    int                     k;
+    int                     i;
+
+    if (row < 1 || row > index->n_rows) { return; }
+
+    chunk = search_index_locate(index, row - 1, &k, &i);
+    r     = array_item(chunk->rows, i);
+
+    chunk->n_matches -= r->n_matches;
+    index->n_matches -= r->n_matches;
+    index->n_rows    -= 1;
+
+    array_delete(chunk->rows, i);
+
+    if (array_len(chunk->rows) == 0) {
+        array_free(chunk->rows);
+        array_delete(index->chunks, k);
+
+        index->hint_chunk = 0;
+        index->hint_first = 0;
+    }
+}
+
+/* Was the index made for the search as it is now? */
+static int search_index_is_current(yed_search_index *index) {
+    yed_search_pattern *pattern;
+
+    pattern = yed_get_current_search_pattern();
+
+    return pattern != NULL
+        && pattern->flags == index->flags
+        && strcmp(pattern->str, index->search) == 0;
+}
+
+yed_search_index *yed_buff_get_search_index(yed_buffer *buff) {
+    yed_search_pattern *pattern;
+    yed_search_index   *index;
+
+    if (buff == NULL || (buff->flags & BUFF_NO_MOD_EVENTS)) { return NULL; }
+
+    pattern = yed_get_current_search_pattern();
+
+    if (pattern == NULL || pattern->len == 0) { return NULL; }
+
+    index = buff->search_index;
+
+    if (index == NULL) {
+        index             = malloc(sizeof(*index));
+        index->search     = NULL;
+        index->chunks     = array_make(yed_search_index_chunk);
+        index->n_rows     = 0;
+        index->n_matches  = 0;
+        index->hint_chunk = 0;
+        index->hint_first = 0;
+
+        buff->search_index = index;
+    }
+
+    if (index->search == NULL || !search_index_is_current(index)) {
+        if (index->search != NULL) { free(index->search); }
+        index->search = strdup(pattern->str);
+        index->flags  = pattern->flags;
+        search_index_reset(index);
+    }
+
+    /* Lines were removed without us hearing about it. Start over. */
+    if (index->n_rows > yed_buff_n_lines(buff)) {
+        search_index_reset(index);
+    }
+
+    return index;
+}
+
+void yed_free_search_index(yed_buffer *buff) {
+    yed_search_index *index;
+
+    index = buff->search_index;
+
+    if (index == NULL) { return; }
+
+    if (index->search != NULL) { free(index->search); }
+    search_index_reset(index);
+    array_free(index->chunks);
+    free(index);
+
+    buff->search_index = NULL;
+}
+
+int yed_search_index_is_complete(yed_buffer *buff, yed_search_index *index) {
+    return index->n_rows == yed_buff_n_lines(buff);
+}
+
+int yed_search_index_scan(yed_buffer *buff, yed_search_index *index, u64 deadline_us) {
+    yed_search_pattern     *pattern;
+    yed_search_index_chunk *chunk;
+    yed_line               *line;
+    yed_search_index_row    r;
+    int                     row;
+    int                     n;
+
+    if (yed_search_index_is_complete(buff, index)) { return 0; }
+
+    pattern = yed_get_current_search_pattern();
+    row     = index->n_rows + 1;
+    n       = 0;
+    chunk   = array_len(index->chunks) ? array_last(index->chunks) : NULL;
+
+    bucket_array_traverse_from(buff->lines, line, row - 1) {
+        r.version   = line->version;
+        r.n_matches = search_index_count_line(pattern, line);
+
+        if (chunk == NULL || array_len(chunk->rows) >= SEARCH_INDEX_CHUNK_ROWS) {
+            chunk = search_index_new_chunk(index, array_len(index->chunks));
+        }
+
+        array_push(chunk->rows, r);
+
+        chunk->n_matches += r.n_matches;
+        index->n_matches += r.n_matches;
+        index->n_rows    += 1;
+
+        row += 1;
+        n   += 1;
+
+        if ((n & 255) == 0 && measure_time_now_us() >= deadline_us) { break; }
+    }
+
+    return !yed_search_index_is_complete(buff, index);
+}
+
+int yed_search_index_row_matches(yed_buffer *buff, yed_search_index *index, int row) {
+    yed_search_index_row *r;
+    yed_line             *line;
+
+    if (row < 1 || row > index->n_rows) { return -1; }
+
+    r    = search_index_row(index, row - 1);
+    line = yed_buff_get_line(buff, row);
+
+    /* The line was changed behind our back (a plugin writing to line->chars, for example). */
+    if (line != NULL && line->version != r->version) {
+        search_index_update_row(buff, index, row);
+    }
+
+    return r->n_matches;
+}
+
+/* First row index in [from, to) that has matches, or -1. */
+static int search_index_find_forward(yed_search_index *index, int from, int to) {
+    yed_search_index_chunk *chunk;
+    yed_search_index_row   *rows;
+    int                     first;
+    int                     i;
+    int                     end;
+
+    first = 0;
+    array_traverse(index->chunks, chunk) {
+        if (first >= to) { break; }
+
+        end = first + array_len(chunk->rows);
+
+        if (chunk->n_matches > 0 && end > from) {
+            rows = array_data(chunk->rows);
+            for (i = MAX(from, first); i < MIN(to, end); i += 1) {
+                if (rows[i - first].n_matches) { return i; }
+            }
+        }
+
+        first = end;
+    }
+
+    return -1;
+}
+
+/* Last row index in [from, to) that has matches, or -1. */
+static int search_index_find_backward(yed_search_index *index, int from, int to) {
+    yed_search_index_chunk *chunk;
+    yed_search_index_row   *rows;
+    int                     end;
+    int                     first;
+    int                     i;
+
+    end = index->n_rows;
+    array_rtraverse(index->chunks, chunk) {
+        if (end <= from) { break; }
+
+        first = end - array_len(chunk->rows);
+
+        if (chunk->n_matches > 0 && first < to) {
+            rows = array_data(chunk->rows);
+            for (i = MIN(to, end) - 1; i >= MAX(from, first); i -= 1) {
+                if (rows[i - first].n_matches) { return i; }
+            }
+        }
+
+        end = first;
+    }
+
+    return -1;
+}
+
+int yed_search_index_next_row(yed_search_index *index, int row) {
+    int i;
+
+    if ((i = search_index_find_forward(index, row, index->n_rows)) < 0
+    &&  (i = search_index_find_forward(index, 0, MIN(row, index->n_rows))) < 0) {
+        return 0;
+    }
+
+    return i + 1;
+}
+
+int yed_search_index_prev_row(yed_search_index *index, int row) {
+    int i;
+
+    if ((i = search_index_find_backward(index, 0, MIN(row - 1, index->n_rows))) < 0
+    &&  (i = search_index_find_backward(index, MAX(row - 1, 0), index->n_rows)) < 0) {
+        return 0;
+    }
+
+    return i + 1;
+}
+
+int yed_search_index_rank(yed_buffer *buff, yed_search_index *index, int row, int col) {
+    yed_search_pattern     *pattern;
+    yed_search_index_chunk *chunk;
+    yed_search_index_row   *rows;
+    yed_line               *line;
+    char                   *data;
+    int                     rank;
+    int                     end;
+    int                     first;
+    int                     i;
+    int                     start;
+    int                     idx;
+
+    end   = MIN(row - 1, index->n_rows);
+    rank  = 0;
+    first = 0;
+
+    /* Whole chunks before the row, then the rows before it in its own chunk. */
+    array_traverse(index->chunks, chunk) {
+        if (first >= end) { break; }
+
+        if (first + array_len(chunk->rows) <= end) {
+            rank += chunk->n_matches;
+        } else {
+            rows = array_data(chunk->rows);
+            for (i = first; i < end; i += 1) {
+                rank += rows[i - first].n_matches;
+            }
+        }
+
+        first += array_len(chunk->rows);
+    }
+
+    /* Then the matches on the row itself, up to the column. */
+    if (yed_search_index_row_matches(buff, index, row) > 0) {
+        pattern = yed_get_current_search_pattern();
+        line    = yed_buff_get_line(buff, row);
+        data    = array_data(line->chars);
+        start   = 0;
+
+        while (array_len(line->chars) - start >= pattern->lit_len) {
+            if ((idx = yed_search_pattern_find(pattern, data, array_len(line->chars), start, array_len(line->chars), NULL)) < 0) { break; }
+            if (yed_line_idx_to_col(line, idx) > col) { break; }
+            rank  += 1;
+            start  = idx + 1;
+        }
+    }
+
+    return rank;
+}
+
+void yed_search_index_buff_mod_handler(yed_event *event) {
+    yed_buffer       *buff;
+    yed_search_index *index;
+    int               row;
+
+    buff  = event->buffer;
+    index = buff->search_index;
+
+    if (index == NULL) { return; }
+
+    /* The search changed since the index was made. The pump handler will start a new one. */
+    if (!search_index_is_current(index)) {
+        yed_free_search_index(buff);
+        return;
+    }
+
+    switch (event->buff_mod_event) {
+        case BUFF_MOD_APPEND_TO_LINE:
+        case BUFF_MOD_POP_FROM_LINE:
+        case BUFF_MOD_INSERT_INTO_LINE:
+        case BUFF_MOD_DELETE_FROM_LINE:
+        case BUFF_MOD_CLEAR_LINE:
+        case BUFF_MOD_SET_LINE:
+            search_index_update_row(buff, index, event->row);
+            break;
+
+        case BUFF_MOD_SET_LINES:
+            for (row = event->row; row <= event->last_row; row += 1) {
+                search_index_update_row(buff, index, row);
+            }
+            break;
+
+        case BUFF_MOD_CLEAR:
+            /* Row 0 means the whole buffer was cleared. Otherwise, it's a single line. */
+            if (event->row == 0) {
+                search_index_reset(index);
+            } else {
+                search_index_update_row(buff, index, event->row);
+            }
+            break;
+
+        case BUFF_MOD_ADD_LINE:
+        case BUFF_MOD_INSERT_LINE:
+            search_index_insert_row(buff, index, event->row);
+            break;
+
+        case BUFF_MOD_DELETE_LINE:
+            search_index_delete_row(index, event->row);
+            break;
+    }
+}
+
+void yed_search_index_pump_handler(yed_event *event) {
+    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)  it;
+    yed_buffer                                   *buff;
+    yed_search_index                             *index;
+
+    /* Let go of the indexes of old searches. */
+    tree_traverse(ys->buffers, it) {
+        buff = tree_it_val(it);
+        if (buff->search_index != NULL && !search_index_is_current(buff->search_index)) {
+            yed_free_search_index(buff);
+        }
+    }
+
+    if (ys->active_frame == NULL || ys->active_frame->buffer == NULL) { return; }
+
+    buff  = ys->active_frame->buffer;
+    index = yed_buff_get_search_index(buff);
+
+    if (index == NULL) { return; }
+
+    /* Come back soon rather than waiting for input. */
+    if (yed_search_index_scan(buff, index, measure_time_now_us() + SEARCH_INDEX_BUDGET_US)) {
+        yed_force_update();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef __SEARCH_INDEX_H__
+#define __SEARCH_INDEX_H__
+
+/*
+ * A per-buffer count of the current search's matches on every row.
+ *
+ * The index for the active buffer is built a little at a time before each
+ * pump and kept up to date from EVENT_BUFFER_POST_MOD, so only rows that
+ * change are searched again. Rows are kept in chunks of at most
+ * SEARCH_INDEX_CHUNK_ROWS, each with its own total, so that adding or
+ * removing a row only touches its chunk, and the rank of a match and the
+ * next row that has any matches can be found without looking at every row
+ * in between.
+ *
+ * Buffers that don't send modification events aren't indexed. Searches in
+ * them (and in buffers whose index isn't finished yet) look at the lines
+ * directly, as before.
+ */
+
+#define SEARCH_INDEX_CHUNK_ROWS  (1024)
+#define SEARCH_INDEX_BUDGET_US   (4000)
+
+typedef struct {
+    u64 version;   /* line->version of the line when it was counted. */
+    int n_matches;
+} yed_search_index_row;
+
+typedef struct {
+    array_t rows;       /* yed_search_index_row, no more than SEARCH_INDEX_CHUNK_ROWS. */
+    int     n_matches;
+} yed_search_index_chunk;
+
+typedef struct yed_search_index_t {
+    char    *search;      /* The search this index counts matches for, */
+    int      flags;       /* and how it was compiled. */
+    array_t  chunks;      /* yed_search_index_chunk, for rows 1 through n_rows in order. */
+    int      n_rows;
+    int      n_matches;
+    int      hint_chunk;  /* The chunk of the last row looked up, */
+    int      hint_first;  /* and the index of its first row. */
+} yed_search_index;
+
+/*
+ * Returns the buffer's index for the current search, starting it if needed.
+ * Returns NULL if there is no search or the buffer can't be indexed.
+ */
+yed_search_index *yed_buff_get_search_index(yed_buffer *buff);
+void yed_free_search_index(yed_buffer *buff);
+
+/* Has every row been indexed? */
+int yed_search_index_is_complete(yed_buffer *buff, yed_search_index *index);
+
+/* Index up to the deadline. Returns non-zero if there are still rows left. */
+int yed_search_index_scan(yed_buffer *buff, yed_search_index *index, u64 deadline_us);
+
+/* Number of matches on a row, or -1 if the index hasn't reached it yet. */
+int yed_search_index_row_matches(yed_buffer *buff, yed_search_index *index, int row);
+
+/*
+ * The next (or previous) row after (or before) row that has any matches,
+ * wrapping around the buffer, or 0 if there aren't any. The index must be complete.
+ */
+int yed_search_index_next_row(yed_search_index *index, int row);
+int yed_search_index_prev_row(yed_search_index *index, int row);
+
+/*
+ * The number of matches that start at or before (row, col).
+ * Only counts rows that have been indexed.
+ */
+int yed_search_index_rank(yed_buffer *buff, yed_search_index *index, int row, int col);
+
+void yed_search_index_buff_mod_handler(yed_event *event);
+void yed_search_index_pump_handler(yed_event *event);
+
+#endif
@@ -0,0 +1,649 @@
+#include "search_pattern.h"
+
+/*
+ * Not in the header: plugins that use syntax.h with PCRE2 get a different
+ * regex_t from pcre2posix.h.
+ */
+#include <regex.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SEARCH_BLOCK (32)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SEARCH_BLOCK (16)
+#endif
+
+static inline unsigned char search_fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline unsigned char search_unfold(unsigned char c) {
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+/* Skip a bracket expression. s points at the '['. */
+static const char *search_regex_skip_bracket(const char *s) {
+    s += 1;
+    if (*s == '^') { s += 1; }
+    if (*s == ']') { s += 1; }
+
+    while (*s && *s != ']') {
+        /* [:class:], [.coll.] and [=equiv=] can have a ']' in them. */
+        if (s[0] == '[' && (s[1] == ':' || s[1] == '.' || s[1] == '=')) {
+            s += 2;
+            while (*s && !(s[0] != 0 && s[1] == ']' && (s[0] == ':' || s[0] == '.' || s[0] == '='))) { s += 1; }
+            if (*s) { s += 2; }
+            continue;
+        }
+        s += 1;
+    }
+
+    return *s ? s + 1 : s;
+}
+
+/* Skip a parenthesized group. s points at the '('. */
+static const char *search_regex_skip_group(const char *s) {
+    int depth;
+
+    depth = 0;
+
+    while (*s) {
+        switch (*s) {
+            case '\\':
+                s += s[1] ? 2 : 1;
+                continue;
+            case '[':
+                s = search_regex_skip_bracket(s);
+                continue;
+            case '(':
+                depth += 1;
+                break;
+            case ')':
+                depth -= 1;
+                if (depth == 0) { return s + 1; }
+                break;
+        }
+        s += 1;
+    }
+
+    return s;
+}
+
+/*
+ * The longest run of literal text that every match of a regex has to
+ * contain, and whether every match starts with it. Lines that don't have it
+ * can be passed over without running the regex at all. This is
+ * conservative: it only looks at the top level of the pattern and gives up
+ * when there's an alternation anywhere in it.
+ */
+static char *search_regex_literal(const char *str, int *len, int *is_prefix) {
+    const char *s;
+    const char *next;
+    char       *run;
+    char       *best;
+    int         run_len;
+    int         run_prefix;
+    int         c;
+
+    run        = malloc(strlen(str) + 1);
+    best       = malloc(strlen(str) + 1);
+    run_len    = 0;
+    run_prefix = 1;
+    *len       = 0;
+    *is_prefix = 0;
+
+    if (strchr(str, '|') != NULL) { goto out; }
+
+    s = str;
+    while (*s) {
+        c    = -1;
+        next = s + 1;
+
+        switch (*s) {
+            case '\\':
+                /* Escaped punctuation is literal. Anything else is a class or an anchor. */
+                if (s[1] && strchr(".[]()*+?{}|^$\\", s[1]) != NULL) { c = s[1]; }
+                next = s[1] ? s + 2 : s + 1;
+                break;
+            case '[':
+                next = search_regex_skip_bracket(s);
+                break;
+            case '(':
+                next = search_regex_skip_group(s);
+                break;
+            case '{':
+                while (*next && *next != '}') { next += 1; }
+                if (*next) { next += 1; }
+                break;
+            case '.': case '^': case '$': case ')':
+            case '*': case '+': case '?': case '}':
+                break;
+            default:
+                c = *s;
+        }
+
+        /* A repeat that can match nothing means the character isn't required. */
+        if (c >= 0 && (*next == '*' || *next == '?' || *next == '{')) { c = -1; }
+
+        if (c >= 0) {
+            run[run_len++] = c;
+        }
+
+        if (c < 0 || *next == '+') {
+            if (run_len > *len) {
+                memcpy(best, run, run_len);
+                *len       = run_len;
+                *is_prefix = run_prefix;
+            }
+            run_len    = 0;
+            run_prefix = 0;
+        }
+
+        s = next;
+    }
+
+    if (run_len > *len) {
+        memcpy(best, run, run_len);
+        *len       = run_len;
+        *is_prefix = run_prefix;
+    }
+
+out:;
+    best[*len] = 0;
+    free(run);
+
+    return best;
+}
+
+void yed_search_pattern_make(yed_search_pattern *pattern, const char *str, int flags) {
+    int           i;
+    int           n;
+    unsigned char c;
+
+    memset(pattern, 0, sizeof(*pattern));
+
+    pattern->str   = strdup(str);
+    pattern->flags = flags;
+    pattern->len   = strlen(str);
+    pattern->width = yed_get_string_width(str);
+
+    if (flags & SEARCH_PATTERN_REGEX) {
+        pattern->reg = malloc(sizeof(regex_t));
+        if (regcomp(pattern->reg, str, REG_EXTENDED | ((flags & SEARCH_PATTERN_ICASE) ? REG_ICASE : 0)) != 0) {
+            free(pattern->reg);
+            pattern->reg = NULL;
+        }
+        pattern->lit = search_regex_literal(str, &n, &pattern->lit_is_prefix);
+    } else {
+        n                      = pattern->len;
+        pattern->lit           = strdup(str);
+        pattern->lit_is_prefix = 1;
+    }
+
+    pattern->lit_len = n;
+
+    if (flags & SEARCH_PATTERN_ICASE) {
+        for (i = 0; i < n; i += 1) {
+            pattern->lit[i] = search_fold(pattern->lit[i]);
+        }
+    }
+
+    for (i = 0; i < 256; i += 1) {
+        pattern->shift[i]  = n;
+        pattern->rshift[i] = n;
+    }
+    for (i = 0; i < n - 1; i += 1) {
+        c = pattern->lit[i];
+        pattern->shift[c]                = n - 1 - i;
+        pattern->shift[search_unfold(c)] = pattern->shift[c];
+    }
+    for (i = n - 1; i > 0; i -= 1) {
+        c = pattern->lit[i];
+        pattern->rshift[c]                = i;
+        pattern->rshift[search_unfold(c)] = i;
+    }
+}
+
+void yed_search_pattern_free(yed_search_pattern *pattern) {
+    if (pattern->str != NULL) {
+        free(pattern->str);
+        pattern->str = NULL;
+    }
+    if (pattern->lit != NULL) {
+        free(pattern->lit);
+        pattern->lit = NULL;
+    }
+    if (pattern->reg != NULL) {
+        regfree(pattern->reg);
+        free(pattern->reg);
+        pattern->reg = NULL;
+    }
+}
+
+static inline int search_byte_matches(yed_search_pattern *pattern, char c, int i) {
+    return (pattern->flags & SEARCH_PATTERN_ICASE)
+            ? search_fold(c) == (unsigned char)pattern->lit[i]
+            : c == pattern->lit[i];
+}
+
+/* Is there a match at text, given that the first and last bytes already match? */
+static inline int search_pattern_middle_matches(yed_search_pattern *pattern, const char *text) {
+    int i;
+
+    if (pattern->lit_len <= 2) { return 1; }
+
+    if (!(pattern->flags & SEARCH_PATTERN_ICASE)) {
+        return memcmp(text + 1, pattern->lit + 1, pattern->lit_len - 2) == 0;
+    }
+
+    for (i = 1; i < pattern->lit_len - 1; i += 1) {
+        if (search_fold(text[i]) != (unsigned char)pattern->lit[i]) { return 0; }
+    }
+
+    return 1;
+}
+
+/* Horspool, for matches starting in [i, len - pattern->lit_len]. */
+static int search_pattern_horspool(yed_search_pattern *pattern, const char *text, int len, int i) {
+    int           last;
+    unsigned char c;
+
+    last = pattern->lit_len - 1;
+
+    while (i <= len - pattern->lit_len) {
+        c = text[i + last];
+
+        if (search_byte_matches(pattern, c, last)
+        &&  search_byte_matches(pattern, text[i], 0)
+        &&  search_pattern_middle_matches(pattern, text + i)) {
+            return i;
+        }
+
+        i += pattern->shift[c];
+    }
+
+    return -1;
+}
+
+/* Horspool backwards, for matches starting in [0, i]. */
+static int search_pattern_rhorspool(yed_search_pattern *pattern, const char *text, int i) {
+    unsigned char c;
+
+    while (i >= 0) {
+        c = text[i];
+
+        if (search_byte_matches(pattern, c, 0)
+        &&  search_byte_matches(pattern, text[i + pattern->lit_len - 1], pattern->lit_len - 1)
+        &&  search_pattern_middle_matches(pattern, text + i)) {
+            return i;
+        }
+
+        i -= pattern->rshift[c];
+    }
+
+    return -1;
+}
+
+#ifdef SEARCH_BLOCK
+#if SEARCH_BLOCK == 32
+typedef __m256i search_vec;
+#define SEARCH_SPLAT(c)      _mm256_set1_epi8(c)
+#define SEARCH_LOAD(p)       _mm256_loadu_si256((const __m256i*)(p))
+#define SEARCH_EQ(a, b)      _mm256_cmpeq_epi8((a), (b))
+#define SEARCH_OR(a, b)      _mm256_or_si256((a), (b))
+#define SEARCH_AND(a, b)     _mm256_and_si256((a), (b))
+#define SEARCH_MASK(a)       ((u32)_mm256_movemask_epi8(a))
+#else
+typedef __m128i search_vec;
+#define SEARCH_SPLAT(c)      _mm_set1_epi8(c)
+#define SEARCH_LOAD(p)       _mm_loadu_si128((const __m128i*)(p))
+#define SEARCH_EQ(a, b)      _mm_cmpeq_epi8((a), (b))
+#define SEARCH_OR(a, b)      _mm_or_si128((a), (b))
+#define SEARCH_AND(a, b)     _mm_and_si128((a), (b))
+#define SEARCH_MASK(a)       ((u32)_mm_movemask_epi8(a))
+#endif
+
+/* The other byte that lit[i] can match: its capital when ignoring case, otherwise itself. */
+static inline char search_lit_alt(yed_search_pattern *pattern, int i) {
+    return (pattern->flags & SEARCH_PATTERN_ICASE)
+            ? search_unfold(pattern->lit[i])
+            : pattern->lit[i];
+}
+
+/*
+ * Bit i is set if the window starting at text + i has the right first and last bytes.
+ * For plain searches, the second of each pair is the same as the first.
+ */
+static inline u32 search_block_candidates(const char *text, int n, search_vec first, search_vec first_up, search_vec last, search_vec last_up) {
+    search_vec a;
+    search_vec b;
+
+    a = SEARCH_LOAD(text);
+    b = SEARCH_LOAD(text + n - 1);
+
+    return SEARCH_MASK(SEARCH_AND(SEARCH_OR(SEARCH_EQ(first, a), SEARCH_EQ(first_up, a)),
+                                  SEARCH_OR(SEARCH_EQ(last,  b), SEARCH_EQ(last_up,  b))));
+}
+#endif
+
+/* First place the literal starts in text[0, len), or -1. */
+static int search_lit_find(yed_search_pattern *pattern, const char *text, int len) {
+    const char *p;
+    int         i;
+#ifdef SEARCH_BLOCK
+    int         n;
+    u32         mask;
+    int         bit;
+    search_vec  first, first_up, last, last_up;
+#endif
+
+    if (pattern->lit_len > len) { return -1; }
+
+    if (pattern->lit_len == 1 && !(pattern->flags & SEARCH_PATTERN_ICASE)) {
+        p = memchr(text, pattern->lit[0], len);
+        return p == NULL ? -1 : p - text;
+    }
+
+    i = 0;
+
+#ifdef SEARCH_BLOCK
+    n        = pattern->lit_len;
+    first    = SEARCH_SPLAT(pattern->lit[0]);
+    last     = SEARCH_SPLAT(pattern->lit[n - 1]);
+    first_up = SEARCH_SPLAT(search_lit_alt(pattern, 0));
+    last_up  = SEARCH_SPLAT(search_lit_alt(pattern, n - 1));
+
+    for (; i + SEARCH_BLOCK <= len - n + 1; i += SEARCH_BLOCK) {
+        mask = search_block_candidates(text + i, n, first, first_up, last, last_up);
+
+        while (mask) {
+            bit = __builtin_ctz(mask);
+
+            if (search_pattern_middle_matches(pattern, text + i + bit)) {
+                return i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* Less than a block's worth of candidates left. */
+    return search_pattern_horspool(pattern, text, len, i);
+}
+
+/* Last place the literal starts in text[0, len), or -1. */
+static int search_lit_rfind(yed_search_pattern *pattern, const char *text, int len) {
+    int         i;
+#ifdef SEARCH_BLOCK
+    int         n;
+    u32         mask;
+    int         bit;
+    search_vec  first, first_up, last, last_up;
+#endif
+
+    if (pattern->lit_len > len) { return -1; }
+
+    /* One past the last place a match could start. */
+    i = len - pattern->lit_len + 1;
+
+#ifdef SEARCH_BLOCK
+    n        = pattern->lit_len;
+    first    = SEARCH_SPLAT(pattern->lit[0]);
+    last     = SEARCH_SPLAT(pattern->lit[n - 1]);
+    first_up = SEARCH_SPLAT(search_lit_alt(pattern, 0));
+    last_up  = SEARCH_SPLAT(search_lit_alt(pattern, n - 1));
+
+    while (i >= SEARCH_BLOCK) {
+        i -= SEARCH_BLOCK;
+
+        mask = search_block_candidates(text + i, n, first, first_up, last, last_up);
+
+        while (mask) {
+            bit = 31 - __builtin_clz(mask);
+
+            if (search_pattern_middle_matches(pattern, text + i + bit)) {
+                return i + bit;
+            }
+
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+
+    /* Less than a block's worth of candidates left. */
+    return search_pattern_rhorspool(pattern, text, i - 1);
+}
+
+/*
+ * Run the regex on text[start, end), which is part of a line of len bytes,
+ * filling in nmatch entries of match.
+ */
+static int search_regexec(yed_search_pattern *pattern, const char *text, int len, int start, int end, int nmatch, regmatch_t *match) {
+    int   eflags;
+    int   err;
+#ifndef REG_STARTEND
+    char *copy;
+    int   i;
+#endif
+
+    eflags = 0;
+    if (start > 0) { eflags |= REG_NOTBOL; }
+    if (end < len) { eflags |= REG_NOTEOL; }
+
+#ifdef REG_STARTEND
+    match->rm_so = start;
+    match->rm_eo = end;
+
+    err = regexec(pattern->reg, text, nmatch, match, eflags | REG_STARTEND);
+#else
+    copy = strndup(text + start, end - start);
+    err  = regexec(pattern->reg, copy, nmatch, match, eflags);
+    free(copy);
+
+    for (i = 0; i < nmatch; i += 1) {
+        if (match[i].rm_so < 0) { continue; }
+        match[i].rm_so += start;
+        match[i].rm_eo += start;
+    }
+#endif
+
+    return err == 0;
+}
+
+static int search_regex_find(yed_search_pattern *pattern, const char *text, int len, int start, int end, int *match_len) {
+    regmatch_t match;
+    int        i;
+
+    if (pattern->reg == NULL) { return -1; }
+
+    /*
+     * Most lines don't have the literal that every match has in it, so those
+     * are done with quickly. If matches start with it, skip ahead to it too.
+     */
+    if (pattern->lit_len > 0) {
+        if ((i = search_lit_find(pattern, text + start, end - start)) < 0) { return -1; }
+        if (pattern->lit_is_prefix) { start += i; }
+    }
+
+    if (!search_regexec(pattern, text, len, start, len, 1, &match)) { return -1; }
+
+    /* It runs past the end. Try again without the rest of the line. */
+    if (match.rm_eo > end
+    &&  !search_regexec(pattern, text, len, start, end, 1, &match)) {
+        return -1;
+    }
+
+    if (match_len != NULL) { *match_len = match.rm_eo - match.rm_so; }
+
+    return match.rm_so;
+}
+
+int yed_search_pattern_find(yed_search_pattern *pattern, const char *text, int len, int start, int end, int *match_len) {
+    int i;
+
+    if (pattern->len == 0 || start > end) { return -1; }
+
+    if (pattern->flags & SEARCH_PATTERN_REGEX) {
+        return search_regex_find(pattern, text, len, start, end, match_len);
+    }
+
+    if ((i = search_lit_find(pattern, text + start, end - start)) < 0) { return -1; }
+
+    if (match_len != NULL) { *match_len = pattern->lit_len; }
+
+    return start + i;
+}
+
+int yed_search_pattern_n_groups(yed_search_pattern *pattern) {
+    if (!(pattern->flags & SEARCH_PATTERN_REGEX) || pattern->reg == NULL) { return 0; }
+
+    return MIN((int)((regex_t*)pattern->reg)->re_nsub, SEARCH_PATTERN_MAX_GROUPS - 1);
+}
+
+int yed_search_pattern_find_groups(yed_search_pattern *pattern, const char *text, int len, int start, int *groups, int n_groups) {
+    regmatch_t match[SEARCH_PATTERN_MAX_GROUPS];
+    int        i;
+    int        match_len;
+
+    n_groups = MIN(n_groups, SEARCH_PATTERN_MAX_GROUPS);
+
+    for (i = 0; i < n_groups; i += 1) {
+        groups[2 * i]     = -1;
+        groups[2 * i + 1] = -1;
+    }
+
+    if (pattern->len == 0 || start > len || n_groups <= 0) { return -1; }
+
+    if (!(pattern->flags & SEARCH_PATTERN_REGEX)) {
+        if ((i = yed_search_pattern_find(pattern, text, len, start, len, &match_len)) < 0) { return -1; }
+        groups[0] = i;
+        groups[1] = i + match_len;
+        return i;
+    }
+
+    if (pattern->reg == NULL) { return -1; }
+
+    if (pattern->lit_len > 0) {
+        if ((i = search_lit_find(pattern, text + start, len - start)) < 0) { return -1; }
+        if (pattern->lit_is_prefix) { start += i; }
+    }
+
+    if (!search_regexec(pattern, text, len, start, len, n_groups, match)) { return -1; }
+
+    for (i = 0; i < n_groups; i += 1) {
+        groups[2 * i]     = match[i].rm_so;
+        groups[2 * i + 1] = match[i].rm_eo;
+    }
+
+    return match[0].rm_so;
+}
+
+int yed_search_pattern_rfind(yed_search_pattern *pattern, const char *text, int len, int end, int *match_len) {
+    int i;
+    int start;
+    int last;
+    int last_len;
+    int n;
+
+    if (pattern->len == 0 || end < 0) { return -1; }
+
+    if (pattern->flags & SEARCH_PATTERN_REGEX) {
+        /* Regexes only go forward, so take the last of the matches going forward. */
+        last     = -1;
+        last_len = 0;
+        start    = 0;
+
+        while ((i = search_regex_find(pattern, text, len, start, end, &n)) >= 0) {
+            last     = i;
+            last_len = n;
+            start    = i + 1;
+        }
+
+        if (last >= 0 && match_len != NULL) { *match_len = last_len; }
+
+        return last;
+    }
+
+    if ((i = search_lit_rfind(pattern, text, end)) < 0) { return -1; }
+
+    if (match_len != NULL) { *match_len = pattern->lit_len; }
+
+    return i;
+}
+
+int yed_search_pattern_find_in_lines(yed_search_pattern *pattern, const char *text, int len, int start, int *match_len) {
+    const char *nl;
+    int         line_start;
+    int         line_end;
+    int         i;
+
+    if (!(pattern->flags & SEARCH_PATTERN_REGEX)) {
+        /* Plain searches can't have a newline in them, so they can't span lines anyway. */
+        return yed_search_pattern_find(pattern, text, len, start, len, match_len);
+    }
+
+    line_start = start;
+
+    while (line_start < len) {
+        /* Go straight to the next line that has the literal. */
+        if (pattern->lit_len > 0) {
+            if ((i = search_lit_find(pattern, text + line_start, len - line_start)) < 0) { return -1; }
+
+            i += line_start;
+            while (i > line_start && text[i - 1] != '\n') { i -= 1; }
+            line_start = i;
+        }
+
+        nl       = memchr(text + line_start, '\n', len - line_start);
+        line_end = nl == NULL ? len : nl - text;
+
+        i = yed_search_pattern_find(pattern, text + line_start, line_end - line_start, 0, line_end - line_start, match_len);
+        if (i >= 0) { return line_start + i; }
+
+        line_start = line_end + 1;
+    }
+
+    return -1;
+}
+
+static int search_pattern_has_upper(const char *str) {
+    for (; *str; str += 1) {
+        if (*str >= 'A' && *str <= 'Z') { return 1; }
+    }
+    return 0;
+}
+
+int yed_search_pattern_flags(const char *str) {
+    int flags;
+
+    flags = 0;
+    if (yed_var_is_truthy("search-regex")) {
+        flags |= SEARCH_PATTERN_REGEX;
+    }
+    if (yed_var_is_truthy("search-smart-case") && !search_pattern_has_upper(str)) {
+        flags |= SEARCH_PATTERN_ICASE;
+    }
+
+    return flags;
+}
+
+yed_search_pattern *yed_get_current_search_pattern(void) {
+    int flags;
+
+    if (ys->current_search == NULL) { return NULL; }
+
+    flags = yed_search_pattern_flags(ys->current_search);
+
+    /* The search may be edited as it's typed, so check that it's still the same. */
+    if (ys->search_pattern.str == NULL
+    ||  ys->search_pattern.flags != flags
+    ||  strcmp(ys->search_pattern.str, ys->current_search) != 0) {
+
+        yed_search_pattern_free(&ys->search_pattern);
+        yed_search_pattern_make(&ys->search_pattern, ys->current_search, flags);
+    }
+
+    return &ys->search_pattern;
+}
@@ -0,0 +1,76 @@
+#ifndef __SEARCH_PATTERN_H__
+#define __SEARCH_PATTERN_H__
+
+/*
+ * A search, compiled once so that it can be looked for in many lines
+ * without any per-call setup.
+ *
+ * Plain searches find candidates a block at a time by comparing the
+ * pattern's first and last bytes against the text with SIMD instructions
+ * (AVX2 or SSE2, whichever the library was built for) and only the
+ * candidates are compared in full. What's left over at the end of the text,
+ * or all of it when there are no SIMD instructions to use, is searched with
+ * Boyer-Moore-Horspool. Case-insensitive searches do the same, comparing
+ * against both cases of each letter.
+ *
+ * Regular expression searches (POSIX extended syntax) first look for the
+ * literal text that every match has to contain, if there is any, the same
+ * way, and only run the regex on lines that have it.
+ *
+ * yed_search_pattern_find() returns the index of the first match that
+ * starts at or after start and ends at or before end in a line of len
+ * bytes, and yed_search_pattern_rfind() returns the index of the last one
+ * that ends at or before end. Both return -1 if there isn't a match, and set
+ * *match_len to the length of the match if match_len isn't NULL.
+ */
+
+#define SEARCH_PATTERN_ICASE (0x1)
+#define SEARCH_PATTERN_REGEX (0x2)
+
+#define SEARCH_PATTERN_MAX_GROUPS (10) /* The whole match and groups 1 through 9. */
+
+typedef struct {
+    char    *str;
+    int      flags;
+    int      len;
+    int      width;       /* Columns taken up by the pattern, for plain searches. */
+    char    *lit;         /* What's searched for with the tables below: the string, or literal text from a regex. */
+    int      lit_len;
+    int      lit_is_prefix;
+    int      shift[256];  /* Horspool: how far forward to move when the last byte of the window is the index. */
+    int      rshift[256]; /* The same, moving backward, by the first byte of the window. */
+    void    *reg;         /* A compiled regex_t, if this is a valid regex search. */
+} yed_search_pattern;
+
+void yed_search_pattern_make(yed_search_pattern *pattern, const char *str, int flags);
+void yed_search_pattern_free(yed_search_pattern *pattern);
+int  yed_search_pattern_find(yed_search_pattern *pattern, const char *text, int len, int start, int end, int *match_len);
+int  yed_search_pattern_rfind(yed_search_pattern *pattern, const char *text, int len, int end, int *match_len);
+
+/*
+ * Like yed_search_pattern_find(), but text is many lines separated by '\n'
+ * (e.g. a whole file) and start is the beginning of one of them. Matches
+ * don't span lines.
+ */
+int  yed_search_pattern_find_in_lines(yed_search_pattern *pattern, const char *text, int len, int start, int *match_len);
+
+/*
+ * The first match that starts at or after start, with the start and end of
+ * the whole match and of each of its groups put in groups (n_groups pairs,
+ * -1 for groups that aren't part of the match). Plain searches have no
+ * groups but the match itself. yed_search_pattern_n_groups() is the number
+ * of groups in a regex, not counting the whole match.
+ */
+int  yed_search_pattern_find_groups(yed_search_pattern *pattern, const char *text, int len, int start, int *groups, int n_groups);
+int  yed_search_pattern_n_groups(yed_search_pattern *pattern);
+
+/*
+ * The compiled form of ys->current_search, or NULL if there isn't one.
+ * The 'search-regex' and 'search-smart-case' variables decide how it's
+ * compiled; yed_search_pattern_flags() gives the flags they ask for.
+ * With smart case, a search without any capital letters ignores case.
+ */
+yed_search_pattern *yed_get_current_search_pattern(void);
+int yed_search_pattern_flags(const char *str);
+
+#endif
@@ -1,32 +1,95 @@
 #include "status_line.h"
 
-static char *get_expanded(char *s) {
-    char       *result;
-    int         just;
-    int         padto;
-    char        ibuff[32];
-    array_t     chars;
-    int         i;
-    char        c;
-    yed_frame **fit;
-    char       *istr;
-    char       *str;
-    struct tm  *tm;
-    time_t      t;
-    char        tbuff[256];
-    int         width;
-    char        space = ' ';
+static const char *status_line_var_names[N_STATUS_LINE_PARTS] = {
+    "status-line-left",
+    "status-line-center",
+    "status-line-right",
+};
+
+void yed_init_status_line(void) {
+    yed_status_line_part *part;
+    int                   i;
+
+    for (i = 0; i < N_STATUS_LINE_PARTS; i += 1) {
+        part           = ys->status_line_parts + i;
+        part->tokens   = array_make(yed_status_line_token);
+        part->text     = array_make(char);
+        part->spans    = array_make(yed_status_line_span);
+    }
+}
 
-    result = NULL;
+void yed_invalidate_status_line(int recompile) {
+    int i;
+
+    ys->status_line_generation += 1;
+
+    if (recompile) {
+        for (i = 0; i < N_STATUS_LINE_PARTS; i += 1) {
+            ys->status_line_parts[i].compiled = 0;
+        }
+    }
+}
+
+static char *pad_expanded(char *result, int just, int padto) {
+    array_t chars;
+    int     width;
+    int     i;
+    char    space = ' ';
+
+    width = yed_get_string_width(result);
+    if (width >= padto) { return result; }
 
-    just = (*s == '-' || *s == '=') ? *s : 0;
-    if (just) { s += 1; }
-    padto = 0;
-    memset(ibuff, 0, sizeof(ibuff));
-    while (is_digit(*s)) { ibuff[strlen(ibuff)] = *s; s += 1; }
-    if (strlen(ibuff))   { padto = s_to_i(ibuff);             }
+    chars = array_make(char);
+    switch (just) {
+        case '-':
+            array_push_n(chars, result, strlen(result));
+            while (padto - width > 0) {
+                array_push(chars, space);
+                width += 1;
+            }
+            break;
+        case '=':
+            for (i = 0; i < (padto - width) / 2; i += 1) {
+                array_push(chars, space);
+            }
+            array_push_n(chars, result, strlen(result));
+            for (i = 0; i < (padto - width) - ((padto - width) / 2); i += 1) {
+                array_push(chars, space);
+            }
+            break;
+        default:
+            while (padto - width > 0) {
+                array_push(chars, space);
+                width += 1;
+            }
+            array_push_n(chars, result, strlen(result));
+    }
+    array_zero_term(chars);
+    free(result);
+    result = strdup(array_data(chars));
+    array_free(chars);
 
-    switch (*s) {
+    return result;
+}
+
+static char *get_expanded(yed_status_line_token *tok) {
+    char             *result;
+    char              ibuff[32];
+    array_t           chars;
+    int               i;
+    char              c;
+    yed_frame       **fit;
+    char             *istr;
+    char             *str;
+    char             *s;
+    struct tm        *tm;
+    time_t            t;
+    char              tbuff[256];
+    yed_search_index *index;
+
+    result = NULL;
+
+    switch (tok->spec) {
         case 'b':
             if (ys->active_frame && ys->active_frame->buffer) {
                 result = strdup(ys->active_frame->buffer->name);
@@ -92,6 +155,20 @@ static char *get_expanded(char *s) {
                 result = strdup("-");
             }
             break;
+        case 'm':
+            if (ys->active_frame
+            &&  ys->active_frame->buffer
+            &&  (index = yed_buff_get_search_index(ys->active_frame->buffer)) != NULL) {
+
+                snprintf(tbuff, sizeof(tbuff), "match %d/%d%s",
+                         yed_search_index_rank(ys->active_frame->buffer, index,
+                                               ys->active_frame->cursor_line,
+                                               ys->active_frame->cursor_col),
+                         index->n_matches,
+                         yed_search_index_is_complete(ys->active_frame->buffer, index) ? "" : "+");
+                result = strdup(tbuff);
+            }
+            break;
         case 'n':
             result = strdup((ys->active_frame == NULL || ys->active_frame->name == NULL) ? "-" : ys->active_frame->name);
             break;
@@ -118,22 +195,12 @@ static char *get_expanded(char *s) {
             result = strdup(tbuff);
             break;
         case '(':
-            chars = array_make(char);
-            s += 1;
-            while (*s && *s != ')') { array_push(chars, *s); s += 1; }
-            if (*s) {
-                array_zero_term(chars);
-                str = (char*)array_data(chars);
-                str = yed_get_var(str);
-                if (str != NULL) {
-                    str = strdup(str);
-                    for (s = str; *s; s += 1) { if (*s == '\n') { *s = 0; break; } }
-                    array_free(chars);
-                    result = str;
-                    goto out;
-                }
+            str = yed_get_var(tok->str);
+            if (str != NULL) {
+                str = strdup(str);
+                for (s = str; *s; s += 1) { if (*s == '\n') { *s = 0; break; } }
+                result = str;
             }
-            array_free(chars);
             break;
         case '%':
             result = strdup("%");
@@ -142,108 +209,92 @@ static char *get_expanded(char *s) {
 
 out:;
     if (result != NULL) {
-        width = yed_get_string_width(result);
-        if (width < padto) {
-            chars = array_make(char);
-            switch (just) {
-                case '-':
-                    array_push_n(chars, result, strlen(result));
-                    while (padto - width > 0) {
-                        array_push(chars, space);
-                        width += 1;
-                    }
-                    break;
-                case '=':
-                    for (i = 0; i < (padto - width) / 2; i += 1) {
-                        array_push(chars, space);
-                    }
-                    array_push_n(chars, result, strlen(result));
-                    for (i = 0; i < (padto - width) - ((padto - width) / 2); i += 1) {
-                        array_push(chars, space);
-                    }
-                    break;
-                default:
-                    while (padto - width > 0) {
-                        array_push(chars, space);
-                        width += 1;
-                    }
-                    array_push_n(chars, result, strlen(result));
-            }
-            array_zero_term(chars);
-            free(result);
-            result = strdup(array_data(chars));
-            array_free(chars);
-        }
+        result = pad_expanded(result, tok->just, tok->padto);
     }
 
     return result;
 }
 
-static void parse_and_put_attrs(char *s) {
-    array_t    chars;
-    char      *str;
-    yed_attrs  base;
-    yed_attrs  attrs;
-
-    chars = array_make(char);
-
-    s += 1;
-    while (*s && *s != ']') { array_push(chars, *s); s += 1; }
-
-    base = yed_active_style_get_status_line();
-
-    if (*s) {
-        array_zero_term(chars);
-
-        str   = (char*)array_data(chars);
-        attrs = yed_parse_attrs(str);
-        yed_combine_attrs(&base, &attrs);
+static int get_spec_uses(char spec) {
+    switch (spec) {
+        case 'b':
+        case 'B':
+        case 'F': return STATUS_LINE_USES_FRAME | STATUS_LINE_USES_BUFFER;
+        case 'c':
+        case 'l': return STATUS_LINE_USES_FRAME | STATUS_LINE_USES_CURSOR;
+        case 'f': return STATUS_LINE_USES_FRAMES;
+        case 'm': return STATUS_LINE_USES_FRAME | STATUS_LINE_USES_BUFFER | STATUS_LINE_USES_CURSOR | STATUS_LINE_USES_SEARCH;
+        case 'n': return STATUS_LINE_USES_FRAME;
+        case 'p': return STATUS_LINE_USES_FRAME | STATUS_LINE_USES_BUFFER | STATUS_LINE_USES_CURSOR | STATUS_LINE_USES_LINES;
+        case 't':
+        case 'T': return STATUS_LINE_USES_TIME;
     }
 
-    yed_set_attr(base);
-
-    array_free(chars);
+    /* %(var) and %% only change when a variable is set. */
+    return 0;
 }
 
-static void parse_var_and_put_attrs(char *s) {
-    array_t    chars;
-    char      *str;
-    yed_attrs  base;
-    yed_attrs  attrs;
-
-    chars = array_make(char);
-
-    s += 1;
-    while (*s && *s != '}') { array_push(chars, *s); s += 1; }
+static void free_status_line_tokens(array_t *tokens) {
+    yed_status_line_token *tok;
 
-    base = yed_active_style_get_status_line();
+    array_traverse(*tokens, tok) {
+        if (tok->str != NULL) { free(tok->str); }
+    }
+    array_clear(*tokens);
+}
 
-    if (*s) {
-        array_zero_term(chars);
+static void flush_text_token(yed_status_line_part *part, array_t *text, int *width) {
+    yed_status_line_token tok;
 
-        str = yed_get_var((char*)array_data(chars));
-        if (str != NULL) {
-            attrs = yed_parse_attrs(str);
-            yed_combine_attrs(&base, &attrs);
-        }
-    }
+    if (array_len(*text) == 0) { return; }
 
-    yed_set_attr(base);
+    memset(&tok, 0, sizeof(tok));
+    array_zero_term(*text);
+    tok.kind  = STATUS_LINE_TOK_TEXT;
+    tok.str   = strdup(array_data(*text));
+    tok.width = *width;
+    array_push(part->tokens, tok);
 
-    array_free(chars);
+    array_clear(*text);
+    *width = 0;
 }
 
 #define GBUMP(_g, _l) ((yed_glyph*)((&((_g)->c)) + (_l)))
 
-static int get_status_line_string_width(char *s) {
-    int         width;
-    yed_glyph  *git;
-    const char *end;
-    int         last_was_perc;
-    int         len;
-    char       *expanded;
-
-    width         = 0;
+/*
+ * Parse a status line format string into tokens.
+ * This follows the same rules that the format strings have always had:
+ *
+ *     %[-=][N]x   expansion x, optionally padded to N columns
+ *     %(var)      the value of var, up to the first newline
+ *     %[attrs]    switch to attrs (combined with the status line style)
+ *     %{var}      switch to the attrs in var
+ *
+ * Parsing stops at a newline or an unterminated bracket.
+ */
+static void compile_status_line_part(yed_status_line_part *part, int which) {
+    char                  *s;
+    array_t                text;
+    int                    text_width;
+    yed_glyph             *git;
+    const char            *end;
+    int                    last_was_perc;
+    int                    len;
+    yed_status_line_token  tok;
+    char                   close;
+    char                  *name_start;
+    char                   ibuff[32];
+
+    free_status_line_tokens(&part->tokens);
+    part->uses     = 0;
+    part->compiled = 1;
+    part->rendered = 0;
+
+    s = yed_get_var(status_line_var_names[which]);
+    if (s == NULL) { return; }
+
+    text          = array_make(char);
+    text_width    = 0;
     git           = (yed_glyph*)s;
     end           = s + strlen(s);
     last_was_perc = 0;
@@ -253,213 +304,331 @@ static int get_status_line_string_width(char *s) {
 
         if (len == 1) {
             if (last_was_perc) {
-                expanded = get_expanded(&git->c);
-                if (expanded != NULL) {
-                    width += yed_get_string_width(expanded);
-                    free(expanded);
+                flush_text_token(part, &text, &text_width);
+
+                memset(&tok, 0, sizeof(tok));
+                last_was_perc = 0;
+
+                if (git->c == '-' || git->c == '=') {
+                    tok.just = git->c;
+                    git      = GBUMP(git, 1);
+                }
+                memset(ibuff, 0, sizeof(ibuff));
+                while (is_digit(git->c)) {
+                    if (strlen(ibuff) < sizeof(ibuff) - 1) { ibuff[strlen(ibuff)] = git->c; }
+                    git = GBUMP(git, 1);
                 }
+                if (strlen(ibuff)) { tok.padto = s_to_i(ibuff); }
+
+                tok.spec = git->c;
 
-                if    (git->c == '-' || git->c == '=') { git = GBUMP(git, 1); }
-                while (is_digit(git->c))               { git = GBUMP(git, 1); }
+                if (tok.spec == '(' || tok.spec == '[' || tok.spec == '{') {
+                    close      = tok.spec == '(' ? ')' : tok.spec == '[' ? ']' : '}';
+                    name_start = &git->c + 1;
 
-                if (git->c == '(') {
-                    while (git->c != ')') {
+                    while (git->c != close) {
                         git = GBUMP(git, len);
-                        if ((&(git->c) >= end)) { goto out; }
+                        if ((&(git->c) >= end)) { break; }
                         len = yed_get_glyph_len(*git);
                     }
-                    goto skip;
-                } else if (git->c == '[') {
-                    while (git->c != ']') {
-                        git = GBUMP(git, len);
-                        if ((&(git->c) >= end)) { goto out; }
-                        len = yed_get_glyph_len(*git);
+
+                    if ((&(git->c) < end)) {
+                        tok.str = strndup(name_start, &git->c - name_start);
                     }
-                    goto skip;
-                } else if (git->c == '{') {
-                    while (git->c != '}') {
-                        git = GBUMP(git, len);
-                        if ((&(git->c) >= end)) { goto out; }
-                        len = yed_get_glyph_len(*git);
+
+                    switch (tok.spec) {
+                        case '(':
+                            /* An unterminated %( expands to nothing. */
+                            if (tok.str == NULL) { goto out; }
+                            tok.kind = STATUS_LINE_TOK_EXPAND;
+                            break;
+                        case '[':
+                            tok.kind = STATUS_LINE_TOK_ATTRS;
+                            break;
+                        case '{':
+                            tok.kind = STATUS_LINE_TOK_VAR_ATTRS;
+                            break;
                     }
-                    goto skip;
+
+                    array_push(part->tokens, tok);
+
+                    if (tok.str == NULL) { goto out; }
+                } else if (tok.spec == 0) {
+                    goto out;
+                } else if (strchr("bBcfFlmnptT%", tok.spec) != NULL) {
+                    tok.kind    = STATUS_LINE_TOK_EXPAND;
+                    part->uses |= get_spec_uses(tok.spec);
+                    array_push(part->tokens, tok);
                 }
-                last_was_perc = 0;
             } else if (git->c == '\n') {
                 goto out;
             } else if (git->c == '%') {
                 last_was_perc = 1;
             } else {
-                width += yed_get_glyph_width(*git);
+                array_push(text, git->c);
+                text_width += yed_get_glyph_width(*git);
             }
         } else {
-            width += yed_get_glyph_width(*git);
+            array_push_n(text, &git->c, len);
+            text_width += yed_get_glyph_width(*git);
         }
 
         git = GBUMP(git, len);
-skip:;
     }
 
 out:;
-    return width;
+    flush_text_token(part, &text, &text_width);
+    array_free(text);
 }
 
-static void put_status_line_string(char *s, int start_col) {
-    yed_attrs   inv;
-    int         col;
-    yed_glyph  *git;
-    const char *end;
-    int         last_was_perc;
-    char       *expanded;
-    int         width;
-    int         len;
+static u64 hash_status_line_str(const char *s) {
+    u64 h;
 
-    yed_set_cursor(ys->term_rows - 1, start_col);
+    h = 0xcbf29ce484222325ULL;
 
-    if (ys->active_style) {
-        yed_set_attr(yed_active_style_get_status_line());
-    } else {
-        inv.flags = ATTR_INVERSE;
-        ATTR_SET_FG_KIND(inv.flags, ATTR_KIND_16);
+    if (s == NULL) { return 0; }
 
-        inv.fg = 0;
-        inv.bg = 0;
-        yed_set_attr(inv);
+    for (; *s; s += 1) {
+        h ^= (unsigned char)*s;
+        h *= 0x100000001b3ULL;
     }
 
-    col           = start_col;
-    git           = (yed_glyph*)s;
-    end           = s + strlen(s);
-    last_was_perc = 0;
+    return h;
+}
 
-    while ((&(git->c) < end)) {
-        width = 0;
-        len   = yed_get_glyph_len(*git);
+static void get_status_line_inputs(int uses, yed_status_line_inputs *inputs) {
+    yed_frame        *frame;
+    yed_buffer       *buffer;
+    yed_frame       **fit;
+    yed_search_index *index;
 
-        if (len == 1) {
-            if (last_was_perc) {
-                expanded = get_expanded(&git->c);
-                if (expanded != NULL) {
-                    width = yed_get_string_width(expanded);
-                    if (col + (width - 1) <= ys->term_cols) {
-                        yed_screen_print(expanded);
-                        free(expanded);
-                    } else {
-                        free(expanded);
-                        break;
-                    }
-                }
+    memset(inputs, 0, sizeof(*inputs));
 
-                if    (git->c == '-' || git->c == '=') { git = GBUMP(git, 1); }
-                while (is_digit(git->c))               { git = GBUMP(git, 1); }
+    frame  = ys->active_frame;
+    buffer = frame == NULL ? NULL : frame->buffer;
 
-                if (git->c == '(') {
-                    while (git->c != ')') {
-                        git = GBUMP(git, len);
-                        if ((&(git->c) >= end)) { goto out; }
-                        len = yed_get_glyph_len(*git);
-                    }
-                    goto skip;
-                } else if (git->c == '[') {
-                    parse_and_put_attrs((char*)&git->c);
-                    while (git->c != ']') {
-                        git = GBUMP(git, len);
-                        if ((&(git->c) >= end)) { goto out; }
-                        len = yed_get_glyph_len(*git);
-                    }
-                    goto skip;
-                } else if (git->c == '{') {
-                    parse_var_and_put_attrs((char*)&git->c);
-                    while (git->c != '}') {
-                        git = GBUMP(git, len);
-                        if ((&(git->c) >= end)) { goto out; }
-                        len = yed_get_glyph_len(*git);
-                    }
-                    goto skip;
-                }
-
-                last_was_perc = 0;
-            } else if (git->c == '\n') {
-                goto out;
-            } else if (git->c == '%') {
-                last_was_perc = 1;
-            } else {
-                width = yed_get_glyph_width(*git);
-                if (col + (width - 1) > ys->term_cols) { break; }
-                yed_screen_print_n(&git->c, len);
-            }
-        } else {
-            width = yed_get_glyph_width(*git);
-            if (col + (width - 1) > ys->term_cols) { break; }
-            yed_screen_print_n(&git->c, len);
+    if (uses & STATUS_LINE_USES_FRAME) {
+        inputs->frame = frame;
+        if (frame != NULL) {
+            inputs->frame_name_hash = hash_status_line_str(frame->name);
+        }
+    }
+    if (uses & STATUS_LINE_USES_BUFFER) {
+        inputs->buffer = buffer;
+        if (buffer != NULL) {
+            inputs->buffer_name_hash = hash_status_line_str(buffer->name);
+            inputs->buffer_path_hash = hash_status_line_str(buffer->path);
+            inputs->ft               = buffer->ft;
+        }
+    }
+    if ((uses & STATUS_LINE_USES_CURSOR) && frame != NULL) {
+        inputs->cursor_line = frame->cursor_line;
+        inputs->cursor_col  = frame->cursor_col;
+    }
+    if ((uses & STATUS_LINE_USES_LINES) && buffer != NULL) {
+        inputs->n_lines = yed_buff_n_lines(buffer);
+    }
+    if (uses & STATUS_LINE_USES_FRAMES) {
+        inputs->frame       = frame;
+        inputs->n_frames    = array_len(ys->frames);
+        inputs->frames_hash = 0xcbf29ce484222325ULL;
+        array_traverse(ys->frames, fit) {
+            inputs->frames_hash ^= (u64)(uintptr_t)*fit;
+            inputs->frames_hash *= 0x100000001b3ULL;
+        }
+    }
+    if (uses & STATUS_LINE_USES_TIME) {
+        inputs->time = time(NULL);
+    }
+    if ((uses & STATUS_LINE_USES_SEARCH) && buffer != NULL && frame != NULL) {
+        inputs->search_matches = -1;
+        inputs->search_rank    = -1;
+        if ((index = yed_buff_get_search_index(buffer)) != NULL) {
+            inputs->search_matches = index->n_matches;
+            inputs->search_rank    = yed_search_index_rank(buffer, index, frame->cursor_line, frame->cursor_col);
+            inputs->search_done    = yed_search_index_is_complete(buffer, index);
         }
+    }
 
-        col += width;
-        git = GBUMP(git, len);
-skip:;
+    inputs->term_cols  = ys->term_cols;
+    inputs->style      = ys->active_style;
+    inputs->generation = ys->status_line_generation;
+}
+
+static yed_attrs get_status_line_base_attrs(void) {
+    yed_attrs inv;
+
+    if (ys->active_style) {
+        return yed_active_style_get_status_line();
     }
-out:;
+
+    inv.flags = ATTR_INVERSE;
+    ATTR_SET_FG_KIND(inv.flags, ATTR_KIND_16);
+    inv.fg = 0;
+    inv.bg = 0;
+
+    return inv;
 }
 
-static void write_status_line_left(void) {
-    char *var;
+static void push_status_line_span(yed_status_line_part *part, yed_attrs attrs, const char *s, int len) {
+    yed_status_line_span *last;
+    yed_status_line_span  span;
 
-    var = yed_get_var("status-line-left");
-    if (var == NULL) { return; }
+    last = array_len(part->spans)
+            ? array_last(part->spans)
+            : NULL;
 
-    put_status_line_string(var, 1);
+    if (last != NULL && ATTRS_EQ(last->attrs, attrs)) {
+        last->len += len;
+    } else {
+        span.attrs = attrs;
+        span.len   = len;
+        array_push(part->spans, span);
+    }
+
+    array_push_n(part->text, (char*)s, len);
 }
 
-static void write_status_line_center(void) {
-    char *var;
-    int   width;
-    int   col;
+/*
+ * Expand the part's tokens, place the part on the line, and lay the result
+ * out into runs of text that share attributes.
+ */
+static void render_status_line_part(yed_status_line_part *part, int which) {
+    array_t                 expansions;
+    yed_status_line_token  *tok;
+    char                   *expanded;
+    char                  **eit;
+    int                     width;
+    int                     col;
+    yed_attrs               attrs;
+    yed_attrs               tok_attrs;
+    char                   *str;
+    yed_glyph              *git;
+    const char             *end;
+    int                     len;
+    int                     g_width;
+
+    array_clear(part->text);
+    array_clear(part->spans);
+
+    /* Expand everything once up front since we need the width to place it. */
+    expansions = array_make(char*);
+    width      = 0;
+
+    array_traverse(part->tokens, tok) {
+        if (tok->kind == STATUS_LINE_TOK_TEXT) {
+            width += tok->width;
+        } else if (tok->kind == STATUS_LINE_TOK_EXPAND) {
+            expanded = get_expanded(tok);
+            if (expanded != NULL) {
+                width += yed_get_string_width(expanded);
+            }
+            array_push(expansions, expanded);
+        }
+    }
 
-    var = yed_get_var("status-line-center");
-    if (var == NULL) { return; }
+    switch (which) {
+        case 0:  col = 1;                                            break;
+        case 1:  col = MAX(1, 1 + (ys->term_cols / 2) - (width / 2)); break;
+        default: col = MAX(1, ys->term_cols - width + 1);            break;
+    }
 
-    width = get_status_line_string_width(var);
-    col   = MAX(1, 1 + (ys->term_cols / 2) - (width / 2));
+    part->col = col;
+
+    attrs = get_status_line_base_attrs();
+    eit   = array_data(expansions);
+
+    array_traverse(part->tokens, tok) {
+        switch (tok->kind) {
+            case STATUS_LINE_TOK_TEXT:
+                git = (yed_glyph*)tok->str;
+                end = tok->str + strlen(tok->str);
+                while ((&(git->c) < end)) {
+                    len     = yed_get_glyph_len(*git);
+                    g_width = yed_get_glyph_width(*git);
+                    if (col + (g_width - 1) > ys->term_cols) { goto out; }
+                    push_status_line_span(part, attrs, &git->c, len);
+                    col += g_width;
+                    git  = GBUMP(git, len);
+                }
+                break;
+            case STATUS_LINE_TOK_EXPAND:
+                expanded = *eit;
+                eit     += 1;
+                if (expanded != NULL) {
+                    g_width = yed_get_string_width(expanded);
+                    if (col + (g_width - 1) > ys->term_cols) { goto out; }
+                    push_status_line_span(part, attrs, expanded, strlen(expanded));
+                    col += g_width;
+                }
+                break;
+            case STATUS_LINE_TOK_ATTRS:
+            case STATUS_LINE_TOK_VAR_ATTRS:
+                attrs = yed_active_style_get_status_line();
+                if (tok->str != NULL) {
+                    str = tok->kind == STATUS_LINE_TOK_ATTRS
+                            ? tok->str
+                            : yed_get_var(tok->str);
+                    if (str != NULL) {
+                        tok_attrs = yed_parse_attrs(str);
+                        yed_combine_attrs(&attrs, &tok_attrs);
+                    }
+                }
+                break;
+        }
+    }
+
+out:;
+    array_traverse(expansions, eit) {
+        if (*eit != NULL) { free(*eit); }
+    }
+    array_free(expansions);
 
-    put_status_line_string(var, col);
+    part->rendered = 1;
 }
 
-static void write_status_line_right(void) {
-    char *var;
-    int   width;
-    int   col;
+static void write_status_line_part(yed_status_line_part *part, int which) {
+    yed_status_line_inputs  inputs;
+    yed_status_line_span   *span;
+    char                   *text;
 
-    var = yed_get_var("status-line-right");
-    if (var == NULL) { return; }
+    if (!part->compiled) {
+        compile_status_line_part(part, which);
+    }
 
-    width = get_status_line_string_width(var);
-    col   = MAX(1, ys->term_cols - width + 1);
+    if (array_len(part->tokens) == 0) { return; }
 
-    put_status_line_string(var, col);
+    get_status_line_inputs(part->uses, &inputs);
+
+    if (!part->rendered
+    ||  memcmp(&inputs, &part->inputs, sizeof(inputs)) != 0) {
+        render_status_line_part(part, which);
+        memcpy(&part->inputs, &inputs, sizeof(inputs));
+    }
+
+    yed_set_cursor(ys->term_rows - 1, part->col);
+
+    text = array_data(part->text);
+    array_traverse(part->spans, span) {
+        yed_set_attr(span->attrs);
+        yed_screen_print_n(text, span->len);
+        text += span->len;
+    }
 }
 
 void yed_write_status_line(void) {
     yed_event event;
-    yed_attrs inv;
     int       i;
 
     event.kind = EVENT_STATUS_LINE_PRE_UPDATE;
     yed_trigger_event(&event);
 
     yed_set_cursor(ys->term_rows - 1, 1);
-
-    if (ys->active_style) {
-        yed_set_attr(yed_active_style_get_status_line());
-    } else {
-        inv.flags = ATTR_INVERSE;
-        ATTR_SET_FG_KIND(inv.flags, ATTR_KIND_16);
-        inv.fg = 0;
-        inv.bg = 0;
-        yed_set_attr(inv);
-    }
+    yed_set_attr(get_status_line_base_attrs());
     for (i = 0; i < ys->term_cols; i += 1) { yed_screen_print_n(" ", 1); }
 
-    write_status_line_left();   yed_reset_attr();
-    write_status_line_center(); yed_reset_attr();
-    write_status_line_right();  yed_reset_attr();
+    for (i = 0; i < N_STATUS_LINE_PARTS; i += 1) {
+        write_status_line_part(ys->status_line_parts + i, i);
+        yed_reset_attr();
+    }
 }
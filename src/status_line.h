@@ -1,6 +1,83 @@
 #ifndef __STATUS_LINE_H__
 #define __STATUS_LINE_H__
 
+/*
+ * The status-line-left/center/right variables are compiled into a list of
+ * tokens when they are set. Each frame, the inputs that the tokens refer to
+ * are gathered into a yed_status_line_inputs. The line is only expanded
+ * again when those inputs differ from the ones used last time.
+ */
+
+enum {
+    STATUS_LINE_TOK_TEXT,
+    STATUS_LINE_TOK_EXPAND,
+    STATUS_LINE_TOK_ATTRS,
+    STATUS_LINE_TOK_VAR_ATTRS,
+};
+
+typedef struct {
+    int   kind;
+    char *str;   /* TEXT: the text; EXPAND: var name for %(...); ATTRS: attr string; VAR_ATTRS: var name */
+    int   width; /* TEXT only. */
+    char  spec;  /* EXPAND only. */
+    char  just;  /* EXPAND only. */
+    int   padto; /* EXPAND only. */
+} yed_status_line_token;
+
+#define STATUS_LINE_USES_FRAME  (1 << 0)
+#define STATUS_LINE_USES_BUFFER (1 << 1)
+#define STATUS_LINE_USES_CURSOR (1 << 2)
+#define STATUS_LINE_USES_LINES  (1 << 3)
+#define STATUS_LINE_USES_FRAMES (1 << 4)
+#define STATUS_LINE_USES_TIME   (1 << 5)
+#define STATUS_LINE_USES_SEARCH (1 << 6)
+
+typedef struct {
+    yed_frame  *frame;
+    yed_buffer *buffer;
+    u64         frame_name_hash;
+    u64         buffer_name_hash;
+    u64         buffer_path_hash;
+    int         ft;
+    int         cursor_line;
+    int         cursor_col;
+    int         n_lines;
+    int         n_frames;
+    u64         frames_hash;
+    time_t      time;
+    int         search_matches;
+    int         search_rank;
+    int         search_done;
+    int         term_cols;
+    yed_style  *style;
+    u64         generation;
+} yed_status_line_inputs;
+
+typedef struct {
+    yed_attrs attrs;
+    int       len;
+} yed_status_line_span;
+
+typedef struct {
+    int                     compiled;
+    array_t                 tokens;
+    int                     uses;
+    int                     rendered;
+    yed_status_line_inputs  inputs;
+    int                     col;
+    array_t                 text;
+    array_t                 spans;
+} yed_status_line_part;
+
+#define N_STATUS_LINE_PARTS (3)
+
+void yed_init_status_line(void);
 void yed_write_status_line(void);
+/*
+ * Force the status line to be expanded again on the next draw.
+ * If recompile is set, the templates are also parsed again from
+ * the status-line-* variables.
+ */
+void yed_invalidate_status_line(int recompile);
 
 #endif
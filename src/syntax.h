@@ -3,34 +3,51 @@
  *
  * Fast highlighting of ASCII keywords matching [a-Z_]+[0-9a-Z_]
  *
- *     Keywords are stored in length buckets so that if we know the length
- *     of the next word in the line, we can search for matches only in one
- *     bucket and cap the string comparisons at word_lenth characters.
+ *     When the syntax is finished, each set of keywords is compiled into a
+ *     two-level perfect hash table. Looking up a word in the line costs one
+ *     hash of the word and at most one string comparison, no matter how many
+ *     keywords the language has.
  *
- *     The main advantage of this is that most keywords are somewhere in the
- *     range of 2-8 characters for most languages, but other words that may
- *     appear in the buffer are typically longer (like identifiers).
- *     In that case, we don't have to search for a match for a 16 character
- *     word because we won't have a 16 character keyword bucket.
- *
- *     The other optimization that can be made for simple keywords is that
- *     we can highlight them all in a single traversal of the line/string.
+ *     The hash of each word is computed while scanning for the end of the
+ *     word, so all keywords are highlighted in a single traversal of the
+ *     line/string.
  *
  * Matching of regular expressions on a single line
  *     Submatches can be specified.
+ *     The result of each regular expression is remembered for the rest of the line,
+ *     so patterns that don't match a line are only run on it once and a pattern that
+ *     does is only run again after highlighting has moved past its match.
  *
  * Single/multi-line ranges defined by start/end regular expressions.
  *     Can include regular expression ranges to skip (e.g. skip \" in a string literal).
  *     Regular expressions and keywords can be specified for highlighting within a specific range.
  *
- * A smart and fast caching strategy that stores states of lines with respect to multi-line range state.
- *     Self-balances the distribution of cache entries so that buffers get good coverage and random access
- *     patterns don't cause huge slowdown.
- *     Always keeps the most recently drawn line in cache so that scrolling and full frame redraws are very quick.
+ * A compact cache of the multi-line range state that each line starts in.
+ *     One byte per line, kept in a bucket array so that inserting and deleting lines only shifts a single bucket.
+ *     Looking up the state of any line is exact and never re-parses the lines above it.
+ *     After an edit, states are recomputed only until one comes out the same as before.
  *     Must parse whole buffer at least once so that the cache can always be correct (if highlighting is to be correct
  *     100% of the time, this is an unfortunate necessity). :(
+ *     That parse is done a few milliseconds at a time between frames (see the 'syntax-scan-budget-ms' variable) so
+ *     that opening a huge file doesn't lock up the editor. Until the scan reaches a line, its state is a guess made
+ *     from the lines just above it.
+ *
+ * Windowed highlighting of very long lines.
+ *     Lines wider than the 'syntax-max-line-length' variable (e.g. minified files) are only highlighted around the
+ *     columns that are in view. The range state at regular checkpoints along such a line is worked out once per
+ *     version of the line, so highlighting can start close to the window in the right state instead of at the start
+ *     of the line.
+ *
+ * Highlighting the visible rows of a frame in parallel.
+ *     Before a frame is drawn, the rows that haven't been highlighted yet are split up between the editor's worker
+ *     threads (see the 'worker-threads' variable). Each worker highlights with its own copy of the syntax, since
+ *     compiled regular expressions can't be shared between threads efficiently. The results are kept per row and
+ *     replayed when the row is drawn, until the line changes or its start state does.
  *
  * A declarative interface for defining syntax.
+ *     Defining a syntax only records its patterns and keywords. The regular expressions are compiled and the keyword
+ *     tables are built the first time the syntax is used to highlight something, so loading many language plugins at
+ *     startup is cheap and only the languages that actually get opened pay for compilation.
  *
  * Support for POSIX regex.h by default and PCRE2 when YED_SYNTAX_USE_PCRE2 is defined.
  *
@@ -74,6 +91,20 @@
  *     EVENT_BUFFER_PRE_DELETE   yed_syntax_buffer_delete_event(&syn);   Remove state cache for the buffer.
  *     EVENT_BUFFER_POST_MOD     yed_syntax_buffer_mod_event(&syn);      Update state cache for the buffer.
  *     EVENT_LINE_PRE_DRAW       yed_syntax_line_event(&syn);            Highlight the line about to be drawn.
+ *     EVENT_PRE_PUMP            yed_syntax_pump_event(&syn);            Scan buffers for multi-line range state.
+ *     EVENT_FRAME_PRE_BUFF_DRAW yed_syntax_frame_event(&syn);           Highlight the frame's rows in parallel.
+ *
+ * Like yed_syntax_line_event(), yed_syntax_frame_event() should only be called for frames whose buffer you highlight.
+ *
+ * Without an EVENT_PRE_PUMP handler, the state of a row is worked out all at once when it's first drawn, which
+ * can take a while for a row far into a large buffer.
+ *
+ * Declare your EVENT_LINE_PRE_DRAW handler as a row decorator so that frames can reuse rows whose lines haven't
+ * changed instead of highlighting them again on every draw:
+ *
+ *     static u64 syn_version(void) { return yed_syntax_decoration_version(&syn); }
+ *
+ *     yed_declare_row_decorator(eline, syn_version);
  *
  * You may choose to call yed_syntax_line_event() selectively if, for example, the buffer's ft matches the kind of
  * buffer you're trying to highlight:
@@ -93,6 +124,15 @@
  *         yed_syntax_line_event(&syn, event);
  *     }
  *
+ * Because patterns are compiled lazily, a bad regular expression is reported (and its item left out) when the syntax
+ * is first used. To find out about errors while building the syntax instead, compile it right away:
+ *
+ *     yed_syntax_end(&syn);
+ *
+ *     if (yed_syntax_compile(&syn) != 0) {
+ *         yed_cerr("bad regex: %s", yed_syntax_get_regex_err(&syn));
+ *     }
+ *
  * Free up the syntax structure when you're finished with it:
  *
  *     yed_syntax_free(&syn);
@@ -108,8 +148,16 @@
 #include <regex.h>
 #endif
 
-#define YED_SYN_CACHE_SIZE         (8192)
-#define YED_SYN_N_EVICTION_BUCKETS (4096)
+#define YED_SYN_STATES_PER_BUCKET  (16384)
+#define YED_SYN_SCAN_LOOKBACK      (256)
+#define YED_SYN_FIXUP_MAX_LINES    (1024)
+#define YED_SYN_MAX_RANGES         (256)
+#define YED_SYN_HL_CACHE_SIZE      (64)
+#define YED_SYN_HL_CACHE_MAX_LEN   (65536)
+#define YED_SYN_ROW_SLOTS          (1024)
+#define YED_SYN_CHECKPOINT_BYTES   (1024)
+#define YED_SYN_CHECKPOINT_LINES   (16)
+#define YED_SYN_WINDOW_CONTEXT     (256)
 
 /* #define YED_SYNTAX_DEBUG */
 
@@ -139,7 +187,23 @@ typedef struct {
 } _yed_syntax_kwd;
 
 typedef struct {
-    array_t kwds_by_len;
+    u32 offset;
+    u32 size;
+    u32 seed;
+} _yed_syntax_kwd_bucket;
+
+typedef struct {
+    array_t                  kwds_by_len;
+    /*
+     * Built by yed_syntax_end(). A word's hash picks a bucket, then the
+     * bucket's own seed picks a slot that no other keyword in the bucket
+     * shares. NULL if the set hasn't been compiled, in which case lookups
+     * fall back to searching kwds_by_len.
+     */
+    _yed_syntax_kwd_bucket  *buckets;
+    _yed_syntax_kwd        **slots;
+    u32                      bucket_mask;
+    u32                      bucket_seed;
 } _yed_syntax_kwd_set;
 
 use_tree(char, _yed_syntax_kwd_set);
@@ -149,29 +213,53 @@ typedef struct {
     array_t             regs;
 } _yed_syntax_items;
 
+/*
+ * The result of the last regexec() of a pattern on the line being highlighted.
+ * Offsets are from the start of the line. If the search started at `from` and
+ * the leftmost match begins at `so`, then a search from anywhere in [from, so]
+ * would find the same match, so it is reused instead of running regexec() again.
+ */
+typedef struct {
+    u64 pass;
+    int from;
+    int so;  /* -1 if there was no match. */
+    int gso; /* Span of the requested group. -1 if it didn't participate. */
+    int geo;
+} _yed_syntax_memo;
+
 typedef struct {
     _yed_syntax_attr *attr;
+    char             *pattern;
     regex_t           reg;
     int               group;
+    _yed_syntax_memo  memo;
 } _yed_syntax_regex;
 
 typedef struct {
     _yed_syntax_attr  *attr;
+    int                idx;
+    char              *start_pattern;
     regex_t            start;
+    _yed_syntax_memo   start_memo;
+    char              *end_pattern;
     regex_t            end;
+    array_t            skip_patterns;
     array_t            skips;
+    array_t            skip_memos;
     int                one_line;
     _yed_syntax_items  items;
+    int                compiled; /* The patterns above have been compiled. */
+    int                broken;   /* The start or end pattern didn't compile, so the range never starts. */
 } _yed_syntax_range;
 
 typedef struct {
-    u32 row;
-    u32 range_idx;
-} _yed_syntax_cache_entry;
-
-typedef struct {
-    array_t entries;
-    u32     size;
+    bucket_array_t states;          /* For each row, the index of the range that it starts in. */
+    u32            scan_row;        /* The states of rows up to and including this one are correct. */
+    int            scanning;        /* The scan hasn't reached the end of the buffer. */
+    u32            provisional_row; /* Lowest row past the states that was given a guess, or 0. */
+    u32            guess_row;       /* Where the last guess stopped, or 0. */
+    u32            guess_range_idx;
+    int            guess_exact;
 } _yed_syntax_cache;
 
 typedef yed_buffer *_yed_syntax_bp;
@@ -183,6 +271,57 @@ use_tree(_yed_syntax_bp, _yed_syntax_cache);
 #define CACHE_TREE_MAKE()  tree_make(_yed_syntax_bp, _yed_syntax_cache)
 #define CACHE_TREE_FREE(c) tree_free(c)
 
+typedef struct {
+    u64      hash;
+    char    *str;
+    array_t  lines; /* An array_t of yed_attrs for each line. */
+    u64      used;
+} _yed_syntax_hl_entry;
+
+typedef struct {
+    int        cstart;
+    int        cend;
+    yed_attrs *attr;
+} _yed_syntax_span;
+
+/*
+ * The highlights of a row, worked out ahead of time by a worker. Rows live in
+ * a direct-mapped table indexed by buffer and row. The spans only depend on
+ * the line's contents and the range it starts in, so a style change doesn't
+ * invalidate them (attr points into the _yed_syntax_attr).
+ */
+typedef struct {
+    yed_buffer *buffer;
+    int         row;
+    u64         line_version;
+    int         start_idx;
+    array_t     spans;
+} _yed_syntax_row;
+
+typedef struct {
+    _yed_syntax_row *slot;
+    yed_line        *line;
+} _yed_syntax_row_job;
+
+typedef struct {
+    u32 offset; /* Where highlighting resumes from. */
+    u8  idx;    /* The range that it resumes in. */
+} _yed_syntax_checkpoint;
+
+/*
+ * Where highlighting can start from in a line that's too long to highlight
+ * all at once. There is one checkpoint for every YED_SYN_CHECKPOINT_BYTES of
+ * the line. A checkpoint in the middle of a range resumes from just after the
+ * range's start, so that the end of the range is still found correctly.
+ */
+typedef struct {
+    u64     line_version;
+    int     start_idx;
+    int     end_idx;
+    array_t points;
+    u64     used;
+} _yed_syntax_checkpoints;
+
 typedef struct {
     array_t            attrs;
     array_t            attr_stack;
@@ -195,7 +334,25 @@ typedef struct {
     CACHE_TREE         caches;
     int                needs_state;
     int                max_line;
+    int                scan_budget_us;
+    int                pumped;   /* yed_syntax_pump_event() has been called, so scans can be left to it. */
     int                finalized;
+    int                compiled;
+    u64                version;
+    u64                pass;
+    array_t            hl_cache;
+    u64                hl_clock;
+    array_t           *record;   /* If not NULL, _yed_syntax_line() appends _yed_syntax_spans here instead. */
+    array_t            rows;     /* YED_SYN_ROW_SLOTS _yed_syntax_rows, once a frame has been highlighted in parallel. */
+    array_t            row_jobs;
+    array_t            workers;  /* A yed_syntax* for each worker thread. The main thread uses the syntax itself. */
+    array_t            checkpoints;
+    u64                checkpoint_clock;
+    const char        *line_end;  /* Where regexec() has to stop in the current pass. */
+    int                eol_flags; /* REG_NOTEOL if that isn't the real end of the line. */
+    u64                col_version;
+    int                col_idx;
+    int                col_col;
 } yed_syntax;
 
 
@@ -204,13 +361,26 @@ typedef struct {
 /************************************************************************************/
 
 static inline void _yed_syntax_make_kwd_set(_yed_syntax_kwd_set *set) {
+    memset(set, 0, sizeof(*set));
     set->kwds_by_len = array_make(array_t);
 }
 
+static inline void _yed_syntax_kwd_set_free_table(_yed_syntax_kwd_set *set) {
+    if (set->buckets != NULL) { free(set->buckets); }
+    if (set->slots   != NULL) { free(set->slots);   }
+
+    set->buckets     = NULL;
+    set->slots       = NULL;
+    set->bucket_mask = 0;
+    set->bucket_seed = 0;
+}
+
 static inline void _yed_syntax_free_kwd_set(_yed_syntax_kwd_set *set) {
     array_t         *kwd_list_it;
     _yed_syntax_kwd *kwd_it;
 
+    _yed_syntax_kwd_set_free_table(set);
+
     array_traverse(set->kwds_by_len, kwd_list_it) {
         array_traverse(*kwd_list_it, kwd_it) {
             free(kwd_it->kwd);
@@ -256,12 +426,220 @@ static inline _yed_syntax_kwd * _yed_syntax_kwd_set_add(_yed_syntax_kwd_set *set
 
     k.kwd = strdup(kwd);
 
+    /* The table points into the lists, which may have just moved. */
+    _yed_syntax_kwd_set_free_table(set);
+
     return (_yed_syntax_kwd*)array_insert(*kwd_list, idx, k);
 }
 
-static inline _yed_syntax_kwd * _yed_syntax_kwd_set_lookup(_yed_syntax_kwd_set *set, const char *kwd, int len) {
-    array_t         *kwd_list;
-    _yed_syntax_kwd *it;
+#define _YED_SYNTAX_KWD_HASH_INIT (0xcbf29ce484222325ULL)
+#define _YED_SYNTAX_KWD_HASH_STEP(_h, _c) (((_h) ^ (unsigned char)(_c)) * 0x100000001b3ULL)
+
+static inline u64 _yed_syntax_kwd_hash(const char *kwd, int len) {
+    u64 h;
+    int i;
+
+    h = _YED_SYNTAX_KWD_HASH_INIT;
+    for (i = 0; i < len; i += 1) {
+        h = _YED_SYNTAX_KWD_HASH_STEP(h, kwd[i]);
+    }
+
+    return h;
+}
+
+static inline u32 _yed_syntax_kwd_hash_mix(u64 h, u32 seed) {
+    h ^= seed * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return (u32)h;
+}
+
+static inline u32 _yed_syntax_kwd_pow2(u32 n) {
+    u32 p;
+
+    p = 1;
+    while (p < n) { p <<= 1; }
+
+    return p;
+}
+
+#define _YED_SYNTAX_KWD_MAX_SEEDS (256)
+
+static inline void _yed_syntax_kwd_set_compile(_yed_syntax_kwd_set *set) {
+    array_t           *kwd_list_it;
+    _yed_syntax_kwd   *kwd_it;
+    u32                n;
+    u32                n_buckets;
+    u32                i;
+    u32                j;
+    u32                b;
+    u32                seed;
+    u32                total;
+    u32                size;
+    u32                slot;
+    _yed_syntax_kwd  **kwds;
+    u64               *hashes;
+    u32               *counts;
+    u32               *starts;
+    u32               *order;
+    u32               *slot_of;
+    char              *taken;
+    int                ok;
+
+    _yed_syntax_kwd_set_free_table(set);
+
+    n = 0;
+    array_traverse(set->kwds_by_len, kwd_list_it) {
+        n += array_len(*kwd_list_it);
+    }
+
+    if (n == 0) { return; }
+
+    n_buckets = _yed_syntax_kwd_pow2(n);
+
+    kwds    = (_yed_syntax_kwd**)malloc(n * sizeof(*kwds));
+    hashes  = (u64*)malloc(n * sizeof(*hashes));
+    counts  = (u32*)calloc(n_buckets, sizeof(*counts));
+    starts  = (u32*)calloc(n_buckets + 1, sizeof(*starts));
+    order   = (u32*)malloc(n * sizeof(*order));
+    slot_of = (u32*)malloc(n * sizeof(*slot_of));
+
+    set->buckets = (_yed_syntax_kwd_bucket*)calloc(n_buckets, sizeof(*set->buckets));
+
+    i = 0;
+    array_traverse(set->kwds_by_len, kwd_list_it) {
+        array_traverse(*kwd_list_it, kwd_it) {
+            kwds[i]   = kwd_it;
+            hashes[i] = _yed_syntax_kwd_hash(kwd_it->kwd, strlen(kwd_it->kwd));
+            i += 1;
+        }
+    }
+
+    /*
+     * First level: find a seed that spreads the keywords out so that the
+     * sum of the squared bucket sizes (the space the second level needs)
+     * stays linear in the number of keywords.
+     */
+    ok = 0;
+    for (seed = 1; seed <= _YED_SYNTAX_KWD_MAX_SEEDS; seed += 1) {
+        memset(counts, 0, n_buckets * sizeof(*counts));
+        for (i = 0; i < n; i += 1) {
+            counts[_yed_syntax_kwd_hash_mix(hashes[i], seed) & (n_buckets - 1)] += 1;
+        }
+
+        total = 0;
+        for (b = 0; b < n_buckets; b += 1) {
+            total += counts[b] * counts[b];
+        }
+
+        if (total <= 4 * n) { ok = 1; break; }
+    }
+
+    if (!ok) { goto fail; }
+
+    set->bucket_mask = n_buckets - 1;
+    set->bucket_seed = seed;
+
+    /* Group the keywords by bucket. */
+    for (b = 0; b < n_buckets; b += 1) {
+        starts[b + 1] = starts[b] + counts[b];
+    }
+    memset(counts, 0, n_buckets * sizeof(*counts));
+    for (i = 0; i < n; i += 1) {
+        b = _yed_syntax_kwd_hash_mix(hashes[i], set->bucket_seed) & set->bucket_mask;
+        order[starts[b] + counts[b]] = i;
+        counts[b] += 1;
+    }
+
+    /*
+     * Second level: give each bucket a power of two sized table of at least
+     * count^2 slots and a seed that places every keyword in it without a
+     * collision.
+     */
+    total = 0;
+    for (b = 0; b < n_buckets; b += 1) {
+        if (counts[b] == 0) { continue; }
+
+        size = _yed_syntax_kwd_pow2(counts[b] * counts[b]);
+
+        for (;;) {
+            taken = (char*)malloc(size);
+            ok    = 0;
+
+            for (seed = 1; seed <= _YED_SYNTAX_KWD_MAX_SEEDS; seed += 1) {
+                memset(taken, 0, size);
+                ok = 1;
+                for (j = starts[b]; j < starts[b + 1]; j += 1) {
+                    slot = _yed_syntax_kwd_hash_mix(hashes[order[j]], seed) & (size - 1);
+                    if (taken[slot]) { ok = 0; break; }
+                    taken[slot]         = 1;
+                    slot_of[order[j]]   = slot;
+                }
+                if (ok) { break; }
+            }
+
+            free(taken);
+
+            if (ok) { break; }
+
+            /* Only identical hashes can get us here with a huge table. */
+            if (size >= 64 * counts[b] * counts[b]) { goto fail; }
+
+            size <<= 1;
+        }
+
+        set->buckets[b].offset = total;
+        set->buckets[b].size   = size;
+        set->buckets[b].seed   = seed;
+
+        total += size;
+    }
+
+    set->slots = (_yed_syntax_kwd**)calloc(total, sizeof(*set->slots));
+
+    for (i = 0; i < n; i += 1) {
+        b = _yed_syntax_kwd_hash_mix(hashes[i], set->bucket_seed) & set->bucket_mask;
+        set->slots[set->buckets[b].offset + slot_of[i]] = kwds[i];
+    }
+
+    goto out;
+
+fail:;
+    _yed_syntax_kwd_set_free_table(set);
+
+out:;
+    free(slot_of);
+    free(order);
+    free(starts);
+    free(counts);
+    free(hashes);
+    free(kwds);
+}
+
+static inline _yed_syntax_kwd * _yed_syntax_kwd_set_lookup_hashed(_yed_syntax_kwd_set *set, const char *kwd, int len, u64 hash) {
+    array_t                *kwd_list;
+    _yed_syntax_kwd        *it;
+    _yed_syntax_kwd_bucket *bucket;
+    int                     cmp;
+
+    if (set->slots != NULL) {
+        bucket = set->buckets + (_yed_syntax_kwd_hash_mix(hash, set->bucket_seed) & set->bucket_mask);
+        if (bucket->size == 0) { return NULL; }
+
+        it = set->slots[bucket->offset + (_yed_syntax_kwd_hash_mix(hash, bucket->seed) & (bucket->size - 1))];
+
+        if (it != NULL
+        &&  strncmp(it->kwd, kwd, len) == 0
+        &&  it->kwd[len] == 0) {
+            return it;
+        }
+
+        return NULL;
+    }
 
     if (!len || len > array_len(set->kwds_by_len)) {
         return NULL;
@@ -269,19 +647,21 @@ static inline _yed_syntax_kwd * _yed_syntax_kwd_set_lookup(_yed_syntax_kwd_set *
 
     kwd_list = (array_t*)array_item(set->kwds_by_len, len - 1);
 
+    /* The list is sorted, so stop once we've passed where kwd would be. */
     array_traverse(*kwd_list, it) {
-        if (it->kwd[0] > kwd[0]) {
-            continue;
-        }
+        cmp = strncmp(it->kwd, kwd, len);
 
-        if (strncmp(it->kwd, kwd, len) == 0) {
-            return it;
-        }
+        if      (cmp == 0) { return it; }
+        else if (cmp > 0)  { break;     }
     }
 
     return NULL;
 }
 
+static inline _yed_syntax_kwd * _yed_syntax_kwd_set_lookup(_yed_syntax_kwd_set *set, const char *kwd, int len) {
+    return _yed_syntax_kwd_set_lookup_hashed(set, kwd, len, _yed_syntax_kwd_hash(kwd, len));
+}
+
 static inline int _yed_syntax_line_get_word_len(yed_line *line, int col) {
     yed_glyph *g;
     yed_glyph *end;
@@ -321,10 +701,11 @@ static inline int _yed_syntax_line_get_word_len(yed_line *line, int col) {
     return len;
 }
 
-static inline void _yed_syntax_free_items(_yed_syntax_items *items);
+static inline void _yed_syntax_free_items(_yed_syntax_items *items, int compiled);
 
-static inline void _yed_syntax_free_regex(_yed_syntax_regex *regex) {
-    regfree(&regex->reg);
+static inline void _yed_syntax_free_regex(_yed_syntax_regex *regex, int compiled) {
+    if (compiled) { regfree(&regex->reg); }
+    free(regex->pattern);
 }
 
 static inline void _yed_syntax_make_empty_items(_yed_syntax_items *items) {
@@ -332,12 +713,12 @@ static inline void _yed_syntax_make_empty_items(_yed_syntax_items *items) {
     items->regs = array_make(_yed_syntax_regex);
 }
 
-static inline void _yed_syntax_free_items(_yed_syntax_items *items) {
+static inline void _yed_syntax_free_items(_yed_syntax_items *items, int compiled) {
     _yed_syntax_regex *rit;
 
     if (array_data(items->regs) != NULL) {
         array_traverse(items->regs, rit) {
-            _yed_syntax_free_regex(rit);
+            _yed_syntax_free_regex(rit, compiled);
         }
         array_free(items->regs);
     }
@@ -348,32 +729,47 @@ static inline void _yed_syntax_make_range(_yed_syntax_range *range) {
     memset(range, 0, sizeof(*range));
 
     _yed_syntax_make_empty_items(&range->items);
-    range->skips = array_make(regex_t);
+    range->skip_patterns = array_make(char*);
+    range->skips         = array_make(regex_t);
+    range->skip_memos    = array_make(_yed_syntax_memo);
 }
 
 static inline void _yed_syntax_free_range(_yed_syntax_range *range) {
-    regex_t *sit;
+    regex_t  *sit;
+    char    **pit;
 
     array_traverse(range->skips, sit) {
         regfree(sit);
     }
     array_free(range->skips);
+    array_free(range->skip_memos);
+
+    array_traverse(range->skip_patterns, pit) {
+        free(*pit);
+    }
+    array_free(range->skip_patterns);
 
-    regfree(&range->end);
-    regfree(&range->start);
+    if (range->compiled && !range->broken) {
+        if (range->end_pattern   != NULL) { regfree(&range->end);   }
+        if (range->start_pattern != NULL) { regfree(&range->start); }
+    }
+
+    if (range->end_pattern   != NULL) { free(range->end_pattern);   }
+    if (range->start_pattern != NULL) { free(range->start_pattern); }
 
-    _yed_syntax_free_items(&range->items);
+    _yed_syntax_free_items(&range->items, range->compiled);
 
     free(range);
 }
 
-static inline void _yed_syntax_make_cache(_yed_syntax_cache *cache, u32 size) {
-    cache->entries = array_make_with_cap(_yed_syntax_cache_entry, size);
-    cache->size    = size;
+static inline void _yed_syntax_make_cache(_yed_syntax_cache *cache) {
+    memset(cache, 0, sizeof(*cache));
+
+    cache->states = bucket_array_make(YED_SYN_STATES_PER_BUCKET, u8);
 }
 
 static inline void _yed_syntax_free_cache(_yed_syntax_cache *cache) {
-    array_free(cache->entries);
+    bucket_array_free(cache->states);
 }
 
 static inline _yed_syntax_attr *_yed_syntax_top_attr(yed_syntax *syntax) {
@@ -388,303 +784,225 @@ static inline _yed_syntax_range *_yed_syntax_top_range(yed_syntax *syntax) {
     return syntax->global;
 }
 
-static inline int _yed_syntax_get_range_idx(yed_syntax *syntax, _yed_syntax_range *range) {
-    int range_idx;
-
-    for (range_idx = 0; range_idx < array_len(syntax->ranges); range_idx += 1) {
-        if (range == *(_yed_syntax_range**)array_item(syntax->ranges, range_idx)) {
-            return range_idx;
-        }
-    }
-
-    return -1;
-}
-
 
 
 /************************************************************************************/
-/*                                      cache                                       */
+/*                                   compilation                                    */
 /************************************************************************************/
 
-static inline void _yed_syntax_build_cache(yed_syntax *syntax, yed_buffer *buffer);
-static inline _yed_syntax_range *_yed_syntax_get_line_end_state(yed_syntax *syntax, yed_buffer *buffer, yed_line *line, _yed_syntax_range *start_range);
+static inline void _yed_syntax_set_regex_err(yed_syntax *syntax, int err, regex_t *reg, const char *pattern) {
+    size_t err_len;
 
-static inline _yed_syntax_cache *_yed_syntax_get_cache(yed_syntax *syntax, yed_buffer *buffer) {
-    CACHE_IT it;
-
-    it = tree_lookup(syntax->caches, buffer);
-
-    if (!tree_it_good(it)) {
-        _yed_syntax_build_cache(syntax, buffer);
-        it = tree_lookup(syntax->caches, buffer);
-    }
+    err_len = regerror(err, reg, NULL, 0);
+    if (syntax->regex_err_str != NULL) { free(syntax->regex_err_str); }
+    syntax->regex_err_str = (char*)malloc(err_len);
+    regerror(err, reg, syntax->regex_err_str, err_len);
 
-    return &tree_it_val(it);
+    LOG_FN_ENTER();
+    yed_log("syntax.h: couldn't compile '%s': %s", pattern, syntax->regex_err_str);
+    LOG_EXIT();
 }
 
-static inline void _yed_syntax_remove_cache(yed_syntax *syntax, yed_buffer *buffer) {
-    CACHE_IT it;
-
-    if (!syntax->finalized || buffer == NULL) { return; }
-
-    it = tree_lookup(syntax->caches, buffer);
+static inline void _yed_syntax_compile_range(yed_syntax *syntax, _yed_syntax_range *range) {
+    int                 err;
+    char              **pit;
+    regex_t             reg;
+    _yed_syntax_memo    memo;
+    _yed_syntax_regex  *rit;
+    int                 i;
+
+    if (range != syntax->global && !range->broken) {
+        err = regcomp(&range->start, range->start_pattern, REG_EXTENDED);
+
+        if (err) {
+            _yed_syntax_set_regex_err(syntax, err, &range->start, range->start_pattern);
+            range->broken = 1;
+        } else if (range->end_pattern == NULL) {
+            /* yed_syntax_range_end() was never called. */
+            regfree(&range->start);
+            range->broken = 1;
+        } else {
+            err = regcomp(&range->end, range->end_pattern, REG_EXTENDED);
 
-    if (tree_it_good(it)) {
-        _yed_syntax_free_cache(&tree_it_val(it));
-        tree_delete(syntax->caches, buffer);
+            if (err) {
+                _yed_syntax_set_regex_err(syntax, err, &range->end, range->end_pattern);
+                regfree(&range->start);
+                range->broken = 1;
+            }
+        }
     }
-}
-
-static inline void _yed_syntax_cache_evict_one(yed_syntax *syntax, _yed_syntax_cache *cache) {
-    _yed_syntax_cache_entry *it;
-    int                      min_row;
-    int                      max_row;
-    int                      distance;
-    int                      buckets[YED_SYN_N_EVICTION_BUCKETS];
-    int                      bump;
-    u32                      lim;
-    int                      max_bucket_idx;
-    int                      i;
-    int                      idx;
 
-    (void)syntax;
+    /* Patterns that don't compile are dropped, so that copies of the syntax can compile everything that's left. */
+    i = 0;
+    while (i < array_len(range->skip_patterns)) {
+        pit = (char**)array_item(range->skip_patterns, i);
+        err = regcomp(&reg, *pit, REG_EXTENDED);
 
-    if (array_len(cache->entries) > 0) {
-        it       = (_yed_syntax_cache_entry*)array_item(cache->entries, 0);
-        min_row  = it->row;
-        it       = (_yed_syntax_cache_entry*)array_last(cache->entries);
-        max_row  = it->row;
-        distance = max_row - min_row;
-
-        memset(buckets, 0, sizeof(buckets[0]) * YED_SYN_N_EVICTION_BUCKETS);
-
-        bump = MAX(distance / YED_SYN_N_EVICTION_BUCKETS, 1);
-        lim  = 1 + bump;
-        idx  = 0;
+        if (err) {
+            _yed_syntax_set_regex_err(syntax, err, &reg, *pit);
+            free(*pit);
+            array_delete(range->skip_patterns, i);
+        } else {
+            array_push(range->skips, reg);
+            memset(&memo, 0, sizeof(memo));
+            array_push(range->skip_memos, memo);
+            i += 1;
+        }
+    }
 
-        array_traverse(cache->entries, it) {
-            if (it->row < lim) {
-                buckets[idx] += 1;
-            } else {
-                lim += bump;
-                idx += 1;
+    i = 0;
+    while (i < array_len(range->items.regs)) {
+        rit = (_yed_syntax_regex*)array_item(range->items.regs, i);
+        err = regcomp(&rit->reg, rit->pattern, REG_EXTENDED);
 
-                /* Things don't always divide nicely, but that's okay. Just keep this in check. */
-                idx = MIN(idx, YED_SYN_N_EVICTION_BUCKETS - 1);
-            }
+        if (err) {
+            _yed_syntax_set_regex_err(syntax, err, &rit->reg, rit->pattern);
+            free(rit->pattern);
+            array_delete(range->items.regs, i);
+        } else {
+            i += 1;
         }
+    }
 
-        max_bucket_idx = YED_SYN_N_EVICTION_BUCKETS - 1;
-        for (i = YED_SYN_N_EVICTION_BUCKETS - 2; i >= 0; i -= 1) {
-            if (buckets[i] > buckets[max_bucket_idx]) { max_bucket_idx = i; }
-        }
+    _yed_syntax_kwd_set_compile(&range->items.kwds);
 
-        idx = (array_len(cache->entries) * max_bucket_idx) / YED_SYN_N_EVICTION_BUCKETS;
-        array_delete(cache->entries, idx);
-    }
+    range->compiled = 1;
 }
 
-static inline int _yed_syntax_cache_is_full(yed_syntax *syntax, _yed_syntax_cache *cache) {
-    (void)syntax;
-    return (u32)array_len(cache->entries) == cache->size;
-}
+static inline void _yed_syntax_parse_attrs(yed_syntax *syntax) {
+    _yed_syntax_attr **ait;
+    _yed_syntax_attr  *a;
 
-static inline void _yed_syntax_cache_evict_if_full(yed_syntax *syntax, _yed_syntax_cache *cache) {
-    if (_yed_syntax_cache_is_full(syntax, cache)) {
-        _yed_syntax_cache_evict_one(syntax, cache);
+    array_traverse(syntax->attrs, ait) {
+        a       = *ait;
+        a->attr = yed_parse_attrs(a->str);
     }
 }
 
-static inline _yed_syntax_cache_entry *_yed_syntax_cache_lookup_exact(yed_syntax *syntax, _yed_syntax_cache *cache, u32 row) {
-    int                      l;
-    int                      r;
-    int                      m;
-    _yed_syntax_cache_entry *it;
-
-    (void)syntax;
-
-    l = 0;
-    r = array_len(cache->entries) - 1;
+static inline void _yed_syntax_compile(yed_syntax *syntax) {
+    _yed_syntax_range **rit;
 
-    while (l <= r) {
-        m  = (l + r) / 2;
-        it = (_yed_syntax_cache_entry*)array_item(cache->entries, m);
+    _yed_syntax_parse_attrs(syntax);
 
-        if (it->row < row) {
-            l = m + 1;
-        } else if (it->row > row) {
-            r = m - 1;
-        } else {
-            return it;
-        }
+    array_traverse(syntax->ranges, rit) {
+        _yed_syntax_compile_range(syntax, *rit);
     }
 
-    return NULL;
+    syntax->matches  = (regmatch_t*)malloc(sizeof(*syntax->matches) * (syntax->max_group + 1));
+    syntax->compiled = 1;
 }
 
-static inline _yed_syntax_cache_entry *_yed_syntax_cache_lookup_nearest(yed_syntax *syntax, _yed_syntax_cache *cache, u32 row) {
-    int                      len;
-    _yed_syntax_cache_entry *it;
-    int                      l;
-    int                      r;
-    int                      m;
-
-    (void)syntax;
 
-    len = array_len(cache->entries);
-    if (len == 0) { return NULL; }
 
-    it = (_yed_syntax_cache_entry*)array_item(cache->entries, 0);
-    if (it->row > row) { return NULL; }
+/************************************************************************************/
+/*                                      cache                                       */
+/************************************************************************************/
 
-    it = (_yed_syntax_cache_entry*)array_last(cache->entries);
-    if (it->row < row) { return (_yed_syntax_cache_entry*)array_last(cache->entries); }
+static inline void _yed_syntax_start_scan(yed_syntax *syntax, yed_buffer *buffer);
+static inline _yed_syntax_range *_yed_syntax_get_line_end_state(yed_syntax *syntax, yed_buffer *buffer, yed_line *line, _yed_syntax_range *start_range);
 
-    l = 0;
-    r = len - 1;
+static inline _yed_syntax_cache *_yed_syntax_get_cache(yed_syntax *syntax, yed_buffer *buffer) {
+    CACHE_IT it;
 
-    while (l <= r) {
-        m  = (l + r) / 2;
-        it = (_yed_syntax_cache_entry*)array_item(cache->entries, m);
+    it = tree_lookup(syntax->caches, buffer);
 
-        if (it->row < row) {
-            l = m + 1;
-        } else if (it->row > row) {
-            r = m - 1;
-        } else {
-            return it;
-        }
+    if (!tree_it_good(it)) {
+        _yed_syntax_start_scan(syntax, buffer);
+        it = tree_lookup(syntax->caches, buffer);
     }
 
-    return (_yed_syntax_cache_entry*)array_item(cache->entries, r);
+    return &tree_it_val(it);
 }
 
-static inline int _yed_syntax_cache_insert_point(yed_syntax *syntax, _yed_syntax_cache *cache, u32 row) {
-    int                      len;
-    _yed_syntax_cache_entry *it;
-    int                      l;
-    int                      r;
-    int                      m;
-
-    (void)syntax;
-
-    len = array_len(cache->entries);
-    if (len == 0) { return 0; }
-
-    it = (_yed_syntax_cache_entry*)array_item(cache->entries, 0);
-    if (it->row > row) { return 0; }
-
-    it = (_yed_syntax_cache_entry*)array_last(cache->entries);
-    if (it->row < row) { return len; }
+static inline void _yed_syntax_remove_cache(yed_syntax *syntax, yed_buffer *buffer) {
+    CACHE_IT it;
 
-    l = 0;
-    r = len - 1;
+    if (!syntax->finalized || buffer == NULL) { return; }
 
-    while (l <= r) {
-        m  = (l + r) / 2;
-        it = (_yed_syntax_cache_entry*)array_item(cache->entries, m);
+    it = tree_lookup(syntax->caches, buffer);
 
-        if (it->row < row) {
-            l = m + 1;
-        } else if (it->row > row) {
-            r = m - 1;
-        } else {
-            return m;
-        }
+    if (tree_it_good(it)) {
+        _yed_syntax_free_cache(&tree_it_val(it));
+        tree_delete(syntax->caches, buffer);
     }
-
-    return r + 1;
 }
 
-static inline _yed_syntax_cache_entry *_yed_syntax_add_to_cache(yed_syntax *syntax, _yed_syntax_cache *cache, u32 row, _yed_syntax_range *range) {
-    int                      range_idx;
-    int                      idx;
-    _yed_syntax_cache_entry *it;
-    _yed_syntax_cache_entry  new_entry;
+static inline _yed_syntax_range *_yed_syntax_cache_get(yed_syntax *syntax, _yed_syntax_cache *cache, u32 row) {
+    return *(_yed_syntax_range**)array_item(syntax->ranges, *(u8*)bucket_array_item(cache->states, row - 1));
+}
 
-    range_idx = _yed_syntax_get_range_idx(syntax, range);
-    if (range_idx == -1) { range_idx = 0; }
+/*
+ * Set the state of a row that has one, or add the state of the next row.
+ * Returns non-zero if an existing state was changed.
+ */
+static inline int _yed_syntax_cache_set(_yed_syntax_cache *cache, u32 row, _yed_syntax_range *range) {
+    u8  idx;
+    u8 *state;
 
-    it = (_yed_syntax_cache_entry*)array_last(cache->entries);
+    idx = range->idx;
 
-    /* Fast path for building from scratch. */
-    if (it == NULL) {
-        new_entry.row       = row;
-        new_entry.range_idx = range_idx;
-        _yed_syntax_cache_evict_if_full(syntax, cache);
-        return (_yed_syntax_cache_entry*)array_push(cache->entries, new_entry);
-    } else {
-        if (it->row < row) {
-            new_entry.row       = row;
-            new_entry.range_idx = range_idx;
-            _yed_syntax_cache_evict_if_full(syntax, cache);
-            return (_yed_syntax_cache_entry*)array_push(cache->entries, new_entry);
-        } else if (it->row == row) {
-            it->range_idx = range_idx;
-            return it;
-        }
+    if (row > bucket_array_len(cache->states)) {
+        bucket_array_push(cache->states, idx);
+        return 0;
     }
 
-    /* Try to insert into an existing entry. */
-    it = _yed_syntax_cache_lookup_exact(syntax, cache, row);
-    if (it != NULL) {
-        it->range_idx = range_idx;
-        return it;
-    }
+    state = (u8*)bucket_array_item(cache->states, row - 1);
 
-    /* Nope, so we might have to evict. */
-    _yed_syntax_cache_evict_if_full(syntax, cache);
+    if (*state == idx) { return 0; }
 
-    idx                 = _yed_syntax_cache_insert_point(syntax, cache, row);
-    new_entry.row       = row;
-    new_entry.range_idx = range_idx;
+    *state = idx;
 
-    return (_yed_syntax_cache_entry*)array_insert(cache->entries, idx, new_entry);
+    return 1;
 }
 
-static inline void _yed_syntax_build_cache(yed_syntax *syntax, yed_buffer *buffer) {
-#ifdef YED_SYNTAX_DEBUG
-    u64                start;
-#endif
-
+/*
+ * Computing the state of every line in a large buffer takes too long to do all
+ * at once, so the states are filled in by a scan that runs a little at a time
+ * from yed_syntax_pump_event(). Rows the scan hasn't reached get a provisional
+ * state from the lines just above them until it catches up. If nothing calls
+ * yed_syntax_pump_event(), the scan is run up to a row when the row's state
+ * is needed instead.
+ */
+static inline void _yed_syntax_start_scan(yed_syntax *syntax, yed_buffer *buffer) {
     CACHE_IT           it;
     _yed_syntax_cache  new_cache;
     _yed_syntax_cache *cache;
-    u32                n_lines;
-    u32                bump;
-    u32                lim;
-    _yed_syntax_range *range;
-    u32                row;
-    yed_line          *line;
-    _yed_syntax_range *new_range;
 
     if (!syntax->finalized || !syntax->needs_state) { return; }
 
-#ifdef YED_SYNTAX_DEBUG
-    start = measure_time_now_ms();
-#endif
+    _yed_syntax_remove_cache(syntax, buffer);
 
-    it = tree_lookup(syntax->caches, buffer);
+    _yed_syntax_make_cache(&new_cache);
+    it    = tree_insert(syntax->caches, buffer, new_cache);
+    cache = &tree_it_val(it);
 
-    if (!tree_it_good(it)) {
-        _yed_syntax_make_cache(&new_cache, YED_SYN_CACHE_SIZE);
-        it = tree_insert(syntax->caches, buffer, new_cache);
-    }
+    /* The first row never starts in a range. */
+    _yed_syntax_cache_set(cache, 1, syntax->global);
 
-    cache = &tree_it_val(it);
+    cache->scan_row = 1;
+    cache->scanning = 1;
+}
 
-    array_clear(cache->entries);
+/* Returns non-zero if the scan still has more to do. */
+static inline int _yed_syntax_scan(yed_syntax *syntax, yed_buffer *buffer, _yed_syntax_cache *cache, u64 deadline_us) {
+    u32                n_lines;
+    u32                row;
+    u32                n;
+    int                changed;
+    _yed_syntax_range *range;
+    yed_line          *line;
+    _yed_syntax_range *new_range;
+
+    if (!cache->scanning) { return 0; }
 
     n_lines = yed_buff_n_lines(buffer);
-    bump    = n_lines < cache->size
-                ? 1
-                : MAX(n_lines / cache->size, 2);
-    lim     = 1 + bump;
-    range   = syntax->global;
-    row     = 1;
+    row     = cache->scan_row;
+    range   = _yed_syntax_cache_get(syntax, cache, row);
+    n       = 0;
+    changed = 0;
 
-    bucket_array_traverse(buffer->lines, line) {
-        if (row == n_lines) { break; }
+    bucket_array_traverse_from(buffer->lines, line, row - 1) {
+        if (row >= n_lines) { break; }
 
         if (line->visual_width > 0) {
             array_zero_term(line->chars);
@@ -692,44 +1010,91 @@ static inline void _yed_syntax_build_cache(yed_syntax *syntax, yed_buffer *buffe
             if (!new_range->one_line) { range = new_range; }
         }
 
-        if (row == lim) {
-            _yed_syntax_add_to_cache(syntax, cache, row + 1, range);
-            lim += bump;
-        }
+        row     += 1;
+        changed |= _yed_syntax_cache_set(cache, row, range);
 
-        row += 1;
+        n += 1;
+        if ((n & 63) == 0 && measure_time_now_us() >= deadline_us) { break; }
+    }
+
+    cache->scan_row = row;
+
+    if (row >= n_lines) {
+        cache->scanning = 0;
+        DBG("scan: reached row %u", row);
     }
 
-    DBG("cache: %llu ms", measure_time_now_ms() - start);
+    /* Rows that were drawn with a guess or an out of date state need to be drawn again. */
+    if (changed
+    ||  (cache->provisional_row != 0 && (!cache->scanning || row >= cache->provisional_row))) {
+        cache->provisional_row  = 0;
+        cache->guess_row        = 0;
+        syntax->version        += 1;
+    }
+
+    return cache->scanning;
 }
 
 static _yed_syntax_range *_yed_syntax_get_start_state(yed_syntax *syntax, yed_buffer *buffer, u32 row) {
-    _yed_syntax_cache       *cache;
-    _yed_syntax_cache_entry *it;
-    u32                      r;
-    _yed_syntax_range       *range;
-    _yed_syntax_range       *new_range;
-    yed_line                *line;
+    _yed_syntax_cache *cache;
+    u32                n_states;
+    u32                r;
+    _yed_syntax_range *range;
+    _yed_syntax_range *new_range;
+    yed_line          *line;
+    int                exact;
 
     if (!syntax->finalized || !syntax->needs_state || buffer == NULL || row <= 1) { return syntax->global; }
 
-    if (row <= 1) { return syntax->global; }
+    cache    = _yed_syntax_get_cache(syntax, buffer);
+
+    /* Nothing else is going to scan, so do it now. A deadline of 0 scans one short stretch at a time. */
+    if (!syntax->pumped) {
+        while (cache->scanning && cache->scan_row < row) {
+            _yed_syntax_scan(syntax, buffer, cache, 0);
+        }
+    }
 
-    cache = _yed_syntax_get_cache(syntax, buffer);
-    it    = _yed_syntax_cache_lookup_nearest(syntax, cache, row);
+    n_states = bucket_array_len(cache->states);
 
-    if (it == NULL) {
-        range = syntax->global;
-        r     = 1;
-    } else {
-        r     = it->row;
-        range = *(_yed_syntax_range**)array_item(syntax->ranges, it->range_idx);
+    /*
+     * Rows between the scan and the last state we have (e.g. after a change
+     * that reached a long way) may be out of date, but the scan will bump the
+     * version if it changes them.
+     */
+    if (row <= n_states) {
+        return _yed_syntax_cache_get(syntax, cache, row);
+    }
+
+    r     = n_states;
+    range = _yed_syntax_cache_get(syntax, cache, r);
+    exact = r <= cache->scan_row;
+
+    /*
+     * Further past the end of the states, walk from the last row we guessed
+     * at if it is close, or else start fresh a little way above the row.
+     * Starting fresh may give the wrong state, so the row is drawn again once
+     * the scan gets here.
+     */
+    if (cache->scanning && row - r > YED_SYN_SCAN_LOOKBACK) {
+        if (cache->guess_row != 0
+        &&  cache->guess_row <= row
+        &&  row - cache->guess_row <= YED_SYN_SCAN_LOOKBACK) {
+
+            r     = cache->guess_row;
+            range = *(_yed_syntax_range**)array_item(syntax->ranges, cache->guess_range_idx);
+            exact = cache->guess_exact;
+        } else {
+            r     = row - YED_SYN_SCAN_LOOKBACK;
+            range = syntax->global;
+            exact = 0;
+        }
     }
 
     while (r < row) {
         line = yed_buff_get_line(buffer, r);
 
-        if (line->visual_width > 0 && line->visual_width <= syntax->max_line) {
+        if (line->visual_width > 0) {
             array_zero_term(line->chars);
             new_range = _yed_syntax_get_line_end_state(syntax, buffer, line, range);
             if (!new_range->one_line) { range = new_range; }
@@ -738,91 +1103,85 @@ static _yed_syntax_range *_yed_syntax_get_start_state(yed_syntax *syntax, yed_bu
         r += 1;
     }
 
-    return range;
-}
+    if (cache->scanning) {
+        cache->guess_row       = row;
+        cache->guess_range_idx = range->idx;
+        cache->guess_exact     = exact;
 
-static inline int _yed_syntax_fixup_cache(yed_syntax *syntax, yed_buffer *buffer, _yed_syntax_cache *cache, u32 row) {
-    int                      started_at_top;
-    _yed_syntax_cache_entry *it;
-    int                      changed;
-#ifdef YED_SYNTAX_DEBUG
-    u32                      count;
-#endif
-    _yed_syntax_range       *start_range;
-    yed_line                *line;
-    _yed_syntax_range       *end_range;
-    int                      end_range_idx;
-
-    if (array_len(cache->entries) == 0) {
-        return 0;
+        if (!exact && (cache->provisional_row == 0 || row < cache->provisional_row)) {
+            cache->provisional_row = row;
+        }
     }
 
-    started_at_top = 0;
-
-    it = _yed_syntax_cache_lookup_nearest(syntax, cache, row);
-    if (it == NULL) {
-        it = _yed_syntax_add_to_cache(syntax, cache, 1, syntax->global);
-        started_at_top = 1;
-    }
+    return range;
+}
 
-    DBG("fixup: row %d ->", it->row);
+/*
+ * The end state of row may have changed. Fix the states of the rows below it,
+ * stopping as soon as one comes out the same as it was.
+ * Returns non-zero if any states changed.
+ */
+static inline int _yed_syntax_propagate(yed_syntax *syntax, yed_buffer *buffer, _yed_syntax_cache *cache, u32 row) {
+    int                changed;
+    u32                n;
+    _yed_syntax_range *range;
+    yed_line          *line;
+    _yed_syntax_range *new_range;
 
     changed = 0;
+    n       = 0;
+
+    while (row < cache->scan_row) {
+        /*
+         * The change is going a long way (e.g. a comment was opened). Leave
+         * the rest to the scan.
+         */
+        if (n == YED_SYN_FIXUP_MAX_LINES) {
+            cache->scan_row = row;
+            cache->scanning = 1;
+            changed         = 1;
+            break;
+        }
 
-#ifdef YED_SYNTAX_DEBUG
-    count = 0;
-#endif
-
-    while (it != (_yed_syntax_cache_entry*)array_last(cache->entries)) {
-        start_range = *(_yed_syntax_range**)array_item(syntax->ranges, it->range_idx);
-        line        = yed_buff_get_line(buffer, it->row);
-
-        array_zero_term(line->chars);
-        end_range = _yed_syntax_get_line_end_state(syntax, buffer, line, start_range);
-
-        end_range_idx = _yed_syntax_get_range_idx(syntax, end_range);
-        if (end_range_idx == -1) { end_range_idx = 0; }
-
-        if ((it + 1)->row == it->row + 1) {
-            /* Cache entry exists. */
+        range = _yed_syntax_cache_get(syntax, cache, row);
+        line  = yed_buff_get_line(buffer, row);
 
-            if ((it + 1)->range_idx == (u32)end_range_idx) {
-                /* The cache entry is correct, therefore all further cache entries are correct, so we're done! */
-                goto out;
-            }
-
-            /* Update it. */
-            it            = it + 1;
-            it->range_idx = end_range_idx;
-            changed       = 1;
-        } else {
-            /* Insert a new entry. */
-            it = _yed_syntax_add_to_cache(syntax, cache, it->row + 1, end_range);
+        if (line->visual_width > 0) {
+            array_zero_term(line->chars);
+            new_range = _yed_syntax_get_line_end_state(syntax, buffer, line, range);
+            if (!new_range->one_line) { range = new_range; }
         }
 
-        /* `it` is the correct next cache entry to use at this point. */
-#ifdef YED_SYNTAX_DEBUG
-        count += 1;
-#endif
-    }
+        if (!_yed_syntax_cache_set(cache, row + 1, range)) { break; }
 
-out:;
-    DBG(" %d entries", count);
+        changed  = 1;
+        row     += 1;
+        n       += 1;
+    }
 
-    return changed | started_at_top;
+    return changed;
 }
 
-static inline void _yed_syntax_cache_rebuild(yed_syntax *syntax, _yed_syntax_cache *cache, yed_buffer *buffer, u32 row, int mod_event) {
-    yed_line                *line;
-    _yed_syntax_cache_entry *cache_entry;
-    _yed_syntax_range       *cached_state;
-    _yed_syntax_range       *start_state;
-    _yed_syntax_range       *end_state;
-    _yed_syntax_cache_entry *it;
-    u32                      idx;
+static inline void _yed_syntax_cache_rebuild(yed_syntax *syntax, _yed_syntax_cache *cache, yed_buffer *buffer, u32 row, u32 last_row, int mod_event) {
+    u32                n_lines;
+    u8                 idx;
+    u32                r;
+    int                changed;
+    _yed_syntax_range *range;
+    yed_line          *line;
+    _yed_syntax_range *new_range;
 
     if (!syntax->finalized) { return; }
 
+    /* Row 0 means the whole buffer was cleared. Otherwise, it's a single line. */
+    if (mod_event == BUFF_MOD_CLEAR && row == 0) {
+        _yed_syntax_remove_cache(syntax, buffer);
+        syntax->version += 1;
+        return;
+    }
+
+    cache->guess_row = 0;
+
     switch (mod_event) {
         case BUFF_MOD_APPEND_TO_LINE:
         case BUFF_MOD_POP_FROM_LINE:
@@ -830,77 +1189,164 @@ static inline void _yed_syntax_cache_rebuild(yed_syntax *syntax, _yed_syntax_cac
         case BUFF_MOD_DELETE_FROM_LINE:
         case BUFF_MOD_CLEAR_LINE:
         case BUFF_MOD_SET_LINE:
-            line = yed_buff_get_line(buffer, row);
-            array_zero_term(line->chars);
+        case BUFF_MOD_CLEAR:
+            if (_yed_syntax_propagate(syntax, buffer, cache, row)) {
+                syntax->version += 1;
+            }
+            break;
 
-            start_state  = _yed_syntax_get_start_state(syntax, buffer, row);
-            end_state    = _yed_syntax_get_line_end_state(syntax, buffer, line, start_state);
-            cache_entry  = _yed_syntax_cache_lookup_exact(syntax, cache, row + 1);
-            cached_state = (cache_entry == NULL)
-                            ? NULL
-                            : *(_yed_syntax_range**)array_item(syntax->ranges, cache_entry->range_idx);
+        case BUFF_MOD_SET_LINES:
+            /* Too many rows to redo now. Let the scan redo them. */
+            if (last_row - row >= YED_SYN_FIXUP_MAX_LINES) {
+                if (row < cache->scan_row) {
+                    cache->scan_row = row;
+                    cache->scanning = 1;
+                }
+                syntax->version += 1;
+                break;
+            }
+
+            /* Every row up to last_row may end differently, then the change goes on as far as it needs to. */
+            changed = 0;
+            for (r = row; r <= last_row && r < cache->scan_row; r += 1) {
+                range = _yed_syntax_cache_get(syntax, cache, r);
+                line  = yed_buff_get_line(buffer, r);
+
+                if (line->visual_width > 0) {
+                    array_zero_term(line->chars);
+                    new_range = _yed_syntax_get_line_end_state(syntax, buffer, line, range);
+                    if (!new_range->one_line) { range = new_range; }
+                }
 
-            if (cached_state != end_state) {
-                _yed_syntax_fixup_cache(syntax, buffer, cache, row);
+                changed |= _yed_syntax_cache_set(cache, r + 1, range);
             }
 
-            if ((u32)array_len(cache->entries) == cache->size - 1) {
-                _yed_syntax_cache_evict_one(syntax, cache);
-            } else if ((u32)array_len(cache->entries) == cache->size) {
-                _yed_syntax_cache_evict_one(syntax, cache);
-                _yed_syntax_cache_evict_one(syntax, cache);
+            if (r > last_row) {
+                changed |= _yed_syntax_propagate(syntax, buffer, cache, last_row + 1);
             }
-            _yed_syntax_add_to_cache(syntax, cache, row + 1, end_state);
-            _yed_syntax_add_to_cache(syntax, cache, row,     start_state);
 
+            if (changed) {
+                syntax->version += 1;
+            }
             break;
 
         case BUFF_MOD_ADD_LINE:
         case BUFF_MOD_INSERT_LINE:
-            if (yed_buff_n_lines(buffer) == 1) { break; }
-
-            if (row < (u32)yed_buff_n_lines(buffer)) {
-                array_rtraverse(cache->entries, it) {
-                    if (it->row >= row) {
-                        it->row += 1;
-                    } else {
-                        break;
-                    }
+            /* The new row starts in the same state as the one it pushed down. */
+            if (row <= bucket_array_len(cache->states)) {
+                idx = *(u8*)bucket_array_item(cache->states, row - 1);
+                bucket_array_insert(cache->states, row - 1, idx);
+
+                if (row < cache->scan_row) {
+                    cache->scan_row += 1;
+                    _yed_syntax_propagate(syntax, buffer, cache, row);
                 }
             }
 
-            start_state = _yed_syntax_get_start_state(syntax, buffer, row);
-            _yed_syntax_add_to_cache(syntax, cache, row, start_state);
-            _yed_syntax_fixup_cache(syntax, buffer, cache, row + 1);
-
+            syntax->version += 1;
             break;
 
         case BUFF_MOD_DELETE_LINE:
-            idx = array_len(cache->entries) - 1;
-            array_rtraverse(cache->entries, it) {
-                if (it->row > row) {
-                    it->row -= 1;
-                } else {
-                    if (it->row == row) {
-                        array_delete(cache->entries, idx);
-                    }
-                    break;
+            /* The row that moves up keeps the state of the deleted one. */
+            if (row < bucket_array_len(cache->states)) {
+                bucket_array_delete(cache->states, row);
+
+                if (row < cache->scan_row) {
+                    cache->scan_row -= 1;
+                    _yed_syntax_propagate(syntax, buffer, cache, row);
                 }
-                idx -= 1;
             }
 
+            syntax->version += 1;
+            break;
+    }
 
-            if (row == 1) {
-                _yed_syntax_add_to_cache(syntax, cache, row, syntax->global);
-            }
-            _yed_syntax_fixup_cache(syntax, buffer, cache, row - 1);
+    n_lines = yed_buff_n_lines(buffer);
 
-            break;
+    while (bucket_array_len(cache->states) > MAX(n_lines, 1)) {
+        bucket_array_pop(cache->states);
+    }
 
-        case BUFF_MOD_CLEAR:
-            _yed_syntax_remove_cache(syntax, buffer);
-            break;
+    cache->scan_row = MIN(cache->scan_row, bucket_array_len(cache->states));
+    cache->scanning = cache->scan_row < n_lines;
+}
+
+
+/************************************************************************************/
+/*                             highlight request cache                              */
+/************************************************************************************/
+
+/*
+ * Completion and hover popups tend to ask for the same strings to be highlighted
+ * over and over, so the results of the most recent requests are kept.
+ */
+
+static inline void _yed_syntax_free_hl_entry(_yed_syntax_hl_entry *entry) {
+    array_t *ait;
+
+    free(entry->str);
+
+    array_traverse(entry->lines, ait) {
+        array_free(*ait);
+    }
+    array_free(entry->lines);
+}
+
+static inline void _yed_syntax_hl_cache_clear(yed_syntax *syntax) {
+    _yed_syntax_hl_entry *it;
+
+    array_traverse(syntax->hl_cache, it) {
+        _yed_syntax_free_hl_entry(it);
     }
+    array_clear(syntax->hl_cache);
+}
+
+static inline _yed_syntax_hl_entry *_yed_syntax_hl_cache_lookup(yed_syntax *syntax, u64 hash, const char *str) {
+    _yed_syntax_hl_entry *it;
+
+    array_traverse(syntax->hl_cache, it) {
+        if (it->hash == hash && strcmp(it->str, str) == 0) {
+            syntax->hl_clock += 1;
+            it->used          = syntax->hl_clock;
+            return it;
+        }
+    }
+
+    return NULL;
+}
+
+/* Remember the line attrs from first on in event->highlight_lines_attrs. */
+static inline void _yed_syntax_hl_cache_add(yed_syntax *syntax, u64 hash, const char *str, yed_event *event, int first) {
+    _yed_syntax_hl_entry *it;
+    _yed_syntax_hl_entry *lru;
+    _yed_syntax_hl_entry  new_entry;
+    int                   i;
+    array_t               line_attrs;
+
+    if (array_len(syntax->hl_cache) == YED_SYN_HL_CACHE_SIZE) {
+        lru = NULL;
+        array_traverse(syntax->hl_cache, it) {
+            if (lru == NULL || it->used < lru->used) { lru = it; }
+        }
+
+        _yed_syntax_free_hl_entry(lru);
+        array_delete(syntax->hl_cache, lru - (_yed_syntax_hl_entry*)array_data(syntax->hl_cache));
+    }
+
+    syntax->hl_clock += 1;
+
+    new_entry.hash  = hash;
+    new_entry.str   = strdup(str);
+    new_entry.lines = array_make(array_t);
+    new_entry.used  = syntax->hl_clock;
+
+    for (i = first; i < array_len(event->highlight_lines_attrs); i += 1) {
+        line_attrs = array_make(yed_attrs);
+        array_copy(line_attrs, *(array_t*)array_item(event->highlight_lines_attrs, i));
+        array_push(new_entry.lines, line_attrs);
+    }
+
+    array_push(syntax->hl_cache, new_entry);
 }
 
 
@@ -910,80 +1356,123 @@ static inline void _yed_syntax_cache_rebuild(yed_syntax *syntax, _yed_syntax_cac
 
 
 static inline const char * _yed_syntax_find_next_kwd(yed_syntax *syntax, _yed_syntax_range *range, yed_line *line, const char *start, const char *end, int *len_out, _yed_syntax_attr **attr_out) {
-    yed_glyph       *g;
-    yed_glyph       *gend;
-    int              len;
-    int              col;
-    int              word_len;
+    const char      *s;
     const char      *word;
+    const char      *line_end;
+    u64              hash;
     _yed_syntax_kwd *lookup;
 
-    (void)syntax;
+    if (array_len(range->items.kwds.kwds_by_len) == 0) { return NULL; }
 
-    g    = (yed_glyph*)(void*)start;
-    gend = (yed_glyph*)(void*)end;
+    s        = start;
+    line_end = syntax->line_end;
 
-    while (g < gend) {
-        len = yed_get_glyph_len(*g);
-        if (len > 1) { goto next; }
-
-        if (is_alpha(g->c) || g->c == '_') {
-            col      = yed_line_idx_to_col(line, ((char*)g) - ((char*)array_data(line->chars)));
-            word_len = _yed_syntax_line_get_word_len(line, col);
-            word     = &g->c;
+    /*
+     * Words are runs of ASCII alphanumerics and underscores, so they can be
+     * scanned (and hashed) byte by byte. Bytes of multi-byte glyphs are never
+     * alphanumeric, so they are skipped over along with other punctuation.
+     */
+    while (s < end) {
+        if (is_alpha(*s) || *s == '_') {
+            word = s;
+            hash = _YED_SYNTAX_KWD_HASH_INIT;
+            do {
+                hash = _YED_SYNTAX_KWD_HASH_STEP(hash, *s);
+                s   += 1;
+            } while (s < line_end && (is_alnum(*s) || *s == '_'));
 
-            if (word + word_len > end) { break; }
+            if (s > end) { break; }
 
-            /*
-             * It's safe to use width here in the lookup even though it's
-             * passed to strncmp() as a byte length because only alphanumeric or
-             * underscore characters can be in a "word" as understood by this part
-             * of the higsyntaxighter.
-             */
-            lookup = _yed_syntax_kwd_set_lookup(&range->items.kwds, word, word_len);
+            lookup = _yed_syntax_kwd_set_lookup_hashed(&range->items.kwds, word, s - word, hash);
             if (lookup != NULL) {
-                *len_out  = word_len;
+                *len_out  = s - word;
                 *attr_out = lookup->attr;
-                return &g->c;
+                return word;
             }
-
-            len += word_len;
+        } else {
+            s += 1;
         }
-
-next:;
-        g = (yed_glyph*)(((char*)g) + len);
     }
 
     return NULL;
 }
 
+/*
+ * Search from start up to syntax->line_end. With REG_STARTEND, regexec() doesn't
+ * have to strlen() the rest of the line every time it's called, which adds up to
+ * quadratic time on long lines, and it can't look past the end of the window
+ * that's being highlighted.
+ */
+static inline int _yed_syntax_regexec(yed_syntax *syntax, regex_t *reg, const char *start, int nmatch, int eflags) {
+#ifdef REG_STARTEND
+    syntax->matches->rm_so = 0;
+    syntax->matches->rm_eo = syntax->line_end - start;
+
+    return regexec(reg, start, nmatch, syntax->matches, eflags | syntax->eol_flags | REG_STARTEND);
+#else
+    return regexec(reg, start, nmatch, syntax->matches, eflags | syntax->eol_flags);
+#endif
+}
+
+static inline int _yed_syntax_memo_regexec(yed_syntax *syntax, _yed_syntax_memo *memo, regex_t *reg, int group, yed_line *line, const char *start, regmatch_t *match) {
+    int         off;
+    int         eflags;
+    regmatch_t *m;
+
+    off = start - (char*)array_data(line->chars);
+
+    if (memo->pass != syntax->pass
+    ||  off < memo->from
+    ||  (memo->so != -1 && off > memo->so)) {
+
+        eflags = (off == 0) ? 0 : REG_NOTBOL;
+
+        memo->pass = syntax->pass;
+        memo->from = off;
+        memo->so   = -1;
+        memo->gso  = -1;
+        memo->geo  = -1;
+
+        if (_yed_syntax_regexec(syntax, reg, start, group + 1, eflags) == 0) {
+            m        = syntax->matches + group;
+            memo->so = off + syntax->matches->rm_so;
+
+            if (m->rm_so != -1) {
+                memo->gso = off + m->rm_so;
+                memo->geo = off + m->rm_eo;
+            }
+        }
+    }
+
+    if (memo->gso == -1) { return REG_NOMATCH; }
+
+    match->rm_so = memo->gso - off;
+    match->rm_eo = memo->geo - off;
+
+    return 0;
+}
+
 static inline const char * _yed_syntax_find_next_regex_match(yed_syntax *syntax, _yed_syntax_range *range, yed_line *line, const char *start, const char *end, int *len_out, _yed_syntax_attr **attr_out) {
-    int                nmatch;
     const char        *match_start;
     _yed_syntax_regex *match_rit;
     regmatch_t         first_match;
-    regmatch_t        *m;
+    regmatch_t         m;
     _yed_syntax_regex *rit;
-    int                eflags;
     int                err;
 
-    nmatch      = syntax->max_group + 1;
     match_start = NULL;
     match_rit   = NULL;
 
     memset(&first_match, 0, sizeof(first_match));
 
     array_traverse(range->items.regs, rit) {
-        eflags = (start == array_data(line->chars)) ? 0 : REG_NOTBOL;
-        err    = regexec(&rit->reg, start, nmatch, syntax->matches, eflags);
+        err = _yed_syntax_memo_regexec(syntax, &rit->memo, &rit->reg, rit->group, line, start, &m);
 
         if (!err) {
-            m = syntax->matches + rit->group;
-
             /* Find the match that occurs first in the string. */
-            if (m->rm_so != -1 && m->rm_eo > m->rm_so && start + m->rm_eo <= end) {
-                if (match_start == NULL || m->rm_so < first_match.rm_so) {
-                    memcpy(&first_match, m, sizeof(first_match));
+            if (m.rm_eo > m.rm_so && start + m.rm_eo <= end) {
+                if (match_start == NULL || m.rm_so < first_match.rm_so) {
+                    memcpy(&first_match, &m, sizeof(first_match));
                     match_start = start + first_match.rm_so;
                     match_rit   = rit;
                 }
@@ -1006,7 +1495,6 @@ static inline const char * _yed_syntax_find_next_range_start(yed_syntax *syntax,
     regmatch_t          first_match;
     _yed_syntax_range **rit;
     _yed_syntax_range  *r;
-    int                 eflags;
     int                 err;
 
     match_start = NULL;
@@ -1015,18 +1503,17 @@ static inline const char * _yed_syntax_find_next_range_start(yed_syntax *syntax,
     memset(&first_match, 0, sizeof(first_match));
 
     array_traverse_from(syntax->ranges, rit, 1) { /* Skip global. */
-        r      = *rit;
-        eflags = (start == array_data(line->chars)) ? 0 : REG_NOTBOL;
-        err    = regexec(&r->start, start, 1, &match, eflags);
+        r = *rit;
+        if (r->broken) { continue; }
+
+        err = _yed_syntax_memo_regexec(syntax, &r->start_memo, &r->start, 0, line, start, &match);
 
         if (!err) {
             /* Find the match that occurs first in the string. */
-            if (match.rm_so != -1) {
-                if (match_start == NULL || match.rm_so < first_match.rm_so) {
-                    memcpy(&first_match, &match, sizeof(first_match));
-                    match_start = start + first_match.rm_so;
-                    match_range = r;
-                }
+            if (match_start == NULL || match.rm_so < first_match.rm_so) {
+                memcpy(&first_match, &match, sizeof(first_match));
+                match_start = start + first_match.rm_so;
+                match_range = r;
             }
         }
     }
@@ -1040,19 +1527,21 @@ static inline const char * _yed_syntax_find_next_range_start(yed_syntax *syntax,
 }
 
 static inline const char * _yed_syntax_find_range_end(yed_syntax *syntax, _yed_syntax_range *range, yed_line *line, const char *start, int *len_out) {
-    const char *end;
-    int         nmatch;
-    regmatch_t  m;
-    int         eflags;
-    int         err;
-    regex_t    *rit;
-
-    end    = (char*)array_data(line->chars) + array_len(line->chars);
+    const char       *end;
+    int               nmatch;
+    regmatch_t        m;
+    regmatch_t        skip;
+    int               eflags;
+    int               err;
+    regex_t          *rit;
+    _yed_syntax_memo *memo;
+
+    end    = syntax->line_end;
     nmatch = syntax->max_group + 1;
 
     while (start <= end) {
         eflags = (start == (char*)array_data(line->chars)) ? 0 : REG_NOTBOL;
-        err    = regexec(&range->end, start, nmatch, syntax->matches, eflags);
+        err    = _yed_syntax_regexec(syntax, &range->end, start, nmatch, eflags);
 
         if (!err) {
             memcpy(&m, syntax->matches, sizeof(m));
@@ -1061,13 +1550,17 @@ static inline const char * _yed_syntax_find_range_end(yed_syntax *syntax, _yed_s
                 /* We found a match for the end. Is it in a skip? */
 
                 array_traverse(range->skips, rit) {
-                    eflags = (start == (char*)array_data(line->chars)) ? 0 : REG_NOTBOL;
-                    err    = regexec(rit, start, nmatch, syntax->matches, eflags);
+                    /*
+                     * A skip that doesn't come before this end is remembered, since it'll
+                     * be checked again for every end (e.g. every string) up to it.
+                     */
+                    memo = (_yed_syntax_memo*)array_item(range->skip_memos, rit - (regex_t*)array_data(range->skips));
+                    err  = _yed_syntax_memo_regexec(syntax, memo, rit, 0, line, start, &skip);
 
                     if (!err) {
-                        if (m.rm_so >= syntax->matches->rm_so) {
+                        if (m.rm_so >= skip.rm_so) {
                             /* A skip that comes before the end. Try again. */
-                            start = start + syntax->matches->rm_eo;
+                            start = start + skip.rm_eo;
                             goto next;
                         }
                     }
@@ -1076,21 +1569,158 @@ static inline const char * _yed_syntax_find_range_end(yed_syntax *syntax, _yed_s
                 *len_out = m.rm_eo - m.rm_so;
                 return start + m.rm_so;
             }
-        }
+        }
+
+        goto out;
+next:;
+        if (start >= end) { break; }
+    }
+
+out:;
+    *len_out = 0;
+
+    if (range->one_line) {
+        return end;
+    }
+
+    return NULL;
+}
+
+static inline int _yed_syntax_checkpoint_offset(yed_line *line, int i) {
+    const char *chars;
+    int         off;
+
+    chars = (char*)array_data(line->chars);
+    off   = i * YED_SYN_CHECKPOINT_BYTES;
+
+    /* Don't start in the middle of a glyph. */
+    while (off > 0 && (chars[off] & 0xC0) == 0x80) { off -= 1; }
+
+    return off;
+}
+
+/*
+ * Add the checkpoints that come before byte until, which are in range. If resume
+ * is -1, highlighting resumes from the checkpoint itself.
+ */
+static inline void _yed_syntax_fill_checkpoints(_yed_syntax_checkpoints *cps, yed_line *line, int until, _yed_syntax_range *range, int resume) {
+    _yed_syntax_checkpoint cp;
+    int                    off;
+
+    while ((off = array_len(cps->points) * YED_SYN_CHECKPOINT_BYTES) < until
+    &&     off < array_len(line->chars)) {
+
+        cp.offset = resume == -1 ? _yed_syntax_checkpoint_offset(line, array_len(cps->points)) : resume;
+        cp.idx    = range->idx;
+        array_push(cps->points, cp);
+    }
+}
+
+/* The same walk over the ranges as _yed_syntax_get_line_end_state(), noting the state as it goes. */
+static inline void _yed_syntax_build_checkpoints(yed_syntax *syntax, yed_line *line, _yed_syntax_range *start_range, _yed_syntax_checkpoints *cps) {
+    _yed_syntax_range *range;
+    const char        *start;
+    const char        *str;
+    int                len;
+    const char        *next_range_start;
+    const char        *range_end_start;
+    int                range_end_len;
+    int                next_range_start_len;
+    _yed_syntax_range *next_range;
+    int                content;
+
+    syntax->pass += 1;
+
+    range             = start_range;
+    start             = (char*)array_data(line->chars);
+    str               = start;
+    len               = array_len(line->chars);
+    syntax->line_end  = start + len;
+    syntax->eol_flags = 0;
+
+    array_clear(cps->points);
+
+    if (range != syntax->global) {
+        range_end_start = _yed_syntax_find_range_end(syntax, range, line, str, &range_end_len);
+
+        if (range_end_start == NULL) {
+            _yed_syntax_fill_checkpoints(cps, line, len, range, 0);
+            goto out;
+        }
+
+        str = range_end_start + range_end_len;
+        _yed_syntax_fill_checkpoints(cps, line, str - start, range, 0);
+        range = syntax->global;
+    }
+
+    while ((next_range_start = _yed_syntax_find_next_range_start(syntax, line, str, &next_range, &next_range_start_len)) != NULL) {
+            _yed_syntax_fill_checkpoints(cps, line, next_range_start - start, syntax->global, -1);
+
+            /* Inside the start of the range, go back to where it starts. */
+            str = next_range_start + next_range_start_len;
+            _yed_syntax_fill_checkpoints(cps, line, str - start, syntax->global, next_range_start - start);
+
+            range   = next_range;
+            content = str - start;
+
+            range_end_start = _yed_syntax_find_range_end(syntax, range, line, str, &range_end_len);
+            if (range_end_start == NULL) {
+                _yed_syntax_fill_checkpoints(cps, line, len, range, content);
+                if (range->one_line) {
+                    range = syntax->global;
+                }
+                goto out;
+            }
 
-        goto out;
-next:;
-        if (start >= end) { break; }
+            str = range_end_start + range_end_len;
+            _yed_syntax_fill_checkpoints(cps, line, str - start, range, content);
+            range = syntax->global;
     }
 
+    _yed_syntax_fill_checkpoints(cps, line, len, syntax->global, -1);
+
 out:;
-    *len_out = 0;
+    cps->end_idx = range->idx;
+}
 
-    if (range->one_line) {
-        return end;
+static inline _yed_syntax_checkpoints *_yed_syntax_get_checkpoints(yed_syntax *syntax, yed_line *line, _yed_syntax_range *start_range) {
+    _yed_syntax_checkpoints *it;
+    _yed_syntax_checkpoints *lru;
+    _yed_syntax_checkpoints  new_cps;
+
+    syntax->checkpoint_clock += 1;
+
+    lru = NULL;
+    array_traverse(syntax->checkpoints, it) {
+        if (it->line_version == line->version && it->start_idx == start_range->idx) {
+            it->used = syntax->checkpoint_clock;
+            return it;
+        }
+        if (lru == NULL || it->used < lru->used) { lru = it; }
     }
 
-    return NULL;
+    if (array_len(syntax->checkpoints) < YED_SYN_CHECKPOINT_LINES) {
+        memset(&new_cps, 0, sizeof(new_cps));
+        new_cps.points = array_make(_yed_syntax_checkpoint);
+        lru = (_yed_syntax_checkpoints*)array_push(syntax->checkpoints, new_cps);
+    }
+
+    lru->line_version = line->version;
+    lru->start_idx    = start_range->idx;
+    lru->used         = syntax->checkpoint_clock;
+
+    _yed_syntax_build_checkpoints(syntax, line, start_range, lru);
+
+    return lru;
+}
+
+static inline void _yed_syntax_free_checkpoints(yed_syntax *syntax) {
+    _yed_syntax_checkpoints *it;
+
+    array_traverse(syntax->checkpoints, it) {
+        array_free(it->points);
+    }
+    array_free(syntax->checkpoints);
 }
 
 static inline _yed_syntax_range *_yed_syntax_get_line_end_state(yed_syntax *syntax, yed_buffer *buffer, yed_line *line, _yed_syntax_range *start_range) {
@@ -1105,12 +1735,21 @@ static inline _yed_syntax_range *_yed_syntax_get_line_end_state(yed_syntax *synt
 
     (void)buffer;
 
-    range            = start_range;
-    start            = (char*)array_data(line->chars);
-    str              = start;
-    next_range_start = NULL;
+    if (!syntax->compiled) { _yed_syntax_compile(syntax); }
 
-    if (line->visual_width > syntax->max_line) { goto out; }
+    /* Long lines are walked once per version, since their checkpoints are needed to draw them anyway. */
+    if (line->visual_width > syntax->max_line) {
+        return *(_yed_syntax_range**)array_item(syntax->ranges, _yed_syntax_get_checkpoints(syntax, line, start_range)->end_idx);
+    }
+
+    syntax->pass += 1;
+
+    range             = start_range;
+    start             = (char*)array_data(line->chars);
+    str               = start;
+    next_range_start  = NULL;
+    syntax->line_end  = start + array_len(line->chars);
+    syntax->eol_flags = 0;
 
     if (range != syntax->global) {
         range_end_start = _yed_syntax_find_range_end(syntax, range, line, str, &range_end_len);
@@ -1143,13 +1782,27 @@ out:;
 }
 
 
-static inline void _yed_syntax_line_apply(yed_event *event, int cstart, int cend, yed_attrs *attr) {
-    int      i;
-    array_t *line_attrs;
+static inline void _yed_syntax_line_apply(yed_syntax *syntax, yed_event *event, int cstart, int cend, yed_attrs *attr) {
+    int               i;
+    array_t          *line_attrs;
+    _yed_syntax_span  span;
 
     if (attr == NULL) { return; }
 
-    if (event->kind == EVENT_LINE_PRE_DRAW) {
+    if (syntax->record != NULL) {
+        span.cstart = cstart;
+        span.cend   = cend;
+        span.attr   = attr;
+        array_push(*syntax->record, span);
+    } else if (event->kind == EVENT_LINE_PRE_DRAW) {
+        /* Don't bother with the columns that are out of view. */
+        if (cstart <= event->frame->buffer_x_offset) {
+            cstart = event->frame->buffer_x_offset + 1;
+        }
+        if (cend > event->frame->buffer_x_offset + array_len(event->eline_attrs) + 1) {
+            cend = event->frame->buffer_x_offset + array_len(event->eline_attrs) + 1;
+        }
+
         for (i = cstart; i < cend; i += 1) {
             yed_eline_combine_col_attrs(event, i, attr);
         }
@@ -1166,7 +1819,103 @@ static inline void _yed_syntax_line_apply(yed_event *event, int cstart, int cend
 }
 
 
-static inline _yed_syntax_range *_yed_syntax_line(yed_syntax *syntax, yed_line *line, yed_event *event, _yed_syntax_range *start_range) {
+/*
+ * yed_line_idx_to_col() and yed_line_col_to_idx() walk the line from the start,
+ * which is too slow to do for every token in a window of a long line with
+ * multi-byte glyphs. Tokens are visited in (mostly) increasing order, so the
+ * syntax remembers where the last conversion was and walks from there instead.
+ */
+static inline int _yed_syntax_is_simple_line(yed_syntax *syntax, yed_line *line) {
+    return line->visual_width <= syntax->max_line
+        || (line->n_glyphs == line->visual_width && line->n_glyphs == array_len(line->chars));
+}
+
+static inline void _yed_syntax_col_cursor_start(yed_syntax *syntax, yed_line *line) {
+    if (syntax->col_col == 0 || syntax->col_version != line->version) {
+        syntax->col_version = line->version;
+        syntax->col_idx     = 0;
+        syntax->col_col     = 1;
+    }
+}
+
+/* Move back one glyph. Returns 0 if the cursor had to go back to the start of the line instead. */
+static inline int _yed_syntax_col_cursor_back(yed_syntax *syntax, yed_line *line) {
+    const char *chars;
+    yed_glyph  *g;
+    int         n;
+
+    chars = (char*)array_data(line->chars);
+
+    n = syntax->col_idx - 1;
+    while (n > 0 && n > syntax->col_idx - 4 && (chars[n] & 0xC0) == 0x80) { n -= 1; }
+
+    g = (yed_glyph*)(chars + n);
+
+    /* Not valid UTF-8, so there's no telling where the glyph starts. */
+    if (n + yed_get_glyph_len(*g) != syntax->col_idx) {
+        syntax->col_idx = 0;
+        syntax->col_col = 1;
+        return 0;
+    }
+
+    syntax->col_col -= yed_get_glyph_width(*g);
+    syntax->col_idx  = n;
+
+    return 1;
+}
+
+static inline int _yed_syntax_idx_to_col(yed_syntax *syntax, yed_line *line, int idx) {
+    yed_glyph *g;
+    int        n;
+
+    if (_yed_syntax_is_simple_line(syntax, line)) { return yed_line_idx_to_col(line, idx); }
+
+    _yed_syntax_col_cursor_start(syntax, line);
+
+    while (syntax->col_idx > idx) {
+        if (!_yed_syntax_col_cursor_back(syntax, line)) { break; }
+    }
+
+    while (syntax->col_idx < idx && syntax->col_idx < array_len(line->chars)) {
+        g = (yed_glyph*)array_item(line->chars, syntax->col_idx);
+        n = yed_get_glyph_len(*g);
+
+        if (syntax->col_idx + n > idx) { break; }
+
+        syntax->col_col += yed_get_glyph_width(*g);
+        syntax->col_idx += n;
+    }
+
+    return syntax->col_col;
+}
+
+static inline int _yed_syntax_col_to_idx(yed_syntax *syntax, yed_line *line, int col) {
+    yed_glyph *g;
+    int        w;
+
+    if (_yed_syntax_is_simple_line(syntax, line)) { return yed_line_col_to_idx(line, col); }
+
+    _yed_syntax_col_cursor_start(syntax, line);
+
+    while (syntax->col_col > col) {
+        if (!_yed_syntax_col_cursor_back(syntax, line)) { break; }
+    }
+
+    while (syntax->col_idx < array_len(line->chars)) {
+        g = (yed_glyph*)array_item(line->chars, syntax->col_idx);
+        w = yed_get_glyph_width(*g);
+
+        if (syntax->col_col + w > col) { break; }
+
+        syntax->col_col += w;
+        syntax->col_idx += yed_get_glyph_len(*g);
+    }
+
+    return syntax->col_idx;
+}
+
+/* Highlight the bytes [from, to) of the line, starting in start_range. */
+static inline _yed_syntax_range *_yed_syntax_line_span(yed_syntax *syntax, yed_line *line, yed_event *event, _yed_syntax_range *start_range, int from, int to) {
     _yed_syntax_range *range;
     const char        *str;
     const char        *start;
@@ -1190,26 +1939,31 @@ static inline _yed_syntax_range *_yed_syntax_line(yed_syntax *syntax, yed_line *
     int                first_len;
 
 
-    if (line->visual_width > syntax->max_line) { return start_range; }
+    if (!syntax->compiled) { _yed_syntax_compile(syntax); }
+
+    /* Forget the regex results from the last line. */
+    syntax->pass += 1;
 
 #define NOT_SEARCHED    ((char*)~(u64)NULL)
 #define NEEDS_SEARCH(x) ((x) == NOT_SEARCHED || ((x) != NULL && (x) < str))
 
-    range    = start_range;
-    str      = (char*)array_data(line->chars);
-    start    = str;
-    line_end = start + array_len(line->chars);
-    end      = line_end;
+    range             = start_range;
+    start             = (char*)array_data(line->chars);
+    str               = start + from;
+    line_end          = start + to;
+    end               = line_end;
+    syntax->line_end  = line_end;
+    syntax->eol_flags = to < array_len(line->chars) ? REG_NOTEOL : 0;
 
     if (range != syntax->global) {
         range_end_start = _yed_syntax_find_range_end(syntax, range, line, str, &range_end_len);
 
-        cstart = yed_line_idx_to_col(line, str - start);
+        cstart = _yed_syntax_idx_to_col(syntax, line, str - start);
         cend   = range_end_start == NULL
                     ? line->visual_width + 1
-                    : yed_line_idx_to_col(line, (range_end_start + range_end_len) - start);
+                    : _yed_syntax_idx_to_col(syntax, line, (range_end_start + range_end_len) - start);
 
-        _yed_syntax_line_apply(event, cstart, cend, &range->attr->attr);
+        _yed_syntax_line_apply(syntax, event, cstart, cend, &range->attr->attr);
 
         if (range_end_start == NULL) {
             return range;
@@ -1277,13 +2031,13 @@ set_range:;
 
             range_end_start = _yed_syntax_find_range_end(syntax, range, line, next_range_start + next_range_start_len, &range_end_len);
 
-            cstart = yed_line_idx_to_col(line, next_range_start - start);
+            cstart = _yed_syntax_idx_to_col(syntax, line, next_range_start - start);
             cend   = range_end_start == NULL
                         ? line->visual_width + 1
-                        : yed_line_idx_to_col(line, (range_end_start + range_end_len) - start);
+                        : _yed_syntax_idx_to_col(syntax, line, (range_end_start + range_end_len) - start);
 
 
-            _yed_syntax_line_apply(event, cstart, cend, &next_range->attr->attr);
+            _yed_syntax_line_apply(syntax, event, cstart, cend, &next_range->attr->attr);
 
             end       = range_end_start + range_end_len;
             first     = next_range_start + MAX(next_range_start_len, 1);
@@ -1310,11 +2064,11 @@ set_kwd:;
             /* Invalidate previously saved searches. */
             next_kwd = next_match = NOT_SEARCHED;
         } else {
-            cstart = yed_line_idx_to_col(line, first - start);
-            cend   = yed_line_idx_to_col(line, (first + first_len) - start);
+            cstart = _yed_syntax_idx_to_col(syntax, line, first - start);
+            cend   = _yed_syntax_idx_to_col(syntax, line, (first + first_len) - start);
             str    = first + first_len;
 
-            _yed_syntax_line_apply(event, cstart, cend, &a->attr);
+            _yed_syntax_line_apply(syntax, event, cstart, cend, &a->attr);
         }
     }
 
@@ -1324,6 +2078,219 @@ set_kwd:;
 #undef NOT_SEARCHED
 }
 
+static inline _yed_syntax_range *_yed_syntax_line(yed_syntax *syntax, yed_line *line, yed_event *event, _yed_syntax_range *start_range) {
+    if (line->visual_width > syntax->max_line) { return start_range; }
+
+    return _yed_syntax_line_span(syntax, line, event, start_range, 0, array_len(line->chars));
+}
+
+/*
+ * Lines longer than syntax->max_line are only highlighted around the columns that
+ * are in view. Highlighting starts from the last checkpoint at least
+ * YED_SYN_WINDOW_CONTEXT bytes before the window and stops that far past it, so a
+ * token cut off at either end is out of view.
+ */
+static inline void _yed_syntax_line_window(yed_syntax *syntax, yed_line *line, yed_event *event, _yed_syntax_range *start_range) {
+    yed_frame               *frame;
+    const char              *chars;
+    int                      len;
+    int                      first_col;
+    int                      last_col;
+    int                      from;
+    int                      to;
+    int                      i;
+    _yed_syntax_checkpoints *cps;
+    _yed_syntax_checkpoint  *cp;
+
+    frame     = event->frame;
+    first_col = frame->buffer_x_offset + 1;
+
+    if (first_col > line->visual_width) { return; }
+
+    if (!syntax->compiled) { _yed_syntax_compile(syntax); }
+
+    last_col = MIN(first_col + frame->width, line->visual_width + 1);
+    chars    = (char*)array_data(line->chars);
+    len      = array_len(line->chars);
+    from     = MAX(_yed_syntax_col_to_idx(syntax, line, first_col) - YED_SYN_WINDOW_CONTEXT, 0);
+    to       = MIN(_yed_syntax_col_to_idx(syntax, line, last_col)  + YED_SYN_WINDOW_CONTEXT, len);
+
+    while (to < len && (chars[to] & 0xC0) == 0x80) { to += 1; }
+
+    cps = _yed_syntax_get_checkpoints(syntax, line, start_range);
+    if (array_len(cps->points) == 0) { return; }
+
+    i  = MIN(from / YED_SYN_CHECKPOINT_BYTES, array_len(cps->points) - 1);
+    cp = (_yed_syntax_checkpoint*)array_item(cps->points, i);
+
+    _yed_syntax_line_span(syntax, line, event, *(_yed_syntax_range**)array_item(syntax->ranges, cp->idx), cp->offset, to);
+}
+
+
+
+/************************************************************************************/
+/*                                  parallel rows                                   */
+/************************************************************************************/
+
+static inline void yed_syntax_free(yed_syntax *syntax);
+
+/* Copy the definition of a compiled syntax. The copy shares src's attrs. */
+static inline void _yed_syntax_clone(yed_syntax *dst, yed_syntax *src) {
+    _yed_syntax_range **rit;
+    _yed_syntax_range  *r;
+    _yed_syntax_range  *c;
+    char              **pit;
+    char               *p;
+    _yed_syntax_regex  *regit;
+    _yed_syntax_regex   reg;
+    array_t            *kwd_list_it;
+    _yed_syntax_kwd    *kwd_it;
+    _yed_syntax_kwd    *k;
+
+    memset(dst, 0, sizeof(*dst));
+
+    dst->attrs      = array_make(_yed_syntax_attr*);
+    dst->attr_stack = array_make(_yed_syntax_attr*);
+    dst->ranges     = array_make(_yed_syntax_range*);
+
+    array_traverse(src->ranges, rit) {
+        r = *rit;
+        c = (_yed_syntax_range*)malloc(sizeof(*c));
+
+        _yed_syntax_make_range(c);
+
+        c->attr     = r->attr;
+        c->idx      = r->idx;
+        c->one_line = r->one_line;
+        c->broken   = r->broken;
+
+        if (!r->broken) {
+            if (r->start_pattern != NULL) { c->start_pattern = strdup(r->start_pattern); }
+            if (r->end_pattern   != NULL) { c->end_pattern   = strdup(r->end_pattern);   }
+
+            array_traverse(r->skip_patterns, pit) {
+                p = strdup(*pit);
+                array_push(c->skip_patterns, p);
+            }
+        }
+
+        array_traverse(r->items.regs, regit) {
+            memset(&reg, 0, sizeof(reg));
+            reg.attr    = regit->attr;
+            reg.pattern = strdup(regit->pattern);
+            reg.group   = regit->group;
+            array_push(c->items.regs, reg);
+        }
+
+        array_traverse(r->items.kwds.kwds_by_len, kwd_list_it) {
+            array_traverse(*kwd_list_it, kwd_it) {
+                k = _yed_syntax_kwd_set_add(&c->items.kwds, kwd_it->kwd);
+                if (k != NULL) { k->attr = kwd_it->attr; }
+            }
+        }
+
+        array_push(dst->ranges, c);
+    }
+
+    dst->global      = *(_yed_syntax_range**)array_item(dst->ranges, 0);
+    dst->max_group   = src->max_group;
+    dst->max_line    = src->max_line;
+    dst->needs_state = src->needs_state;
+    dst->caches      = CACHE_TREE_MAKE();
+    dst->hl_cache    = array_make(_yed_syntax_hl_entry);
+    dst->rows        = array_make(_yed_syntax_row);
+    dst->row_jobs    = array_make(_yed_syntax_row_job);
+    dst->workers     = array_make(yed_syntax*);
+    dst->checkpoints = array_make(_yed_syntax_checkpoints);
+    dst->finalized   = 1;
+
+    _yed_syntax_compile(dst);
+}
+
+static inline yed_syntax *_yed_syntax_get_worker(yed_syntax *syntax, int worker) {
+    return worker == 0
+            ? syntax
+            : *(yed_syntax**)array_item(syntax->workers, worker - 1);
+}
+
+static inline void _yed_syntax_ensure_workers(yed_syntax *syntax, int n_workers) {
+    yed_syntax *w;
+
+    while (array_len(syntax->workers) < n_workers - 1) {
+        w = (yed_syntax*)malloc(sizeof(*w));
+        _yed_syntax_clone(w, syntax);
+        array_push(syntax->workers, w);
+    }
+}
+
+static inline void _yed_syntax_free_workers(yed_syntax *syntax) {
+    yed_syntax **wit;
+
+    array_traverse(syntax->workers, wit) {
+        yed_syntax_free(*wit);
+        free(*wit);
+    }
+    array_free(syntax->workers);
+}
+
+static inline void _yed_syntax_free_rows(yed_syntax *syntax) {
+    _yed_syntax_row *rit;
+
+    array_traverse(syntax->rows, rit) {
+        array_free(rit->spans);
+    }
+    array_free(syntax->rows);
+    array_free(syntax->row_jobs);
+}
+
+static inline _yed_syntax_row *_yed_syntax_row_slot(yed_syntax *syntax, yed_buffer *buffer, int row) {
+    u64 idx;
+
+    /* Consecutive rows of a buffer get consecutive slots, so a frame's rows don't collide with each other. */
+    idx = ((((u64)buffer) >> 4) * 0x9e3779b97f4a7c15ULL) + row;
+
+    return (_yed_syntax_row*)array_item(syntax->rows, idx & (YED_SYN_ROW_SLOTS - 1));
+}
+
+static inline void _yed_syntax_row_work(int item, int worker, void *arg) {
+    yed_syntax          *syntax;
+    yed_syntax          *w;
+    _yed_syntax_row_job *job;
+    _yed_syntax_range   *start_range;
+
+    syntax      = (yed_syntax*)arg;
+    w           = _yed_syntax_get_worker(syntax, worker);
+    job         = (_yed_syntax_row_job*)array_item(syntax->row_jobs, item);
+    start_range = *(_yed_syntax_range**)array_item(w->ranges, job->slot->start_idx);
+
+    w->record = &job->slot->spans;
+    _yed_syntax_line(w, job->line, NULL, start_range);
+    w->record = NULL;
+}
+
+static inline int _yed_syntax_replay_row(yed_syntax *syntax, yed_event *event, yed_line *line, _yed_syntax_range *start_range) {
+    _yed_syntax_row  *slot;
+    _yed_syntax_span *span;
+
+    if (array_len(syntax->rows) == 0) { return 0; }
+
+    slot = _yed_syntax_row_slot(syntax, event->frame->buffer, event->row);
+
+    if (slot->buffer       != event->frame->buffer
+    ||  slot->row          != event->row
+    ||  slot->line_version != line->version
+    ||  slot->start_idx    != start_range->idx) {
+
+        return 0;
+    }
+
+    array_traverse(slot->spans, span) {
+        _yed_syntax_line_apply(syntax, event, span->cstart, span->cend, span->attr);
+    }
+
+    return 1;
+}
+
 
 
 
@@ -1345,6 +2312,14 @@ static inline void yed_syntax_start(yed_syntax *syntax) {
     array_push(syntax->ranges, syntax->global);
 
     syntax->caches = CACHE_TREE_MAKE();
+
+    syntax->hl_cache = array_make(_yed_syntax_hl_entry);
+
+    syntax->rows     = array_make(_yed_syntax_row);
+    syntax->row_jobs = array_make(_yed_syntax_row_job);
+    syntax->workers  = array_make(yed_syntax*);
+
+    syntax->checkpoints = array_make(_yed_syntax_checkpoints);
 }
 
 static inline void yed_syntax_end(yed_syntax *syntax) {
@@ -1352,11 +2327,24 @@ static inline void yed_syntax_end(yed_syntax *syntax) {
         syntax->max_line = 1000;
     }
 
-    syntax->matches = (regmatch_t*)malloc(sizeof(*syntax->matches) * (syntax->max_group + 1));
+    if (!yed_get_var_as_int("syntax-scan-budget-ms", &syntax->scan_budget_us)) {
+        syntax->scan_budget_us = DEFAULT_SYNTAX_SCAN_BUDGET_MS;
+    }
+    syntax->scan_budget_us *= 1000;
 
     syntax->finalized = 1;
 }
 
+static inline int yed_syntax_compile(yed_syntax *syntax) {
+    if (!syntax->finalized) { return -1; }
+
+    if (!syntax->compiled) {
+        _yed_syntax_compile(syntax);
+    }
+
+    return syntax->regex_err_str == NULL ? 0 : -1;
+}
+
 static inline void yed_syntax_free(yed_syntax *syntax) {
     _yed_syntax_range **rit;
     _yed_syntax_attr  **ait;
@@ -1382,6 +2370,13 @@ static inline void yed_syntax_free(yed_syntax *syntax) {
         _yed_syntax_free_cache(&tree_it_val(it));
     }
     CACHE_TREE_FREE(syntax->caches);
+
+    _yed_syntax_hl_cache_clear(syntax);
+    array_free(syntax->hl_cache);
+
+    _yed_syntax_free_rows(syntax);
+    _yed_syntax_free_workers(syntax);
+    _yed_syntax_free_checkpoints(syntax);
 }
 
 
@@ -1403,7 +2398,7 @@ static inline void yed_syntax_attr_push(yed_syntax *syntax, const char *str) {
     a = (_yed_syntax_attr*)malloc(sizeof(*a));
 
     a->str  = strdup(str);
-    a->attr = yed_parse_attrs(str);
+    a->attr = ZERO_ATTR; /* Parsed when the syntax is compiled. */
 
     array_push(syntax->attrs, a);
     array_push(syntax->attr_stack, a);
@@ -1416,35 +2411,33 @@ static inline void yed_syntax_attr_pop(yed_syntax *syntax) {
 }
 
 static inline int _yed_syntax_add_regex(yed_syntax *syntax, const char *pattern, int group) {
-    int                err;
     _yed_syntax_regex  r;
-    size_t             err_len;
     _yed_syntax_range *range;
 
-    memset(&r, 0, sizeof(r));
+    if (syntax->finalized) { return -1; }
 
-    err = regcomp(&r.reg, pattern, REG_EXTENDED);
+    memset(&r, 0, sizeof(r));
 
-    if (err) {
-        err_len = regerror(err, &r.reg, NULL, 0);
-        if (syntax->regex_err_str != NULL) { free(syntax->regex_err_str); }
-        syntax->regex_err_str = (char*)malloc(err_len);
-        regerror(err, &r.reg, syntax->regex_err_str, err_len);
-    } else {
-        range = _yed_syntax_top_range(syntax);
+    range = _yed_syntax_top_range(syntax);
 
-        r.group = group;
-        r.attr  = _yed_syntax_top_attr(syntax);
-        array_push(range->items.regs, r);
+    r.pattern = strdup(pattern);
+    r.group   = group;
+    r.attr    = _yed_syntax_top_attr(syntax);
+    array_push(range->items.regs, r);
 
-        if (group > syntax->max_group) {
-            syntax->max_group = group;
-        }
+    if (group > syntax->max_group) {
+        syntax->max_group = group;
     }
 
-    return err;
+    return 0;
 }
 
+/*
+ * This and the other functions that take a pattern only keep it for later,
+ * so they fail when the pattern can't go where it's put, not when it's a bad
+ * regular expression. That's found when the syntax is compiled: see
+ * yed_syntax_compile().
+ */
 static inline int yed_syntax_regex(yed_syntax *syntax, const char *pattern) {
     return _yed_syntax_add_regex(syntax, pattern, 0);
 }
@@ -1455,77 +2448,52 @@ static inline int yed_syntax_regex_sub(yed_syntax *syntax, const char *pattern,
 
 static inline int yed_syntax_range_start(yed_syntax *syntax, const char *pattern) {
     _yed_syntax_range *range;
-    int                err;
-    size_t             err_len;
+
+    if (syntax->finalized) { return -1; }
 
     if (_yed_syntax_top_range(syntax) != syntax->global) { return -1; }
 
+    /* The state of each line is stored in a byte. */
+    if (array_len(syntax->ranges) == YED_SYN_MAX_RANGES) { return -1; }
+
     range = (_yed_syntax_range*)malloc(sizeof(*range));
 
     _yed_syntax_make_range(range);
 
-    err = regcomp(&range->start, pattern, REG_EXTENDED);
-
-    if (err) {
-        err_len = regerror(err, &range->start, NULL, 0);
-        if (syntax->regex_err_str != NULL) { free(syntax->regex_err_str); }
-        syntax->regex_err_str = (char*)malloc(err_len);
-        regerror(err, &range->start, syntax->regex_err_str, err_len);
-        _yed_syntax_free_range(range);
-    } else {
-        range->attr = _yed_syntax_top_attr(syntax);
-        array_push(syntax->ranges, range);
-        syntax->range = range;
-    }
+    range->start_pattern = strdup(pattern);
+    range->attr          = _yed_syntax_top_attr(syntax);
+    range->idx           = array_len(syntax->ranges);
+    array_push(syntax->ranges, range);
+    syntax->range = range;
 
-    return err;
+    return 0;
 }
 
 static inline int yed_syntax_range_end(yed_syntax *syntax, const char *pattern) {
     _yed_syntax_range *range;
-    int                err;
-    size_t             err_len;
 
     range = _yed_syntax_top_range(syntax);
     if (range == syntax->global) { return -1; }
 
-    err = regcomp(&range->end, pattern, REG_EXTENDED);
+    range->end_pattern = strdup(pattern);
 
-    if (err) {
-        err_len = regerror(err, &range->end, NULL, 0);
-        if (syntax->regex_err_str != NULL) { free(syntax->regex_err_str); }
-        syntax->regex_err_str = (char*)malloc(err_len);
-        regerror(err, &range->end, syntax->regex_err_str, err_len);
-        _yed_syntax_free_range(range);
-    } else {
-        if (!range->one_line) { syntax->needs_state = 1; }
-        syntax->range = NULL;
-    }
+    if (!range->one_line) { syntax->needs_state = 1; }
+    syntax->range = NULL;
 
-    return err;
+    return 0;
 }
 
 static inline int yed_syntax_range_skip(yed_syntax *syntax, const char *pattern) {
     _yed_syntax_range *range;
-    int                err;
-    regex_t            reg;
-    size_t             err_len;
+    char              *p;
 
     range = _yed_syntax_top_range(syntax);
     if (range == syntax->global) { return -1; }
 
-    err = regcomp(&reg, pattern, REG_EXTENDED);
-
-    if (err) {
-        err_len = regerror(err, &reg, NULL, 0);
-        if (syntax->regex_err_str != NULL) { free(syntax->regex_err_str); }
-        syntax->regex_err_str = (char*)malloc(err_len);
-        regerror(err, &reg, syntax->regex_err_str, err_len);
-    } else {
-        array_push(range->skips, reg);
-    }
+    p = strdup(pattern);
+    array_push(range->skip_patterns, p);
 
-    return err;
+    return 0;
 }
 
 static inline int yed_syntax_range_one_line(yed_syntax *syntax) {
@@ -1556,21 +2524,105 @@ static inline void yed_syntax_line_event(yed_syntax *syntax, yed_event *event) {
 
     start_range = _yed_syntax_get_start_state(syntax, event->frame->buffer, event->row);
 
-    _yed_syntax_line(syntax, line, event, start_range);
+    if (_yed_syntax_replay_row(syntax, event, line, start_range)) { return; }
+
+    if (line->visual_width > syntax->max_line) {
+        _yed_syntax_line_window(syntax, line, event, start_range);
+    } else {
+        _yed_syntax_line(syntax, line, event, start_range);
+    }
 }
 
-static inline void yed_syntax_style_event(yed_syntax *syntax, yed_event *event) {
-    _yed_syntax_attr **ait;
-    _yed_syntax_attr  *a;
+static inline void yed_syntax_frame_event(yed_syntax *syntax, yed_event *event) {
+    yed_frame           *frame;
+    yed_buffer          *buffer;
+    int                  n_workers;
+    _yed_syntax_row      empty;
+    yed_line            *line;
+    int                  row;
+    _yed_syntax_range   *start_range;
+    _yed_syntax_row     *slot;
+    _yed_syntax_row_job  job;
+
+    if (!syntax->finalized) { return; }
+
+    frame = event->frame;
+    if (frame == NULL || (buffer = frame->buffer) == NULL) { return; }
+
+    /* With only one thread, yed_syntax_line_event() does the same work as it draws. */
+    n_workers = yed_n_workers();
+    if (n_workers <= 1) { return; }
 
+    if (!syntax->compiled) { _yed_syntax_compile(syntax); }
+
+    if (array_len(syntax->rows) == 0) {
+        memset(&empty, 0, sizeof(empty));
+        while (array_len(syntax->rows) < YED_SYN_ROW_SLOTS) {
+            empty.spans = array_make(_yed_syntax_span);
+            array_push(syntax->rows, empty);
+        }
+    }
+
+    array_clear(syntax->row_jobs);
+
+    row = frame->buffer_y_offset + 1;
+    bucket_array_traverse_from(buffer->lines, line, frame->buffer_y_offset) {
+        if (row > frame->buffer_y_offset + MIN(frame->height, YED_SYN_ROW_SLOTS)) { break; }
+
+        if (line->visual_width > 0 && line->visual_width <= syntax->max_line) {
+            start_range = _yed_syntax_get_start_state(syntax, buffer, row);
+            slot        = _yed_syntax_row_slot(syntax, buffer, row);
+
+            if (slot->buffer       != buffer
+            ||  slot->row          != row
+            ||  slot->line_version != line->version
+            ||  slot->start_idx    != start_range->idx) {
+
+                array_zero_term(line->chars);
+
+                slot->buffer       = buffer;
+                slot->row          = row;
+                slot->line_version = line->version;
+                slot->start_idx    = start_range->idx;
+                array_clear(slot->spans);
+
+                job.slot = slot;
+                job.line = line;
+                array_push(syntax->row_jobs, job);
+            }
+        }
+
+        row += 1;
+    }
+
+    if (array_len(syntax->row_jobs) == 0) { return; }
+
+    _yed_syntax_ensure_workers(syntax, n_workers);
+
+    yed_work_run(array_len(syntax->row_jobs), _yed_syntax_row_work, syntax);
+}
+
+/*
+ * Changes whenever highlighting of an unmodified line could have changed,
+ * e.g. because an edit elsewhere changed which multi-line range it's in.
+ */
+static inline u64 yed_syntax_decoration_version(yed_syntax *syntax) {
+    return syntax->version;
+}
+
+static inline void yed_syntax_style_event(yed_syntax *syntax, yed_event *event) {
     (void)event;
 
     if (!syntax->finalized) { return; }
 
-    array_traverse(syntax->attrs, ait) {
-        a       = *ait;
-        a->attr = yed_parse_attrs(a->str);
+    /* Otherwise, the attrs are parsed when the syntax is compiled. */
+    if (syntax->compiled) {
+        _yed_syntax_parse_attrs(syntax);
     }
+
+    _yed_syntax_hl_cache_clear(syntax);
+
+    syntax->version += 1;
 }
 
 static inline void yed_syntax_buffer_delete_event(yed_syntax *syntax, yed_event *event) {
@@ -1582,6 +2634,7 @@ static inline void yed_syntax_buffer_delete_event(yed_syntax *syntax, yed_event
 
     if (tree_it_good(it)) {
         _yed_syntax_remove_cache(syntax, event->buffer);
+        syntax->version += 1;
     }
 }
 
@@ -1593,44 +2646,116 @@ static inline void yed_syntax_buffer_mod_event(yed_syntax *syntax, yed_event *ev
     it = tree_lookup(syntax->caches, event->buffer);
 
     if (tree_it_good(it)) {
-        _yed_syntax_cache_rebuild(syntax, &tree_it_val(it), event->buffer, event->row, event->buff_mod_event);
+        _yed_syntax_cache_rebuild(syntax, &tree_it_val(it), event->buffer, event->row, event->last_row, event->buff_mod_event);
+    }
+}
+
+/* Advance unfinished scans of buffer state. */
+static inline void yed_syntax_pump_event(yed_syntax *syntax, yed_event *event) {
+    u64                deadline_us;
+    int                more;
+    CACHE_IT           it;
+    yed_buffer        *active;
+
+    (void)event;
+
+    if (!syntax->finalized || !syntax->needs_state) { return; }
+
+    syntax->pumped = 1;
+
+    deadline_us = measure_time_now_us() + syntax->scan_budget_us;
+    more        = 0;
+
+    /* The buffer being looked at goes first. */
+    active = ys->active_frame == NULL ? NULL : ys->active_frame->buffer;
+    if (active != NULL) {
+        it = tree_lookup(syntax->caches, active);
+        if (tree_it_good(it)) {
+            more |= _yed_syntax_scan(syntax, active, &tree_it_val(it), deadline_us);
+        }
+    }
+
+    tree_traverse(syntax->caches, it) {
+        if (tree_it_key(it) == active || !tree_it_val(it).scanning) { continue; }
+
+        if (measure_time_now_us() >= deadline_us) {
+            more = 1;
+            break;
+        }
+
+        more |= _yed_syntax_scan(syntax, tree_it_key(it), &tree_it_val(it), deadline_us);
+    }
+
+    /* Come back soon rather than waiting for input. */
+    if (more) {
+        yed_force_update();
     }
 }
 
 static inline void yed_syntax_highlight_request_event(yed_syntax *syntax, yed_event *event) {
-    yed_buffer         buff;
-    yed_attrs          za;
-    int                row;
-    yed_line          *line;
-    array_t            line_attrs;
-    array_t           *line_attrsp;
-    int                i;
-    _yed_syntax_range *start_range;
+    int                   len;
+    u64                   hash;
+    _yed_syntax_hl_entry *entry;
+    array_t              *ait;
+    int                   first;
+    yed_buffer            buff;
+    yed_attrs             za;
+    int                   row;
+    yed_line             *line;
+    array_t               line_attrs;
+    array_t              *line_attrsp;
+    int                   i;
+    _yed_syntax_range    *range;
+    _yed_syntax_range    *end_range;
 
     if (!syntax->finalized) { return; }
 
+    len   = strlen(event->highlight_string);
+    hash  = _yed_syntax_kwd_hash(event->highlight_string, len);
+    entry = _yed_syntax_hl_cache_lookup(syntax, hash, event->highlight_string);
+
+    if (entry != NULL) {
+        array_traverse(entry->lines, ait) {
+            line_attrs = array_make(yed_attrs);
+            array_copy(line_attrs, *ait);
+            array_push(event->highlight_lines_attrs, line_attrs);
+        }
+        return;
+    }
+
+    first = array_len(event->highlight_lines_attrs);
+
     buff        = yed_new_buff();
     buff.flags |= BUFF_NO_MOD_EVENTS;
 
-    yed_fill_buff_from_string(&buff, event->highlight_string, strlen(event->highlight_string));
+    yed_fill_buff_from_string(&buff, event->highlight_string, len);
 
-    za  = ZERO_ATTR;
-    row = 1;
+    /*
+     * The lines are highlighted in order, so the state at the end of each one
+     * is carried to the next rather than looked up in a cache.
+     */
+    za    = ZERO_ATTR;
+    row   = 1;
+    range = syntax->global;
     bucket_array_traverse(buff.lines, line) {
         line_attrs  = array_make(yed_attrs);
         line_attrsp = (array_t*)array_push(event->highlight_lines_attrs, line_attrs);
 
-        if (line != NULL && line->visual_width >= 0) {
+        /* An empty line has nothing to highlight and leaves the state as it was. */
+        if (line != NULL && line->visual_width > 0) {
             array_zero_term(line->chars);
 
             for (i = 0; i < line->visual_width; i += 1) {
                 array_push(*line_attrsp, za);
             }
 
-            start_range = _yed_syntax_get_start_state(syntax, &buff, row);
-
             event->row = row;
-            _yed_syntax_line(syntax, line, event, start_range);
+            _yed_syntax_line(syntax, line, event, range);
+
+            if (syntax->needs_state) {
+                end_range = _yed_syntax_get_line_end_state(syntax, &buff, line, range);
+                if (!end_range->one_line) { range = end_range; }
+            }
         }
 
 
@@ -1638,6 +2763,10 @@ static inline void yed_syntax_highlight_request_event(yed_syntax *syntax, yed_ev
     }
 
     yed_destroy_buffer(&buff);
+
+    if (len <= YED_SYN_HL_CACHE_MAX_LEN) {
+        _yed_syntax_hl_cache_add(syntax, hash, event->highlight_string, event, first);
+    }
 }
 
 
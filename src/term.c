@@ -46,10 +46,12 @@ int yed_term_enter(void) {
     yed_register_sigchld_handler();
     yed_register_sigpipe_handler();
 
+    yed_render_lock();
     printf(TERM_ALT_SCREEN);
     printf(TERM_ENABLE_BRACKETED_PASTE);
 
     fflush(stdout);
+    yed_render_unlock();
 
     return 0;
 }
@@ -83,6 +85,7 @@ int yed_term_exit(void) {
         return 0;
     }
 
+    yed_render_lock();
     printf("\e[%d q", TERM_CURSOR_STYLE_DEFAULT);
     printf(TERM_DISABLE_BRACKETED_PASTE);
     printf(TERM_STD_SCREEN);
@@ -94,10 +97,60 @@ int yed_term_exit(void) {
     yed_term_has_exited = 1;
 
     fflush(stdout);
+    yed_render_unlock();
 
     return 0;
 }
 
+#define TERM_EXIT_SEQUENCE           \
+    "\e[0 q"                         \
+    TERM_DISABLE_BRACKETED_PASTE     \
+    TERM_STD_SCREEN                  \
+    TERM_CURSOR_SHOW                 \
+    TERM_MOUSE_BUTTON_DISABLE
+
+/*
+ * yed_term_exit() for signal handlers.
+ * The render thread may be stuck writing to a terminal that isn't reading, or
+ * it may be the thread that faulted, so we can't wait on the render lock.
+ * Take it if it's free and write the reset sequences ourselves either way.
+ */
+static void yed_term_exit_from_signal(void) {
+    const char *seq;
+    int         len;
+    int         n;
+    int         locked;
+
+    if (yed_term_has_exited) {
+        return;
+    }
+
+    locked = ys->render_thread_running
+             && pthread_mutex_trylock(&ys->render_mutex) == 0;
+
+    seq = TERM_EXIT_SEQUENCE;
+    len = sizeof(TERM_EXIT_SEQUENCE) - 1;
+
+    while (len > 0) {
+        n = write(1, seq, len);
+        if (n < 0) {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+        seq += n;
+        len -= n;
+    }
+
+    /* Not TCSAFLUSH: that waits for the output to drain. */
+    tcsetattr(0, TCSANOW, &ys->sav_term);
+
+    yed_term_has_exited = 1;
+
+    if (locked) {
+        pthread_mutex_unlock(&ys->render_mutex);
+    }
+}
+
 int yed_term_get_dim(int *r, int *c) {
     struct winsize ws;
 
@@ -133,7 +186,9 @@ void yed_term_set_cursor_style(int style) {
         case TERM_CURSOR_STYLE_STEADY_UNDERLINE:
         case TERM_CURSOR_STYLE_BLINKING_BAR:
         case TERM_CURSOR_STYLE_STEADY_BAR:
+            yed_render_lock();
             printf("\e[%d q", style);
+            yed_render_unlock();
             break;
         default:;
     }
@@ -156,7 +211,7 @@ void sigstop_handler(int sig) {
 
     /* Exit the terminal. */
     ys->stopped = 1;
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     /* Do the real suspend */
     kill(0, SIGTSTP);
@@ -192,7 +247,7 @@ void sigterm_handler(int sig) {
     sigaction(SIGTERM, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     /* Do the real terminate */
     kill(0, SIGTERM);
@@ -207,7 +262,7 @@ void sigquit_handler(int sig) {
     sigaction(SIGQUIT, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     /* Do the real quit */
     kill(0, SIGQUIT);
@@ -238,7 +293,7 @@ void sigsegv_handler(int sig) {
     sigaction(SIGSEGV, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     print_fatal_signal_message_and_backtrace("SIGSEGV");
 
@@ -255,7 +310,7 @@ void sigabrt_handler(int sig) {
     sigaction(SIGABRT, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     print_fatal_signal_message_and_backtrace("SIGABRT");
 
@@ -272,7 +327,7 @@ void sigill_handler(int sig) {
     sigaction(SIGILL, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     print_fatal_signal_message_and_backtrace("SIGILL");
 
@@ -289,7 +344,7 @@ void sigfpe_handler(int sig) {
     sigaction(SIGFPE, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     print_fatal_signal_message_and_backtrace("SIGFPE");
 
@@ -306,7 +361,7 @@ void sigbus_handler(int sig) {
     sigaction(SIGBUS, &act, NULL);
 
     /* Exit the terminal. */
-    yed_term_exit();
+    yed_term_exit_from_signal();
 
     print_fatal_signal_message_and_backtrace("SIGBUS");
 
@@ -523,16 +578,20 @@ void yed_handle_resize(void) {
 }
 
 void yed_term_enable_mouse_reporting(void) {
+    yed_render_lock();
     printf("%s", TERM_MOUSE_BUTTON_ENABLE);
     printf("%s", TERM_SGR_1006_ENABLE);
+    yed_render_unlock();
     LOG_FN_ENTER();
     yed_log("mouse on");
     LOG_EXIT();
 }
 
 void yed_term_disable_mouse_reporting(void) {
+    yed_render_lock();
     printf("%s", TERM_MOUSE_BUTTON_DISABLE);
     printf("%s", TERM_SGR_1006_DISABLE);
+    yed_render_unlock();
     LOG_FN_ENTER();
     yed_log("mouse off");
     LOG_EXIT();
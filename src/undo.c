@@ -18,9 +18,27 @@ yed_undo_history yed_new_undo_history(void) {
 }
 
 void yed_free_undo_record(yed_undo_record *record) {
+    yed_undo_action *action;
+
+    array_traverse(record->actions, action) {
+        if (action->kind == UNDO_LINE_SPAN) {
+            free(action->span.text);
+        }
+    }
+
     array_free(record->actions);
 }
 
+static void yed_clear_redo(yed_undo_history *history) {
+    yed_undo_record *record;
+
+    array_traverse(history->redo, record) {
+        yed_free_undo_record(record);
+    }
+
+    array_clear(history->redo);
+}
+
 void yed_free_undo_history(yed_undo_history *history) {
     yed_undo_record *record;
 
@@ -56,13 +74,8 @@ void yed_force_end_undo_record(yed_undo_history *history) {
     record->end_cursor_row = record->start_cursor_row;
     record->end_cursor_col = record->start_cursor_col;
 
-    /*
-     * We must clear the redo history here.
-     * For now, we'll just clear the array, but
-     * eventually there will be stuff that needs
-     * to be freed and such.
-     */
-    array_clear(history->redo);
+    /* We must clear the redo history here. */
+    yed_clear_redo(history);
 
     history->current_record = NULL;
 }
@@ -129,13 +142,8 @@ void yed_end_undo_record(yed_frame *frame, yed_buffer *buffer) {
         record->end_cursor_col = 1;
     }
 
-    /*
-     * We must clear the redo history here.
-     * For now, we'll just clear the array, but
-     * eventually there will be stuff that needs
-     * to be freed and such.
-     */
-    array_clear(history->redo);
+    /* We must clear the redo history here. */
+    yed_clear_redo(history);
 
     history->current_record    = NULL;
 }
@@ -191,7 +199,8 @@ void yed_merge_undo_records(struct yed_buffer_t *buffer) {
     new_last_record->end_cursor_row = last_record->end_cursor_row;
     new_last_record->end_cursor_col = last_record->end_cursor_col;
 
-    yed_free_undo_record(last_record);
+    /* The actions live on in new_last_record, so only the array goes. */
+    array_free(last_record->actions);
     array_pop(history->undo);
 
     new_last_record = array_last(history->undo);
@@ -247,6 +256,11 @@ void yed_undo_single_action(yed_frame *frame, yed_buffer *buffer, yed_undo_actio
             yed_buff_insert_line_no_undo(buffer, action->row);
             break;
 
+        case UNDO_LINE_SPAN:
+            yed_buff_replace_span_no_undo(buffer, action->row, action->col, action->span.new_len,
+                                          action->span.text, action->span.old_len);
+            break;
+
         default:
             ASSERT(0, "unhandled undo action kind");
     }
@@ -278,6 +292,11 @@ void yed_redo_single_action(yed_frame *frame, yed_buffer *buffer, yed_undo_actio
             yed_buff_delete_line_no_undo(buffer, action->row);
             break;
 
+        case UNDO_LINE_SPAN:
+            yed_buff_replace_span_no_undo(buffer, action->row, action->col, action->span.old_len,
+                                          action->span.text + action->span.old_len, action->span.new_len);
+            break;
+
         default:
             ASSERT(0, "unhandled undo action kind");
     }
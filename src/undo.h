@@ -8,6 +8,7 @@
 #define UNDO_GLYPH_POP  (4)
 #define UNDO_LINE_ADD   (5)
 #define UNDO_LINE_DEL   (6)
+#define UNDO_LINE_SPAN  (7) /* span.old_len bytes at byte index col were replaced. */
 
 struct yed_line_t;
 
@@ -15,6 +16,11 @@ typedef struct {
     union {
         yed_glyph  g;
         char      *text;
+        struct {
+            char  *text;    /* The old bytes followed by the new ones. */
+            int    old_len;
+            int    new_len;
+        } span;
     };
     int            kind;
     int            col;
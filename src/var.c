@@ -11,19 +11,25 @@ void yed_set_default_vars(void) {
     yed_set_var("buffer-load-mode",             "stream");
     yed_set_var("bracketed-paste-mode",         "on");
     yed_set_var("enable-search-cursor-move",    "yes");
+    yed_set_var("search-regex",                 "no");
+    yed_set_var("search-smart-case",            "no");
+    yed_set_var("grep-ignore",                  DEFAULT_GREP_IGNORE);
     yed_set_var("default-scroll-offset",        XSTR(DEFAULT_SCROLL_OFF));
     yed_set_var("command-prompt-string",        DEFAULT_CMD_PROMPT_STRING);
+    yed_set_var("compl-fuzzy",                  "yes");
     yed_set_var("border-style",                 DEFAULT_BORDER_STYLE);
     yed_set_var("fill-string",                  DEFAULT_FILL_STRING);
     yed_set_var("cursor-move-clears-search",    "yes");
-    yed_set_var("use-boyer-moore",              "no");
     yed_set_var("status-line-left",             DEFAULT_STATUS_LINE_LEFT);
     yed_set_var("status-line-center",           DEFAULT_STATUS_LINE_CENTER);
     yed_set_var("status-line-right",            DEFAULT_STATUS_LINE_RIGHT);
     yed_set_var("screen-update-sync",           "yes");
     yed_set_var("syntax-max-line-length",       XSTR(DEFAULT_SYNTAX_MAX_LINE_LENGTH));
-    yed_set_var("compl-words-buffer-max-lines", XSTR(DEFAULT_COMPL_WORDS_BUFFER_MAX_LINES));
+    yed_set_var("syntax-scan-budget-ms",        XSTR(DEFAULT_SYNTAX_SCAN_BUDGET_MS));
     yed_set_var("screen-fake-opacity",          XSTR(DEFAULT_FAKE_OPACITY));
+    yed_set_var("frame-row-cache",              "yes");
+    yed_set_var("screen-render-thread",         "yes");
+    yed_set_var("worker-threads",               "auto");
 }
 
 void yed_set_var(const char *var, const char *val) {
@@ -20,15 +20,19 @@ int yed_get_default_scroll_offset(void);
 #define DEFAULT_BORDER_STYLE "thin"
 
 #define DEFAULT_STATUS_LINE_LEFT   " %f %b"
-#define DEFAULT_STATUS_LINE_CENTER ""
+#define DEFAULT_STATUS_LINE_CENTER "%m"
 #define DEFAULT_STATUS_LINE_RIGHT  "(%p%%)  %l :: %c  %t "
 
 #define DEFAULT_SYNTAX_MAX_LINE_LENGTH 1000
+#define DEFAULT_SYNTAX_SCAN_BUDGET_MS  4
 
+/* Deprecated: the 'compl-words-buffer-max-lines' variable is gone, and nothing uses this. */
 #define DEFAULT_COMPL_WORDS_BUFFER_MAX_LINES 25000
 
 #define DEFAULT_FAKE_OPACITY 0.9
 
+#define DEFAULT_GREP_IGNORE "node_modules __pycache__ *.min.js"
+
 int yed_var_is_truthy(const char *var);
 int yed_get_var_as_int(const char *var, int *out);
 
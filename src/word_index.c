@@ -0,0 +1,588 @@
+#include "word_index.h"
+
+static u32 word_hash(const char *s, int len) {
+    u32 h;
+    int i;
+
+    h = 2166136261u;
+    for (i = 0; i < len; i += 1) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static inline u32 word_ptr_hash(yed_word *word) {
+    return word->hash * 2654435761u;
+}
+
+static inline int is_word_char(char c) {
+    return is_alnum((unsigned char)c) || c == '_';
+}
+
+void yed_init_word_index(void) {
+    yed_word_table *table;
+
+    if (ys->word_table != NULL) { return; }
+
+    table          = malloc(sizeof(*table));
+    table->cap     = 1024;
+    table->len     = 0;
+    table->n_live  = 0;
+    table->slots   = calloc(table->cap, sizeof(yed_word*));
+    table->sorted  = array_make(yed_word*);
+    table->pending = array_make(yed_word*);
+    table->scratch = array_make(yed_word*);
+    table->results = array_make(yed_word*);
+
+    table->pending_sorted = 1;
+
+    ys->word_table = table;
+}
+
+static void word_table_put(yed_word **slots, int cap, yed_word *word) {
+    int i;
+
+    for (i = word->hash & (cap - 1); slots[i] != NULL; i = (i + 1) & (cap - 1));
+
+    slots[i] = word;
+}
+
+static void word_table_grow(yed_word_table *table) {
+    yed_word **slots;
+    int        cap;
+    int        i;
+
+    cap   = table->cap * 2;
+    slots = calloc(cap, sizeof(yed_word*));
+
+    for (i = 0; i < table->cap; i += 1) {
+        if (table->slots[i] != NULL) {
+            word_table_put(slots, cap, table->slots[i]);
+        }
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->cap   = cap;
+}
+
+static yed_word *word_intern(yed_word_table *table, const char *s, int len) {
+    u32       hash;
+    int       i;
+    yed_word *word;
+
+    hash = word_hash(s, len);
+
+    for (i = hash & (table->cap - 1); (word = table->slots[i]) != NULL; i = (i + 1) & (table->cap - 1)) {
+        if (word->hash == hash && word->len == len && memcmp(word->str, s, len) == 0) {
+            return word;
+        }
+    }
+
+    word                = malloc(sizeof(yed_word) + len + 1);
+    word->hash          = hash;
+    word->len           = len;
+    word->count         = 0;
+    word->special_count = 0;
+    word->refs          = 0;
+    memcpy(word->str, s, len);
+    word->str[len] = 0;
+
+    table->slots[i]  = word;
+    table->len      += 1;
+
+    array_push(table->pending, word);
+    table->pending_sorted = 0;
+
+    if (2 * table->len > table->cap) {
+        word_table_grow(table);
+    }
+
+    return word;
+}
+
+static void word_index_put(yed_word_index_entry *entries, int cap, yed_word_index_entry *entry) {
+    int i;
+
+    for (i = word_ptr_hash(entry->word) & (cap - 1); entries[i].word != NULL; i = (i + 1) & (cap - 1));
+
+    entries[i] = *entry;
+}
+
+static void word_index_rehash(yed_word_index *index, int cap) {
+    yed_word_index_entry *entries;
+    int                   i;
+
+    entries = calloc(cap, sizeof(yed_word_index_entry));
+
+    for (i = 0; i < index->cap; i += 1) {
+        if (index->entries[i].word != NULL) {
+            word_index_put(entries, cap, index->entries + i);
+        }
+    }
+
+    free(index->entries);
+    index->entries = entries;
+    index->cap     = cap;
+}
+
+static yed_word_index_entry *word_index_entry(yed_word_index *index, yed_word *word) {
+    int                   i;
+    yed_word_index_entry *entry;
+
+    for (i = word_ptr_hash(word) & (index->cap - 1); (entry = index->entries + i)->word != NULL; i = (i + 1) & (index->cap - 1)) {
+        if (entry->word == word) { return entry; }
+    }
+
+    entry->word  = word;
+    entry->count = 0;
+    word->refs  += 1;
+    index->len  += 1;
+
+    if (2 * index->len > index->cap) {
+        word_index_rehash(index, 2 * index->cap);
+        return word_index_entry(index, word);
+    }
+
+    return entry;
+}
+
+static void word_count(yed_word_table *table, yed_word *word, int special, int delta) {
+    int before;
+
+    before = word->count + word->special_count;
+
+    if (special) { word->special_count += delta; }
+    else         { word->count         += delta; }
+
+    if      (before == 0 && word->count + word->special_count > 0) { table->n_live += 1; }
+    else if (before > 0 && word->count + word->special_count == 0) { table->n_live -= 1; }
+}
+
+static void word_index_count_text(yed_word_index *index, const char *data, int len, int delta) {
+    yed_word_table       *table;
+    int                   i;
+    int                   j;
+    yed_word_index_entry *entry;
+
+    table = ys->word_table;
+    i     = 0;
+
+    while (i < len) {
+        if (!is_word_char(data[i])) {
+            i += 1;
+            continue;
+        }
+
+        for (j = i + 1; j < len && is_word_char(data[j]); j += 1);
+
+        entry         = word_index_entry(index, word_intern(table, data + i, j - i));
+        entry->count += delta;
+        word_count(table, entry->word, index->special, delta);
+
+        i = j;
+    }
+}
+
+static void word_index_count_line(yed_word_index *index, yed_line *line, int delta) {
+    word_index_count_text(index, array_data(line->chars), array_len(line->chars), delta);
+}
+
+static int buff_can_word_index(yed_buffer *buff) {
+    return !(buff->flags & BUFF_NO_MOD_EVENTS) && buff->kind != BUFF_KIND_YANK;
+}
+
+yed_word_index *yed_buff_get_word_index(yed_buffer *buff) {
+    yed_word_index *index;
+
+    if (buff->word_index != NULL) { return buff->word_index; }
+
+    if (ys->word_table == NULL || !buff_can_word_index(buff)) { return NULL; }
+
+    index           = malloc(sizeof(*index));
+    index->cap      = 64;
+    index->len      = 0;
+    index->entries  = calloc(index->cap, sizeof(yed_word_index_entry));
+    index->old_text = array_make(char);
+    index->scan_row = 1;
+    index->special  = !!(buff->flags & BUFF_SPECIAL);
+
+    buff->word_index = index;
+
+    return index;
+}
+
+void yed_free_word_index(yed_buffer *buff) {
+    yed_word_index       *index;
+    yed_word_index_entry *entry;
+    int                   i;
+
+    index = buff->word_index;
+
+    if (index == NULL) { return; }
+
+    for (i = 0; i < index->cap; i += 1) {
+        entry = index->entries + i;
+        if (entry->word == NULL) { continue; }
+
+        word_count(ys->word_table, entry->word, index->special, -entry->count);
+        entry->word->refs -= 1;
+    }
+
+    free(index->entries);
+    array_free(index->old_text);
+    free(index);
+
+    buff->word_index = NULL;
+}
+
+int yed_word_index_scan(yed_buffer *buff, yed_word_index *index, u64 deadline_us) {
+    yed_line *line;
+    int       n;
+
+    if (index->scan_row > yed_buff_n_lines(buff)) { return 0; }
+
+    n = 0;
+    bucket_array_traverse_from(buff->lines, line, index->scan_row - 1) {
+        word_index_count_line(index, line, 1);
+        index->scan_row += 1;
+
+        n += 1;
+        if ((n & 255) == 0 && measure_time_now_us() >= deadline_us) { break; }
+    }
+
+    return index->scan_row <= yed_buff_n_lines(buff);
+}
+
+static int word_cmp(const void *a, const void *b) {
+    return strcmp((*(yed_word**)a)->str, (*(yed_word**)b)->str);
+}
+
+/* Sort the new words into table->sorted. */
+static void word_table_merge_pending(yed_word_table *table) {
+    yed_word **a, **a_end,
+             **b, **b_end;
+    array_t    tmp;
+
+    if (array_len(table->pending) == 0) { return; }
+
+    qsort(array_data(table->pending), array_len(table->pending), sizeof(yed_word*), word_cmp);
+
+    a     = array_data(table->sorted);
+    a_end = a + array_len(table->sorted);
+    b     = array_data(table->pending);
+    b_end = b + array_len(table->pending);
+
+    array_clear(table->scratch);
+    array_grow_if_needed_to(table->scratch, array_len(table->sorted) + array_len(table->pending));
+
+    while (a < a_end && b < b_end) {
+        if (strcmp((*a)->str, (*b)->str) <= 0) { array_push(table->scratch, *a); a += 1; }
+        else                                   { array_push(table->scratch, *b); b += 1; }
+    }
+    array_push_n(table->scratch, a, a_end - a);
+    array_push_n(table->scratch, b, b_end - b);
+
+    tmp            = table->sorted;
+    table->sorted  = table->scratch;
+    table->scratch = tmp;
+
+    array_clear(table->pending);
+    table->pending_sorted = 1;
+}
+
+/*
+ * Throw out the words that don't appear anywhere: first the buffers' counts
+ * of them, then the words themselves.
+ */
+static void word_table_collect(yed_word_table *table) {
+    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)   it;
+    yed_word_index                                *index;
+    yed_word_index_entry                          *entries;
+    int                                            cap;
+    int                                            i;
+    yed_word                                     **w;
+
+    tree_traverse(ys->buffers, it) {
+        index = tree_it_val(it)->word_index;
+        if (index == NULL) { continue; }
+
+        entries        = index->entries;
+        cap            = index->cap;
+        index->entries = calloc(cap, sizeof(yed_word_index_entry));
+        index->len     = 0;
+
+        for (i = 0; i < cap; i += 1) {
+            if (entries[i].word == NULL) { continue; }
+
+            if (entries[i].count == 0) {
+                entries[i].word->refs -= 1;
+            } else {
+                word_index_put(index->entries, cap, entries + i);
+                index->len += 1;
+            }
+        }
+
+        free(entries);
+    }
+
+    word_table_merge_pending(table);
+
+    memset(table->slots, 0, table->cap * sizeof(yed_word*));
+    table->len = 0;
+
+    array_clear(table->scratch);
+    array_traverse(table->sorted, w) {
+        if ((*w)->refs == 0) {
+            free(*w);
+        } else {
+            array_push(table->scratch, *w);
+            word_table_put(table->slots, table->cap, *w);
+            table->len += 1;
+        }
+    }
+
+    array_clear(table->sorted);
+    array_push_n(table->sorted, (yed_word**)array_data(table->scratch), array_len(table->scratch));
+}
+
+/* First word in words[0, n) that doesn't come before prefix. */
+static int word_lower_bound(yed_word **words, int n, const char *prefix) {
+    int lo, hi, mid;
+
+    lo = 0;
+    hi = n;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (strcmp(words[mid]->str, prefix) < 0) { lo = mid + 1; }
+        else                                     { hi = mid;     }
+    }
+
+    return lo;
+}
+
+static inline int word_is_live(yed_word *word, int include_special) {
+    return word->count > 0 || (include_special && word->special_count > 0);
+}
+
+int yed_word_index_lookup(const char *prefix, int include_special, yed_word ***words) {
+    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)   it;
+    yed_word_table                                *table;
+    yed_word_index                                *index;
+    yed_word                                     **a, **b;
+    int                                            a_len, b_len;
+    int                                            i, j;
+    int                                            len;
+    yed_word                                      *word;
+
+    table = ys->word_table;
+
+    tree_traverse(ys->buffers, it) {
+        if ((index = yed_buff_get_word_index(tree_it_val(it))) != NULL) {
+            yed_word_index_scan(tree_it_val(it), index, (u64)-1);
+        }
+    }
+
+    if (array_len(table->pending) > MAX(WORD_INDEX_PENDING_MIN, array_len(table->sorted) / WORD_INDEX_PENDING_FRAC)) {
+        word_table_merge_pending(table);
+    } else if (!table->pending_sorted) {
+        qsort(array_data(table->pending), array_len(table->pending), sizeof(yed_word*), word_cmp);
+        table->pending_sorted = 1;
+    }
+
+    len   = strlen(prefix);
+    a     = array_data(table->sorted);
+    a_len = array_len(table->sorted);
+    b     = array_data(table->pending);
+    b_len = array_len(table->pending);
+    i     = word_lower_bound(a, a_len, prefix);
+    j     = word_lower_bound(b, b_len, prefix);
+
+    array_clear(table->results);
+
+    while (i < a_len || j < b_len) {
+        if (j == b_len || (i < a_len && strcmp(a[i]->str, b[j]->str) <= 0)) {
+            word  = a[i];
+            i    += 1;
+        } else {
+            word  = b[j];
+            j    += 1;
+        }
+
+        if (strncmp(word->str, prefix, len) != 0) { break; }
+
+        if (word_is_live(word, include_special)) {
+            array_push(table->results, word);
+        }
+    }
+
+    *words = array_data(table->results);
+
+    return array_len(table->results);
+}
+
+static int word_index_line_mod(int kind) {
+    switch (kind) {
+        case BUFF_MOD_APPEND_TO_LINE:
+        case BUFF_MOD_POP_FROM_LINE:
+        case BUFF_MOD_CLEAR_LINE:
+        case BUFF_MOD_SET_LINE:
+        case BUFF_MOD_INSERT_INTO_LINE:
+        case BUFF_MOD_DELETE_FROM_LINE:
+        case BUFF_MOD_CLEAR:
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Count the words of rows first through last that the scan has been past. */
+static void word_index_count_rows(yed_buffer *buff, yed_word_index *index, int first, int last) {
+    yed_line *line;
+    int       row;
+
+    last = MIN(last, index->scan_row - 1);
+    if (first > last) { return; }
+
+    row = first;
+    bucket_array_traverse_from(buff->lines, line, first - 1) {
+        if (row > last) { break; }
+        word_index_count_line(index, line, 1);
+        row += 1;
+    }
+}
+
+/*
+ * Keep the text of the rows that are about to change (those that the scan
+ * has been past) so that their words can be taken away once they have.
+ * The change may still be cancelled by a later handler.
+ */
+static void word_index_save_rows(yed_buffer *buff, yed_word_index *index, int first, int last) {
+    yed_line *line;
+    int       row;
+    char      nl;
+
+    array_clear(index->old_text);
+
+    last = MIN(last, index->scan_row - 1);
+    if (first > last) { return; }
+
+    nl  = '\n';
+    row = first;
+    bucket_array_traverse_from(buff->lines, line, first - 1) {
+        if (row > last) { break; }
+        array_push_n(index->old_text, (char*)array_data(line->chars), array_len(line->chars));
+        array_push(index->old_text, nl);
+        row += 1;
+    }
+}
+
+static void word_index_uncount_saved(yed_word_index *index) {
+    word_index_count_text(index, array_data(index->old_text), array_len(index->old_text), -1);
+    array_clear(index->old_text);
+}
+
+void yed_word_index_pre_mod_handler(yed_event *event) {
+    yed_buffer     *buff;
+    yed_word_index *index;
+
+    buff  = event->buffer;
+    index = buff->word_index;
+
+    if (index == NULL) { return; }
+
+    /* Row 0 means the whole buffer is being cleared. It'll be indexed again. */
+    if (event->buff_mod_event == BUFF_MOD_CLEAR && event->row == 0) {
+        yed_free_word_index(buff);
+        return;
+    }
+
+    if (word_index_line_mod(event->buff_mod_event)
+    ||  event->buff_mod_event == BUFF_MOD_DELETE_LINE) {
+        word_index_save_rows(buff, index, event->row, event->row);
+    } else if (event->buff_mod_event == BUFF_MOD_SET_LINES) {
+        word_index_save_rows(buff, index, event->row, event->last_row);
+    } else {
+        array_clear(index->old_text);
+    }
+}
+
+void yed_word_index_post_mod_handler(yed_event *event) {
+    yed_buffer     *buff;
+    yed_word_index *index;
+
+    buff  = event->buffer;
+    index = buff->word_index;
+
+    if (index == NULL) { return; }
+
+    switch (event->buff_mod_event) {
+        case BUFF_MOD_SET_LINES:
+            word_index_uncount_saved(index);
+            word_index_count_rows(buff, index, event->row, event->last_row);
+            break;
+
+        case BUFF_MOD_ADD_LINE:
+        case BUFF_MOD_INSERT_LINE:
+            /* New rows are empty. */
+            if (event->row < index->scan_row) { index->scan_row += 1; }
+            break;
+
+        case BUFF_MOD_DELETE_LINE:
+            word_index_uncount_saved(index);
+            if (event->row < index->scan_row) { index->scan_row -= 1; }
+            break;
+
+        default:
+            if (word_index_line_mod(event->buff_mod_event)) {
+                word_index_uncount_saved(index);
+                word_index_count_rows(buff, index, event->row, event->row);
+            }
+    }
+}
+
+void yed_word_index_pump_handler(yed_event *event) {
+    tree_it(yed_buffer_name_t, yed_buffer_ptr_t)  it;
+    yed_word_table                               *table;
+    yed_buffer                                   *buff;
+    yed_word_index                               *index;
+    u64                                           deadline_us;
+    int                                           more;
+
+    table = ys->word_table;
+
+    if (table == NULL) { return; }
+
+    if (table->len - table->n_live > MAX(WORD_INDEX_GC_MIN, table->n_live)) {
+        word_table_collect(table);
+    }
+
+    deadline_us = measure_time_now_us() + WORD_INDEX_BUDGET_US;
+    more        = 0;
+
+    /* The buffer being looked at goes first. */
+    if (ys->active_frame != NULL && ys->active_frame->buffer != NULL
+    &&  (index = yed_buff_get_word_index(ys->active_frame->buffer)) != NULL) {
+        more |= yed_word_index_scan(ys->active_frame->buffer, index, deadline_us);
+    }
+
+    tree_traverse(ys->buffers, it) {
+        buff = tree_it_val(it);
+
+        if ((index = yed_buff_get_word_index(buff)) == NULL) { continue; }
+
+        if (measure_time_now_us() >= deadline_us) {
+            more |= index->scan_row <= yed_buff_n_lines(buff);
+            continue;
+        }
+
+        more |= yed_word_index_scan(buff, index, deadline_us);
+    }
+
+    /* Come back soon rather than waiting for input. */
+    if (more) {
+        yed_force_update();
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef __WORD_INDEX_H__
+#define __WORD_INDEX_H__
+
+/*
+ * The words in every buffer, for word completion.
+ *
+ * Each word (a run of letters, digits and underscores) is stored once, in a
+ * hash table shared by all buffers, along with how many times it appears.
+ * Each buffer has its own count of every word it has, so that all of its
+ * words can be let go of at once when it is cleared or destroyed.
+ *
+ * Buffers are indexed a little at a time before each pump, the active one
+ * first, and kept up to date from the modification events: the text of a
+ * row that is about to change is kept in EVENT_BUFFER_PRE_MOD, and in
+ * EVENT_BUFFER_POST_MOD its old words are taken away and the new ones are
+ * added, so a change that is cancelled leaves the counts alone. Rows past
+ * the point that the background scan has reached are left for it to count.
+ *
+ * Lookups by prefix binary search a sorted array of the words and a much
+ * smaller sorted array of the words that are new since it was last put
+ * together, so that typing a new word doesn't mean merging every word
+ * again. The new ones are merged in once there are more than
+ * WORD_INDEX_PENDING_MIN of them and more than 1/WORD_INDEX_PENDING_FRAC
+ * of all words. Words that no longer appear anywhere stay until there are
+ * more of them than live ones, and are then thrown out before a pump.
+ *
+ * Buffers that don't send modification events aren't indexed.
+ */
+
+#define WORD_INDEX_BUDGET_US (4000)
+#define WORD_INDEX_GC_MIN    (4096)
+#define WORD_INDEX_PENDING_MIN  (1024)
+#define WORD_INDEX_PENDING_FRAC (64)
+
+typedef struct yed_word_t {
+    u32  hash;
+    int  len;
+    int  count;          /* Times it appears in buffers that aren't special, */
+    int  special_count;  /* and in those that are. */
+    int  refs;           /* Buffer indexes that have a count for it. */
+    char str[];
+} yed_word;
+
+typedef struct {
+    yed_word *word;
+    int       count;
+} yed_word_index_entry;
+
+typedef struct yed_word_index_t {
+    yed_word_index_entry *entries;   /* Open addressing, by word pointer. */
+    int                   cap;
+    int                   len;
+    array_t               old_text;  /* Rows about to change, as they were. */
+    int                   scan_row;  /* Rows before this one have been counted. */
+    int                   special;
+} yed_word_index;
+
+typedef struct yed_word_table_t {
+    yed_word **slots;    /* Open addressing, by string. */
+    int        cap;
+    int        len;
+    int        n_live;   /* Words that appear somewhere. */
+    array_t    sorted;   /* yed_word*, by string. */
+    array_t    pending;  /* yed_word*, not in sorted yet. */
+    int        pending_sorted;
+    array_t    scratch;
+    array_t    results;  /* yed_word*, from the last lookup. */
+} yed_word_table;
+
+void yed_init_word_index(void);
+
+yed_word_index *yed_buff_get_word_index(yed_buffer *buff);
+void yed_free_word_index(yed_buffer *buff);
+
+/* Index up to the deadline. Returns non-zero if there are still rows left. */
+int yed_word_index_scan(yed_buffer *buff, yed_word_index *index, u64 deadline_us);
+
+/*
+ * Finish indexing every buffer and set *words to the words that start with
+ * prefix and appear in some buffer (special buffers only count if
+ * include_special is set), in sorted order. Returns how many there are.
+ * The array belongs to the index and is only good until the next lookup.
+ */
+int yed_word_index_lookup(const char *prefix, int include_special, yed_word ***words);
+
+void yed_word_index_pre_mod_handler(yed_event *event);
+void yed_word_index_post_mod_handler(yed_event *event);
+void yed_word_index_pump_handler(yed_event *event);
+
+#endif
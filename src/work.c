@@ -0,0 +1,154 @@
+#include "work.h"
+
+static void do_work_items(int worker) {
+    int item;
+
+    while ((item = __atomic_fetch_add(&ys->work_next_item, 1, __ATOMIC_ACQ_REL)) < ys->work_n_items) {
+        ys->work_fn(item, worker, ys->work_arg);
+    }
+}
+
+static void * worker_thread(void *arg) {
+    int worker;
+    u64 seen;
+
+    worker = (int)(u64)arg;
+    seen   = 0;
+
+    pthread_mutex_lock(&ys->work_mutex);
+
+    for (;;) {
+        while (!ys->work_stop && ys->work_generation == seen) {
+            pthread_cond_wait(&ys->work_cond, &ys->work_mutex);
+        }
+
+        if (ys->work_stop) { break; }
+
+        seen = ys->work_generation;
+
+        pthread_mutex_unlock(&ys->work_mutex);
+        do_work_items(worker);
+        pthread_mutex_lock(&ys->work_mutex);
+
+        /*
+         * Every worker checks in for every run, so yed_work_run() can't
+         * return (and start a new run) while one of us is still looking
+         * at the old one.
+         */
+        ys->work_n_finished += 1;
+        if (ys->work_n_finished == ys->n_workers) {
+            pthread_cond_signal(&ys->work_done_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&ys->work_mutex);
+
+    return NULL;
+}
+
+void yed_start_workers(void) {
+    int      n;
+    long     n_cpus;
+    sigset_t block;
+    sigset_t save;
+
+    if (ys->workers_started) { return; }
+
+    if (!yed_get_var_as_int("worker-threads", &n)) {
+        n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n      = n_cpus > 1 ? n_cpus : 1;
+    }
+
+    /* The main thread is a worker too. */
+    n -= 1;
+    LIMIT(n, 0, MAX_WORKERS - 1);
+
+    pthread_mutex_init(&ys->work_mutex, NULL);
+    pthread_cond_init(&ys->work_cond, NULL);
+    pthread_cond_init(&ys->work_done_cond, NULL);
+
+    ys->work_stop       = 0;
+    ys->work_generation = 0;
+    ys->n_workers       = 0;
+    ys->workers_started = 1;
+
+    /* Same as the render thread: leave the asynchronous signals to the main thread. */
+    sigfillset(&block);
+    sigdelset(&block, SIGSEGV);
+    sigdelset(&block, SIGBUS);
+    sigdelset(&block, SIGFPE);
+    sigdelset(&block, SIGILL);
+    sigdelset(&block, SIGABRT);
+
+    pthread_sigmask(SIG_BLOCK, &block, &save);
+
+    while (ys->n_workers < n) {
+        if (pthread_create(ys->worker_ids + ys->n_workers, NULL, worker_thread, (void*)(u64)(ys->n_workers + 1)) != 0) {
+            break;
+        }
+        ys->n_workers += 1;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &save, NULL);
+}
+
+void yed_stop_workers(void) {
+    void *junk;
+    int   i;
+
+    if (!ys->workers_started) { return; }
+
+    pthread_mutex_lock(&ys->work_mutex);
+    ys->work_stop = 1;
+    pthread_cond_broadcast(&ys->work_cond);
+    pthread_mutex_unlock(&ys->work_mutex);
+
+    for (i = 0; i < ys->n_workers; i += 1) {
+        pthread_join(ys->worker_ids[i], &junk);
+    }
+
+    pthread_cond_destroy(&ys->work_done_cond);
+    pthread_cond_destroy(&ys->work_cond);
+    pthread_mutex_destroy(&ys->work_mutex);
+
+    ys->n_workers       = 0;
+    ys->workers_started = 0;
+}
+
+int yed_n_workers(void) { return ys->n_workers + 1; }
+
+void yed_work_run(int n_items, yed_work_fn_t fn, void *arg) {
+    int i;
+
+    if (n_items <= 0) { return; }
+
+    /* Not worth waking anyone up for. Also, runs don't nest. */
+    if (ys->n_workers == 0 || n_items == 1 || ys->work_busy) {
+        for (i = 0; i < n_items; i += 1) {
+            fn(i, 0, arg);
+        }
+        return;
+    }
+
+    ys->work_busy = 1;
+
+    pthread_mutex_lock(&ys->work_mutex);
+    ys->work_fn         = fn;
+    ys->work_arg        = arg;
+    ys->work_n_items    = n_items;
+    ys->work_next_item  = 0;
+    ys->work_n_finished = 0;
+    ys->work_generation += 1;
+    pthread_cond_broadcast(&ys->work_cond);
+    pthread_mutex_unlock(&ys->work_mutex);
+
+    do_work_items(0);
+
+    pthread_mutex_lock(&ys->work_mutex);
+    while (ys->work_n_finished < ys->n_workers) {
+        pthread_cond_wait(&ys->work_done_cond, &ys->work_mutex);
+    }
+    pthread_mutex_unlock(&ys->work_mutex);
+
+    ys->work_busy = 0;
+}
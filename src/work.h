@@ -0,0 +1,29 @@
+#ifndef __WORK_H__
+#define __WORK_H__
+
+/*
+ * A small pool of worker threads for work that has to be finished before
+ * the main thread can go on, e.g. highlighting the rows of a frame right
+ * before they're drawn. yed_work_run() hands items out to the workers and
+ * to the calling thread and returns once every item is done.
+ *
+ * Work functions run while the main thread is waiting in yed_work_run(),
+ * so they may read editor state, but they must not modify anything that
+ * another item could be touching. The worker index passed to the function
+ * is in [0, yed_n_workers()) and is 0 for the calling thread, so it can be
+ * used to pick per-thread scratch space.
+ *
+ * The number of threads comes from the 'worker-threads' variable. If it
+ * isn't a number, one thread per CPU is used.
+ */
+
+#define MAX_WORKERS (16)
+
+typedef void (*yed_work_fn_t)(int item, int worker, void *arg);
+
+void yed_start_workers(void);
+void yed_stop_workers(void);
+int  yed_n_workers(void);
+void yed_work_run(int n_items, yed_work_fn_t fn, void *arg);
+
+#endif
@@ -176,8 +176,7 @@ void yed_draw_everything(void) {
     event.kind = EVENT_POST_DRAW_EVERYTHING;
     yed_trigger_event(&event);
 
-    yed_diff_and_swap_screens();
-    yed_render_screen();
+    yed_present_screen();
 }
 
 yed_state * yed_init(yed_lib_t *yed_lib, int argc, char **argv) {
@@ -238,9 +237,11 @@ yed_state * yed_init(yed_lib_t *yed_lib, int argc, char **argv) {
     yed_init_log();
     yed_init_frame_trees();
     yed_init_direct_draw();
+    yed_init_status_line();
     yed_term_enter();
     yed_term_get_dim(&ys->term_rows, &ys->term_cols);
     yed_init_screen();
+    yed_start_workers();
     yed_init_commands();
     yed_init_keys();
     yed_init_search();
@@ -280,6 +281,11 @@ void yed_fini(yed_state *state) {
 
     startup_time = state->start_time_ms;
 
+    yed_stop_grep_files();
+    yed_stop_dir_cache();
+    yed_stop_render_thread();
+    yed_stop_workers();
+
     printf(TERM_RESET);
     yed_term_exit();
 
@@ -304,6 +310,7 @@ int yed_pump(void) {
     int                  save_hz;
     int                  keys[16], n_keys, i;
     unsigned long long   start_us;
+    unsigned long long   drain_start_us;
     int                  skip_keys;
     int                  got_non_null_key;
 
@@ -321,6 +328,10 @@ int yed_pump(void) {
         save_hz = ys->update_hz;
         ys->update_hz = 0;
         yed_set_update_hz(save_hz);
+        if (yed_var_is_truthy("screen-render-thread")) {
+            yed_start_render_thread();
+        }
+        yed_start_workers();
     }
 
     ys->status = YED_NORMAL;
@@ -341,9 +352,26 @@ int yed_pump(void) {
                 : yed_read_keys(keys);
 
     got_non_null_key = 0;
-    for (i = 0; i < n_keys; i += 1) {
-        yed_take_key(keys[i]);
-        got_non_null_key |= !!keys[i];
+    drain_start_us   = measure_time_now_us();
+
+    /*
+     * Take every key that's already there before drawing, so that a paste
+     * or a replayed macro is drawn once and not once per key.
+     */
+    while (n_keys > 0) {
+        for (i = 0; i < n_keys; i += 1) {
+            yed_take_key(keys[i]);
+            got_non_null_key |= !!keys[i];
+        }
+
+        if (ys->status != YED_NORMAL
+        ||  ys->has_resized
+        ||  measure_time_now_us() - drain_start_us >= INPUT_MAX_DRAIN_US
+        ||  !yed_input_pending()) {
+            break;
+        }
+
+        n_keys = yed_read_keys(keys);
     }
 
     if (got_non_null_key && ys->update_hz >= MIN_UPDATE_HZ) {
@@ -377,6 +405,10 @@ LOG_EXIT();
         } else {
             yed_unload_plugin_libs();
             kill_update_forcer();
+            yed_stop_grep_files();
+            yed_stop_dir_cache();
+            yed_stop_render_thread();
+            yed_stop_workers();
         }
     }
 #endif